@@ -146,6 +146,7 @@ private:
 								bigtime_t timeout = B_INFINITE_TIMEOUT);
 			BMessage*		ReadMessageFromPort(
 								bigtime_t timeout = B_INFINITE_TIMEOUT);
+			void			_DrainPort();
 	virtual	BMessage*		ConvertToMessage(void* raw, int32 code);
 	virtual	void			task_looper();
 			void			_QuitRequested(BMessage* msg);
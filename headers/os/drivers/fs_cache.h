@@ -38,6 +38,8 @@ extern status_t cache_sync_transaction(void *cache, int32 id);
 extern status_t cache_end_transaction(void *cache, int32 id,
 					transaction_notification_hook hook, void *data);
 extern status_t cache_abort_transaction(void *cache, int32 id);
+extern status_t cache_hold_transaction_blocks(void *cache, int32 id);
+extern status_t cache_release_transaction_blocks(void *cache, int32 id);
 extern int32 cache_detach_sub_transaction(void *cache, int32 id,
 					transaction_notification_hook hook, void *data);
 extern status_t cache_abort_sub_transaction(void *cache, int32 id);
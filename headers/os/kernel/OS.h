@@ -179,6 +179,22 @@ extern status_t		_get_port_message_info_etc(port_id port,
 #define get_port_message_info_etc(port, info, flags, timeout) \
 	_get_port_message_info_etc((port), (info), sizeof(*(info)), flags, timeout)
 
+typedef struct port_message_vec {
+	int32		code;
+	void*		buffer;
+	size_t		size;
+		/* size of the buffer; read_port_messages_etc() sets it to the size
+		   of the message read */
+} port_message_vec;
+
+/* write or read several messages with a single call */
+extern ssize_t		write_port_messages_etc(port_id port,
+						const port_message_vec *messages, size_t count,
+						uint32 flags, bigtime_t timeout);
+extern ssize_t		read_port_messages_etc(port_id port,
+						port_message_vec *messages, size_t count, uint32 flags,
+						bigtime_t timeout);
+
 
 /* Semaphores */
 
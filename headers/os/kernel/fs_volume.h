@@ -13,6 +13,8 @@
 /* mount flags */
 #define B_MOUNT_READ_ONLY		1
 #define B_MOUNT_VIRTUAL_DEVICE	2
+#define B_MOUNT_NO_NEGATIVE_ENTRY_CACHE	4
+	/* don't cache lookups of entries that don't exist */
 
 /* unmount flags */
 #define B_FORCE_UNMOUNT			1
@@ -18,8 +18,17 @@
 // of the code, just read the beginning of the query constructor.
 // The API is not fully available, just the Query and the Expression class
 // are.
+//
+// The equation that is used to iterate over an index is chosen by its score,
+// ie. the estimated number of index entries that have to be visited. If the
+// policy can count the entries matching a value (IndexEstimateMatches()), the
+// score of "==" equations is exact, up to kMaxEstimatedMatches. The matching
+// nodes of such equations that are and-ed with the one being iterated are
+// collected in a sorted ID list up front, so that the candidates that
+// cannot match the query are skipped without loading them.
 
 #ifdef FS_SHELL
+#	include <algorithm>
 #	include <new>
 
 #	include "fssh_api_wrapper.h"
@@ -71,6 +80,9 @@
 namespace QueryParser {
 
 
+static const int32 kMaxEstimatedMatches = 4096;
+
+
 template<typename QueryPolicy> class Equation;
 template<typename QueryPolicy> class Expression;
 template<typename QueryPolicy> class Term;
@@ -147,6 +159,8 @@ public:
 
 private:
 			status_t		_GetNextEntry(struct dirent* dirent, size_t size);
+			void			_BuildFilter();
+			void			_DeleteFilter();
 			void			_SendEntryNotification(Entry* entry,
 								status_t (*notify)(port_id, int32, dev_t, ino_t,
 									const char*, ino_t));
@@ -158,6 +172,8 @@ private:
 			IndexIterator*	fIterator;
 			Index			fIndex;
 			Stack<Equation<QueryPolicy>*> fStack;
+			ino_t*			fFilter;
+			int32			fFilterCount;
 
 			uint32			fFlags;
 			port_id			fPort;
@@ -251,10 +267,15 @@ public:
 							IndexIterator** iterator, bool queryNonIndexed);
 			status_t	GetNextMatching(Context* context,
 							IndexIterator* iterator, struct dirent* dirent,
-							size_t bufferSize);
+							size_t bufferSize, const ino_t* filter = NULL,
+							int32 filterCount = -1);
+			status_t	CollectMatchingIDs(Context* context, Index& index,
+							ino_t*& _ids, int32& _count);
 
 	virtual	void		CalculateScore(Index &index);
 	virtual	int32		Score() const { return fScore; }
+			int32		EstimatedMatches() const
+							{ return fEstimatedMatches; }
 
 	virtual	bool		NeedsEntry();
 
@@ -270,6 +291,7 @@ private:
 			status_t	ConvertValue(type_code type, uint32 size);
 			bool		CompareTo(const uint8* value, size_t size);
 			uint8*		Value() const { return (uint8*)&fValue; }
+			int32		_SearchKeySize(Index& index);
 
 			char*		fAttribute;
 			char*		fString;
@@ -279,6 +301,7 @@ private:
 			bool		fIsPattern;
 
 			int32		fScore;
+			int32		fEstimatedMatches;
 			bool		fHasIndex;
 };
 
@@ -368,8 +391,10 @@ Equation<QueryPolicy>::Equation(const char** expr)
 	fAttribute(NULL),
 	fString(NULL),
 	fType(0),
+	fSize(0),
 	fIsPattern(false),
-	fScore(INT32_MAX)
+	fScore(INT32_MAX),
+	fEstimatedMatches(-1)
 {
 	const char* string = *expr;
 	const char* start = string;
@@ -760,6 +785,8 @@ Equation<QueryPolicy>::CalculateScore(Index &index)
 	// As always, these values could be tuned and refined.
 	// And the code could also need some real world testing :-)
 
+	fEstimatedMatches = -1;
+
 	// do we have to operate on a "foreign" index?
 	if (QueryPolicy::IndexSetTo(index, fAttribute) < B_OK) {
 		fScore = INT32_MAX;
@@ -783,8 +810,22 @@ Equation<QueryPolicy>::CalculateScore(Index &index)
 	} else {
 		// Score by operator
 		if (Term<QueryPolicy>::fOp == OP_EQUAL) {
+			// the value needs to be converted to the index type to know
+			// its size
+			int32 keySize = _SearchKeySize(index);
+
 			// higher than most patterns
-			fScore /= (fSize > 8) ? 8 : fSize;
+			if (fSize > 1)
+				fScore /= (fSize > 8) ? 8 : fSize;
+
+			// If the index can tell, use the actual number of matching
+			// entries instead
+			if (keySize > 0) {
+				fEstimatedMatches = QueryPolicy::IndexEstimateMatches(index,
+					Value(), keySize, kMaxEstimatedMatches);
+				if (fEstimatedMatches >= 0 && fEstimatedMatches < fScore)
+					fScore = fEstimatedMatches;
+			}
 		} else {
 			// better than nothing, anyway
 			fScore /= 2;
@@ -793,6 +834,97 @@ Equation<QueryPolicy>::CalculateScore(Index &index)
 }
 
 
+/*!	Converts the value to the type of \a index, and returns the size of the
+	key to look up in the index, or a negative error code.
+*/
+template<typename QueryPolicy>
+int32
+Equation<QueryPolicy>::_SearchKeySize(Index& index)
+{
+	int32 keySize = QueryPolicy::IndexGetKeySize(index);
+	if (ConvertValue(QueryPolicy::IndexGetType(index), keySize) != B_OK)
+		return B_BAD_VALUE;
+
+	if (keySize == 0) {
+		if (fType != B_STRING_TYPE)
+			return B_BAD_VALUE;
+
+		// see PrepareQuery() for the empty string
+		keySize = strlen(fValue.String);
+		if (keySize == 0)
+			keySize = 1;
+	}
+	return keySize;
+}
+
+
+/*!	Collects the IDs of all nodes that match this "==" equation in \a _ids,
+	sorted in ascending order. The caller is responsible for freeing the
+	array. If there are more than kMaxEstimatedMatches of them, the
+	method fails with \c B_BUFFER_OVERFLOW.
+*/
+template<typename QueryPolicy>
+status_t
+Equation<QueryPolicy>::CollectMatchingIDs(Context* context, Index& index,
+	ino_t*& _ids, int32& _count)
+{
+	if (Term<QueryPolicy>::fOp != OP_EQUAL || fIsPattern)
+		return B_BAD_VALUE;
+
+	status_t status = QueryPolicy::IndexSetTo(index, fAttribute);
+	if (status != B_OK)
+		return status;
+
+	int32 keySize = _SearchKeySize(index);
+	if (keySize < 0)
+		return keySize;
+
+	IndexIterator* iterator = QueryPolicy::IndexCreateIterator(index);
+	if (iterator == NULL)
+		return B_NO_MEMORY;
+
+	ino_t* ids = (ino_t*)malloc(kMaxEstimatedMatches * sizeof(ino_t));
+	if (ids == NULL) {
+		QueryPolicy::IndexIteratorDelete(iterator);
+		return B_NO_MEMORY;
+	}
+
+	int32 count = 0;
+	status = QueryPolicy::IndexIteratorFind(iterator, Value(), keySize);
+	while (status == B_OK) {
+		union value<QueryPolicy> indexValue;
+		size_t keyLength;
+		size_t duplicate = 0;
+
+		status = QueryPolicy::IndexIteratorFetchNextEntry(iterator,
+			&indexValue, &keyLength, (size_t)sizeof(indexValue), &duplicate);
+		if (status != B_OK || !CompareTo((uint8*)&indexValue, keyLength))
+			break;
+
+		if (count == kMaxEstimatedMatches) {
+			status = B_BUFFER_OVERFLOW;
+			break;
+		}
+
+		status = QueryPolicy::IndexIteratorGetEntryID(iterator, &ids[count]);
+		count++;
+	}
+
+	QueryPolicy::IndexIteratorDelete(iterator);
+
+	if (status != B_OK && status != B_ENTRY_NOT_FOUND) {
+		free(ids);
+		return status;
+	}
+
+	std::sort(ids, ids + count);
+
+	_ids = ids;
+	_count = count;
+	return B_OK;
+}
+
+
 template<typename QueryPolicy>
 status_t
 Equation<QueryPolicy>::PrepareQuery(Context* /*context*/, Index& index,
@@ -886,10 +1018,15 @@ Equation<QueryPolicy>::PrepareQuery(Context* /*context*/, Index& index,
 }
 
 
+/*!	Returns the next entry of \a iterator that matches the query. If
+	\a filterCount is not negative, only the nodes in the sorted \a filter
+	array are considered.
+*/
 template<typename QueryPolicy>
 status_t
 Equation<QueryPolicy>::GetNextMatching(Context* context,
-	IndexIterator* iterator, struct dirent* dirent, size_t bufferSize)
+	IndexIterator* iterator, struct dirent* dirent, size_t bufferSize,
+	const ino_t* filter, int32 filterCount)
 {
 	while (true) {
 		NodeHolder nodeHolder;
@@ -919,6 +1056,15 @@ Equation<QueryPolicy>::GetNextMatching(Context* context,
 			continue;
 		}
 
+		if (filterCount >= 0) {
+			// don't bother loading nodes that can't match the rest of the
+			// query anyway
+			ino_t id;
+			if (QueryPolicy::IndexIteratorGetEntryID(iterator, &id) == B_OK
+				&& !std::binary_search(filter, filter + filterCount, id))
+				continue;
+		}
+
 		Entry* entry = NULL;
 		status = QueryPolicy::IndexIteratorGetEntry(context, iterator,
 			nodeHolder, &entry);
@@ -1415,6 +1561,8 @@ Query<QueryPolicy>::Query(Context* context, Expression<QueryPolicy>* expression,
 	fCurrent(NULL),
 	fIterator(NULL),
 	fIndex(context),
+	fFilter(NULL),
+	fFilterCount(-1),
 	fFlags(flags),
 	fPort(port),
 	fToken(token),
@@ -1439,6 +1587,7 @@ Query<QueryPolicy>::Query(Context* context, Expression<QueryPolicy>* expression,
 template<typename QueryPolicy>
 Query<QueryPolicy>::~Query()
 {
+	_DeleteFilter();
 	delete fExpression;
 }
 
@@ -1486,6 +1635,7 @@ Query<QueryPolicy>::Rewind()
 	QueryPolicy::IndexIteratorDelete(fIterator);
 	fIterator = NULL;
 	fCurrent = NULL;
+	_DeleteFilter();
 
 	// put the whole expression on the stack
 
@@ -1661,16 +1811,19 @@ Query<QueryPolicy>::_GetNextEntry(struct dirent* dirent, size_t size)
 
 			if (status != B_OK)
 				return status;
+
+			_BuildFilter();
 		}
 		if (fCurrent == NULL)
 			QUERY_RETURN_ERROR(B_ERROR);
 
 		status_t status = fCurrent->GetNextMatching(fContext, fIterator, dirent,
-			size);
+			size, fFilter, fFilterCount);
 		if (status != B_OK) {
 			QueryPolicy::IndexIteratorDelete(fIterator);
 			fIterator = NULL;
 			fCurrent = NULL;
+			_DeleteFilter();
 		} else {
 			// only return if we have another entry
 			return B_OK;
@@ -1679,6 +1832,75 @@ Query<QueryPolicy>::_GetNextEntry(struct dirent* dirent, size_t size)
 }
 
 
+/*!	Intersects the nodes matching all "==" equations that are and-ed with the
+	current one, and whose number of matches is known to be small. The
+	result is used to filter the entries of the current equation.
+*/
+template<typename QueryPolicy>
+void
+Query<QueryPolicy>::_BuildFilter()
+{
+	_DeleteFilter();
+
+	Term<QueryPolicy>* term = fCurrent;
+	Operator<QueryPolicy>* parent;
+	while ((parent = (Operator<QueryPolicy>*)term->Parent()) != NULL) {
+		Term<QueryPolicy>* other = parent->Right();
+		if (other == term)
+			other = parent->Left();
+		term = parent;
+
+		if (parent->Op() != OP_AND || other->Op() <= OP_EQUATION)
+			continue;
+
+		Equation<QueryPolicy>* equation = (Equation<QueryPolicy>*)other;
+		if (equation->EstimatedMatches() < 0)
+			continue;
+
+		Index index(fContext);
+		ino_t* ids;
+		int32 count;
+		status_t status = equation->CollectMatchingIDs(fContext, index, ids,
+			count);
+		QueryPolicy::IndexUnset(index);
+		if (status != B_OK)
+			continue;
+
+		if (fFilter == NULL) {
+			fFilter = ids;
+			fFilterCount = count;
+			continue;
+		}
+
+		// both arrays are sorted, so this can be done in place
+		int32 filterCount = 0;
+		for (int32 i = 0, j = 0; i < fFilterCount && j < count;) {
+			if (fFilter[i] < ids[j])
+				i++;
+			else if (ids[j] < fFilter[i])
+				j++;
+			else {
+				fFilter[filterCount++] = fFilter[i];
+				i++;
+				j++;
+			}
+		}
+		fFilterCount = filterCount;
+		free(ids);
+	}
+}
+
+
+template<typename QueryPolicy>
+void
+Query<QueryPolicy>::_DeleteFilter()
+{
+	free(fFilter);
+	fFilter = NULL;
+	fFilterCount = -1;
+}
+
+
 template<typename QueryPolicy>
 void
 Query<QueryPolicy>::_SendEntryNotification(Entry* entry,
@@ -829,6 +829,8 @@
 #define cache_sync_transaction			fssh_cache_sync_transaction
 #define cache_end_transaction			fssh_cache_end_transaction
 #define cache_abort_transaction			fssh_cache_abort_transaction
+#define cache_hold_transaction_blocks	fssh_cache_hold_transaction_blocks
+#define cache_release_transaction_blocks fssh_cache_release_transaction_blocks
 #define cache_detach_sub_transaction	fssh_cache_detach_sub_transaction
 #define cache_abort_sub_transaction		fssh_cache_abort_sub_transaction
 #define cache_start_sub_transaction		fssh_cache_start_sub_transaction
@@ -38,6 +38,10 @@ extern fssh_status_t	fssh_cache_end_transaction(void *_cache, int32_t id,
 							fssh_transaction_notification_hook hook,
 							void *data);
 extern fssh_status_t	fssh_cache_abort_transaction(void *_cache, int32_t id);
+extern fssh_status_t	fssh_cache_hold_transaction_blocks(void *_cache,
+							int32_t id);
+extern fssh_status_t	fssh_cache_release_transaction_blocks(void *_cache,
+							int32_t id);
 extern int32_t			fssh_cache_detach_sub_transaction(void *_cache,
 							int32_t id, fssh_transaction_notification_hook hook,
 							void *data);
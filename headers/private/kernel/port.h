@@ -14,6 +14,8 @@ struct select_info;
 
 
 #define PORT_FLAG_USE_USER_MEMCPY 0x80000000
+#define PORT_FLAG_NO_TRUNCATE 0x40000000
+	// read_port_etc() fails with B_BUFFER_OVERFLOW instead of truncating
 
 // port flags
 enum {
@@ -45,6 +47,10 @@ status_t deselect_port(int32 object, struct select_info *info, bool kernel);
 status_t writev_port_etc(port_id id, int32 msgCode, const iovec *msgVecs,
 				size_t vecCount, size_t bufferSize, uint32 flags,
 				bigtime_t timeout);
+ssize_t write_port_messages_etc(port_id id, const port_message_vec *messages,
+				size_t count, uint32 flags, bigtime_t timeout);
+ssize_t read_port_messages_etc(port_id id, port_message_vec *messages,
+				size_t count, uint32 flags, bigtime_t timeout);
 
 // user syscalls
 port_id		_user_create_port(int32 queueLength, const char *name);
@@ -70,6 +76,12 @@ status_t	_user_writev_port_etc(port_id id, int32 msgCode,
 status_t	_user_get_port_message_info_etc(port_id port,
 				port_message_info *info, size_t infoSize, uint32 flags,
 				bigtime_t timeout);
+ssize_t		_user_write_port_messages_etc(port_id port,
+				const port_message_vec *messages, size_t count,
+				uint32 flags, bigtime_t timeout);
+ssize_t		_user_read_port_messages_etc(port_id port,
+				port_message_vec *messages, size_t count, uint32 flags,
+				bigtime_t timeout);
 
 #ifdef __cplusplus
 }
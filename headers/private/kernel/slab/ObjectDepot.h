@@ -21,14 +21,39 @@ typedef struct object_depot {
 	size_t					full_count;
 	size_t					empty_count;
 	size_t					max_count;
-	size_t					magazine_capacity;
+	int32					magazine_capacity;
+		// changed under the inner lock, but read without it
+	size_t					min_capacity;
+	size_t					max_capacity;
 	struct depot_cpu_store*	stores;
+	void*					stores_allocation;
 	void*					cookie;
 
+	// adapting the magazine capacity, protected by the inner lock
+	uint32					window_exchanges;
+	uint32					window_contentions;
+	bigtime_t				window_start;
+	uint64					exchanges;
+	uint64					contentions;
+	uint32					resizes;
+
 	void (*return_object)(struct object_depot* depot, void* cookie,
 		void* object, uint32 flags);
 } object_depot;
 
+typedef struct object_depot_info {
+	size_t					magazine_capacity;
+	size_t					full_magazines;
+	size_t					empty_magazines;
+	uint64					obtain_hits;
+	uint64					obtain_misses;
+	uint64					store_hits;
+	uint64					store_misses;
+	uint64					exchanges;
+	uint64					contentions;
+	uint32					resizes;
+} object_depot_info;
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +70,8 @@ void object_depot_store(object_depot* depot, void* object, uint32 flags);
 
 void object_depot_make_empty(object_depot* depot, uint32 flags);
 
+void object_depot_get_info(object_depot* depot, object_depot_info* info);
+
 #if PARANOID_KERNEL_FREE
 bool object_depot_contains_object(object_depot* depot, void* object);
 #endif
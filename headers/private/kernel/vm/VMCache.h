@@ -115,6 +115,11 @@ public:
 			void				MovePage(vm_page* page);
 			void				MoveAllPages(VMCache* fromCache);
 
+			void				AddShadowEntry(page_num_t offset,
+									uint32 evictionTime);
+			bool				RemoveShadowEntry(page_num_t offset,
+									uint32& _evictionTime);
+
 	inline	page_num_t			WiredPagesCount() const;
 	inline	void				IncrementWiredPagesCount();
 	inline	void				DecrementWiredPagesCount();
@@ -229,6 +234,7 @@ private:
 			void*				fUserData;
 			VMCacheRef*			fCacheRef;
 			page_num_t			fWiredPagesCount;
+			uint32				fShadowID;
 };
 
 
@@ -380,7 +386,7 @@ vm_page::DecrementWiredCount()
 {
 	ASSERT_PRINT(fWiredCount > 0, "page: %#" B_PRIx64, physical_page_number * B_PAGE_SIZE);
 
-	if (--fWiredCount == 0)
+	if (--fWiredCount == 0 && cache_ref != NULL)
 		cache_ref->cache->DecrementWiredPagesCount();
 }
 
@@ -78,6 +78,11 @@ public:
 
 	virtual	void				Flush() = 0;
 
+	// large pages (map locked)
+	virtual	size_t				LargePageSize() const;
+	virtual	status_t			CollapseLargePage(addr_t address);
+	virtual	void				SplitLargePages(addr_t start, addr_t end);
+
 	// backends for KDL commands
 	virtual	void				DebugPrintMappingInfo(addr_t virtualAddress);
 	virtual	bool				DebugGetReverseMappingInfo(
@@ -44,6 +44,16 @@ typedef struct net_buffer {
 	uint16					buffer_flags;
 } net_buffer;
 
+/*!	Memory that can be attached to a net_buffer without copying it; see
+	net_buffer_module_info::append_external().
+*/
+typedef struct net_external_vec {
+	const void*		data;
+	size_t			length;
+	void			(*release)(void* cookie);
+	void*			cookie;
+} net_external_vec;
+
 struct ancillary_data_container;
 
 struct net_buffer_module_info {
@@ -108,6 +118,10 @@ struct net_buffer_module_info {
 	void			(*swap_addresses)(net_buffer* buffer);
 
 	void			(*dump)(net_buffer* buffer);
+
+	status_t		(*append_external)(net_buffer* buffer, const void* data,
+						size_t bytes, void (*release)(void* cookie),
+						void* cookie);
 };
 
 
@@ -113,6 +113,9 @@ struct net_socket_module_info {
 	int			(*shutdown)(net_socket* socket, int direction);
 	status_t	(*socketpair)(int family, int type, int protocol,
 					net_socket* _sockets[2]);
+
+	ssize_t		(*send_external)(net_socket* socket,
+					const net_external_vec* vecs, uint32 count, int flags);
 };
 
 
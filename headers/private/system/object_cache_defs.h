@@ -0,0 +1,41 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef _SYSTEM_OBJECT_CACHE_DEFS_H
+#define _SYSTEM_OBJECT_CACHE_DEFS_H
+
+#include <OS.h>
+
+
+#define OBJECT_CACHE_SYSCALLS		"object caches"
+#define GET_OBJECT_CACHE_INFOS		0x01
+	// fills the buffer with as many object_cache_info structures as fit,
+	// and returns the total number of object caches
+
+
+#define OBJECT_CACHE_HAS_DEPOT		0x01
+
+typedef struct object_cache_info {
+	char		name[32];
+	uint32		flags;
+	size_t		object_size;
+	size_t		total_objects;
+	size_t		used_objects;
+	size_t		usage;
+	size_t		magazine_capacity;
+	size_t		full_magazines;
+	uint64		alloc_hits;
+		// allocations served from a per-CPU magazine
+	uint64		alloc_misses;
+	uint64		free_hits;
+	uint64		free_misses;
+	uint64		depot_exchanges;
+		// how often a CPU had to exchange magazines with the depot
+	uint64		depot_contentions;
+		// how often this had to wait for another CPU
+	uint32		magazine_resizes;
+} object_cache_info;
+
+
+#endif	/* _SYSTEM_OBJECT_CACHE_DEFS_H */
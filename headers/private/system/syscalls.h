@@ -378,6 +378,8 @@ extern ssize_t		_kern_sendto(int socket, const void *data, size_t length,
 						socklen_t addressLength);
 extern ssize_t		_kern_sendmsg(int socket, const struct msghdr *message,
 						int flags);
+extern ssize_t		_kern_sendfile(int socket, int fd, off_t pos,
+						size_t length, int flags);
 extern status_t		_kern_getsockopt(int socket, int level, int option,
 						void *value, socklen_t *_length);
 extern status_t		_kern_setsockopt(int socket, int level, int option,
@@ -490,6 +492,12 @@ extern status_t		_kern_writev_port_etc(port_id id, int32 msgCode,
 extern status_t		_kern_get_port_message_info_etc(port_id port,
 						port_message_info *info, size_t infoSize, uint32 flags,
 						bigtime_t timeout);
+extern ssize_t		_kern_write_port_messages_etc(port_id port,
+						const port_message_vec *messages, size_t count,
+						uint32 flags, bigtime_t timeout);
+extern ssize_t		_kern_read_port_messages_etc(port_id port,
+						port_message_vec *messages, size_t count, uint32 flags,
+						bigtime_t timeout);
 
 // debug support functions
 extern status_t		_kern_kernel_debugger(const char *message);
@@ -12,6 +12,8 @@
 
 #include "BPlusTree.h"
 
+#include <algorithm>
+
 #include <file_systems/QueryParserUtils.h>
 
 #include "Debug.h"
@@ -483,32 +485,14 @@ CachedNode::Free(Transaction& transaction, off_t offset)
 	if (fTree == NULL || fTree->fStream == NULL || offset == BPLUSTREE_NULL)
 		RETURN_ERROR(B_BAD_VALUE);
 
-	// TODO: scan the free nodes list and remove all nodes at the end
-	// of the tree - perhaps that shouldn't be done everytime that
-	// function is called, perhaps it should be done when the directory
-	// inode is closed or based on some calculation or whatever...
+	// Free nodes at the end of the stream are cut off after the removal
+	// by BPlusTree::_TrimFreeNodes(), as the caller might still use them.
 
 	CachedNode cached(fTree);
 	bplustree_header* header = cached.SetToWritableHeader(transaction);
 	if (header == NULL)
 		return B_IO_ERROR;
 
-#if 0
-	// TODO: temporarily disabled because CheckNode() doesn't like this...
-	// 		Also, it's such an edge case that it's almost useless, anyway.
-	// if the node is the last one in the tree, we shrink
-	// the tree and file size by one node
-	off_t lastOffset = header->MaximumSize() - fTree->fNodeSize;
-	if (offset == lastOffset) {
-		status_t status = fTree->fStream->SetFileSize(transaction, lastOffset);
-		if (status != B_OK)
-			return status;
-
-		header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(lastOffset);
-		return B_OK;
-	}
-#endif
-
 	// add the node to the free nodes list
 	fNode->left_link = header->free_node_pointer;
 	fNode->overflow_link = HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_FREE);
@@ -990,6 +974,22 @@ BPlusTree::_UpdateIterators(off_t offset, off_t nextOffset, uint16 keyIndex,
 }
 
 
+/*!	Updates all iterators after the node at \a offset has been merged into
+	the one at \a targetOffset, in front of its \a count keys.
+*/
+void
+BPlusTree::_UpdateIteratorsMerged(off_t offset, off_t targetOffset,
+	uint16 count)
+{
+	MutexLocker _(fIteratorLock);
+
+	SinglyLinkedList<TreeIterator>::ConstIterator iterator
+		= fIterators.GetIterator();
+	while (iterator.HasNext())
+		iterator.Next()->Merged(offset, targetOffset, count);
+}
+
+
 void
 BPlusTree::_AddIterator(TreeIterator* iterator)
 {
@@ -1677,6 +1677,18 @@ BPlusTree::_SplitNode(bplustree_node* node, off_t nodeOffset,
 status_t
 BPlusTree::Insert(Transaction& transaction, const uint8* key, uint16 keyLength,
 	off_t value)
+{
+	status_t status = _Insert(transaction, key, keyLength, value);
+	if (status == B_OK && !fAllowDuplicates)
+		fStream->DirectoryEntryAdded(key, keyLength, value);
+
+	return status;
+}
+
+
+status_t
+BPlusTree::_Insert(Transaction& transaction, const uint8* key,
+	uint16 keyLength, off_t value)
 {
 	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
 		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
@@ -1918,6 +1930,41 @@ BPlusTree::_RemoveDuplicate(Transaction& transaction,
 	if (duplicate == NULL)
 		RETURN_ERROR(B_IO_ERROR);
 
+	// If the remaining values fit into one of its siblings, move them there,
+	// so that the node can be freed below
+
+	if (arrayCount > 0) {
+		off_t siblings[2] = { duplicate->RightLink(), duplicate->LeftLink() };
+		for (int32 i = 0; i < 2; i++) {
+			if (siblings[i] == BPLUSTREE_NULL)
+				continue;
+
+			CachedNode cachedSibling(this);
+			const bplustree_node* sibling = cachedSibling.SetTo(siblings[i],
+				false);
+			if (sibling == NULL)
+				return B_IO_ERROR;
+
+			int32 siblingCount = sibling->DuplicateArray()->Count();
+			if (siblingCount < 0
+				|| siblingCount + arrayCount > NUM_DUPLICATE_VALUES)
+				continue;
+
+			bplustree_node* writableSibling
+				= cachedSibling.MakeWritable(transaction);
+			if (writableSibling == NULL)
+				return B_IO_ERROR;
+
+			duplicate_array* siblingArray = writableSibling->DuplicateArray();
+			for (int32 j = 0; j < arrayCount; j++)
+				siblingArray->Insert(array->ValueAt(j));
+
+			array->count = 0;
+			arrayCount = 0;
+			break;
+		}
+	}
+
 	// The entry got removed from the duplicate node, but we might want to free
 	// it now in case it's empty
 
@@ -2097,6 +2144,25 @@ BPlusTree::_RemoveKey(bplustree_node* node, uint16 index)
 status_t
 BPlusTree::Remove(Transaction& transaction, const uint8* key, uint16 keyLength,
 	off_t value)
+{
+	status_t status = _Remove(transaction, key, keyLength, value);
+	if (status != B_OK)
+		return status;
+
+	if (!fAllowDuplicates)
+		fStream->DirectoryEntryRemoved(key, keyLength);
+
+	// Give back the nodes at the end of the stream that are no longer used
+	if (fHeader.FreeNode() != BPLUSTREE_NULL)
+		return _TrimFreeNodes(transaction);
+
+	return B_OK;
+}
+
+
+status_t
+BPlusTree::_Remove(Transaction& transaction, const uint8* key,
+	uint16 keyLength, off_t value)
 {
 	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
 		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
@@ -2185,7 +2251,9 @@ BPlusTree::Remove(Transaction& transaction, const uint8* key, uint16 keyLength,
 		if (writableNode->NumKeys() > 1
 			|| (!writableNode->IsLeaf() && writableNode->NumKeys() == 1)) {
 			_RemoveKey(writableNode, nodeAndKey.keyIndex);
-			return B_OK;
+			cached.Unset();
+
+			return _Rebalance(transaction, stack, nodeAndKey.nodeOffset);
 		}
 
 		// when we are here, we can just free the node, but
@@ -2208,6 +2276,299 @@ BPlusTree::Remove(Transaction& transaction, const uint8* key, uint16 keyLength,
 }
 
 
+/*!	Merges the node at \a nodeOffset with one of its siblings if it has
+	become less than a quarter full, and continues to do so with its
+	parents as long as they lose keys that way. If the root node is left with
+	only its overflow link, its only child becomes the new root, and the tree
+	loses a level.
+	\a stack must contain the parents of the node, as left by _SeekDown().
+*/
+status_t
+BPlusTree::_Rebalance(Transaction& transaction, Stack<node_and_key>& stack,
+	off_t nodeOffset)
+{
+	CachedNode cached(this);
+
+	while (true) {
+		const bplustree_node* node = cached.SetTo(nodeOffset);
+		if (node == NULL)
+			return B_IO_ERROR;
+
+		if (nodeOffset == fHeader.RootNode()) {
+			if (node->IsLeaf() || node->NumKeys() > 0)
+				return B_OK;
+
+			// The root only has a single child left
+			off_t child = node->OverflowLink();
+
+			CachedNode cachedHeader(this);
+			bplustree_header* header
+				= cachedHeader.SetToWritableHeader(transaction);
+			if (header == NULL)
+				return B_IO_ERROR;
+
+			header->root_node_pointer = HOST_ENDIAN_TO_BFS_INT64(child);
+			header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(
+				header->MaxNumberOfLevels() - 1);
+			cachedHeader.Unset();
+
+			if (cached.MakeWritable(transaction) == NULL)
+				return B_IO_ERROR;
+
+			status_t status = cached.Free(transaction, nodeOffset);
+			if (status != B_OK)
+				return status;
+
+			nodeOffset = child;
+			continue;
+		}
+
+		if (node->Used() >= fNodeSize / 4)
+			return B_OK;
+
+		node_and_key parentAndKey;
+		if (!stack.Pop(&parentAndKey))
+			return B_OK;
+
+		cached.Unset();
+
+		CachedNode cachedParent(this);
+		const bplustree_node* parent = cachedParent.SetTo(
+			parentAndKey.nodeOffset);
+		if (parent == NULL)
+			return B_IO_ERROR;
+
+		// Always merge the left node into the right one; if our node is the
+		// overflow link of its parent, it has to be the right one
+		uint16 index = parentAndKey.keyIndex;
+		if (index >= parent->NumKeys()) {
+			if (parent->NumKeys() == 0) {
+				// We don't have any siblings, but our parent might
+				nodeOffset = parentAndKey.nodeOffset;
+				continue;
+			}
+			index = parent->NumKeys() - 1;
+		}
+
+		Unaligned<off_t>* values = parent->Values();
+		off_t leftOffset = BFS_ENDIAN_TO_HOST_INT64(values[index]);
+		off_t rightOffset = index + 1 < parent->NumKeys()
+			? BFS_ENDIAN_TO_HOST_INT64(values[index + 1])
+			: parent->OverflowLink();
+
+		bool merged;
+		status_t status = _MergeNodes(transaction, parent, index, leftOffset,
+			rightOffset, merged);
+		if (status != B_OK || !merged)
+			return status;
+
+		// The left node is gone, and so is its key in the parent
+		bplustree_node* writableParent = cachedParent.MakeWritable(transaction);
+		if (writableParent == NULL)
+			return B_IO_ERROR;
+
+		_RemoveKey(writableParent, index);
+		nodeOffset = parentAndKey.nodeOffset;
+	}
+}
+
+
+/*!	Moves all keys of the node at \a leftOffset in front of the keys of its
+	right sibling at \a rightOffset, and frees it, if the resulting node would
+	not be more than three quarters full.
+	\a index is the index of the left node in \a parent; for index nodes, the
+	key at that index is needed to separate the keys of both nodes.
+	The caller is responsible to remove that key from the parent afterwards.
+*/
+status_t
+BPlusTree::_MergeNodes(Transaction& transaction, const bplustree_node* parent,
+	uint16 index, off_t leftOffset, off_t rightOffset, bool& _merged)
+{
+	_merged = false;
+
+	CachedNode cachedLeft(this);
+	const bplustree_node* left = cachedLeft.SetTo(leftOffset);
+	if (left == NULL)
+		return B_IO_ERROR;
+
+	CachedNode cachedRight(this);
+	const bplustree_node* right = cachedRight.SetTo(rightOffset);
+	if (right == NULL)
+		return B_IO_ERROR;
+
+	bool isLeaf = left->IsLeaf();
+	if (isLeaf != right->IsLeaf() || left->RightLink() != rightOffset)
+		RETURN_ERROR(B_BAD_DATA);
+
+	// An index node gets the parent's key for its overflow link
+	uint16 separatorLength = 0;
+	const uint8* separator = NULL;
+	if (!isLeaf) {
+		separator = parent->KeyAt(index, &separatorLength);
+		if (separatorLength > BPLUSTREE_MAX_KEY_LENGTH)
+			RETURN_ERROR(B_BAD_DATA);
+	}
+
+	int32 leftCount = left->NumKeys();
+	int32 count = leftCount + right->NumKeys() + (isLeaf ? 0 : 1);
+	int32 leftLength = left->AllKeyLength() + separatorLength;
+	int32 length = leftLength + right->AllKeyLength();
+
+	if (int32(key_align(sizeof(bplustree_node) + length)
+			+ count * (sizeof(uint16) + sizeof(off_t))) > fNodeSize * 3 / 4)
+		return B_OK;
+
+	bplustree_node* merged = (bplustree_node*)malloc(fNodeSize);
+	if (merged == NULL)
+		return B_NO_MEMORY;
+
+	memset(merged, 0, fNodeSize);
+	merged->left_link = left->left_link;
+	merged->right_link = right->right_link;
+	merged->overflow_link = right->overflow_link;
+	merged->all_key_count = HOST_ENDIAN_TO_BFS_INT16(count);
+	merged->all_key_length = HOST_ENDIAN_TO_BFS_INT16(length);
+
+	uint8* keys = merged->Keys();
+	memcpy(keys, left->Keys(), left->AllKeyLength());
+	if (separator != NULL)
+		memcpy(keys + left->AllKeyLength(), separator, separatorLength);
+	memcpy(keys + leftLength, right->Keys(), right->AllKeyLength());
+
+	Unaligned<uint16>* keyLengths = merged->KeyLengths();
+	Unaligned<off_t>* values = merged->Values();
+	Unaligned<uint16>* leftKeyLengths = left->KeyLengths();
+	Unaligned<off_t>* leftValues = left->Values();
+	Unaligned<uint16>* rightKeyLengths = right->KeyLengths();
+	Unaligned<off_t>* rightValues = right->Values();
+
+	int32 i = 0;
+	for (; i < leftCount; i++) {
+		keyLengths[i] = leftKeyLengths[i];
+		values[i] = leftValues[i];
+	}
+	if (!isLeaf) {
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(leftLength);
+		values[i] = left->overflow_link;
+		i++;
+	}
+	for (int32 j = 0; i < count; i++, j++) {
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(
+			BFS_ENDIAN_TO_HOST_INT16(rightKeyLengths[j]) + leftLength);
+		values[i] = rightValues[j];
+	}
+
+	bplustree_node* writableRight = cachedRight.MakeWritable(transaction);
+	if (writableRight == NULL) {
+		free(merged);
+		return B_IO_ERROR;
+	}
+
+	memcpy(writableRight, merged, fNodeSize);
+	free(merged);
+
+	if (isLeaf)
+		_UpdateIteratorsMerged(leftOffset, rightOffset, leftCount);
+
+	// Link the left sibling to the merged node, and free the left node
+
+	off_t leftLeftOffset = left->LeftLink();
+	if (cachedLeft.MakeWritable(transaction) == NULL)
+		return B_IO_ERROR;
+
+	status_t status = cachedLeft.Free(transaction, leftOffset);
+	if (status != B_OK)
+		return status;
+
+	if (leftLeftOffset != BPLUSTREE_NULL) {
+		CachedNode cachedOther(this);
+		bplustree_node* other = cachedOther.SetToWritable(transaction,
+			leftLeftOffset);
+		if (other == NULL)
+			return B_IO_ERROR;
+
+		other->right_link = HOST_ENDIAN_TO_BFS_INT64(rightOffset);
+	}
+
+	_merged = true;
+	return B_OK;
+}
+
+
+/*!	Cuts off all free nodes at the end of the tree's stream, and removes them
+	from the free list.
+*/
+status_t
+BPlusTree::_TrimFreeNodes(Transaction& transaction)
+{
+	off_t size = fHeader.MaximumSize();
+	off_t end = size;
+
+	CachedNode cached(this);
+	while (end > 2 * fNodeSize) {
+		const bplustree_node* node = cached.SetTo(end - fNodeSize, false);
+		if (node == NULL)
+			return B_IO_ERROR;
+		if (node->OverflowLink() != BPLUSTREE_FREE)
+			break;
+
+		end -= fNodeSize;
+	}
+
+	if (end == size)
+		return B_OK;
+
+	CachedNode cachedHeader(this);
+	bplustree_header* header = cachedHeader.SetToWritableHeader(transaction);
+	if (header == NULL)
+		return B_IO_ERROR;
+
+	// Remove the nodes from the free list
+
+	CachedNode cachedPrevious(this);
+	off_t previous = BPLUSTREE_NULL;
+	off_t offset = header->FreeNode();
+	int32 maxCount = size / fNodeSize;
+
+	while (offset != BPLUSTREE_NULL) {
+		if (maxCount-- <= 0) {
+			FATAL(("free node list of inode %" B_PRIdOFF " is circular!\n",
+				fStream->ID()));
+			RETURN_ERROR(B_BAD_DATA);
+		}
+
+		const bplustree_node* node = cached.SetTo(offset, false);
+		if (node == NULL)
+			return B_IO_ERROR;
+
+		off_t next = node->LeftLink();
+		if (offset >= end) {
+			if (previous == BPLUSTREE_NULL)
+				header->free_node_pointer = HOST_ENDIAN_TO_BFS_INT64(next);
+			else {
+				bplustree_node* previousNode = cachedPrevious.SetToWritable(
+					transaction, previous, false);
+				if (previousNode == NULL)
+					return B_IO_ERROR;
+
+				previousNode->left_link = HOST_ENDIAN_TO_BFS_INT64(next);
+			}
+		} else
+			previous = offset;
+
+		offset = next;
+	}
+
+	header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(end);
+
+	cached.Unset();
+	cachedPrevious.Unset();
+	cachedHeader.Unset();
+
+	return fStream->SetFileSize(transaction, end);
+}
+
+
 /*!	Replaces the value for the key in the tree.
 	Returns B_OK if the key could be found and its value replaced,
 	B_ENTRY_NOT_FOUND if the key couldn't be found, and other errors
@@ -2247,6 +2608,7 @@ BPlusTree::Replace(Transaction& transaction, const uint8* key, uint16 keyLength,
 				if (writableNode != NULL) {
 					writableNode->Values()[keyIndex]
 						= HOST_ENDIAN_TO_BFS_INT64(value);
+					fStream->DirectoryEntryAdded(key, keyLength, value);
 				} else
 					status = B_IO_ERROR;
 			}
@@ -2876,6 +3238,17 @@ TreeIterator::Update(off_t offset, off_t nextOffset, uint16 keyIndex,
 }
 
 
+void
+TreeIterator::Merged(off_t offset, off_t targetOffset, uint16 count)
+{
+	// The keys of the merged node are put in front of the target's keys
+	if (fCurrentNodeOffset == targetOffset)
+		fCurrentKey += count;
+	else if (fCurrentNodeOffset == offset)
+		fCurrentNodeOffset = targetOffset;
+}
+
+
 void
 TreeIterator::Stop()
 {
@@ -2901,6 +3274,639 @@ TreeIterator::Dump()
 #endif
 
 
+#if !_BOOT_MODE
+//	#pragma mark - TreeBuilder
+
+
+static const size_t kBuilderChunkSize = 1024 * 1024;
+static const size_t kMaxBuilderMemory = 256 * 1024 * 1024;
+	// for all builders together
+static const int32 kBuilderGrowNodes = 256;
+static const uint32 kBuilderTransactionNodes = 1024;
+
+static int32 sBuilderMemory = 0;
+	// in KB
+
+
+struct TreeBuilder::entry {
+	off_t	value;
+	uint16	keyLength;
+	uint8	key[0];
+};
+
+struct TreeBuilder::chunk {
+	chunk*	next;
+	size_t	used;
+	uint8	data[0];
+};
+
+struct TreeBuilder::build_key {
+	const uint8*	key;
+	uint16			keyLength;
+	off_t			value;
+};
+
+struct TreeBuilder::EntryLess {
+	EntryLess(TreeBuilder* builder)
+		:
+		fBuilder(builder)
+	{
+	}
+
+	bool operator()(const entry* a, const entry* b) const
+	{
+		return fBuilder->_CompareEntries(a, b) < 0;
+	}
+
+	TreeBuilder*	fBuilder;
+};
+
+
+TreeBuilder::TreeBuilder(BPlusTree* tree)
+	:
+	fTree(tree),
+	fChunks(NULL),
+	fEntries(NULL),
+	fCount(0),
+	fCapacity(0),
+	fMemoryUsed(0),
+	fBuilt(false),
+	fLocked(false),
+	fNextOffset(0),
+	fFragmentOffset(BPLUSTREE_NULL),
+	fFragmentIndex(0),
+	fNodesWritten(0)
+{
+}
+
+
+TreeBuilder::~TreeBuilder()
+{
+	_FreeEntries();
+	_UnlockTree();
+}
+
+
+/*!	Adds the key/value pair to the tree. The key is only stored in memory
+	until Finish() is called; if the builder runs out of memory, it builds
+	the tree from what it has collected so far, and then falls back to
+	inserting the remaining keys directly.
+*/
+status_t
+TreeBuilder::Add(const uint8* key, uint16 keyLength, off_t value)
+{
+	if (keyLength < BPLUSTREE_MIN_KEY_LENGTH
+		|| keyLength > BPLUSTREE_MAX_KEY_LENGTH)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	if (fBuilt)
+		return _Insert(key, keyLength, value);
+
+	size_t size = round_up(sizeof(entry) + keyLength, sizeof(off_t));
+
+	if (fChunks == NULL || fChunks->used + size > kBuilderChunkSize) {
+		chunk* newChunk = NULL;
+		if (_ReserveMemory(kBuilderChunkSize))
+			newChunk = (chunk*)malloc(sizeof(chunk) + kBuilderChunkSize);
+		if (newChunk == NULL) {
+			status_t status = _Build();
+			if (status != B_OK)
+				return status;
+
+			return _Insert(key, keyLength, value);
+		}
+
+		newChunk->next = fChunks;
+		newChunk->used = 0;
+		fChunks = newChunk;
+	}
+
+	if (fCount == fCapacity) {
+		int32 capacity = max_c(fCapacity * 2, 1024);
+		entry** entries = NULL;
+		if (_ReserveMemory((capacity - fCapacity) * sizeof(entry*)))
+			entries = (entry**)realloc(fEntries, capacity * sizeof(entry*));
+		if (entries == NULL) {
+			status_t status = _Build();
+			if (status != B_OK)
+				return status;
+
+			return _Insert(key, keyLength, value);
+		}
+
+		fEntries = entries;
+		fCapacity = capacity;
+	}
+
+	entry* newEntry = (entry*)(fChunks->data + fChunks->used);
+	fChunks->used += size;
+
+	newEntry->value = value;
+	newEntry->keyLength = keyLength;
+	memcpy(newEntry->key, key, keyLength);
+
+	fEntries[fCount++] = newEntry;
+	return B_OK;
+}
+
+
+/*!	Writes out the tree from the keys that have been added so far. */
+status_t
+TreeBuilder::Finish()
+{
+	status_t status = B_OK;
+	if (!fBuilt)
+		status = _Build();
+
+	_UnlockTree();
+	return status;
+}
+
+
+int32
+TreeBuilder::_CompareEntries(const entry* a, const entry* b)
+{
+	int32 compare = fTree->_CompareKeys(a->key, a->keyLength, b->key,
+		b->keyLength);
+	if (compare != 0)
+		return compare;
+
+	return a->value < b->value ? -1 : (a->value > b->value ? 1 : 0);
+}
+
+
+bool
+TreeBuilder::_Fits(int32 count, int32 keyLength) const
+{
+	return int32(key_align(sizeof(bplustree_node) + keyLength)
+		+ count * (sizeof(uint16) + sizeof(off_t))) < fTree->fNodeSize;
+}
+
+
+status_t
+TreeBuilder::_Insert(const uint8* key, uint16 keyLength, off_t value)
+{
+	Inode* stream = fTree->fStream;
+	Transaction transaction(stream->GetVolume(), stream->BlockNumber());
+	stream->WriteLockInTransaction(transaction);
+
+	status_t status = fTree->Insert(transaction, key, keyLength, value);
+	if (status != B_OK)
+		return status;
+
+	return transaction.Done();
+}
+
+
+status_t
+TreeBuilder::_InsertEntries()
+{
+	for (int32 i = 0; i < fCount; i++) {
+		entry* current = fEntries[i];
+		status_t status = _Insert(current->key, current->keyLength,
+			current->value);
+		if (status != B_OK)
+			return status;
+	}
+	return B_OK;
+}
+
+
+/*!	Sorts all collected keys, and writes the tree out in one go: first all
+	duplicate arrays, then the leaves from left to right, and then each
+	level of index nodes on top of them. Since all nodes are written
+	sequentially into the stream, and are completely filled, the resulting
+	tree is also as compact as it can be.
+*/
+status_t
+TreeBuilder::_Build()
+{
+	fBuilt = true;
+
+	// If we ran out of memory, the remaining keys are inserted one by one
+	// after this, so the lock is only released by Finish()
+	_LockTree();
+
+	status_t status = fTree->MakeEmpty();
+	if (status != B_OK) {
+		_FreeEntries();
+		return status;
+	}
+
+	std::sort(fEntries, fEntries + fCount, EntryLess(this));
+
+	build_key* keys = (build_key*)malloc(max_c(fCount, 1) * sizeof(build_key));
+	if (keys == NULL) {
+		// Insert the keys the slow way, at least they are sorted now
+		status_t status = _InsertEntries();
+		_FreeEntries();
+		return status;
+	}
+
+	Inode* stream = fTree->fStream;
+	Transaction transaction(stream->GetVolume(), stream->BlockNumber());
+	stream->WriteLockInTransaction(transaction);
+
+	// All nodes of the (empty) tree are overwritten, starting with the first
+	// one after the header
+	CachedNode cached(fTree);
+	bplustree_header* header = cached.SetToWritableHeader(transaction);
+	if (header == NULL) {
+		free(keys);
+		_FreeEntries();
+		return B_IO_ERROR;
+	}
+
+	header->free_node_pointer
+		= HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
+	header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(stream->Size());
+	cached.Unset();
+
+	fNextOffset = fTree->fNodeSize;
+	fFragmentOffset = BPLUSTREE_NULL;
+	fNodesWritten = 0;
+
+	int32 count;
+	uint32 levels = 1;
+	status = _CollectKeys(transaction, keys, count);
+	if (status == B_OK)
+		status = _WriteLevel(transaction, keys, count, true);
+	while (status == B_OK && count > 1) {
+		status = _WriteLevel(transaction, keys, count, false);
+		levels++;
+	}
+
+	off_t root = keys[0].value;
+	free(keys);
+	_FreeEntries();
+
+	if (status != B_OK)
+		return status;
+
+	// Cut off the nodes we didn't need anymore
+	status = stream->SetFileSize(transaction, fNextOffset);
+	if (status != B_OK)
+		return status;
+
+	header = cached.SetToWritableHeader(transaction);
+	if (header == NULL)
+		return B_IO_ERROR;
+
+	header->root_node_pointer = HOST_ENDIAN_TO_BFS_INT64(root);
+	header->max_number_of_levels = HOST_ENDIAN_TO_BFS_INT32(levels);
+	header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(fNextOffset);
+	cached.Unset();
+
+	return transaction.Done();
+}
+
+
+/*!	Turns the sorted entries into the keys of the leaf nodes, and writes out
+	the duplicate arrays of all keys that have more than one value.
+*/
+status_t
+TreeBuilder::_CollectKeys(Transaction& transaction, build_key* keys,
+	int32& _count)
+{
+	int32 count = 0;
+
+	for (int32 first = 0; first < fCount;) {
+		entry* current = fEntries[first];
+
+		int32 last = first + 1;
+		while (last < fCount && fTree->_CompareKeys(current->key,
+				current->keyLength, fEntries[last]->key,
+				fEntries[last]->keyLength) == 0) {
+			last++;
+		}
+
+		off_t value = current->value;
+		int32 valueCount = last - first;
+		if (valueCount > 1) {
+			if (!fTree->fAllowDuplicates)
+				return B_NAME_IN_USE;
+
+			status_t status;
+			if (valueCount <= NUM_FRAGMENT_VALUES) {
+				status = _WriteFragment(transaction, fEntries + first,
+					valueCount, value);
+			} else {
+				status = _WriteDuplicates(transaction, fEntries + first,
+					valueCount, value);
+			}
+			if (status != B_OK)
+				return status;
+		}
+
+		keys[count].key = current->key;
+		keys[count].keyLength = current->keyLength;
+		keys[count].value = value;
+		count++;
+
+		first = last;
+	}
+
+	_count = count;
+	return B_OK;
+}
+
+
+status_t
+TreeBuilder::_WriteFragment(Transaction& transaction, entry** entries,
+	int32 count, off_t& _value)
+{
+	CachedNode cached(fTree);
+	bplustree_node* node;
+
+	if (fFragmentOffset == BPLUSTREE_NULL
+		|| fFragmentIndex >= bplustree_node::MaxFragments(fTree->fNodeSize)) {
+		status_t status = _AllocateNode(transaction, cached, &node,
+			&fFragmentOffset);
+		if (status != B_OK)
+			return status;
+
+		fFragmentIndex = 0;
+	} else {
+		node = cached.SetToWritable(transaction, fFragmentOffset, false);
+		if (node == NULL)
+			return B_IO_ERROR;
+	}
+
+	duplicate_array* array = node->FragmentAt(fFragmentIndex);
+	array->count = HOST_ENDIAN_TO_BFS_INT64(count);
+	for (int32 i = 0; i < count; i++)
+		array->SetValueAt(i, entries[i]->value);
+
+	_value = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_FRAGMENT,
+		fFragmentOffset, fFragmentIndex++);
+
+	cached.Unset();
+	return _NodeWritten(transaction);
+}
+
+
+status_t
+TreeBuilder::_WriteDuplicates(Transaction& transaction, entry** entries,
+	int32 count, off_t& _value)
+{
+	CachedNode cached(fTree);
+	off_t previous = BPLUSTREE_NULL;
+
+	for (int32 first = 0; first < count; first += NUM_DUPLICATE_VALUES) {
+		int32 valueCount = min_c(count - first, NUM_DUPLICATE_VALUES);
+
+		bplustree_node* node;
+		off_t offset;
+		status_t status = _AllocateNode(transaction, cached, &node, &offset);
+		if (status != B_OK)
+			return status;
+
+		// the duplicate nodes of a key are written in a row
+		node->left_link = HOST_ENDIAN_TO_BFS_INT64(previous);
+		if (first + valueCount < count)
+			node->right_link = HOST_ENDIAN_TO_BFS_INT64(fNextOffset);
+		else
+			node->right_link = HOST_ENDIAN_TO_BFS_INT64((uint64)BPLUSTREE_NULL);
+
+		duplicate_array* array = node->DuplicateArray();
+		array->count = HOST_ENDIAN_TO_BFS_INT64(valueCount);
+		for (int32 i = 0; i < valueCount; i++)
+			array->SetValueAt(i, entries[first + i]->value);
+
+		if (previous == BPLUSTREE_NULL) {
+			_value = bplustree_node::MakeLink(BPLUSTREE_DUPLICATE_NODE,
+				offset);
+		}
+		previous = offset;
+
+		cached.Unset();
+		status = _NodeWritten(transaction);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Writes a complete level of the tree from left to right, and replaces
+	\a keys with the keys for the next level, ie. the largest key of each
+	node written, and its offset.
+	If \a leaf is \c false, the last key of each node is not stored in it,
+	but its value becomes the node's overflow link.
+*/
+status_t
+TreeBuilder::_WriteLevel(Transaction& transaction, build_key* keys,
+	int32& _count, bool leaf)
+{
+	CachedNode cached(fTree);
+	int32 count = _count;
+	int32 parentCount = 0;
+	off_t previous = BPLUSTREE_NULL;
+	int32 first = 0;
+
+	do {
+		// Find out how many keys fit into this node
+		int32 end = leaf ? count : count - 1;
+		int32 last = first;
+		int32 keyLength = 0;
+		while (last < end
+			&& _Fits(last - first + 1, keyLength + keys[last].keyLength)) {
+			keyLength += keys[last].keyLength;
+			last++;
+		}
+
+		// An index node needs at least one key besides its overflow link,
+		// so make sure we don't leave a single child for the next one
+		if (!leaf && last + 2 == count && last - first > 1)
+			last--;
+
+		bool more = leaf ? last < count : last + 1 < count;
+
+		bplustree_node* node;
+		off_t offset;
+		status_t status = _AllocateNode(transaction, cached, &node, &offset);
+		if (status != B_OK)
+			return status;
+
+		node->left_link = HOST_ENDIAN_TO_BFS_INT64(previous);
+		node->right_link = HOST_ENDIAN_TO_BFS_INT64(
+			more ? fNextOffset : (uint64)BPLUSTREE_NULL);
+		node->overflow_link = HOST_ENDIAN_TO_BFS_INT64(
+			leaf ? (uint64)BPLUSTREE_NULL : keys[last].value);
+
+		_FillNode(node, keys + first, last - first);
+
+		// Remember the largest key of the node's subtree for its parent
+		build_key largest = { NULL, 0, 0 };
+		if (!leaf)
+			largest = keys[last++];
+		else if (last > first)
+			largest = keys[last - 1];
+
+		largest.value = offset;
+		keys[parentCount++] = largest;
+
+		previous = offset;
+		first = last;
+
+		cached.Unset();
+		status = _NodeWritten(transaction);
+		if (status != B_OK)
+			return status;
+	} while (first < count);
+
+	_count = parentCount;
+	return B_OK;
+}
+
+
+void
+TreeBuilder::_FillNode(bplustree_node* node, const build_key* keys,
+	int32 count)
+{
+	uint8* data = node->Keys();
+	uint16 length = 0;
+	for (int32 i = 0; i < count; i++) {
+		memcpy(data + length, keys[i].key, keys[i].keyLength);
+		length += keys[i].keyLength;
+	}
+
+	node->all_key_count = HOST_ENDIAN_TO_BFS_INT16(count);
+	node->all_key_length = HOST_ENDIAN_TO_BFS_INT16(length);
+
+	Unaligned<uint16>* keyLengths = node->KeyLengths();
+	Unaligned<off_t>* values = node->Values();
+
+	length = 0;
+	for (int32 i = 0; i < count; i++) {
+		length += keys[i].keyLength;
+		keyLengths[i] = HOST_ENDIAN_TO_BFS_INT16(length);
+		values[i] = HOST_ENDIAN_TO_BFS_INT64(keys[i].value);
+	}
+}
+
+
+/*!	Returns the next node in the stream, and grows the stream if needed.
+	The node is cleared, and \a cached is set to it.
+*/
+status_t
+TreeBuilder::_AllocateNode(Transaction& transaction, CachedNode& cached,
+	bplustree_node** _node, off_t* _offset)
+{
+	Inode* stream = fTree->fStream;
+
+	if (fNextOffset + fTree->fNodeSize > stream->Size()) {
+		// Grow the stream in larger steps to keep it contiguous
+		status_t status = stream->Append(transaction,
+			kBuilderGrowNodes * fTree->fNodeSize);
+		if (status != B_OK)
+			return status;
+
+		bplustree_header* header = cached.SetToWritableHeader(transaction);
+		if (header == NULL)
+			return B_IO_ERROR;
+
+		header->maximum_size = HOST_ENDIAN_TO_BFS_INT64(stream->Size());
+		cached.Unset();
+	}
+
+	bplustree_node* node = cached.SetToWritable(transaction, fNextOffset,
+		false);
+	if (node == NULL)
+		RETURN_ERROR(B_IO_ERROR);
+
+	memset(node, 0, fTree->fNodeSize);
+
+	*_node = node;
+	*_offset = fNextOffset;
+	fNextOffset += fTree->fNodeSize;
+	return B_OK;
+}
+
+
+/*!	Splits the tree construction into several transactions, so that we
+	don't blow the log. As with MakeEmpty(), it doesn't need to be atomic;
+	the inode stays write locked in between.
+*/
+status_t
+TreeBuilder::_NodeWritten(Transaction& transaction)
+{
+	if (++fNodesWritten % kBuilderTransactionNodes != 0)
+		return B_OK;
+
+	status_t status = transaction.Done();
+	if (status != B_OK)
+		return status;
+
+	Inode* stream = fTree->fStream;
+	status = transaction.Start(stream->GetVolume(), stream->BlockNumber());
+	if (status != B_OK)
+		return status;
+
+	stream->WriteLockInTransaction(transaction);
+	return B_OK;
+}
+
+
+/*!	Accounts for \a size more bytes of memory, unless that would exceed the
+	limit for all builders.
+*/
+bool
+TreeBuilder::_ReserveMemory(size_t size)
+{
+	int32 kilobytes = (size + 1023) / 1024;
+	if (atomic_add(&sBuilderMemory, kilobytes) + kilobytes
+			> int32(kMaxBuilderMemory / 1024)) {
+		atomic_add(&sBuilderMemory, -kilobytes);
+		return false;
+	}
+
+	fMemoryUsed += kilobytes * 1024;
+	return true;
+}
+
+
+void
+TreeBuilder::_FreeEntries()
+{
+	while (fChunks != NULL) {
+		chunk* next = fChunks->next;
+		free(fChunks);
+		fChunks = next;
+	}
+
+	free(fEntries);
+	fEntries = NULL;
+	fCount = 0;
+	fCapacity = 0;
+
+	atomic_add(&sBuilderMemory, -int32(fMemoryUsed / 1024));
+	fMemoryUsed = 0;
+}
+
+
+void
+TreeBuilder::_LockTree()
+{
+	if (!fLocked) {
+		rw_lock_write_lock(&fTree->fStream->Lock());
+		fLocked = true;
+	}
+}
+
+
+void
+TreeBuilder::_UnlockTree()
+{
+	if (fLocked) {
+		rw_lock_write_unlock(&fTree->fStream->Lock());
+		fLocked = false;
+	}
+}
+#endif // !_BOOT_MODE
+
+
 // #pragma mark -
 
 
@@ -160,6 +160,7 @@ enum bplustree_traversing {
 
 class BPlusTree;
 struct TreeCheck;
+class TreeBuilder;
 class TreeIterator;
 
 
@@ -341,6 +342,9 @@ private:
 									off_t value);
 			void				_InsertKey(bplustree_node* node, uint16 index,
 									uint8* key, uint16 keyLength, off_t value);
+			status_t			_Insert(Transaction& transaction,
+									const uint8* key, uint16 keyLength,
+									off_t value);
 			status_t			_SplitNode(bplustree_node* node,
 									off_t nodeOffset, bplustree_node* other,
 									off_t otherOffset, uint16* _keyIndex,
@@ -352,10 +356,23 @@ private:
 									CachedNode& cached, uint16 keyIndex,
 									off_t value);
 			void				_RemoveKey(bplustree_node* node, uint16 index);
+			status_t			_Remove(Transaction& transaction,
+									const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			_Rebalance(Transaction& transaction,
+									Stack<node_and_key>& stack,
+									off_t nodeOffset);
+			status_t			_MergeNodes(Transaction& transaction,
+									const bplustree_node* parent,
+									uint16 index, off_t leftOffset,
+									off_t rightOffset, bool& _merged);
+			status_t			_TrimFreeNodes(Transaction& transaction);
 
 			void				_UpdateIterators(off_t offset, off_t nextOffset,
 									uint16 keyIndex, uint16 splitAt,
 									int8 change);
+			void				_UpdateIteratorsMerged(off_t offset,
+									off_t targetOffset, uint16 count);
 			void				_AddIterator(TreeIterator* iterator);
 			void				_RemoveIterator(TreeIterator* iterator);
 
@@ -372,6 +389,7 @@ private:
 
 private:
 			friend class TreeIterator;
+			friend class TreeBuilder;
 			friend class CachedNode;
 			friend struct TreeCheck;
 
@@ -425,6 +443,8 @@ private:
 			void				Update(off_t offset, off_t nextOffset,
 									uint16 keyIndex, uint16 splitAt,
 									int8 change);
+			void				Merged(off_t offset, off_t targetOffset,
+									uint16 count);
 			void				Stop();
 
 private:
@@ -439,6 +459,77 @@ private:
 };
 
 
+#if !_BOOT_MODE
+/*!	Builds a B+tree bottom-up from a set of keys that is collected up front,
+	which is a lot faster than inserting them one by one. The tree keeps its
+	previous contents until Finish() is called; it is then emptied and
+	rebuilt while its inode is write locked, so that readers never see a
+	partially built tree. The caller must make sure that no one else changes
+	the tree in the mean time.
+*/
+class TreeBuilder {
+public:
+								TreeBuilder(BPlusTree* tree);
+								~TreeBuilder();
+
+			status_t			Add(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			Finish();
+
+private:
+			struct entry;
+			struct chunk;
+			struct build_key;
+			struct EntryLess;
+
+			int32				_CompareEntries(const entry* a,
+									const entry* b);
+			bool				_Fits(int32 count, int32 keyLength) const;
+
+			status_t			_Insert(const uint8* key, uint16 keyLength,
+									off_t value);
+			status_t			_InsertEntries();
+			status_t			_Build();
+			status_t			_CollectKeys(Transaction& transaction,
+									build_key* keys, int32& _count);
+			status_t			_WriteFragment(Transaction& transaction,
+									entry** entries, int32 count,
+									off_t& _value);
+			status_t			_WriteDuplicates(Transaction& transaction,
+									entry** entries, int32 count,
+									off_t& _value);
+			status_t			_WriteLevel(Transaction& transaction,
+									build_key* keys, int32& _count,
+									bool leaf);
+			void				_FillNode(bplustree_node* node,
+									const build_key* keys, int32 count);
+			status_t			_AllocateNode(Transaction& transaction,
+									CachedNode& cached,
+									bplustree_node** _node, off_t* _offset);
+			status_t			_NodeWritten(Transaction& transaction);
+			bool				_ReserveMemory(size_t size);
+			void				_FreeEntries();
+			void				_LockTree();
+			void				_UnlockTree();
+
+private:
+			BPlusTree*			fTree;
+			chunk*				fChunks;
+			entry**				fEntries;
+			int32				fCount;
+			int32				fCapacity;
+			size_t				fMemoryUsed;
+			bool				fBuilt;
+			bool				fLocked;
+
+			off_t				fNextOffset;
+			off_t				fFragmentOffset;
+			uint32				fFragmentIndex;
+			uint32				fNodesWritten;
+};
+#endif // !_BOOT_MODE
+
+
 //	#pragma mark - BPlusTree's inline functions
 //	(most of them may not be needed)
 
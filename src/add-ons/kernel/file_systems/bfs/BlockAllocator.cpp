@@ -998,19 +998,19 @@ BlockAllocator::Allocate(Transaction& transaction, Inode* inode,
 	// Are there already allocated blocks? (then just try to allocate near the
 	// last one)
 	if (inode->Size() > 0) {
+		// Continue right after the last allocated run, no matter in which
+		// range of the stream it is, so that _GrowStream() can merge the
+		// runs. Preallocated blocks are part of the stream, too.
 		const data_stream& data = inode->Node().data;
-		// TODO: we currently don't care for when the data stream
-		// is already grown into the indirect ranges
-		if (data.max_double_indirect_range == 0
-			&& data.max_indirect_range == 0) {
-			// Since size > 0, there must be a valid block run in this stream
-			int32 last = 0;
-			for (; last < NUM_DIRECT_BLOCKS - 1; last++)
-				if (data.direct[last + 1].IsZero())
-					break;
-
-			group = data.direct[last].AllocationGroup();
-			start = data.direct[last].Start() + data.direct[last].Length();
+		off_t end = max_c(data.MaxDirectRange(), max_c(data.MaxIndirectRange(),
+			data.MaxDoubleIndirectRange()));
+
+		block_run last;
+		off_t offset;
+		if (end > 0 && inode->FindBlockRun(end - 1, last, offset) == B_OK
+			&& !last.IsZero()) {
+			group = last.AllocationGroup();
+			start = last.Start() + last.Length();
 		}
 	} else if (inode->IsContainer() || inode->IsSymLink()) {
 		// directory and symbolic link data will go in the same allocation
@@ -19,13 +19,15 @@
 struct check_index {
 	check_index()
 		:
-		inode(NULL)
+		inode(NULL),
+		builder(NULL)
 	{
 	}
 
 	char				name[B_FILE_NAME_LENGTH];
 	block_run			run;
 	Inode*				inode;
+	TreeBuilder*		builder;
 };
 
 
@@ -179,6 +181,30 @@ CheckVisitor::StartIndexPass()
 }
 
 
+/*!	Writes out the indices that have been collected during the index pass.
+*/
+status_t
+CheckVisitor::WriteBackIndices()
+{
+	status_t result = B_OK;
+
+	for (int32 i = 0; i < Indices().CountItems(); i++) {
+		check_index* index = Indices().Array()[i];
+		if (index->builder == NULL)
+			continue;
+
+		status_t status = index->builder->Finish();
+		if (status != B_OK) {
+			FATAL(("check: Could not rebuild index \"%s\": %s\n",
+				index->name, strerror(status)));
+			result = status;
+		}
+	}
+
+	return result;
+}
+
+
 status_t
 CheckVisitor::StopChecking()
 {
@@ -695,9 +721,13 @@ CheckVisitor::_PrepareIndices()
 			continue;
 		}
 
-		status = tree->MakeEmpty();
-		if (status != B_OK)
-			return status;
+		// The keys are collected during the index pass, and the tree is
+		// then emptied and built from them in one go by WriteBackIndices().
+		// Until then, the old index stays usable; writers cannot change it,
+		// as the journal is locked for the whole check.
+		index->builder = new(std::nothrow) TreeBuilder(tree);
+		if (index->builder == NULL)
+			return B_NO_MEMORY;
 
 		index->inode = inode;
 		vnode.Keep();
@@ -717,6 +747,7 @@ CheckVisitor::_FreeIndices()
 			put_vnode(GetVolume()->FSVolume(),
 				GetVolume()->ToVnode(index->inode->BlockRun()));
 		}
+		delete index->builder;
 		delete index;
 	}
 	Indices().MakeEmpty();
@@ -726,19 +757,12 @@ CheckVisitor::_FreeIndices()
 status_t
 CheckVisitor::_AddInodeToIndex(Inode* inode)
 {
-	Transaction transaction(GetVolume(), inode->BlockNumber());
-
 	for (int32 i = 0; i < Indices().CountItems(); i++) {
 		check_index* index = Indices().Array()[i];
 		if (index->inode == NULL)
 			continue;
 
-		index->inode->WriteLockInTransaction(transaction);
-
-		BPlusTree* tree = index->inode->Tree();
-		if (tree == NULL)
-			return B_ERROR;
-
+		TreeBuilder* builder = index->builder;
 		status_t status = B_OK;
 
 		if (!strcmp(index->name, "name")) {
@@ -747,22 +771,26 @@ CheckVisitor::_AddInodeToIndex(Inode* inode)
 				if (inode->GetName(name, B_FILE_NAME_LENGTH) != B_OK)
 					return B_ERROR;
 
-				status = tree->Insert(transaction, name, inode->ID());
+				status = builder->Add((uint8*)name, strlen(name), inode->ID());
 			}
 		} else if (!strcmp(index->name, "last_modified")) {
 			if (inode->InLastModifiedIndex()) {
-				status = tree->Insert(transaction, inode->OldLastModified(),
+				int64 modified = inode->OldLastModified();
+				status = builder->Add((uint8*)&modified, sizeof(int64),
 					inode->ID());
 			}
 		} else if (!strcmp(index->name, "size")) {
-			if (inode->InSizeIndex())
-				status = tree->Insert(transaction, inode->Size(), inode->ID());
+			if (inode->InSizeIndex()) {
+				int64 size = inode->Size();
+				status = builder->Add((uint8*)&size, sizeof(int64),
+					inode->ID());
+			}
 		} else {
 			uint8 key[MAX_INDEX_KEY_LENGTH];
 			size_t keyLength = sizeof(key);
 			if (inode->ReadAttribute(index->name, B_ANY_TYPE, 0, key,
 					&keyLength) == B_OK) {
-				status = tree->Insert(transaction, key, keyLength, inode->ID());
+				status = builder->Add(key, keyLength, inode->ID());
 			}
 		}
 
@@ -770,5 +798,5 @@ CheckVisitor::_AddInodeToIndex(Inode* inode)
 			return status;
 	}
 
-	return transaction.Done();
+	return B_OK;
 }
@@ -33,6 +33,7 @@ public:
 			status_t			StartBitmapPass();
 			status_t			WriteBackCheckBitmap();
 			status_t			StartIndexPass();
+			status_t			WriteBackIndices();
 			status_t			StopChecking();
 
 	virtual status_t			VisitDirectoryEntry(Inode* inode,
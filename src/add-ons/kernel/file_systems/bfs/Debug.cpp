@@ -47,7 +47,9 @@ dump_super_block(const disk_super_block* superBlock)
 	kprintf("  name           = %s\n", superBlock->name);
 	kprintf("  magic1         = %#08x (%s) %s\n", (int)superBlock->Magic1(),
 		get_tupel(superBlock->magic1),
-		(superBlock->magic1 == SUPER_BLOCK_MAGIC1 ? "valid" : "INVALID"));
+		(superBlock->magic1 == SUPER_BLOCK_MAGIC1
+			|| superBlock->magic1 == SUPER_BLOCK_MAGIC1_FEATURES
+				? "valid" : "INVALID"));
 	kprintf("  fs_byte_order  = %#08x (%s)\n", (int)superBlock->fs_byte_order,
 		get_tupel(superBlock->fs_byte_order));
 	kprintf("  block_size     = %u\n", (unsigned)superBlock->BlockSize());
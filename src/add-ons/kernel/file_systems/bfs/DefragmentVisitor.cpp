@@ -0,0 +1,466 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//!	Online defragmentation of file and B+tree streams
+
+
+#include "DefragmentVisitor.h"
+
+#include "BlockAllocator.h"
+#include "CachedBlock.h"
+#include "Debug.h"
+#include "Inode.h"
+#include "Journal.h"
+#include "Volume.h"
+
+
+/*!	The defragmenter visits one inode per BFS_IOCTL_DEFRAGMENT_NEXT_NODE
+	call. If the inode's stream consists of more extents than it would need
+	at the least, a new set of contiguous runs is allocated for it, the
+	contents are copied over, and the old stream is freed, all in a single
+	transaction that also holds the inode's write lock. Since this keeps the
+	journal locked, only streams that fit into the direct block runs, and
+	are no larger than a few hundred megabytes are moved.
+
+	File data is copied directly on the device after the file cache has
+	been synced; concurrent writers only touch the file cache, and their
+	pages will be written back to the new location later on. B+tree nodes
+	are copied through the block cache, as they are part of the transaction.
+*/
+
+
+static const size_t kBufferSize = 64 * 1024;
+static const off_t kMaxStreamSize = 256 * 1024 * 1024LL;
+	// larger streams would keep the journal locked for too long
+
+
+DefragmentVisitor::DefragmentVisitor(Volume* volume)
+	:
+	FileSystemVisitor(volume),
+	fBuffer(NULL)
+{
+	memset(&fControl, 0, sizeof(defragment_control));
+}
+
+
+DefragmentVisitor::~DefragmentVisitor()
+{
+	free(fBuffer);
+}
+
+
+status_t
+DefragmentVisitor::StartDefragmenting()
+{
+	if (!_ControlValid())
+		return B_BAD_VALUE;
+
+	if ((fControl.flags & BFS_DEFRAGMENT_ANALYZE_ONLY) == 0
+		&& GetVolume()->IsReadOnly())
+		return B_READ_ONLY_DEVICE;
+
+	if ((fControl.flags & (BFS_DEFRAGMENT_FILES | BFS_DEFRAGMENT_BPLUSTREES))
+			== 0) {
+		fControl.flags |= BFS_DEFRAGMENT_FILES | BFS_DEFRAGMENT_BPLUSTREES;
+	}
+
+	fBuffer = (uint8*)malloc(kBufferSize);
+	if (fBuffer == NULL)
+		return B_NO_MEMORY;
+
+	memset(&fControl.stats, 0, sizeof(defragment_control::stats));
+	fControl.stats.block_size = GetVolume()->BlockSize();
+	fControl.status = B_OK;
+
+	Start(VISIT_REGULAR | VISIT_INDICES | VISIT_ATTRIBUTE_DIRECTORIES);
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::StopDefragmenting()
+{
+	Stop();
+
+	free(fBuffer);
+	fBuffer = NULL;
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::VisitInode(Inode* inode, const char* treeName)
+{
+	fControl.inode = inode->ID();
+	fControl.mode = inode->Mode();
+	fControl.runs = 0;
+	fControl.status = B_OK;
+
+	// set name
+	if (treeName == NULL) {
+		if (inode->GetName(fControl.name) < B_OK) {
+			if (inode->IsContainer())
+				strcpy(fControl.name, "(dir has no name)");
+			else
+				strcpy(fControl.name, "(node has no name)");
+		}
+	} else
+		strlcpy(fControl.name, treeName, B_FILE_NAME_LENGTH);
+
+	fControl.stats.inodes++;
+
+	uint32 extents;
+	uint32 neededRuns;
+	status_t status;
+	{
+		InodeReadLocker locker(inode);
+		if (!_WantsStream(inode))
+			return B_OK;
+
+		status = _CountExtents(inode, extents, neededRuns);
+	}
+	if (status != B_OK) {
+		fControl.status = status;
+		return B_OK;
+	}
+
+	fControl.runs = extents;
+	if (extents <= neededRuns)
+		return B_OK;
+
+	fControl.stats.fragmented++;
+	if ((fControl.flags & BFS_DEFRAGMENT_ANALYZE_ONLY) != 0)
+		return B_OK;
+
+	status = _Defragment(inode);
+	if (status != B_OK) {
+		fControl.stats.skipped++;
+		fControl.status = status;
+	}
+
+	// A failure only affects this inode, we just go on with the next one
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::OpenInodeFailed(status_t reason, ino_t id, Inode* parent,
+	char* treeName, TreeIterator* iterator)
+{
+	FATAL(("Could not open inode at %" B_PRIdOFF ": %s\n", id,
+		strerror(reason)));
+
+	// Leave it to checkfs to deal with broken nodes
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::OpenBPlusTreeFailed(Inode* inode)
+{
+	FATAL(("Could not open b+tree from inode at %" B_PRIdOFF "\n",
+		inode->ID()));
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::TreeIterationFailed(status_t reason, Inode* parent)
+{
+	FATAL(("Could not iterate b+tree from inode at %" B_PRIdOFF ": %s\n",
+		parent->ID(), strerror(reason)));
+
+	// skip the rest of the directory
+	return B_OK;
+}
+
+
+bool
+DefragmentVisitor::_ControlValid()
+{
+	if (fControl.magic != BFS_IOCTL_DEFRAGMENT_MAGIC) {
+		FATAL(("invalid defragment_control!\n"));
+		return false;
+	}
+
+	return true;
+}
+
+
+/*!	Returns whether or not the stream of \a inode is one that should be
+	defragmented. The inode must be locked.
+*/
+bool
+DefragmentVisitor::_WantsStream(Inode* inode) const
+{
+	if (inode->IsDeleted() || inode->HasInlineData() || inode->Size() == 0)
+		return false;
+
+	if (inode->IsContainer())
+		return (fControl.flags & BFS_DEFRAGMENT_BPLUSTREES) != 0;
+	if (inode->NeedsFileCache())
+		return (fControl.flags & BFS_DEFRAGMENT_FILES) != 0;
+
+	return false;
+}
+
+
+/*!	Counts the physically contiguous extents of the stream of \a inode, and
+	computes how many block runs it would need at the least.
+	The inode must be locked.
+*/
+status_t
+DefragmentVisitor::_CountExtents(Inode* inode, uint32& _extents,
+	uint32& _neededRuns)
+{
+	Volume* volume = GetVolume();
+	uint32 blockShift = volume->BlockShift();
+	off_t end = round_up(inode->Size(), volume->BlockSize());
+
+	off_t numBlocks = end >> blockShift;
+	off_t maxRunLength = min_c((off_t)MAX_BLOCK_RUN_LENGTH,
+		1LL << volume->AllocationGroupShift());
+	_neededRuns = (numBlocks + maxRunLength - 1) / maxRunLength;
+
+	uint32 extents = 0;
+	off_t nextBlock = -1;
+
+	for (off_t pos = 0; pos < end;) {
+		block_run run;
+		off_t offset;
+		status_t status = inode->FindBlockRun(pos, run, offset);
+		if (status != B_OK)
+			return status;
+
+		off_t block = volume->ToBlock(run) + ((pos - offset) >> blockShift);
+		off_t length = offset + ((off_t)run.Length() << blockShift) - pos;
+
+		if (block != nextBlock)
+			extents++;
+
+		nextBlock = block + (length >> blockShift);
+		pos += length;
+	}
+
+	_extents = extents;
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::_Defragment(Inode* inode)
+{
+	Volume* volume = GetVolume();
+
+	// We bypass the file cache, so the data on disk must be current
+	if (inode->FileCache() != NULL) {
+		status_t status = file_cache_sync(inode->FileCache());
+		if (status != B_OK)
+			return status;
+	}
+
+	Transaction transaction(volume, inode->BlockNumber());
+	inode->WriteLockInTransaction(transaction);
+
+	// The stream may have changed since we looked at it
+	if (!_WantsStream(inode))
+		return B_OK;
+
+	uint32 extents;
+	uint32 neededRuns;
+	status_t status = _CountExtents(inode, extents, neededRuns);
+	if (status != B_OK)
+		return status;
+	if (extents <= neededRuns)
+		return B_OK;
+
+	off_t numBlocks = round_up(inode->Size(), volume->BlockSize())
+		>> volume->BlockShift();
+	off_t maxBlocks = inode->IsContainer()
+		? volume->Log().Length() / 4 : kMaxStreamSize >> volume->BlockShift();
+			// B+tree nodes are written to the log
+	if (neededRuns > NUM_DIRECT_BLOCKS || numBlocks > maxBlocks)
+		return B_NOT_SUPPORTED;
+
+	block_run runs[NUM_DIRECT_BLOCKS];
+	status = _AllocateRuns(transaction, inode, numBlocks, runs, neededRuns);
+	if (status != B_OK)
+		return status;
+
+	status = _CopyStream(transaction, inode, runs, neededRuns);
+	if (status == B_OK)
+		status = inode->ReplaceStream(transaction, runs, neededRuns);
+	if (status != B_OK) {
+		_FreeRuns(transaction, runs, neededRuns);
+		return status;
+	}
+
+	status = transaction.Done();
+	if (status != B_OK)
+		return status;
+
+	fControl.stats.defragmented++;
+	fControl.stats.runs_before += extents;
+	fControl.stats.runs_after += neededRuns;
+	fControl.stats.moved_blocks += numBlocks;
+	return B_OK;
+}
+
+
+/*!	Allocates \a count runs of the maximum length for \a numBlocks, one
+	following the other if possible. The runs are only ever allocated as a
+	whole.
+*/
+status_t
+DefragmentVisitor::_AllocateRuns(Transaction& transaction, Inode* inode,
+	off_t numBlocks, block_run* runs, int32 count)
+{
+	Volume* volume = GetVolume();
+	off_t maxRunLength = min_c((off_t)MAX_BLOCK_RUN_LENGTH,
+		1LL << volume->AllocationGroupShift());
+
+	for (int32 i = 0; i < count; i++) {
+		uint16 length = (uint16)min_c(numBlocks, maxRunLength);
+		status_t status;
+
+		if (i == 0) {
+			status = volume->Allocate(transaction, inode, length, runs[i],
+				length);
+		} else {
+			// try to continue right after the previous run
+			int32 group = runs[i - 1].AllocationGroup();
+			uint32 start = runs[i - 1].Start() + runs[i - 1].Length();
+			if (start >= (1UL << volume->AllocationGroupShift())) {
+				group++;
+				start = 0;
+			}
+
+			status = volume->Allocator().AllocateBlocks(transaction, group,
+				start, length, length, runs[i]);
+		}
+		if (status != B_OK) {
+			_FreeRuns(transaction, runs, i);
+			return status;
+		}
+
+		numBlocks -= length;
+	}
+
+	return B_OK;
+}
+
+
+void
+DefragmentVisitor::_FreeRuns(Transaction& transaction, block_run* runs,
+	int32 count)
+{
+	for (int32 i = 0; i < count; i++)
+		GetVolume()->Free(transaction, runs[i]);
+}
+
+
+/*!	Copies the stream of \a inode to the \a count runs in \a runs.
+	The inode must be write locked.
+*/
+status_t
+DefragmentVisitor::_CopyStream(Transaction& transaction, Inode* inode,
+	const block_run* runs, int32 count)
+{
+	Volume* volume = GetVolume();
+	uint32 blockShift = volume->BlockShift();
+	off_t end = round_up(inode->Size(), volume->BlockSize());
+
+	int32 index = 0;
+	off_t targetOffset = 0;
+		// the stream position of runs[index]
+
+	for (off_t pos = 0; pos < end;) {
+		block_run run;
+		off_t offset;
+		status_t status = inode->FindBlockRun(pos, run, offset);
+		if (status != B_OK)
+			return status;
+
+		off_t targetEnd = targetOffset
+			+ ((off_t)runs[index].Length() << blockShift);
+		if (pos >= targetEnd) {
+			if (++index >= count)
+				RETURN_ERROR(B_BAD_VALUE);
+
+			targetOffset = targetEnd;
+			continue;
+		}
+
+		off_t source = volume->ToBlock(run) + ((pos - offset) >> blockShift);
+		off_t target = volume->ToBlock(runs[index])
+			+ ((pos - targetOffset) >> blockShift);
+		off_t length = min_c(offset + ((off_t)run.Length() << blockShift),
+			min_c(targetEnd, end)) - pos;
+
+		if (inode->IsContainer()) {
+			status = _CopyBlocks(transaction, source, target,
+				length >> blockShift);
+		} else {
+			status = _CopyData(source << blockShift, target << blockShift,
+				length);
+		}
+		if (status != B_OK)
+			return status;
+
+		pos += length;
+	}
+
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::_CopyBlocks(Transaction& transaction, off_t source,
+	off_t target, off_t numBlocks)
+{
+	CachedBlock cachedSource(GetVolume());
+	CachedBlock cachedTarget(GetVolume());
+
+	for (off_t i = 0; i < numBlocks; i++) {
+		status_t status = cachedSource.SetTo(source + i);
+		if (status != B_OK)
+			return status;
+
+		status = cachedTarget.SetToWritable(transaction, target + i, true);
+		if (status != B_OK)
+			return status;
+
+		memcpy(cachedTarget.WritableBlock(), cachedSource.Block(),
+			GetVolume()->BlockSize());
+	}
+
+	return B_OK;
+}
+
+
+status_t
+DefragmentVisitor::_CopyData(off_t source, off_t target, off_t length)
+{
+	int device = GetVolume()->Device();
+
+	while (length > 0) {
+		size_t bytes = (size_t)min_c(length, (off_t)kBufferSize);
+
+		ssize_t bytesRead = read_pos(device, source, fBuffer, bytes);
+		if (bytesRead != (ssize_t)bytes)
+			return bytesRead < 0 ? (status_t)bytesRead : B_IO_ERROR;
+
+		ssize_t bytesWritten = write_pos(device, target, fBuffer, bytes);
+		if (bytesWritten != (ssize_t)bytes)
+			return bytesWritten < 0 ? (status_t)bytesWritten : B_IO_ERROR;
+
+		source += bytes;
+		target += bytes;
+		length -= bytes;
+	}
+
+	return B_OK;
+}
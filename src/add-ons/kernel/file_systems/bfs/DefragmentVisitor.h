@@ -0,0 +1,63 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef DEFRAGMENT_VISITOR_H
+#define DEFRAGMENT_VISITOR_H
+
+
+#include "system_dependencies.h"
+
+#include "bfs_control.h"
+#include "FileSystemVisitor.h"
+
+
+class Transaction;
+
+
+class DefragmentVisitor : public FileSystemVisitor {
+public:
+								DefragmentVisitor(Volume* volume);
+	virtual						~DefragmentVisitor();
+
+			defragment_control&	Control() { return fControl; }
+
+			status_t			StartDefragmenting();
+			status_t			StopDefragmenting();
+
+	virtual status_t			VisitInode(Inode* inode, const char* treeName);
+
+	virtual status_t			OpenInodeFailed(status_t reason, ino_t id,
+									Inode* parent, char* treeName,
+									TreeIterator* iterator);
+	virtual status_t			OpenBPlusTreeFailed(Inode* inode);
+	virtual status_t			TreeIterationFailed(status_t reason,
+									Inode* parent);
+
+private:
+			bool				_ControlValid();
+			bool				_WantsStream(Inode* inode) const;
+			status_t			_CountExtents(Inode* inode, uint32& _extents,
+									uint32& _neededRuns);
+			status_t			_Defragment(Inode* inode);
+			status_t			_AllocateRuns(Transaction& transaction,
+									Inode* inode, off_t numBlocks,
+									block_run* runs, int32 count);
+			void				_FreeRuns(Transaction& transaction,
+									block_run* runs, int32 count);
+			status_t			_CopyStream(Transaction& transaction,
+									Inode* inode, const block_run* runs,
+									int32 count);
+			status_t			_CopyBlocks(Transaction& transaction,
+									off_t source, off_t target,
+									off_t numBlocks);
+			status_t			_CopyData(off_t source, off_t target,
+									off_t length);
+
+private:
+			defragment_control	fControl;
+			uint8*				fBuffer;
+};
+
+
+#endif	// DEFRAGMENT_VISITOR_H
@@ -0,0 +1,457 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+
+
+//!	in-memory hash of the entries of huge directories
+
+
+#include "DirectoryHash.h"
+
+#include "BPlusTree.h"
+#include "Debug.h"
+#include "Inode.h"
+
+#ifndef FS_SHELL
+#	include <low_resource_manager.h>
+#endif
+
+
+/*!	Looking up a name in the B+tree of a directory with hundreds of thousands
+	of entries needs several node reads per lookup, and if those are no longer
+	in the block cache, just as many disk accesses.
+	Therefore, once a huge directory has seen a number of lookups, all of its
+	entries are read into an in-memory hash table, which is then used to
+	answer lookups (including misses) from there on. The B+tree keeps the
+	hash up to date when entries are added, removed, or replaced; if the
+	transaction is aborted, the hash is simply thrown away.
+
+	All hashes are kept in a global list, so that they can be freed again
+	when the system is running low on memory. They will be rebuilt on demand.
+
+	Lookups only read lock fLock, so that they can run in parallel. Changes
+	are serialized by fWriteLock, and need fLock to be write locked, too.
+	This allows the low resource handler to try to lock fWriteLock while it
+	holds the global lock; after that, it only has to wait for the lookups
+	in progress, which do not need any other lock.
+*/
+
+
+struct DirectoryHash::entry {
+	entry*		next;
+	ino_t		id;
+	uint32		hash;
+	uint16		length;
+	char		name[0];
+};
+
+struct DirectoryHash::chunk {
+	chunk*		next;
+	size_t		used;
+};
+
+
+static const off_t kMinDirectorySize = 64 * 1024;
+	// the size of the B+tree stream, a few thousand entries
+static const int32 kLookupsBeforeBuild = 32;
+static const size_t kChunkSize = 64 * 1024;
+static const uint32 kInitialTableSize = 1024;
+
+static mutex sHashLock;
+static DoublyLinkedList<DirectoryHash> sHashes;
+
+
+DirectoryHash::DirectoryHash(Inode* directory)
+	:
+	fDirectory(directory),
+	fTable(NULL),
+	fTableSize(0),
+	fCount(0),
+	fChunks(NULL),
+	fMemoryUsed(0),
+	fMemoryWasted(0),
+	fLookups(0),
+	fLastUsed(0)
+{
+	rw_lock_init(&fLock, "bfs directory hash");
+	mutex_init(&fWriteLock, "bfs directory hash writer");
+}
+
+
+DirectoryHash::~DirectoryHash()
+{
+	MutexLocker writeLocker(fWriteLock);
+	WriteLocker locker(fLock);
+	_Unset();
+	locker.Unlock();
+	writeLocker.Unlock();
+
+	rw_lock_destroy(&fLock);
+	mutex_destroy(&fWriteLock);
+}
+
+
+/*!	Looks up \a name in the hash, and builds it first if the directory
+	qualifies. Returns \c B_NO_INIT if the hash cannot be used, in which case
+	the caller must use the B+tree instead.
+	The directory must be at least read locked.
+*/
+status_t
+DirectoryHash::Lookup(const char* name, ino_t* _id)
+{
+	size_t length = strlen(name);
+	if (length < BPLUSTREE_MIN_KEY_LENGTH || length > BPLUSTREE_MAX_KEY_LENGTH)
+		return B_NO_INIT;
+
+	// Only huge directories that are actually used are worth it
+	if (fDirectory->Size() < kMinDirectorySize)
+		return B_NO_INIT;
+
+	ReadLocker locker(fLock);
+	if (fTable != NULL)
+		return _Lookup(name, length, _id);
+	locker.Unlock();
+
+	if (atomic_add(&fLookups, 1) + 1 < kLookupsBeforeBuild)
+		return B_NO_INIT;
+
+	MutexLocker writeLocker(fWriteLock);
+	WriteLocker tableLocker(fLock);
+
+	if (fTable == NULL) {
+		// no one else built it in the mean time
+		atomic_set(&fLookups, 0);
+		if (_Build() != B_OK)
+			return B_NO_INIT;
+	}
+
+	return _Lookup(name, length, _id);
+}
+
+
+/*!	Called by the B+tree whenever an entry has been added, or its value has
+	been replaced. The directory must be write locked.
+*/
+void
+DirectoryHash::EntryAdded(const uint8* name, uint16 length, ino_t id)
+{
+	MutexLocker writeLocker(fWriteLock);
+	if (fTable == NULL)
+		return;
+
+	WriteLocker locker(fLock);
+
+	uint32 hash = _HashName((const char*)name, length);
+	entry* item = _Find((const char*)name, length, hash);
+	if (item != NULL) {
+		item->id = id;
+		return;
+	}
+
+	// An incomplete hash would report existing entries as missing
+	if (_Add((const char*)name, length, hash, id) != B_OK)
+		_Unset();
+}
+
+
+/*!	Called by the B+tree whenever an entry has been removed. The directory
+	must be write locked.
+*/
+void
+DirectoryHash::EntryRemoved(const uint8* name, uint16 length)
+{
+	MutexLocker writeLocker(fWriteLock);
+	if (fTable == NULL)
+		return;
+
+	WriteLocker locker(fLock);
+
+	entry** link;
+	entry* item = _Find((const char*)name, length,
+		_HashName((const char*)name, length), &link);
+	if (item == NULL)
+		return;
+
+	*link = item->next;
+	fCount--;
+	fMemoryWasted += _EntrySize(length);
+
+	// Rather than compacting the entries, we just start over later on
+	if (fMemoryWasted > fMemoryUsed / 2)
+		_Unset();
+}
+
+
+/*!	Throws away the hash; it will be rebuilt on demand. */
+void
+DirectoryHash::Invalidate()
+{
+	MutexLocker writeLocker(fWriteLock);
+	WriteLocker locker(fLock);
+	_Unset();
+}
+
+
+/*static*/ void
+DirectoryHash::Init()
+{
+	mutex_init(&sHashLock, "bfs directory hashes");
+
+#ifndef FS_SHELL
+	register_low_resource_handler(&_LowResourceHandler, NULL,
+		B_KERNEL_RESOURCE_PAGES | B_KERNEL_RESOURCE_MEMORY, 0);
+#endif
+}
+
+
+/*static*/ void
+DirectoryHash::Uninit()
+{
+#ifndef FS_SHELL
+	unregister_low_resource_handler(&_LowResourceHandler, NULL);
+#endif
+
+	mutex_destroy(&sHashLock);
+}
+
+
+/*!	Answers a lookup from the hash. fLock must be held. */
+status_t
+DirectoryHash::_Lookup(const char* name, uint16 length, ino_t* _id)
+{
+	atomic_set(&fLastUsed, system_time() / 1000000);
+
+	entry* item = _Find(name, length, _HashName(name, length));
+	if (item == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	*_id = item->id;
+	return B_OK;
+}
+
+
+/*!	Reads all entries of the directory into the hash. fWriteLock must be
+	held, fLock must be write locked, and the directory must be at least read
+	locked.
+*/
+status_t
+DirectoryHash::_Build()
+{
+	BPlusTree* tree = fDirectory->Tree();
+	if (tree == NULL)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	status_t status = _Resize(kInitialTableSize);
+	if (status != B_OK)
+		return status;
+
+	MutexLocker hashLocker(sHashLock);
+	sHashes.Add(this);
+	hashLocker.Unlock();
+
+	TreeIterator iterator(tree);
+	char name[BPLUSTREE_MAX_KEY_LENGTH + 1];
+	uint16 length;
+	ino_t id;
+	while ((status = iterator.GetNextEntry(name, &length, sizeof(name), &id))
+			== B_OK) {
+		status = _Add(name, length, _HashName(name, length), id);
+		if (status != B_OK)
+			break;
+	}
+
+	if (status != B_ENTRY_NOT_FOUND) {
+		_Unset();
+		return status;
+	}
+
+	PRINT(("DirectoryHash: built hash of %" B_PRIu32 " entries for inode %"
+		B_PRIdINO " (%" B_PRIuSIZE " bytes)\n", fCount, fDirectory->ID(),
+		fMemoryUsed));
+	return B_OK;
+}
+
+
+/*!	Removes the hash from the global list, and frees it. fWriteLock must be
+	held, and fLock must be write locked.
+*/
+void
+DirectoryHash::_Unset()
+{
+	if (fTable == NULL)
+		return;
+
+	MutexLocker hashLocker(sHashLock);
+	sHashes.Remove(this);
+	hashLocker.Unlock();
+
+	_Free();
+}
+
+
+/*!	Frees all memory used by the hash. fWriteLock must be held, fLock must
+	be write locked, and the hash must no longer be part of the global list.
+*/
+void
+DirectoryHash::_Free()
+{
+	while (fChunks != NULL) {
+		chunk* next = fChunks->next;
+		free(fChunks);
+		fChunks = next;
+	}
+
+	free(fTable);
+	fTable = NULL;
+	fTableSize = 0;
+	fCount = 0;
+	fMemoryUsed = 0;
+	fMemoryWasted = 0;
+}
+
+
+status_t
+DirectoryHash::_Add(const char* name, uint16 length, uint32 hash, ino_t id)
+{
+	if (fCount >= fTableSize) {
+		status_t status = _Resize(fTableSize * 2);
+		if (status != B_OK)
+			return status;
+	}
+
+	size_t size = _EntrySize(length);
+	if (fChunks == NULL || fChunks->used + size > kChunkSize) {
+		chunk* newChunk = (chunk*)malloc(kChunkSize);
+		if (newChunk == NULL)
+			return B_NO_MEMORY;
+
+		newChunk->next = fChunks;
+		newChunk->used = key_align(sizeof(chunk));
+		fChunks = newChunk;
+		fMemoryUsed += kChunkSize;
+	}
+
+	entry* item = (entry*)((uint8*)fChunks + fChunks->used);
+	fChunks->used += size;
+
+	item->id = id;
+	item->hash = hash;
+	item->length = length;
+	memcpy(item->name, name, length);
+
+	entry** bucket = &fTable[hash & (fTableSize - 1)];
+	item->next = *bucket;
+	*bucket = item;
+	fCount++;
+
+	return B_OK;
+}
+
+
+DirectoryHash::entry*
+DirectoryHash::_Find(const char* name, uint16 length, uint32 hash,
+	entry*** _link)
+{
+	entry** link = &fTable[hash & (fTableSize - 1)];
+	for (entry* item = *link; item != NULL; item = *link) {
+		if (item->hash == hash && item->length == length
+			&& memcmp(item->name, name, length) == 0) {
+			if (_link != NULL)
+				*_link = link;
+			return item;
+		}
+		link = &item->next;
+	}
+
+	return NULL;
+}
+
+
+/*!	Sets the number of buckets to \a size, which must be a power of two. */
+status_t
+DirectoryHash::_Resize(uint32 size)
+{
+	entry** table = (entry**)calloc(size, sizeof(entry*));
+	if (table == NULL)
+		return B_NO_MEMORY;
+
+	for (uint32 i = 0; i < fTableSize; i++) {
+		entry* item = fTable[i];
+		while (item != NULL) {
+			entry* next = item->next;
+			entry** bucket = &table[item->hash & (size - 1)];
+			item->next = *bucket;
+			*bucket = item;
+			item = next;
+		}
+	}
+
+	free(fTable);
+	fMemoryUsed += (size - fTableSize) * sizeof(entry*);
+	fTable = table;
+	fTableSize = size;
+	return B_OK;
+}
+
+
+/*static*/ size_t
+DirectoryHash::_EntrySize(uint16 length)
+{
+	return key_align(sizeof(entry) + length);
+}
+
+
+/*static*/ uint32
+DirectoryHash::_HashName(const char* name, uint16 length)
+{
+	uint32 hash = 0;
+	for (uint16 i = 0; i < length; i++)
+		hash = (hash << 5) - hash + (uint8)name[i];
+
+	return hash;
+}
+
+
+/*static*/ void
+DirectoryHash::_LowResourceHandler(void* /*data*/, uint32 /*resources*/,
+	int32 level)
+{
+#ifndef FS_SHELL
+	int32 maxAge;
+		// in seconds
+	switch (level) {
+		case B_NO_LOW_RESOURCE:
+			return;
+		case B_LOW_RESOURCE_NOTE:
+			maxAge = 60;
+			break;
+		case B_LOW_RESOURCE_WARNING:
+			maxAge = 5;
+			break;
+		case B_LOW_RESOURCE_CRITICAL:
+		default:
+			maxAge = 0;
+			break;
+	}
+
+	int32 now = system_time() / 1000000;
+	MutexLocker locker(sHashLock);
+
+	DoublyLinkedList<DirectoryHash>::Iterator iterator = sHashes.GetIterator();
+	while (DirectoryHash* hash = iterator.Next()) {
+		// Hashes that are being changed right now will be handled next time
+		if (mutex_trylock(&hash->fWriteLock) != B_OK)
+			continue;
+
+		if (now - atomic_get(&hash->fLastUsed) >= maxAge) {
+			rw_lock_write_lock(&hash->fLock);
+			iterator.Remove();
+			hash->_Free();
+			rw_lock_write_unlock(&hash->fLock);
+		}
+
+		mutex_unlock(&hash->fWriteLock);
+	}
+#endif
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * This file may be used under the terms of the MIT License.
+ */
+#ifndef DIRECTORY_HASH_H
+#define DIRECTORY_HASH_H
+
+
+#include "system_dependencies.h"
+
+
+class Inode;
+
+
+class DirectoryHash : public DoublyLinkedListLinkImpl<DirectoryHash> {
+public:
+							DirectoryHash(Inode* directory);
+							~DirectoryHash();
+
+			status_t		Lookup(const char* name, ino_t* _id);
+
+			void			EntryAdded(const uint8* name, uint16 length,
+								ino_t id);
+			void			EntryRemoved(const uint8* name, uint16 length);
+			void			Invalidate();
+
+	static	void			Init();
+	static	void			Uninit();
+
+private:
+							DirectoryHash(const DirectoryHash& other);
+							DirectoryHash& operator=(
+								const DirectoryHash& other);
+								// no implementation
+
+			struct entry;
+			struct chunk;
+
+			status_t		_Lookup(const char* name, uint16 length,
+								ino_t* _id);
+			status_t		_Build();
+			void			_Unset();
+			void			_Free();
+			status_t		_Add(const char* name, uint16 length,
+								uint32 hash, ino_t id);
+			entry*			_Find(const char* name, uint16 length,
+								uint32 hash, entry*** _link = NULL);
+			status_t		_Resize(uint32 size);
+
+	static	size_t			_EntrySize(uint16 length);
+	static	uint32			_HashName(const char* name, uint16 length);
+	static	void			_LowResourceHandler(void* data,
+								uint32 resources, int32 level);
+
+private:
+			rw_lock			fLock;
+			mutex			fWriteLock;
+			Inode*			fDirectory;
+			entry**			fTable;
+			uint32			fTableSize;
+			uint32			fCount;
+			chunk*			fChunks;
+			size_t			fMemoryUsed;
+			size_t			fMemoryWasted;
+			int32			fLookups;
+			int32			fLastUsed;
+				// in seconds
+};
+
+
+#endif	// DIRECTORY_HASH_H
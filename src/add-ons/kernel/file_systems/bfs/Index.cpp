@@ -68,18 +68,8 @@ Index::SetTo(const char* name)
 	// Note, the name is saved even if the index couldn't be initialized!
 	// This is used to optimize Index::Update() in case there is no index
 
-	Inode* indices = fVolume->IndicesNode();
-	if (indices == NULL)
-		return B_ENTRY_NOT_FOUND;
-
-	InodeReadLocker locker(indices);
-
-	BPlusTree* tree = indices->Tree();
-	if (tree == NULL)
-		return B_BAD_VALUE;
-
 	ino_t id;
-	status_t status = tree->Find((uint8*)name, (uint16)strlen(name), &id);
+	status_t status = fVolume->FindIndex(name, id);
 	if (status != B_OK)
 		return status;
 
@@ -205,8 +195,13 @@ Index::Create(Transaction& transaction, const char* name, uint32 type)
 	}
 
 	// Inode::Create() will keep the inode locked for us
-	return Inode::Create(transaction, fVolume->IndicesNode(), name,
+	status_t status = Inode::Create(transaction, fVolume->IndicesNode(), name,
 		S_INDEX_DIR | S_DIRECTORY | mode, 0, type, NULL, NULL, &fNode);
+
+	// get rid of negative cache entries right away; the transaction owner
+	// has to invalidate the cache again when it's done
+	fVolume->InvalidateIndexCache();
+	return status;
 }
 
 
@@ -10,6 +10,7 @@
 #include "Debug.h"
 #include "Inode.h"
 #include "BPlusTree.h"
+#include "DirectoryHash.h"
 #include "Index.h"
 
 
@@ -342,6 +343,7 @@ Inode::Inode(Volume* volume, ino_t id)
 	fVolume(volume),
 	fID(id),
 	fTree(NULL),
+	fDirectoryHash(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
 	fMap(NULL)
@@ -363,9 +365,15 @@ Inode::Inode(Volume* volume, ino_t id)
 
 	if (IsContainer())
 		fTree = new(std::nothrow) BPlusTree(this);
+	if (IsDirectory())
+		fDirectoryHash = new(std::nothrow) DirectoryHash(this);
 	if (NeedsFileCache()) {
 		SetFileCache(file_cache_create(fVolume->ID(), ID(), Size()));
 		SetMap(file_map_create(volume->ID(), ID(), Size()));
+#ifndef FS_SHELL
+		if (HasInlineData() && FileCache() != NULL)
+			file_cache_disable(FileCache());
+#endif
 	}
 }
 
@@ -376,6 +384,7 @@ Inode::Inode(Volume* volume, Transaction& transaction, ino_t id, mode_t mode,
 	fVolume(volume),
 	fID(id),
 	fTree(NULL),
+	fDirectoryHash(NULL),
 	fAttributes(NULL),
 	fCache(NULL),
 	fMap(NULL)
@@ -413,6 +422,9 @@ Inode::Inode(Volume* volume, Transaction& transaction, ino_t id, mode_t mode,
 	// these two will help to maintain the indices
 	fOldSize = Size();
 	fOldLastModified = LastModified();
+
+	if (IsDirectory())
+		fDirectoryHash = new(std::nothrow) DirectoryHash(this);
 }
 
 
@@ -422,6 +434,7 @@ Inode::~Inode()
 
 	file_cache_delete(FileCache());
 	file_map_delete(Map());
+	delete fDirectoryHash;
 	delete fTree;
 
 	rw_lock_destroy(&fLock);
@@ -568,7 +581,9 @@ Inode::_MakeSpaceForSmallData(Transaction& transaction, bfs_inode* node,
 		int32 index = 0, maxIndex = 0;
 		for (; !item->IsLast(node); item = item->Next(), index++) {
 			// should not remove those
-			if (*item->Name() == FILE_NAME_NAME || !strcmp(name, item->Name()))
+			if (*item->Name() == FILE_NAME_NAME
+				|| *item->Name() == INLINE_DATA_NAME
+				|| !strcmp(name, item->Name()))
 				continue;
 
 			if (max == NULL || max->Size() < item->Size()) {
@@ -1379,6 +1394,26 @@ Inode::CreateAttribute(Transaction& transaction, const char* name, uint32 type,
 //	#pragma mark - directory tree
 
 
+/*!	Looks up the ID of the entry \a name in this directory. Huge directories
+	are served from the directory hash, if possible.
+	You need to have the inode read or write locked.
+*/
+status_t
+Inode::Lookup(const char* name, ino_t* _id)
+{
+	if (fTree == NULL)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	if (fDirectoryHash != NULL) {
+		status_t status = fDirectoryHash->Lookup(name, _id);
+		if (status != B_NO_INIT)
+			return status;
+	}
+
+	return fTree->Find((const uint8*)name, (uint16)strlen(name), _id);
+}
+
+
 bool
 Inode::IsEmpty()
 {
@@ -1415,6 +1450,28 @@ Inode::ContainerContentsChanged(Transaction& transaction)
 }
 
 
+/*!	Called by the B+tree of this directory whenever an entry has been added,
+	or its ID has been replaced.
+*/
+void
+Inode::DirectoryEntryAdded(const uint8* name, uint16 length, ino_t id)
+{
+	if (fDirectoryHash != NULL)
+		fDirectoryHash->EntryAdded(name, length, id);
+}
+
+
+/*!	Called by the B+tree of this directory whenever an entry has been
+	removed.
+*/
+void
+Inode::DirectoryEntryRemoved(const uint8* name, uint16 length)
+{
+	if (fDirectoryHash != NULL)
+		fDirectoryHash->EntryRemoved(name, length);
+}
+
+
 //	#pragma mark - data stream
 
 
@@ -1574,6 +1631,12 @@ Inode::FindBlockRun(off_t pos, block_run& run, off_t& offset)
 status_t
 Inode::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 {
+	if (HasInlineData()) {
+		InodeReadLocker locker(this);
+		if (HasInlineData())
+			return ReadInlineData(pos, buffer, _length);
+	}
+
 	return file_cache_read(FileCache(), NULL, pos, buffer, _length);
 }
 
@@ -1650,6 +1713,17 @@ Inode::WriteAt(Transaction& transaction, off_t pos, const uint8* buffer,
 	if (length == 0)
 		return B_OK;
 
+	if (HasInlineData()) {
+		// The data is part of the inode, and is not written through the file
+		// cache, as its paging hooks must not start a transaction
+		if (!transaction.IsStarted())
+			transaction.Start(fVolume, BlockNumber());
+
+		WriteLockInTransaction(transaction);
+		if (HasInlineData())
+			return WriteInlineData(transaction, pos, buffer, _length);
+	}
+
 	status_t status = file_cache_write(FileCache(), NULL, pos, buffer, _length);
 
 	if (transaction.IsStarted())
@@ -1668,6 +1742,11 @@ Inode::WriteAt(Transaction& transaction, off_t pos, const uint8* buffer,
 status_t
 Inode::FillGapWithZeros(off_t pos, off_t newSize)
 {
+	if (HasInlineData()) {
+		// SetFileSize() already cleared the gap
+		return B_OK;
+	}
+
 	while (pos < newSize) {
 		size_t size;
 		if (newSize > pos + 1024 * 1024 * 1024)
@@ -1686,6 +1765,92 @@ Inode::FillGapWithZeros(off_t pos, off_t newSize)
 }
 
 
+/*!	Reads up to \a _length bytes of the file data that is stored in the
+	inode itself, but not beyond its end.
+	The inode must be read locked, and must have INODE_INLINE_DATA set.
+*/
+status_t
+Inode::ReadInlineData(off_t pos, uint8* buffer, size_t* _length)
+{
+	NodeGetter node(fVolume);
+	status_t status = node.SetTo(this);
+	if (status != B_OK)
+		return status;
+
+	RecursiveLocker locker(fSmallDataLock);
+
+	const small_data* item = _FindInlineData(node.Node());
+	if (item == NULL)
+		RETURN_ERROR(B_BAD_DATA);
+
+	size_t length = 0;
+	if (pos >= 0 && pos < item->DataSize())
+		length = min_c(*_length, item->DataSize() - pos);
+
+	*_length = length;
+	if (length > 0 && user_memcpy(buffer, item->Data() + pos, length) < B_OK)
+		return B_BAD_ADDRESS;
+
+	return B_OK;
+}
+
+
+/*!	Overwrites the file data that is stored in the inode itself. This never
+	changes the size of the file; anything beyond its end is ignored, and
+	\a _length is set to the number of bytes actually written.
+	The inode must be read locked, and must have INODE_INLINE_DATA set.
+*/
+status_t
+Inode::WriteInlineData(Transaction& transaction, off_t pos,
+	const uint8* buffer, size_t* _length)
+{
+	NodeGetter node(fVolume);
+	status_t status = node.SetToWritable(transaction, this);
+	if (status != B_OK)
+		return status;
+
+	RecursiveLocker locker(fSmallDataLock);
+
+	small_data* item = _FindInlineData(node.Node());
+	if (item == NULL)
+		RETURN_ERROR(B_BAD_DATA);
+
+	size_t length = 0;
+	if (pos >= 0 && pos < item->DataSize())
+		length = min_c(*_length, item->DataSize() - pos);
+
+	*_length = length;
+	if (length > 0 && user_memcpy(item->Data() + pos, buffer, length) < B_OK)
+		return B_BAD_ADDRESS;
+
+	return B_OK;
+}
+
+
+/*!	Moves the data of the file out of the inode into a regular data stream,
+	so that its pages can be written back like those of any other file. This
+	is needed once a mapping of the file has modified them.
+	As it starts a transaction, it must not be called from the paging hooks.
+*/
+status_t
+Inode::MoveInlineDataToStream()
+{
+	Transaction transaction(fVolume, BlockNumber());
+	WriteLockInTransaction(transaction);
+
+	status_t status = B_OK;
+	if (HasInlineData()) {
+		status = _MoveInlineDataToStream(transaction, Size());
+		if (status == B_OK)
+			status = WriteBack(transaction);
+	}
+	if (status == B_OK)
+		status = transaction.Done();
+
+	return status;
+}
+
+
 /*!	Allocates \a length blocks, and clears their contents. Growing
 	the indirect and double indirect range uses this method.
 	The allocated block_run is saved in "run"
@@ -1831,10 +1996,15 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 					break;
 			}
 
-			if (free < NUM_DIRECT_BLOCKS) {
-				// can we merge the last allocated run with the new one?
-				int32 last = free - 1;
-				if (free > 0 && data->direct[last].MergeableWith(run)) {
+			// can we merge the last allocated run with the new one? This
+			// also works if the direct range is full already, as long as
+			// the stream has not grown into the indirect range yet
+			int32 last = free - 1;
+			bool merge = free > 0 && data->MaxIndirectRange() == 0
+				&& data->direct[last].MergeableWith(run);
+
+			if (free < NUM_DIRECT_BLOCKS || merge) {
+				if (merge) {
 					data->direct[last].length = HOST_ENDIAN_TO_BFS_INT16(
 						data->direct[last].Length() + run.Length());
 				} else
@@ -1857,6 +2027,7 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 			block_run* runs = NULL;
 			uint32 free = 0;
 			off_t block;
+			int32 i = 0;
 
 			// if there is no indirect block yet, create one
 			if (data->indirect.IsZero()) {
@@ -1878,7 +2049,6 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 				block = fVolume->ToBlock(data->indirect);
 
 				// search first empty entry
-				int32 i = 0;
 				for (; i < data->indirect.Length(); i++) {
 					status = cached.SetTo(block + i);
 					if (status != B_OK)
@@ -1896,18 +2066,40 @@ Inode::_GrowStream(Transaction& transaction, off_t size)
 					runs = NULL;
 			}
 
-			if (runs != NULL) {
-				// try to insert the run to the last one - note that this
-				// doesn't take block borders into account, so it could be
-				// further optimized
-				cached.MakeWritable(transaction);
+			// The last run of the stream can also be at the end of the
+			// previous indirect block, or, if the indirect range is full
+			// already, at the end of the last one
+			CachedBlock lastCached(fVolume);
+			block_run* last = NULL;
+			bool lastInBlock = runs != NULL && free > 0;
+			if (lastInBlock)
+				last = &runs[free - 1];
+			else if (i > 0 && data->MaxDoubleIndirectRange() == 0) {
+				status = lastCached.SetTo(fVolume->ToBlock(data->indirect)
+					+ i - 1);
+				if (status != B_OK)
+					return status;
+
+				last = (block_run*)lastCached.Block()
+					+ fVolume->BlockSize() / sizeof(block_run) - 1;
+			}
+
+			bool merge = last != NULL && last->MergeableWith(run);
 
-				int32 last = free - 1;
-				if (free > 0 && runs[last].MergeableWith(run)) {
-					runs[last].length = HOST_ENDIAN_TO_BFS_INT16(
-						runs[last].Length() + run.Length());
-				} else
+			if (runs != NULL || merge) {
+				if (merge) {
+					// just grow the last run
+					if (lastInBlock)
+						cached.MakeWritable(transaction);
+					else
+						lastCached.MakeWritable(transaction);
+
+					last->length = HOST_ENDIAN_TO_BFS_INT16(
+						last->Length() + run.Length());
+				} else {
+					cached.MakeWritable(transaction);
 					runs[free] = run;
+				}
 
 				data->max_indirect_range = HOST_ENDIAN_TO_BFS_INT64(
 					data->MaxIndirectRange()
@@ -2266,6 +2458,147 @@ Inode::_ShrinkStream(Transaction& transaction, off_t size)
 }
 
 
+/*!	Returns how many bytes of file data may be stored in the small_data
+	section. There is always enough room left for a name of maximum length, so
+	that renaming a file can't fail because of its data.
+*/
+size_t
+Inode::_MaxInlineDataSize() const
+{
+	size_t space = fVolume->InodeSize() - sizeof(bfs_inode);
+	size_t nameSize = sizeof(small_data) + FILE_NAME_NAME_LENGTH + 3
+		+ B_FILE_NAME_LENGTH;
+	size_t overhead = sizeof(small_data) + INLINE_DATA_NAME_LENGTH + 3 + 1
+		+ sizeof(small_data);
+		// the item itself, and the end marker of the section
+
+	return space - nameSize - overhead;
+}
+
+
+/*!	Returns the small_data item that contains the data of the file, or
+	NULL if there is none.
+	You need to hold the fSmallDataLock when you call this method
+*/
+small_data*
+Inode::_FindInlineData(const bfs_inode* node) const
+{
+	ASSERT_LOCKED_RECURSIVE(&fSmallDataLock);
+
+	small_data* smallData = NULL;
+	while (_GetNextSmallData(const_cast<bfs_inode*>(node), &smallData)
+			== B_OK) {
+		if (*smallData->Name() == INLINE_DATA_NAME
+			&& smallData->NameSize() == INLINE_DATA_NAME_LENGTH)
+			return smallData;
+	}
+	return NULL;
+}
+
+
+/*!	Lets a new file store its data in the small_data section of its inode,
+	instead of a data stream.
+*/
+status_t
+Inode::_CreateInlineData(Transaction& transaction)
+{
+	NodeGetter node(fVolume);
+	status_t status = node.SetToWritable(transaction, this);
+	if (status != B_OK)
+		return status;
+
+	const char nameTag[2] = {INLINE_DATA_NAME, 0};
+	status = _AddSmallData(transaction, node, nameTag, INLINE_DATA_TYPE, 0,
+		(const uint8*)"", 0);
+	if (status != B_OK)
+		return status;
+
+	Node().flags |= HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
+	return WriteBack(transaction);
+}
+
+
+/*!	Resizes the inline data to \a size bytes; any new space is cleared.
+	Returns \c B_DEVICE_FULL if the data doesn't fit into the inode anymore.
+*/
+status_t
+Inode::_SetInlineDataSize(Transaction& transaction, off_t size)
+{
+	if (size > (off_t)_MaxInlineDataSize())
+		return B_DEVICE_FULL;
+
+	NodeGetter node(fVolume);
+	status_t status = node.SetToWritable(transaction, this);
+	if (status != B_OK)
+		return status;
+
+	// Writing nothing at the new end resizes the item, and clears the gap
+	const char nameTag[2] = {INLINE_DATA_NAME, 0};
+	status = _AddSmallData(transaction, node, nameTag, INLINE_DATA_TYPE, size,
+		(const uint8*)"", 0);
+	if (status != B_OK)
+		return status;
+
+	Node().data.size = HOST_ENDIAN_TO_BFS_INT64(size);
+	return B_OK;
+}
+
+
+/*!	Moves the data of the file out of the inode into a new data stream of
+	\a size bytes. The inline data always fits into the first block of the
+	stream; it is written directly, as the file cache doesn't contain it.
+*/
+status_t
+Inode::_MoveInlineDataToStream(Transaction& transaction, off_t size)
+{
+	uint32 blockSize = fVolume->BlockSize();
+	uint8* buffer = (uint8*)calloc(1, blockSize);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	MemoryDeleter deleter(buffer);
+
+	size_t length = blockSize;
+	status_t status = ReadInlineData(0, buffer, &length);
+	if (status != B_OK)
+		return status;
+
+	off_t oldSize = Size();
+	Node().data.size = 0;
+
+	status = _GrowStream(transaction, size);
+	if (status == B_OK) {
+		block_run run;
+		off_t offset;
+		status = FindBlockRun(0, run, offset);
+		if (status == B_OK && write_pos(fVolume->Device(),
+				fVolume->ToOffset(run), buffer, blockSize) != (ssize_t)blockSize)
+			status = B_IO_ERROR;
+	}
+	if (status != B_OK) {
+		_ShrinkStream(transaction, 0);
+		Node().data.size = HOST_ENDIAN_TO_BFS_INT64(oldSize);
+		return status;
+	}
+
+	Node().flags &= ~HOST_ENDIAN_TO_BFS_INT32(INODE_INLINE_DATA);
+
+	NodeGetter node(fVolume);
+	status = node.SetTo(this);
+	if (status == B_OK) {
+		const char nameTag[2] = {INLINE_DATA_NAME, 0};
+		status = _RemoveSmallData(transaction, node, nameTag);
+	}
+	if (status != B_OK)
+		return status;
+
+#ifndef FS_SHELL
+	file_cache_enable(FileCache());
+#endif
+	return B_OK;
+}
+
+
 status_t
 Inode::SetFileSize(Transaction& transaction, off_t size)
 {
@@ -2281,7 +2614,13 @@ Inode::SetFileSize(Transaction& transaction, off_t size)
 
 	// should the data stream grow or shrink?
 	status_t status;
-	if (size > oldSize) {
+	if (HasInlineData()) {
+		status = _SetInlineDataSize(transaction, size);
+		if (status == B_DEVICE_FULL) {
+			// the data has outgrown the inode
+			status = _MoveInlineDataToStream(transaction, size);
+		}
+	} else if (size > oldSize) {
 		status = _GrowStream(transaction, size);
 		if (status < B_OK) {
 			// if the growing of the stream fails, the whole operation
@@ -2345,6 +2684,45 @@ Inode::TrimPreallocation(Transaction& transaction)
 }
 
 
+/*!	Replaces the data stream with the \a count direct block runs in \a runs,
+	and frees all blocks of the previous stream, including its block arrays.
+	The new runs must already contain a copy of the stream's contents; this
+	is used by the defragmenter to move a stream as a whole.
+	The inode must be write locked in \a transaction.
+*/
+status_t
+Inode::ReplaceStream(Transaction& transaction, const block_run* runs,
+	int32 count)
+{
+	if (count <= 0 || count > NUM_DIRECT_BLOCKS || HasInlineData())
+		RETURN_ERROR(B_BAD_VALUE);
+
+	off_t size = Size();
+	off_t range = 0;
+	for (int32 i = 0; i < count; i++)
+		range += (off_t)runs[i].Length() << fVolume->BlockShift();
+
+	if (range < size)
+		RETURN_ERROR(B_BAD_VALUE);
+
+	status_t status = _ShrinkStream(transaction, 0);
+	if (status != B_OK)
+		return status;
+
+	data_stream* data = &Node().data;
+	memset(data, 0, sizeof(data_stream));
+	for (int32 i = 0; i < count; i++)
+		data->direct[i] = runs[i];
+	data->max_direct_range = HOST_ENDIAN_TO_BFS_INT64(range);
+	data->size = HOST_ENDIAN_TO_BFS_INT64(size);
+
+	if (Map() != NULL)
+		file_map_invalidate(Map(), 0, size);
+
+	return WriteBack(transaction);
+}
+
+
 //!	Frees the file's data stream and removes all attributes
 status_t
 Inode::Free(Transaction& transaction)
@@ -2386,8 +2764,17 @@ Inode::Free(Transaction& transaction)
 status_t
 Inode::Sync()
 {
-	if (FileCache())
-		return file_cache_sync(FileCache());
+	if (FileCache()) {
+		status_t status = file_cache_sync(FileCache());
+		if (status != B_OK && HasInlineData()) {
+			// Pages modified through a mapping can only be written back
+			// after the data has been moved out of the inode
+			status = MoveInlineDataToStream();
+			if (status == B_OK)
+				status = file_cache_sync(FileCache());
+		}
+		return status;
+	}
 
 	// We may also want to flush the attribute's data stream to
 	// disk here... (do we?)
@@ -2494,6 +2881,17 @@ Inode::TransactionDone(bool success)
 		// Revert any changes made to the cached bfs_inode
 		// TODO: return code gets eaten
 		UpdateNodeFromDisk();
+
+#ifndef FS_SHELL
+		// A reverted move of the inline data needs the file cache off again
+		if (HasInlineData() && FileCache() != NULL
+			&& file_cache_is_enabled(FileCache()))
+			file_cache_disable(FileCache());
+#endif
+
+		// The directory hash may contain changes that were just reverted
+		if (fDirectoryHash != NULL)
+			fDirectoryHash->Invalidate();
 	}
 }
 
@@ -2750,6 +3148,13 @@ Inode::Create(Transaction& transaction, Inode* parent, const char* name,
 		&& inode->SetName(transaction, name) != B_OK)
 		return B_ERROR;
 
+	// Files start out with their data in the inode, if the volume allows it
+	if (tree != NULL && inode->IsFile() && volume->HasInlineData()) {
+		status = inode->_CreateInlineData(transaction);
+		if (status != B_OK)
+			RETURN_ERROR(status);
+	}
+
 	// Initialize b+tree if it's a directory (and add "." & ".." if it's
 	// a standard directory for files - not for attributes or indices)
 	if (inode->IsContainer()) {
@@ -2817,6 +3222,11 @@ Inode::Create(Transaction& transaction, Inode* parent, const char* name,
 
 		if (inode->FileCache() == NULL || inode->Map() == NULL)
 			return B_NO_MEMORY;
+
+#ifndef FS_SHELL
+		if (inode->HasInlineData())
+			file_cache_disable(inode->FileCache());
+#endif
 	}
 
 	// Everything worked well until this point, we have a fully
@@ -2894,8 +3304,10 @@ AttributeIterator::GetNext(char* name, size_t* _length, uint32* _type,
 
 		int32 index = 0;
 		for (; !item->IsLast(node); item = item->Next(), index++) {
-			if (item->NameSize() == FILE_NAME_NAME_LENGTH
-				&& *item->Name() == FILE_NAME_NAME)
+			if ((item->NameSize() == FILE_NAME_NAME_LENGTH
+					&& *item->Name() == FILE_NAME_NAME)
+				|| (item->NameSize() == INLINE_DATA_NAME_LENGTH
+					&& *item->Name() == INLINE_DATA_NAME))
 				continue;
 
 			if (index >= fCurrentSmallData)
@@ -17,6 +17,7 @@
 class BPlusTree;
 class TreeIterator;
 class AttributeIterator;
+class DirectoryHash;
 class Index;
 class InodeAllocator;
 class NodeGetter;
@@ -75,6 +76,9 @@ public:
 			bool				IsLongSymLink() const
 									{ return (Flags() & INODE_LONG_SYMLINK)
 										!= 0; }
+			bool				HasInlineData() const
+									{ return (Flags() & INODE_INLINE_DATA)
+										!= 0; }
 
 			bool				HasUserAccessableStream() const
 									{ return IsFile(); }
@@ -137,6 +141,7 @@ public:
 
 			// for directories only:
 			BPlusTree*			Tree() const { return fTree; }
+			status_t			Lookup(const char* name, ino_t* _id);
 			bool				IsEmpty();
 			status_t			ContainerContentsChanged(
 									Transaction& transaction);
@@ -149,12 +154,20 @@ public:
 			status_t			WriteAt(Transaction& transaction, off_t pos,
 									const uint8* buffer, size_t* length);
 			status_t			FillGapWithZeros(off_t oldSize, off_t newSize);
+			status_t			ReadInlineData(off_t pos, uint8* buffer,
+									size_t* _length);
+			status_t			WriteInlineData(Transaction& transaction,
+									off_t pos, const uint8* buffer,
+									size_t* _length);
+			status_t			MoveInlineDataToStream();
 
 			status_t			SetFileSize(Transaction& transaction,
 									off_t size);
 			status_t			Append(Transaction& transaction, off_t bytes);
 			status_t			TrimPreallocation(Transaction& transaction);
 			bool				NeedsTrimming() const;
+			status_t			ReplaceStream(Transaction& transaction,
+									const block_run* runs, int32 count);
 
 			status_t			Free(Transaction& transaction);
 			status_t			Sync();
@@ -182,6 +195,12 @@ public:
 			off_t				OldSize() { return fOldSize; }
 			off_t				OldLastModified() { return fOldLastModified; }
 
+			// directory hash maintaining helper
+			void				DirectoryEntryAdded(const uint8* name,
+									uint16 length, ino_t id);
+			void				DirectoryEntryRemoved(const uint8* name,
+									uint16 length);
+
 			bool				InNameIndex() const;
 			bool				InSizeIndex() const;
 			bool				InLastModifiedIndex() const;
@@ -254,11 +273,21 @@ private:
 			status_t			_ShrinkStream(Transaction& transaction,
 									off_t size);
 
+			// inline data
+			size_t				_MaxInlineDataSize() const;
+			small_data*			_FindInlineData(const bfs_inode* node) const;
+			status_t			_CreateInlineData(Transaction& transaction);
+			status_t			_SetInlineDataSize(Transaction& transaction,
+									off_t size);
+			status_t			_MoveInlineDataToStream(
+									Transaction& transaction, off_t size);
+
 private:
 			rw_lock				fLock;
 			Volume*				fVolume;
 			ino_t				fID;
 			BPlusTree*			fTree;
+			DirectoryHash*		fDirectoryHash;
 			Inode*				fAttributes;
 			void*				fCache;
 			void*				fMap;
@@ -88,6 +88,19 @@ private:
 };
 
 
+/*!	A log entry that has been reserved in the log, but whose contents are
+	still to be written. The blocks of its transaction are held in the block
+	cache until the entry has made it to the disk.
+*/
+struct PendingLogWrite {
+	int32		transactionID;
+	uint32		start;
+	uint32		length;
+	uint32		end;
+	uint8*		data;
+};
+
+
 #if BFS_TRACING && !defined(FS_SHELL) && !defined(_BOOT_MODE)
 namespace BFSJournalTracing {
 
@@ -407,10 +420,12 @@ Journal::Journal(Volume* volume)
 	fUsed(0),
 	fUnwrittenTransactions(0),
 	fHasSubtransaction(false),
-	fSeparateSubTransactions(false)
+	fSeparateSubTransactions(false),
+	fPendingLogWrite(NULL)
 {
 	recursive_lock_init(&fLock, "bfs journal");
 	mutex_init(&fEntriesLock, "bfs journal entries");
+	mutex_init(&fLogWriteLock, "bfs journal log write");
 
 	fLogFlusherSem = create_sem(0, "bfs log flusher");
 	fLogFlusher = spawn_kernel_thread(&Journal::_LogFlusher, "bfs log flusher",
@@ -426,6 +441,7 @@ Journal::~Journal()
 
 	recursive_lock_destroy(&fLock);
 	mutex_destroy(&fEntriesLock);
+	mutex_destroy(&fLogWriteLock);
 
 	sem_id logFlusher = fLogFlusherSem;
 	fLogFlusherSem = -1;
@@ -658,6 +674,9 @@ Journal::_TransactionWritten(int32 transactionID, int32 event, void* _logEntry)
 
 	if (logEntry == journal->fEntries.First()) {
 		LogEntry* next = journal->fEntries.GetNext(logEntry);
+			// If the next entry is still being written, its start equals the
+			// log end that is currently stored on disk, so the log is
+			// considered empty until the write has been finished.
 		if (next != NULL) {
 			superBlock.log_start = HOST_ENDIAN_TO_BFS_INT64(next->Start()
 				% journal->fLogSize);
@@ -719,8 +738,234 @@ Journal::_LogFlusher(void* _journal)
 }
 
 
-/*!	Writes the blocks that are part of current transaction into the log,
-	and ends the current transaction.
+/*!	Writes the run arrays and the blocks of \a runArrays directly into the
+	log, starting at \a _logPosition. On return, \a _logPosition points
+	behind the written entry.
+	This is only used when there is not enough memory to copy the log entry.
+*/
+status_t
+Journal::_WriteRunArrays(RunArrays& runArrays, off_t& _logPosition)
+{
+	int32 blockShift = fVolume->BlockShift();
+	off_t logOffset = fVolume->ToBlock(fVolume->Log()) << blockShift;
+	off_t logStart = _logPosition;
+	off_t logPosition = logStart;
+
+	int32 maxVecs = runArrays.MaxArrayLength() + 1;
+		// one extra for the index block
+
+	BStackOrHeapArray<iovec, 8> vecs(maxVecs);
+	if (!vecs.IsValid()) {
+		// TODO: write back log entries directly?
+		return B_NO_MEMORY;
+	}
+
+	for (int32 k = 0; k < runArrays.CountArrays(); k++) {
+		run_array* array = runArrays.ArrayAt(k);
+		int32 index = 0, count = 1;
+		int32 wrap = fLogSize - logStart;
+
+		add_to_iovec(vecs, index, maxVecs, (void*)array, fVolume->BlockSize());
+
+		// add block runs
+
+		for (int32 i = 0; i < array->CountRuns(); i++) {
+			const block_run& run = array->RunAt(i);
+			off_t blockNumber = fVolume->ToBlock(run);
+
+			for (int32 j = 0; j < run.Length(); j++) {
+				if (count >= wrap) {
+					// We need to write back the first half of the entry
+					// directly as the log wraps around
+					if (writev_pos(fVolume->Device(), logOffset
+						+ (logStart << blockShift), vecs, index) < 0)
+						FATAL(("could not write log area!\n"));
+
+					logPosition = logStart + count;
+					logStart = 0;
+					wrap = fLogSize;
+					count = 0;
+					index = 0;
+				}
+
+				// make blocks available in the cache
+				const void* data = block_cache_get(fVolume->BlockCache(),
+					blockNumber + j);
+				if (data == NULL)
+					return B_IO_ERROR;
+
+				add_to_iovec(vecs, index, maxVecs, data, fVolume->BlockSize());
+				count++;
+			}
+		}
+
+		// write back the rest of the log entry
+		if (count > 0) {
+			logPosition = logStart + count;
+			if (writev_pos(fVolume->Device(), logOffset
+					+ (logStart << blockShift), vecs, index) < 0)
+				FATAL(("could not write log area: %s!\n", strerror(errno)));
+		}
+
+		// release blocks again
+		for (int32 i = 0; i < array->CountRuns(); i++) {
+			const block_run& run = array->RunAt(i);
+			off_t blockNumber = fVolume->ToBlock(run);
+
+			for (int32 j = 0; j < run.Length(); j++) {
+				block_cache_put(fVolume->BlockCache(), blockNumber + j);
+			}
+		}
+
+		logStart = logPosition % fLogSize;
+	}
+
+	_logPosition = logPosition;
+	return B_OK;
+}
+
+
+/*!	Copies the run arrays and the blocks of \a runArrays into \a data, in
+	the order they will appear in the log.
+*/
+status_t
+Journal::_CopyRunArrays(RunArrays& runArrays, uint8* data)
+{
+	int32 blockSize = fVolume->BlockSize();
+
+	for (int32 k = 0; k < runArrays.CountArrays(); k++) {
+		run_array* array = runArrays.ArrayAt(k);
+
+		memcpy(data, array, blockSize);
+		data += blockSize;
+
+		for (int32 i = 0; i < array->CountRuns(); i++) {
+			const block_run& run = array->RunAt(i);
+			off_t blockNumber = fVolume->ToBlock(run);
+
+			for (int32 j = 0; j < run.Length(); j++) {
+				const void* block = block_cache_get(fVolume->BlockCache(),
+					blockNumber + j);
+				if (block == NULL)
+					return B_IO_ERROR;
+
+				memcpy(data, block, blockSize);
+				block_cache_put(fVolume->BlockCache(), blockNumber + j);
+				data += blockSize;
+			}
+		}
+	}
+
+	return B_OK;
+}
+
+
+/*!	Updates the log end pointer in the superblock, and makes sure it reaches
+	the disk.
+*/
+status_t
+Journal::_UpdateLogEnd(off_t logEnd)
+{
+	mutex_lock(&fEntriesLock);
+	fVolume->SuperBlock().flags = SUPER_BLOCK_DISK_DIRTY;
+	fVolume->SuperBlock().log_end = HOST_ENDIAN_TO_BFS_INT64(logEnd);
+	mutex_unlock(&fEntriesLock);
+
+	status_t status = fVolume->WriteSuperBlock();
+
+	// We need to flush the drives own cache here to ensure
+	// disk consistency.
+	// If that call fails, we can't do anything about it anyway
+	ioctl(fVolume->Device(), B_FLUSH_DRIVE_CACHE);
+
+	return status;
+}
+
+
+/*!	Writes the log entry described by \a write to disk, and updates the log
+	end pointer in the superblock. Afterwards, the blocks of its transaction
+	may be written back to their final location.
+	Must not be called with the journal lock held, unless the write has been
+	detached by the same thread; the log write lock is released on return.
+*/
+status_t
+Journal::_FinishLogWrite(PendingLogWrite* write)
+{
+	if (write == NULL)
+		return B_OK;
+
+	int32 blockShift = fVolume->BlockShift();
+	off_t logOffset = fVolume->ToBlock(fVolume->Log()) << blockShift;
+
+	// the entry might wrap around the end of the log
+	uint32 length = min_c(write->length, fLogSize - write->start);
+	if (write_pos(fVolume->Device(), logOffset
+			+ ((off_t)write->start << blockShift), write->data,
+			(size_t)length << blockShift) < 0)
+		FATAL(("could not write log area: %s!\n", strerror(errno)));
+
+	if (length < write->length) {
+		if (write_pos(fVolume->Device(), logOffset, write->data
+				+ ((size_t)length << blockShift),
+				(size_t)(write->length - length) << blockShift) < 0)
+			FATAL(("could not write log area: %s!\n", strerror(errno)));
+	}
+
+	status_t status = _UpdateLogEnd(write->end);
+
+	cache_release_transaction_blocks(fVolume->BlockCache(),
+		write->transactionID);
+
+	free(write->data);
+	delete write;
+
+	mutex_unlock(&fLogWriteLock);
+	return status;
+}
+
+
+/*!	Detaches the pending log write, if any, so that it can be finished by
+	the caller once it released the journal lock. The log write lock is
+	acquired on behalf of the write; others can wait for it to be finished
+	by acquiring that lock, too.
+	Must be called with the journal lock held.
+*/
+PendingLogWrite*
+Journal::_DetachPendingLogWrite()
+{
+	PendingLogWrite* write = fPendingLogWrite;
+	if (write != NULL) {
+		fPendingLogWrite = NULL;
+		mutex_lock(&fLogWriteLock);
+	}
+
+	return write;
+}
+
+
+/*!	Makes sure that the last log entry has been written to disk.
+	Must be called with the journal lock held.
+*/
+void
+Journal::_WaitForLogWrite()
+{
+	if (fPendingLogWrite != NULL) {
+		_FinishLogWrite(_DetachPendingLogWrite());
+		return;
+	}
+
+	// another thread might still be writing the entry it detached
+	mutex_lock(&fLogWriteLock);
+	mutex_unlock(&fLogWriteLock);
+}
+
+
+/*!	Reserves space for the blocks that are part of current transaction in the
+	log, and ends the current transaction.
+	The contents of the log entry are copied, and only written to disk once
+	the journal lock is released (see _FinishLogWrite()), so that the next
+	transaction can already be started in the mean time. The blocks of the
+	transaction are held in the block cache until then.
 	If the current transaction is too large to fit into the log, it will
 	try to detach an existing sub-transaction.
 */
@@ -750,8 +995,11 @@ Journal::_WriteTransactionToLog()
 
 	fHasSubtransaction = false;
 
+	// The previous log entry must be complete before the log end can be
+	// moved again, and before the block cache may end another transaction
+	_WaitForLogWrite();
+
 	int32 blockShift = fVolume->BlockShift();
-	off_t logOffset = fVolume->ToBlock(fVolume->Log()) << blockShift;
 	off_t logStart = fVolume->LogEnd() % fLogSize;
 	off_t logPosition = logStart;
 	status_t status;
@@ -796,81 +1044,43 @@ Journal::_WriteTransactionToLog()
 		}
 	}
 
-	// Write log entries to disk
-
-	int32 maxVecs = runArrays.MaxArrayLength() + 1;
-		// one extra for the index block
-
-	BStackOrHeapArray<iovec, 8> vecs(maxVecs);
-	if (!vecs.IsValid()) {
-		// TODO: write back log entries directly?
+	PendingLogWrite* write = new(std::nothrow) PendingLogWrite;
+	if (write == NULL)
 		return B_NO_MEMORY;
-	}
 
-	for (int32 k = 0; k < runArrays.CountArrays(); k++) {
-		run_array* array = runArrays.ArrayAt(k);
-		int32 index = 0, count = 1;
-		int32 wrap = fLogSize - logStart;
-
-		add_to_iovec(vecs, index, maxVecs, (void*)array, fVolume->BlockSize());
-
-		// add block runs
+	write->start = logStart;
+	write->length = runArrays.LogEntryLength();
+	write->data = (uint8*)malloc((size_t)write->length << blockShift);
 
-		for (int32 i = 0; i < array->CountRuns(); i++) {
-			const block_run& run = array->RunAt(i);
-			off_t blockNumber = fVolume->ToBlock(run);
-
-			for (int32 j = 0; j < run.Length(); j++) {
-				if (count >= wrap) {
-					// We need to write back the first half of the entry
-					// directly as the log wraps around
-					if (writev_pos(fVolume->Device(), logOffset
-						+ (logStart << blockShift), vecs, index) < 0)
-						FATAL(("could not write log area!\n"));
-
-					logPosition = logStart + count;
-					logStart = 0;
-					wrap = fLogSize;
-					count = 0;
-					index = 0;
-				}
-
-				// make blocks available in the cache
-				const void* data = block_cache_get(fVolume->BlockCache(),
-					blockNumber + j);
-				if (data == NULL)
-					return B_IO_ERROR;
-
-				add_to_iovec(vecs, index, maxVecs, data, fVolume->BlockSize());
-				count++;
-			}
-		}
-
-		// write back the rest of the log entry
-		if (count > 0) {
-			logPosition = logStart + count;
-			if (writev_pos(fVolume->Device(), logOffset
-					+ (logStart << blockShift), vecs, index) < 0)
-				FATAL(("could not write log area: %s!\n", strerror(errno)));
+	if (write->data != NULL) {
+		status = _CopyRunArrays(runArrays, write->data);
+		if (status != B_OK) {
+			free(write->data);
+			delete write;
+			return status;
 		}
 
-		// release blocks again
-		for (int32 i = 0; i < array->CountRuns(); i++) {
-			const block_run& run = array->RunAt(i);
-			off_t blockNumber = fVolume->ToBlock(run);
-
-			for (int32 j = 0; j < run.Length(); j++) {
-				block_cache_put(fVolume->BlockCache(), blockNumber + j);
-			}
-		}
+		logPosition = logStart + write->length;
+		if (logPosition > fLogSize)
+			logPosition -= fLogSize;
+	} else {
+		// Not enough memory to defer the write, write the entry directly
+		delete write;
+		write = NULL;
 
-		logStart = logPosition % fLogSize;
+		status = _WriteRunArrays(runArrays, logPosition);
+		if (status != B_OK)
+			return status;
 	}
 
 	LogEntry* logEntry = new(std::nothrow) LogEntry(this, fVolume->LogEnd(),
 		runArrays.LogEntryLength());
 	if (logEntry == NULL) {
 		FATAL(("no memory to allocate log entries!"));
+		if (write != NULL) {
+			free(write->data);
+			delete write;
+		}
 		return B_NO_MEMORY;
 	}
 
@@ -878,29 +1088,30 @@ Journal::_WriteTransactionToLog()
 	logEntry->SetTransactionID(fTransactionID);
 #endif
 
-	// Update the log end pointer in the superblock
-
-	fVolume->SuperBlock().flags = SUPER_BLOCK_DISK_DIRTY;
-	fVolume->SuperBlock().log_end = HOST_ENDIAN_TO_BFS_INT64(logPosition);
-
-	status = fVolume->WriteSuperBlock();
+	if (write == NULL) {
+		// Update the log end pointer in the superblock
+		status = _UpdateLogEnd(logPosition);
+	}
 
 	fVolume->LogEnd() = logPosition;
 	T(LogEntry(logEntry, fVolume->LogEnd(), true));
 
-	// We need to flush the drives own cache here to ensure
-	// disk consistency.
-	// If that call fails, we can't do anything about it anyway
-	ioctl(fVolume->Device(), B_FLUSH_DRIVE_CACHE);
-
 	// at this point, we can finally end the transaction - we're in
-	// a guaranteed valid state
+	// a guaranteed valid state, or will be once the pending log write has
+	// been finished
 
 	mutex_lock(&fEntriesLock);
 	fEntries.Add(logEntry);
 	fUsed += logEntry->Length();
 	mutex_unlock(&fEntriesLock);
 
+	if (write != NULL) {
+		write->transactionID = fTransactionID;
+		write->end = logPosition;
+		cache_hold_transaction_blocks(fVolume->BlockCache(), fTransactionID);
+		fPendingLogWrite = write;
+	}
+
 	if (detached) {
 		fTransactionID = cache_detach_sub_transaction(fVolume->BlockCache(),
 			fTransactionID, _TransactionWritten, logEntry);
@@ -948,11 +1159,16 @@ Journal::_FlushLog(bool canWait, bool flushBlocks)
 			FATAL(("writing current log entry failed: %s\n", strerror(status)));
 	}
 
-	if (flushBlocks)
+	if (flushBlocks) {
+		_WaitForLogWrite();
 		status = fVolume->FlushDevice();
+	}
 
+	PendingLogWrite* write = _DetachPendingLogWrite();
 	recursive_lock_unlock(&fLock);
-	return status;
+
+	status_t writeStatus = _FinishLogWrite(write);
+	return status == B_OK ? writeStatus : status;
 }
 
 
@@ -1045,8 +1261,14 @@ Journal::Unlock(Transaction* owner, bool success)
 	} else
 		owner->MoveListenersTo(fOwner);
 
+	// Write the log entry of the transaction only after we released the
+	// lock, so that the next transaction does not have to wait for it
+	PendingLogWrite* write = NULL;
+	if (recursive_lock_get_recursion(&fLock) == 1)
+		write = _DetachPendingLogWrite();
+
 	recursive_lock_unlock(&fLock);
-	return B_OK;
+	return _FinishLogWrite(write);
 }
 
 
@@ -1086,8 +1308,10 @@ Journal::_TransactionDone(bool success)
 	if (size < fMaxTransactionSize) {
 		// Flush the log from time to time, so that we have enough space
 		// for this transaction
-		if (size > FreeLogBlocks())
+		if (size > FreeLogBlocks()) {
+			_WaitForLogWrite();
 			cache_sync_transaction(fVolume->BlockCache(), fTransactionID);
+		}
 
 		fUnwrittenTransactions++;
 		return B_OK;
@@ -1118,6 +1342,11 @@ Journal::Dump()
 	kprintf("  transaction ID:       %" B_PRId32 "\n", fTransactionID);
 	kprintf("  has subtransaction:   %d\n", fHasSubtransaction);
 	kprintf("  separate sub-trans.:  %d\n", fSeparateSubTransactions);
+	if (fPendingLogWrite != NULL) {
+		kprintf("  pending log write:    id %" B_PRId32 ", start %" B_PRIu32
+			", length %" B_PRIu32 "\n", fPendingLogWrite->transactionID,
+			fPendingLogWrite->start, fPendingLogWrite->length);
+	}
 	kprintf("entries:\n");
 	kprintf("  address        id  start length\n");
 
@@ -15,6 +15,8 @@
 struct run_array;
 class Inode;
 class LogEntry;
+struct PendingLogWrite;
+class RunArrays;
 typedef DoublyLinkedList<LogEntry> LogEntryList;
 
 
@@ -52,6 +54,14 @@ private:
 			status_t		_FlushLog(bool canWait, bool flushBlocks);
 			uint32			_TransactionSize() const;
 			status_t		_WriteTransactionToLog();
+			status_t		_WriteRunArrays(RunArrays& runArrays,
+								off_t& _logPosition);
+			status_t		_CopyRunArrays(RunArrays& runArrays,
+								uint8* data);
+			status_t		_UpdateLogEnd(off_t logEnd);
+			status_t		_FinishLogWrite(PendingLogWrite* write);
+			void			_WaitForLogWrite();
+			PendingLogWrite* _DetachPendingLogWrite();
 			status_t		_CheckRunArray(const run_array* array);
 			status_t		_ReplayRunArray(int32* start);
 			status_t		_TransactionDone(bool success);
@@ -72,6 +82,8 @@ private:
 			int32			fUnwrittenTransactions;
 			mutex			fEntriesLock;
 			LogEntryList	fEntries;
+			mutex			fLogWriteLock;
+			PendingLogWrite* fPendingLogWrite;
 			bigtime_t		fTimestamp;
 			int32			fTransactionID;
 			bool			fHasSubtransaction;
@@ -124,10 +124,52 @@ struct Query::QueryPolicy {
 
 	static int32 IndexGetSize(Index& index)
 	{
-		off_t size = index.Node()->Size() / index.Node()->GetVolume()->BlockSize();
-		if (size > INT32_MAX)
+		// Estimate the number of entries from the number of nodes in the
+		// tree, assuming they are filled by three quarters on average; the
+		// length of string keys is just a guess.
+		BPlusTree* tree = index.Node()->Tree();
+		if (tree == NULL)
 			return INT32_MAX;
-		return size;
+
+		off_t nodes = index.Node()->Size() / tree->NodeSize();
+		size_t keyLength = index.KeySize();
+		if (keyLength == 0)
+			keyLength = 16;
+
+		off_t entries = nodes * (tree->NodeSize() - sizeof(bplustree_node))
+			/ (keyLength + sizeof(uint16) + sizeof(off_t)) * 3 / 4;
+		if (entries > INT32_MAX)
+			return INT32_MAX;
+		return entries;
+	}
+
+	static int32 IndexEstimateMatches(Index& index, const void* value,
+		size_t size, int32 maxCount)
+	{
+		// the keys of the time index cannot be compared directly
+		if (index.isSpecialTime || index.Node()->Tree() == NULL)
+			return -1;
+
+		TreeIterator iterator(index.Node()->Tree());
+		if (iterator.Find((const uint8*)value, size) != B_OK)
+			return 0;
+
+		type_code type = index.Type();
+		int32 count = 0;
+		while (count < maxCount) {
+			uint8 key[MAX_INDEX_KEY_LENGTH + 1];
+			uint16 keyLength;
+			off_t id;
+			if (iterator.GetNextEntry(key, &keyLength, sizeof(key), &id)
+					!= B_OK
+				|| QueryParser::compareKeys(type, key, keyLength, value,
+					size) != 0) {
+				break;
+			}
+			count++;
+		}
+
+		return count;
 	}
 
 	static type_code IndexGetType(Index& index)
@@ -206,6 +248,13 @@ struct Query::QueryPolicy {
 		return B_OK;
 	}
 
+	static status_t IndexIteratorGetEntryID(IndexIterator* iterator,
+		ino_t* _id)
+	{
+		*_id = iterator->offset;
+		return B_OK;
+	}
+
 	static void IndexIteratorSkipDuplicates(IndexIterator* iterator)
 	{
 		iterator->SkipDuplicates();
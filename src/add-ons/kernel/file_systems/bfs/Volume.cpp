@@ -8,7 +8,9 @@
 
 
 #include "Attribute.h"
+#include "BPlusTree.h"
 #include "CheckVisitor.h"
+#include "DefragmentVisitor.h"
 #include "Debug.h"
 #include "file_systems/DeviceOpener.h"
 #include "Inode.h"
@@ -35,7 +37,8 @@ static const int32 kDesiredAllocationGroups = 56;
 bool
 disk_super_block::IsMagicValid() const
 {
-	return Magic1() == (int32)SUPER_BLOCK_MAGIC1
+	return (Magic1() == (int32)SUPER_BLOCK_MAGIC1
+			|| Magic1() == (int32)SUPER_BLOCK_MAGIC1_FEATURES)
 		&& Magic2() == (int32)SUPER_BLOCK_MAGIC2
 		&& Magic3() == (int32)SUPER_BLOCK_MAGIC3;
 }
@@ -53,7 +56,8 @@ disk_super_block::IsValid() const
 		|| BlocksPerAllocationGroup() < 1
 		|| NumBlocks() < 10
 		|| AllocationGroups() != divide_roundup(NumBlocks(),
-			1L << AllocationGroupShift()))
+			1L << AllocationGroupShift())
+		|| (Features() & ~SUPER_BLOCK_KNOWN_FEATURES) != 0)
 		return false;
 
 	return true;
@@ -132,17 +136,23 @@ Volume::Volume(fs_volume* volume)
 	fRootNode(NULL),
 	fIndicesNode(NULL),
 	fDirtyCachedBlocks(0),
+	fIndexCacheGeneration(0),
 	fFlags(0),
 	fCheckingThread(-1),
-	fCheckVisitor(NULL)
+	fCheckVisitor(NULL),
+	fDefragmentVisitor(NULL)
 {
 	mutex_init(&fLock, "bfs volume");
 	mutex_init(&fQueryLock, "bfs queries");
+	mutex_init(&fIndexCacheLock, "bfs index cache");
+
+	InvalidateIndexCache();
 }
 
 
 Volume::~Volume()
 {
+	mutex_destroy(&fIndexCacheLock);
 	mutex_destroy(&fQueryLock);
 	mutex_destroy(&fLock);
 }
@@ -477,6 +487,86 @@ Volume::RemoveQuery(Query* query)
 }
 
 
+/*!	Looks up the index \a name in the indices directory, and returns the ID
+	of its node. The result is cached, including the fact that an index does
+	not exist, since Index::Update() looks up an index for every attribute
+	that is changed, and most of them are not indexed.
+*/
+status_t
+Volume::FindIndex(const char* name, ino_t& _id)
+{
+	size_t length = strlen(name);
+	bool cacheable = length > 0 && length < kMaxCachedIndexNameLength;
+		// empty names are used to mark unused cache entries
+
+	uint32 hash = 0;
+	for (size_t i = 0; i < length; i++)
+		hash = (hash << 5) - hash + (uint8)name[i];
+	index_cache_entry& entry = fIndexCache[hash % kIndexCacheSize];
+
+	uint32 generation = 0;
+	if (cacheable) {
+		MutexLocker locker(fIndexCacheLock);
+		if (strcmp(entry.name, name) == 0) {
+			if (entry.id < 0)
+				return B_ENTRY_NOT_FOUND;
+
+			_id = entry.id;
+			return B_OK;
+		}
+
+		generation = fIndexCacheGeneration;
+	}
+
+	Inode* indices = IndicesNode();
+	if (indices == NULL)
+		return B_ENTRY_NOT_FOUND;
+
+	InodeReadLocker indicesLocker(indices);
+
+	BPlusTree* tree = indices->Tree();
+	if (tree == NULL)
+		return B_BAD_VALUE;
+
+	ino_t id;
+	status_t status = tree->Find((uint8*)name, (uint16)length, &id);
+	if (status != B_OK && status != B_ENTRY_NOT_FOUND)
+		return status;
+
+	indicesLocker.Unlock();
+
+	if (cacheable) {
+		// only cache the result if no index has been added or removed since
+		// we started looking
+		MutexLocker locker(fIndexCacheLock);
+		if (generation == fIndexCacheGeneration) {
+			strcpy(entry.name, name);
+			entry.id = status == B_OK ? id : -1;
+		}
+	}
+
+	if (status == B_OK)
+		_id = id;
+	return status;
+}
+
+
+/*!	Needs to be called whenever an index has been created or removed, after
+	the transaction doing so has been finished.
+*/
+void
+Volume::InvalidateIndexCache()
+{
+	MutexLocker locker(fIndexCacheLock);
+
+	for (int32 i = 0; i < kIndexCacheSize; i++) {
+		fIndexCache[i].name[0] = '\0';
+		fIndexCache[i].id = -1;
+	}
+	fIndexCacheGeneration++;
+}
+
+
 status_t
 Volume::CreateCheckVisitor()
 {
@@ -499,6 +589,28 @@ Volume::DeleteCheckVisitor()
 }
 
 
+status_t
+Volume::CreateDefragmentVisitor()
+{
+	if (fDefragmentVisitor != NULL)
+		return B_BUSY;
+
+	fDefragmentVisitor = new(std::nothrow) ::DefragmentVisitor(this);
+	if (fDefragmentVisitor == NULL)
+		return B_NO_MEMORY;
+
+	return B_OK;
+}
+
+
+void
+Volume::DeleteDefragmentVisitor()
+{
+	delete fDefragmentVisitor;
+	fDefragmentVisitor = NULL;
+}
+
+
 //	#pragma mark - Disk scanning and initialization
 
 
@@ -579,6 +691,12 @@ Volume::Initialize(int fd, const char* name, uint32 blockSize,
 	// create valid superblock
 
 	fSuperBlock.Initialize(name, numBlocks, blockSize);
+	if ((flags & VOLUME_INLINE_DATA) != 0) {
+		fSuperBlock.magic1
+			= HOST_ENDIAN_TO_BFS_INT32(SUPER_BLOCK_MAGIC1_FEATURES);
+		fSuperBlock.features
+			|= HOST_ENDIAN_TO_BFS_INT32(SUPER_BLOCK_FEATURE_INLINE_DATA);
+	}
 
 	// initialize short hands to the superblock (to save byte swapping)
 	fBlockSize = fSuperBlock.BlockSize();
@@ -13,6 +13,7 @@
 
 
 class CheckVisitor;
+class DefragmentVisitor;
 class Journal;
 class Inode;
 class Query;
@@ -24,10 +25,20 @@ enum volume_flags {
 
 enum volume_initialize_flags {
 	VOLUME_NO_INDICES	= 0x0001,
+	VOLUME_INLINE_DATA	= 0x0002,
 };
 
 typedef DoublyLinkedList<Inode> InodeList;
 
+static const int32 kIndexCacheSize = 32;
+static const size_t kMaxCachedIndexNameLength = 48;
+
+struct index_cache_entry {
+	char			name[kMaxCachedIndexNameLength];
+	ino_t			id;
+		// negative if the index does not exist
+};
+
 
 class Volume {
 public:
@@ -44,6 +55,9 @@ public:
 			bool			IsValidSuperBlock() const;
 			bool			IsValidInodeBlock(off_t block) const;
 			bool			IsReadOnly() const;
+			bool			HasInlineData() const
+								{ return (fSuperBlock.Features()
+									& SUPER_BLOCK_FEATURE_INLINE_DATA) != 0; }
 			void			Panic();
 			mutex&			Lock();
 
@@ -121,6 +135,10 @@ public:
 			status_t		CreateCheckVisitor();
 			void			DeleteCheckVisitor();
 			::CheckVisitor*	CheckVisitor() { return fCheckVisitor; }
+			status_t		CreateDefragmentVisitor();
+			void			DeleteDefragmentVisitor();
+			::DefragmentVisitor* DefragmentVisitor()
+								{ return fDefragmentVisitor; }
 
 			// cache access
 			status_t		WriteSuperBlock();
@@ -139,6 +157,10 @@ public:
 			void			AddQuery(Query* query);
 			void			RemoveQuery(Query* query);
 
+			// indices
+			status_t		FindIndex(const char* name, ino_t& _id);
+			void			InvalidateIndexCache();
+
 			status_t		Sync();
 			Journal*		GetJournal(off_t refBlock) const;
 
@@ -175,11 +197,16 @@ protected:
 			mutex			fQueryLock;
 			DoublyLinkedList<Query> fQueries;
 
+			mutex			fIndexCacheLock;
+			index_cache_entry fIndexCache[kIndexCacheSize];
+			uint32			fIndexCacheGeneration;
+
 			uint32			fFlags;
 
 			void*			fBlockCache;
 			thread_id		fCheckingThread;
 			::CheckVisitor*	fCheckVisitor;
+			::DefragmentVisitor* fDefragmentVisitor;
 
 			InodeList		fRemovedInodes;
 };
@@ -76,7 +76,8 @@ struct disk_super_block {
 	int32		magic3;
 	inode_addr	root_dir;
 	inode_addr	indices;
-	int32		_reserved[8];
+	uint32		features;
+	int32		_reserved[7];
 	int32		pad_to_block[87];
 		// this also contains parts of the boot block
 
@@ -97,6 +98,7 @@ struct disk_super_block {
 	int32 Flags() const { return BFS_ENDIAN_TO_HOST_INT32(flags); }
 	off_t LogStart() const { return BFS_ENDIAN_TO_HOST_INT64(log_start); }
 	off_t LogEnd() const { return BFS_ENDIAN_TO_HOST_INT64(log_end); }
+	inline uint32 Features() const;
 
 	// implemented in Volume.cpp:
 	bool IsMagicValid() const;
@@ -107,12 +109,33 @@ struct disk_super_block {
 #define SUPER_BLOCK_FS_LENDIAN		'BIGE'		/* BIGE */
 
 #define SUPER_BLOCK_MAGIC1			'BFS1'		/* BFS1 */
+#define SUPER_BLOCK_MAGIC1_FEATURES	'BFS2'		/* BFS2 */
+	// used instead of SUPER_BLOCK_MAGIC1 by volumes that use any of the
+	// features below, so that older drivers refuse to mount them
 #define SUPER_BLOCK_MAGIC2			0xdd121031
 #define SUPER_BLOCK_MAGIC3			0x15b6830e
 
 #define SUPER_BLOCK_DISK_CLEAN		'CLEN'		/* CLEN */
 #define SUPER_BLOCK_DISK_DIRTY		'DIRT'		/* DIRT */
 
+// Features that change the on-disk format; a volume that uses a feature we
+// don't know about must not be mounted. Drivers that predate this field
+// ignore it, so such volumes also have SUPER_BLOCK_MAGIC1_FEATURES set.
+#define SUPER_BLOCK_FEATURE_INLINE_DATA	0x00000001
+	// the contents of small files are stored in their inode
+
+#define SUPER_BLOCK_KNOWN_FEATURES	SUPER_BLOCK_FEATURE_INLINE_DATA
+
+
+inline uint32
+disk_super_block::Features() const
+{
+	// the field is only used by volumes that older drivers reject
+	return Magic1() == (int32)SUPER_BLOCK_MAGIC1_FEATURES
+		? BFS_ENDIAN_TO_HOST_INT32(features) : 0;
+}
+
+
 //**************************************
 
 #define NUM_DIRECT_BLOCKS			12
@@ -172,6 +195,12 @@ struct small_data {
 #define FILE_NAME_NAME			0x13
 #define FILE_NAME_NAME_LENGTH	1
 
+// The contents of files with INODE_INLINE_DATA set are part of the
+// small_data structure, too
+#define INLINE_DATA_TYPE		'RAWT'
+#define INLINE_DATA_NAME		0x14
+#define INLINE_DATA_NAME_LENGTH	1
+
 // The maximum key length of attribute data that is put  in the index.
 // This excludes a terminating null byte.
 // This must be smaller than or equal as BPLUSTREE_MAX_KEY_LENGTH.
@@ -259,6 +288,7 @@ enum inode_flags {
 	INODE_DELETED			= 0x00000010,
 	INODE_NOT_READY			= 0x00000020,	// used during Inode construction
 	INODE_LONG_SYMLINK		= 0x00000040,	// symlink in data stream
+	INODE_INLINE_DATA		= 0x00000080,	// file data in small_data
 
 	INODE_PERMANENT_FLAGS	= 0x0000ffff,
 
@@ -278,7 +308,8 @@ struct file_cookie {
 	int		open_mode;
 };
 
-#define BFS_OPEN_MODE_USER_MASK		0x7fffffff
+#define BFS_OPEN_MODE_USER_MASK		0x3fffffff
+#define BFS_OPEN_MODE_DEFRAGMENTING	0x40000000
 #define BFS_OPEN_MODE_CHECKING		0x80000000
 
 // notify every second if the file size has changed
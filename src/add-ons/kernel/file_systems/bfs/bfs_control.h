@@ -104,4 +104,48 @@ struct check_control {
 #define BFS_IOCTL_RESIZE		14205
 
 
+/* ioctls to defragment a mounted volume, one node at a time
+ * all calls use a struct defragment_control as single parameter
+ */
+#define BFS_IOCTL_START_DEFRAGMENTING	14206
+#define BFS_IOCTL_STOP_DEFRAGMENTING	14207
+#define BFS_IOCTL_DEFRAGMENT_NEXT_NODE	14208
+
+/* All fields except "magic", and "flags" must be set to zero before
+ * BFS_IOCTL_START_DEFRAGMENTING is called.
+ * "runs" and "status" describe the node last visited, "runs" being the
+ * number of contiguous extents its stream consisted of before.
+ */
+struct defragment_control {
+	uint32		magic;
+	uint32		flags;
+	char		name[B_FILE_NAME_LENGTH];
+	ino_t		inode;
+	uint32		mode;
+	uint32		runs;
+	struct {
+		uint64	inodes;
+		uint64	fragmented;
+		uint64	defragmented;
+		uint64	skipped;
+		uint64	runs_before;
+		uint64	runs_after;
+		uint64	moved_blocks;
+		uint32	block_size;
+	} stats;
+	status_t	status;
+};
+
+/* values for the flags field */
+#define BFS_DEFRAGMENT_FILES		1
+	/* file, attribute, and symbolic link data */
+#define BFS_DEFRAGMENT_BPLUSTREES	2
+	/* directories, attribute directories, and indices */
+#define BFS_DEFRAGMENT_ANALYZE_ONLY	4
+	/* only reports fragmented nodes, doesn't change anything */
+
+/* defragment control magic value */
+#define BFS_IOCTL_DEFRAGMENT_MAGIC	'BDfg'
+
+
 #endif	/* BFS_CONTROL_H */
@@ -9,7 +9,9 @@
 
 #include "Attribute.h"
 #include "CheckVisitor.h"
+#include "DefragmentVisitor.h"
 #include "Debug.h"
+#include "DirectoryHash.h"
 #include "Volume.h"
 #include "Inode.h"
 #include "Index.h"
@@ -118,6 +120,133 @@ iterative_io_finished_hook(void* cookie, io_request* request, status_t status,
 }
 
 
+/*!	Reads from a file that keeps its data in the inode; stops at the end of
+	the file. The inode must be read locked.
+*/
+static status_t
+read_inline_data_pages(Inode* inode, off_t pos, const iovec* vecs,
+	size_t count, size_t* _numBytes)
+{
+	size_t bytesLeft = *_numBytes;
+	*_numBytes = 0;
+
+	for (size_t i = 0; i < count && bytesLeft > 0; i++) {
+		size_t length = min_c(vecs[i].iov_len, bytesLeft);
+		size_t bytes = length;
+		status_t status = inode->ReadInlineData(pos, (uint8*)vecs[i].iov_base,
+			&bytes);
+		if (status != B_OK)
+			return status;
+
+		*_numBytes += bytes;
+		if (bytes < length)
+			break;
+
+		pos += bytes;
+		bytesLeft -= bytes;
+	}
+
+	return B_OK;
+}
+
+
+#ifndef FS_SHELL
+static status_t
+move_inline_data_thread(void* _inode)
+{
+	Inode* inode = (Inode*)_inode;
+
+	status_t status = inode->MoveInlineDataToStream();
+	if (status != B_OK) {
+		FATAL(("could not move inline data of inode %" B_PRIdINO ": %s\n",
+			inode->ID(), strerror(status)));
+	}
+
+	put_vnode(inode->GetVolume()->FSVolume(), inode->ID());
+	return status;
+}
+#endif	// !FS_SHELL
+
+
+/*!	Called when modified pages of a file that keeps its data in the inode are
+	to be written back; they can only stem from a mapping of the file, as
+	Inode::WriteAt() doesn't use the file cache for such files.
+	The paging hooks must not start a transaction, as the page writer could
+	then wait for the journal while its owner waits for free pages. Instead,
+	the data is moved to a regular data stream in the background, and the
+	pages are written back the next time the page writer comes by.
+*/
+static status_t
+request_inline_data_move(Volume* volume, Inode* inode)
+{
+#ifndef FS_SHELL
+	acquire_vnode(volume->FSVolume(), inode->ID());
+
+	thread_id thread = spawn_kernel_thread(&move_inline_data_thread,
+		"bfs inline data mover", B_NORMAL_PRIORITY, inode);
+	if (thread < 0)
+		put_vnode(volume->FSVolume(), inode->ID());
+	else
+		resume_thread(thread);
+#endif
+
+	return B_BUSY;
+}
+
+
+#ifndef FS_SHELL
+/*!	Handles \a request directly for a file that keeps its data in the inode.
+	Writes are not done here, but see request_inline_data_move().
+	Returns \c false if the file doesn't do that (anymore), in which case the
+	request is left untouched.
+*/
+static bool
+inline_data_io(Volume* volume, Inode* inode, io_request* request)
+{
+	InodeReadLocker locker(inode);
+
+	if (!inode->HasInlineData()) {
+		// the data has been moved to a data stream in the mean time
+		return false;
+	}
+
+	if (io_request_is_write(request)) {
+		locker.Unlock();
+		notify_io_request(request, request_inline_data_move(volume, inode));
+		return true;
+	}
+
+	size_t bufferSize = volume->BlockSize();
+	uint8* buffer = (uint8*)malloc(bufferSize);
+	MemoryDeleter deleter(buffer);
+	status_t status = buffer != NULL ? B_OK : B_NO_MEMORY;
+
+	off_t pos = io_request_offset(request);
+	off_t end = pos + io_request_length(request);
+
+	while (status == B_OK && pos < end) {
+		size_t length = min_c(end - pos, (off_t)bufferSize);
+		size_t bytes = length;
+
+		status = inode->ReadInlineData(pos, buffer, &bytes);
+		if (status == B_OK && bytes > 0)
+			status = write_to_io_request(request, buffer, bytes);
+		if (bytes < length) {
+			// we've reached the end of the file
+			break;
+		}
+
+		pos += length;
+	}
+
+	locker.Unlock();
+
+	notify_io_request(request, status);
+	return true;
+}
+#endif	// !FS_SHELL
+
+
 //	#pragma mark - Scanning
 
 
@@ -420,6 +549,9 @@ bfs_read_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 
 	InodeReadLocker _(inode);
 
+	if (inode->HasInlineData())
+		return read_inline_data_pages(inode, pos, vecs, count, _numBytes);
+
 	uint32 vecIndex = 0;
 	size_t vecOffset = 0;
 	size_t bytesLeft = *_numBytes;
@@ -465,6 +597,9 @@ bfs_write_pages(fs_volume* _volume, fs_vnode* _node, void* _cookie,
 
 	InodeReadLocker _(inode);
 
+	if (inode->HasInlineData())
+		return request_inline_data_move(volume, inode);
+
 	uint32 vecIndex = 0;
 	size_t vecOffset = 0;
 	size_t bytesLeft = *_numBytes;
@@ -520,6 +655,12 @@ bfs_io(fs_volume* _volume, fs_vnode* _node, void* _cookie, io_request* request)
 		RETURN_ERROR(B_BAD_VALUE);
 	}
 
+#ifndef FS_SHELL
+	// Small files may not have a data stream that could be mapped
+	if (inode->HasInlineData() && inline_data_io(volume, inode, request))
+		return B_OK;
+#endif
+
 	// We lock the node here and will unlock it in the "finished" hook.
 	rw_lock_read_lock(&inode->Lock());
 
@@ -605,11 +746,7 @@ bfs_lookup(fs_volume* _volume, fs_vnode* _directory, const char* file,
 	if (status != B_OK)
 		RETURN_ERROR(status);
 
-	BPlusTree* tree = directory->Tree();
-	if (tree == NULL)
-		RETURN_ERROR(B_BAD_VALUE);
-
-	status = tree->Find((uint8*)file, (uint16)strlen(file), _vnodeID);
+	status = directory->Lookup(file, _vnodeID);
 	if (status != B_OK) {
 		//PRINT(("bfs_walk() could not find %lld:\"%s\": %s\n", directory->BlockNumber(), file, strerror(status)));
 		if (status == B_ENTRY_NOT_FOUND)
@@ -748,7 +885,8 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 				if (checker->Pass() == BFS_CHECK_PASS_BITMAP) {
 					if (checker->WriteBackCheckBitmap() == B_OK)
 						status = checker->StartIndexPass();
-				}
+				} else if (checker->Pass() == BFS_CHECK_PASS_INDEX)
+					checker->WriteBackIndices();
 			}
 
 			if (status == B_OK) {
@@ -758,6 +896,71 @@ bfs_ioctl(fs_volume* _volume, fs_vnode* _node, void* _cookie, uint32 cmd,
 
 			return status;
 		}
+		case BFS_IOCTL_START_DEFRAGMENTING:
+		{
+			// the checker keeps the journal locked
+			if (volume->CheckVisitor() != NULL)
+				return B_BUSY;
+
+			status_t status = volume->CreateDefragmentVisitor();
+			if (status != B_OK)
+				return status;
+
+			DefragmentVisitor* defragmenter = volume->DefragmentVisitor();
+
+			if (user_memcpy(&defragmenter->Control(), buffer,
+					sizeof(defragment_control)) != B_OK) {
+				volume->DeleteDefragmentVisitor();
+				return B_BAD_ADDRESS;
+			}
+
+			status = defragmenter->StartDefragmenting();
+			if (status == B_OK) {
+				file_cookie* cookie = (file_cookie*)_cookie;
+				cookie->open_mode |= BFS_OPEN_MODE_DEFRAGMENTING;
+			} else
+				volume->DeleteDefragmentVisitor();
+
+			return status;
+		}
+		case BFS_IOCTL_STOP_DEFRAGMENTING:
+		{
+			DefragmentVisitor* defragmenter = volume->DefragmentVisitor();
+			if (defragmenter == NULL)
+				return B_NO_INIT;
+
+			status_t status = defragmenter->StopDefragmenting();
+
+			if (status == B_OK) {
+				file_cookie* cookie = (file_cookie*)_cookie;
+				cookie->open_mode &= ~BFS_OPEN_MODE_DEFRAGMENTING;
+
+				status = user_memcpy(buffer, &defragmenter->Control(),
+					sizeof(defragment_control));
+			}
+
+			volume->DeleteDefragmentVisitor();
+			return status;
+		}
+		case BFS_IOCTL_DEFRAGMENT_NEXT_NODE:
+		{
+			DefragmentVisitor* defragmenter = volume->DefragmentVisitor();
+			if (defragmenter == NULL)
+				return B_NO_INIT;
+
+			status_t status = defragmenter->Next();
+			if (status == B_ENTRY_NOT_FOUND) {
+				defragmenter->Control().status = B_ENTRY_NOT_FOUND;
+				return status;
+			}
+
+			if (status == B_OK) {
+				status = user_memcpy(buffer, &defragmenter->Control(),
+					sizeof(defragment_control));
+			}
+
+			return status;
+		}
 		case BFS_IOCTL_UPDATE_BOOT_BLOCK:
 		{
 			// let's makebootable (or anyone else) update the boot block
@@ -1569,6 +1772,12 @@ bfs_free_cookie(fs_volume* _volume, fs_vnode* _node, void* _cookie)
 		volume->CheckVisitor()->StopChecking();
 		volume->DeleteCheckVisitor();
 	}
+	if ((cookie->open_mode & BFS_OPEN_MODE_DEFRAGMENTING) != 0) {
+		// the defragmenter exited without stopping
+		FATAL(("defragment process was aborted!\n"));
+		volume->DefragmentVisitor()->StopDefragmenting();
+		volume->DeleteDefragmentVisitor();
+	}
 
 	if ((cookie->open_mode & O_NOCACHE) != 0 && inode->FileCache() != NULL)
 		file_cache_enable(inode->FileCache());
@@ -2189,14 +2398,18 @@ bfs_create_index(fs_volume* _volume, const char* name, uint32 type,
 	if (geteuid() != 0)
 		return B_NOT_ALLOWED;
 
-	Transaction transaction(volume, volume->Indices());
+	status_t status;
+	{
+		Transaction transaction(volume, volume->Indices());
 
-	Index index(volume);
-	status_t status = index.Create(transaction, name, type);
+		Index index(volume);
+		status = index.Create(transaction, name, type);
 
-	if (status == B_OK)
-		status = transaction.Done();
+		if (status == B_OK)
+			status = transaction.Done();
+	}
 
+	volume->InvalidateIndexCache();
 	RETURN_ERROR(status);
 }
 
@@ -2219,12 +2432,16 @@ bfs_remove_index(fs_volume* _volume, const char* name)
 	if (indices == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	Transaction transaction(volume, volume->Indices());
+	status_t status;
+	{
+		Transaction transaction(volume, volume->Indices());
 
-	status_t status = indices->Remove(transaction, name);
-	if (status == B_OK)
-		status = transaction.Done();
+		status = indices->Remove(transaction, name);
+		if (status == B_OK)
+			status = transaction.Done();
+	}
 
+	volume->InvalidateIndexCache();
 	RETURN_ERROR(status);
 }
 
@@ -2429,6 +2646,7 @@ bfs_std_ops(int32 op, ...)
 {
 	switch (op) {
 		case B_MODULE_INIT:
+			DirectoryHash::Init();
 #ifdef BFS_DEBUGGER_COMMANDS
 			add_debugger_commands();
 #endif
@@ -2437,6 +2655,7 @@ bfs_std_ops(int32 op, ...)
 #ifdef BFS_DEBUGGER_COMMANDS
 			remove_debugger_commands();
 #endif
+			DirectoryHash::Uninit();
 			return B_OK;
 
 		default:
@@ -180,6 +180,13 @@ struct Query::QueryPolicy {
 		return index.index->CountEntries();
 	}
 
+	static int32 IndexEstimateMatches(Index& index, const void* value,
+		size_t size, int32 maxCount)
+	{
+		// unknown
+		return -1;
+	}
+
 	static type_code IndexGetType(Index& index)
 	{
 		return index.index->GetType();
@@ -225,6 +232,12 @@ struct Query::QueryPolicy {
 		return B_OK;
 	}
 
+	static status_t IndexIteratorGetEntryID(IndexIterator* indexIterator,
+		ino_t* _id)
+	{
+		return B_UNSUPPORTED;
+	}
+
 	static void IndexIteratorSkipDuplicates(IndexIterator* indexIterator)
 	{
 		// Nothing to do.
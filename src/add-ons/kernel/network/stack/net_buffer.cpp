@@ -53,6 +53,8 @@
 #define DATA_NODE_READ_ONLY		0x1
 #define DATA_NODE_STORED_HEADER	0x2
 
+#define DATA_HEADER_EXTERNAL	0x1
+
 struct header_space {
 	uint16	size;
 	uint16	free;
@@ -70,6 +72,16 @@ struct data_header {
 	uint8*			data_end;
 	header_space	space;
 	uint16			tail_space;
+	uint16			flags;
+};
+
+/*!	Refers to data that is owned by someone else, and can therefore only be
+	referenced by read-only data nodes. Once the last reference is gone,
+	\c release is called.
+*/
+struct external_data_header : data_header {
+	void			(*release)(void* cookie);
+	void*			cookie;
 };
 
 struct data_node {
@@ -153,6 +165,7 @@ struct net_buffer_private : net_buffer {
 
 static object_cache* sNetBufferCache;
 static object_cache* sDataNodeCache;
+static object_cache* sExternalDataHeaderCache;
 
 
 static status_t append_data(net_buffer* buffer, const void* data, size_t size);
@@ -814,6 +827,7 @@ create_data_header(size_t headerSpace)
 	header->tail_space = (uint8*)header + BUFFER_SIZE - header->data_end
 		- headerSpace;
 	header->first_free = NULL;
+	header->flags = 0;
 
 	TRACE(("%d:   create new data header %p\n", find_thread(NULL), header));
 	T2(CreateDataHeader(header));
@@ -830,6 +844,14 @@ release_data_header(data_header* header)
 		return;
 
 	TRACE(("%d:   free header %p\n", find_thread(NULL), header));
+
+	if ((header->flags & DATA_HEADER_EXTERNAL) != 0) {
+		external_data_header* external = (external_data_header*)header;
+		external->release(external->cookie);
+		object_cache_free(sExternalDataHeaderCache, external, 0);
+		return;
+	}
+
 	free_data_header(header);
 }
 
@@ -1416,7 +1438,8 @@ merge_buffer(net_buffer* _buffer, net_buffer* _with, bool after)
 		if (node == NULL)
 			break;
 
-		if ((uint8*)node > (uint8*)node->header
+		if ((node->header->flags & DATA_HEADER_EXTERNAL) == 0
+			&& (uint8*)node > (uint8*)node->header
 			&& (uint8*)node < (uint8*)node->header + BUFFER_SIZE) {
 			// The node is already in the buffer, we can just move it
 			// over to the new owner
@@ -2011,6 +2034,67 @@ append_cloned_data(net_buffer* _buffer, net_buffer* _source, uint32 offset,
 }
 
 
+/*!	Appends \a bytes of the memory at \a data to the buffer without copying
+	it. The memory stays owned by the caller, and must not go away before
+	\a release has been called with \a cookie; this happens as soon as the
+	last buffer referencing the data is freed. If this function fails,
+	\a release is not called.
+*/
+static status_t
+append_external_data(net_buffer* _buffer, const void* data, size_t bytes,
+	void (*release)(void* cookie), void* cookie)
+{
+	net_buffer_private* buffer = (net_buffer_private*)_buffer;
+	TRACE(("%d: append_external_data(buffer %p, data %p, bytes = %ld)\n",
+		find_thread(NULL), buffer, data, bytes));
+
+	// the size of a data node is limited to 16 bits
+	if (bytes == 0 || bytes > UINT16_MAX || release == NULL)
+		return B_BAD_VALUE;
+
+	ParanoiaChecker _(buffer);
+
+	external_data_header* header = (external_data_header*)object_cache_alloc(
+		sExternalDataHeaderCache, 0);
+	if (header == NULL)
+		return ENOBUFS;
+
+	header->ref_count = 1;
+	header->physical_address = 0;
+	header->first_free = NULL;
+	header->data_end = (uint8*)data + bytes;
+	header->space.size = 0;
+	header->space.free = 0;
+	header->tail_space = 0;
+	header->flags = DATA_HEADER_EXTERNAL;
+	header->release = release;
+	header->cookie = cookie;
+
+	data_node* node = add_data_node(buffer, header);
+	if (node == NULL) {
+		object_cache_free(sExternalDataHeaderCache, header, 0);
+		return ENOBUFS;
+	}
+
+	// the node holds the only reference from now on
+	release_data_header(header);
+
+	node->offset = buffer->size;
+	node->start = (uint8*)data;
+	node->used = bytes;
+	node->flags = DATA_NODE_READ_ONLY;
+
+	list_add_item(&buffer->buffers, node);
+	buffer->size += bytes;
+
+	CHECK_BUFFER(buffer);
+	SET_PARANOIA_CHECK(PARANOIA_SUSPICIOUS, buffer, &buffer->size,
+		sizeof(buffer->size));
+
+	return B_OK;
+}
+
+
 void
 set_ancillary_data(net_buffer* buffer, ancillary_data_container* container)
 {
@@ -2327,6 +2411,15 @@ std_ops(int32 op, ...)
 				return B_NO_MEMORY;
 			}
 
+			sExternalDataHeaderCache = create_object_cache(
+				"external data header cache", sizeof(external_data_header), 0,
+				NULL, NULL, NULL);
+			if (sExternalDataHeaderCache == NULL) {
+				delete_object_cache(sNetBufferCache);
+				delete_object_cache(sDataNodeCache);
+				return B_NO_MEMORY;
+			}
+
 #if ENABLE_STATS
 			add_debugger_command_etc("net_buffer_stats", &dump_net_buffer_stats,
 				"Print net buffer statistics",
@@ -2348,6 +2441,7 @@ std_ops(int32 op, ...)
 #endif
 			delete_object_cache(sNetBufferCache);
 			delete_object_cache(sDataNodeCache);
+			delete_object_cache(sExternalDataHeaderCache);
 			return B_OK;
 
 		default:
@@ -2405,5 +2499,7 @@ net_buffer_module_info gNetBufferModule = {
 	swap_addresses,
 
 	dump_buffer,	// dump
+
+	append_external_data,
 };
 
@@ -1417,6 +1417,93 @@ socket_send(net_socket* socket, msghdr* header, const void* data, size_t length,
 }
 
 
+/*!	Sends the memory described by \a vecs over the connected stream
+	\a socket without copying it; it is attached to the net_buffers as
+	external data instead.
+	The socket always takes over the \a vecs, no matter if they could be
+	sent or not: their release hooks will be called as soon as their data is
+	no longer needed.
+	Returns \c B_NOT_SUPPORTED if the socket's protocol cannot handle
+	external data.
+*/
+ssize_t
+socket_send_external(net_socket* socket, const net_external_vec* vecs,
+	uint32 count, int flags)
+{
+	const bool nosignal = ((flags & MSG_NOSIGNAL) != 0);
+	flags &= ~MSG_NOSIGNAL;
+
+	uint32 index = 0;
+	ssize_t bytesSent = 0;
+	status_t status = B_OK;
+
+	if (socket->type != SOCK_STREAM
+		|| socket->first_info->send_data_no_buffer != NULL) {
+		status = B_NOT_SUPPORTED;
+	} else if (socket->peer.ss_len == 0)
+		status = ENOTCONN;
+
+	while (status == B_OK && index < count) {
+		net_buffer* buffer = gNetBufferModule.create(256);
+		if (buffer == NULL) {
+			status = ENOBUFS;
+			break;
+		}
+
+		while (index < count && (buffer->size == 0
+				|| buffer->size + vecs[index].length
+					<= socket->send.buffer_size)) {
+			if (gNetBufferModule.append_external(buffer, vecs[index].data,
+					vecs[index].length, vecs[index].release,
+					vecs[index].cookie) != B_OK) {
+				status = ENOBUFS;
+				break;
+			}
+			index++;
+		}
+
+		if (buffer->size == 0) {
+			gNetBufferModule.free(buffer);
+			break;
+		}
+
+		size_t bufferSize = buffer->size;
+		buffer->msg_flags = flags;
+		memcpy(buffer->source, &socket->address, socket->address.ss_len);
+		memcpy(buffer->destination, &socket->peer, socket->peer.ss_len);
+
+		status = socket->first_info->send_data(socket->first_protocol, buffer);
+		if (status != B_OK) {
+			// we only send signals when called from userland
+			if (status == EPIPE && is_syscall() && !nosignal)
+				send_signal(find_thread(NULL), SIGPIPE);
+
+			size_t sizeAfterSend = buffer->size;
+			gNetBufferModule.free(buffer);
+
+			if ((sizeAfterSend != bufferSize || bytesSent > 0)
+				&& (status == B_INTERRUPTED || status == B_WOULD_BLOCK)) {
+				// this appears to be a partial write
+				bytesSent += bufferSize - sizeAfterSend;
+				status = B_OK;
+			}
+			break;
+		}
+
+		bytesSent += bufferSize;
+	}
+
+	// release everything that didn't make it into a buffer
+	for (; index < count; index++)
+		vecs[index].release(vecs[index].cookie);
+
+	if (status != B_OK && bytesSent == 0)
+		return status;
+
+	return bytesSent;
+}
+
+
 status_t
 socket_set_option(net_socket* socket, int level, int option, const void* value,
 	int length)
@@ -1701,6 +1788,8 @@ net_socket_module_info gNetSocketModule = {
 	socket_send,
 	socket_setsockopt,
 	socket_shutdown,
-	socket_socketpair
+	socket_socketpair,
+
+	socket_send_external
 };
 
@@ -244,6 +244,14 @@ stack_interface_get_next_socket_stat(int family, uint32* cookie,
 }
 
 
+static ssize_t
+stack_interface_send_external(net_socket* socket, const net_external_vec* vecs,
+	uint32 count, int flags)
+{
+	return gNetSocketModule.send_external(socket, vecs, count, flags);
+}
+
+
 static status_t
 stack_interface_std_ops(int32 op, ...)
 {
@@ -298,5 +306,7 @@ net_stack_interface_module_info gNetStackInterfaceModule = {
 	&stack_interface_select,
 	&stack_interface_deselect,
 
-	&stack_interface_get_next_socket_stat
+	&stack_interface_get_next_socket_stat,
+
+	&stack_interface_send_external
 };
@@ -9,16 +9,19 @@
 #include "PoorManServer.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h> //for struct timeval
+#include <unistd.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <poll.h>
 
-#include <File.h>
+#include <AutoDeleter.h>
 #include <Debug.h>
 #include <OS.h>
 #include <String.h>
@@ -388,17 +391,13 @@ status_t PoorManServer::_HandleGet(httpd_conn* hc)
 {
 	PRINT(("HandleGet() called\n"));
 
-	ssize_t bytesRead;
-	uint8* buf;
 	BString log;
 
-	BFile file(hc->expnfilename, B_READ_ONLY);
-	if (file.InitCheck() != B_OK)
+	int fd = open(hc->expnfilename, O_RDONLY);
+	if (fd < 0)
 		return B_ERROR;
 
-	buf = new uint8[POOR_MAN_BUF_SIZE];
-	if (buf == NULL)
-		return B_ERROR;
+	FileDescriptorCloser fileCloser(fd);
 	
 	static_cast<PoorManApplication*>(be_app)->GetPoorManWindow()->SetHits(
 		static_cast<PoorManApplication*>(be_app)->
@@ -413,21 +412,16 @@ status_t PoorManServer::_HandleGet(httpd_conn* hc)
 	poorman_log(log.String(), true, &hc->client_addr);
 	
 	//send mime headers
-	if (send(hc->conn_fd, hc->response, hc->responselen, 0) < 0) {
-		delete [] buf;
+	if (send(hc->conn_fd, hc->response, hc->responselen, 0) < 0)
 		return B_ERROR;
-	}
 	
-	file.Seek(hc->first_byte_index, SEEK_SET);
+	// let the kernel send the file straight out of the file cache
+	off_t offset = hc->first_byte_index;
 	while (true) {
-		bytesRead = file.Read(buf, POOR_MAN_BUF_SIZE);
-		if (bytesRead == 0)
+		ssize_t bytesSent = sendfile(hc->conn_fd, fd, &offset, SSIZE_MAX);
+		if (bytesSent == 0)
 			break;
-		else if (bytesRead < 0) {
-			delete [] buf;
-			return B_ERROR;
-		}
-		if (send(hc->conn_fd, (void*)buf, bytesRead, 0) < 0) {
+		if (bytesSent < 0) {
 			log.SetTo("Error sending file: ");
 			if (pthread_rwlock_rdlock(&fWebDirLock) == 0) {
 				log << hc->hs->cwd;
@@ -435,12 +429,10 @@ status_t PoorManServer::_HandleGet(httpd_conn* hc)
 			}
 			log << '/' << hc->expnfilename << '\n';
 			poorman_log(log.String(), true, &hc->client_addr, RED);
-			delete [] buf;
 			return B_ERROR;
 		}
 	}
 	
-	delete [] buf;
 	return B_OK;
 }
 
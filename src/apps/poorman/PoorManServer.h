@@ -15,7 +15,6 @@
 
 #include "libhttpd/libhttpd.h"
 
-#define POOR_MAN_BUF_SIZE 1048576ll
 
 #ifdef __cplusplus
 class PoorManServer{
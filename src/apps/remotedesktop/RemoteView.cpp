@@ -1,5 +1,5 @@
 /*
- * Copyright 2009-2014, Haiku, Inc.
+ * Copyright 2009-2026, Haiku, Inc.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -69,7 +69,8 @@ RemoteView::RemoteView(BRect frame, const char *remoteHost, uint16 remotePort)
 	fOffscreen(NULL),
 	fViewCursor(kCursorData),
 	fCursorBitmap(NULL),
-	fCursorVisible(false)
+	fCursorVisible(false),
+	fCachedBitmaps(NULL)
 {
 	fReceiveBuffer = new(std::nothrow) StreamingRingBuffer(16 * 1024);
 	if (fReceiveBuffer == NULL) {
@@ -173,6 +174,8 @@ RemoteView::~RemoteView()
 
 	int32 result;
 	wait_for_thread(fDrawThread, &result);
+
+	_DeleteBitmapCache();
 }
 
 
@@ -442,7 +445,9 @@ RemoteView::_DrawThread()
 	// cursor
 	BPoint cursorHotSpot(0, 0);
 
+	uint32 offeredCapabilities = RemoteMessage::SupportedCapabilities();
 	reply.Start(RP_INIT_CONNECTION);
+	reply.Add(offeredCapabilities);
 	reply.Flush();
 
 	while (!fStopThread) {
@@ -468,6 +473,24 @@ RemoteView::_DrawThread()
 		switch (code) {
 			case RP_INIT_CONNECTION:
 			{
+				// servers that don't know about capabilities don't send any
+				uint32 capabilities = 0;
+				if (message.DataLeft() >= sizeof(uint32))
+					message.Read(capabilities);
+
+				_DeleteBitmapCache();
+				if ((capabilities & RP_CAPABILITY_BITMAP_CACHE) != 0
+					&& _InitBitmapCache() != B_OK) {
+					// The server expects us to cache bitmaps now; negotiate
+					// again without the cache, and wait for its answer.
+					TRACE_ERROR("failed to allocate the bitmap cache\n");
+					offeredCapabilities &= ~RP_CAPABILITY_BITMAP_CACHE;
+					reply.Start(RP_INIT_CONNECTION);
+					reply.Add(offeredCapabilities);
+					reply.Flush();
+					continue;
+				}
+
 				BRect bounds = fOffscreenBitmap->Bounds();
 				reply.Start(RP_UPDATE_DISPLAY_MODE);
 				reply.Add(bounds.IntegerWidth() + 1);
@@ -546,6 +569,25 @@ RemoteView::_DrawThread()
 				continue;
 			}
 
+			case RP_CACHE_BITMAP:
+			{
+				int32 slot;
+				if (message.Read(slot) != B_OK || fCachedBitmaps == NULL
+					|| slot < 0 || slot >= kRemoteBitmapCacheSlots) {
+					continue;
+				}
+
+				// The server considers the slot replaced even if the bitmap
+				// cannot be read, so the old one must not be drawn anymore.
+				delete fCachedBitmaps[slot];
+				fCachedBitmaps[slot] = NULL;
+
+				BBitmap *bitmap;
+				if (message.ReadEncodedBitmap(&bitmap) == B_OK)
+					fCachedBitmaps[slot] = bitmap;
+				continue;
+			}
+
 			case RP_INVALIDATE_RECT:
 			{
 				BRect rect;
@@ -774,6 +816,27 @@ RemoteView::_DrawThread()
 				break;
 			}
 
+			case RP_DRAW_CACHED_BITMAP:
+			{
+				BRect bitmapRect, viewRect;
+				uint32 options;
+				int32 slot;
+
+				message.Read(bitmapRect);
+				message.Read(viewRect);
+				message.Read(options);
+				if (message.Read(slot) != B_OK || fCachedBitmaps == NULL
+					|| slot < 0 || slot >= kRemoteBitmapCacheSlots
+					|| fCachedBitmaps[slot] == NULL) {
+					continue;
+				}
+
+				offscreen->DrawBitmap(fCachedBitmaps[slot], bitmapRect,
+					viewRect, options);
+				invalidRegion.Include(viewRect);
+				break;
+			}
+
 			case RP_DRAW_BITMAP_RECTS:
 			{
 				color_space colorSpace;
@@ -1328,3 +1391,29 @@ RemoteView::_BuildInvalidateRect(BPoint *points, int32 pointCount)
 
 	return bounds;
 }
+
+
+status_t
+RemoteView::_InitBitmapCache()
+{
+	fCachedBitmaps = (BBitmap **)calloc(kRemoteBitmapCacheSlots,
+		sizeof(BBitmap *));
+	if (fCachedBitmaps == NULL)
+		return B_NO_MEMORY;
+
+	return B_OK;
+}
+
+
+void
+RemoteView::_DeleteBitmapCache()
+{
+	if (fCachedBitmaps == NULL)
+		return;
+
+	for (int32 i = 0; i < kRemoteBitmapCacheSlots; i++)
+		delete fCachedBitmaps[i];
+
+	free(fCachedBitmaps);
+	fCachedBitmaps = NULL;
+}
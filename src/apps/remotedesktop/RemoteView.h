@@ -61,6 +61,9 @@ static	int32						_DrawEntry(void *data);
 		BRect						_BuildInvalidateRect(BPoint *points,
 										int32 pointCount);
 
+		status_t					_InitBitmapCache();
+		void						_DeleteBitmapCache();
+
 		status_t					fInitStatus;
 		bool						fIsConnected;
 
@@ -81,6 +84,8 @@ static	int32						_DrawEntry(void *data);
 		BRect						fCursorFrame;
 		bool						fCursorVisible;
 
+		BBitmap **					fCachedBitmaps;
+
 		BObjectList<engine_state>	fStates;
 };
 
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <StorageDefs.h>
+
+#include <AutoDeleter.h>
+#include <StringForSize.h>
+
+#include "bfs_control.h"
+
+
+static struct option const kLongOptions[] = {
+	{"help", no_argument, 0, 'h'},
+	{"analyze", no_argument, 0, 'a'},
+	{"files", no_argument, 0, 'f'},
+	{"trees", no_argument, 0, 't'},
+	{"verbose", no_argument, 0, 'v'},
+	{NULL}
+};
+
+
+extern const char* __progname;
+static const char* kProgramName = __progname;
+
+static volatile sig_atomic_t sQuit = 0;
+
+
+void
+PrintUsage(void)
+{
+	fprintf(stderr, "Usage: %s [options] <path-to-mounted-file-system>\n",
+		kProgramName);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "%s rewrites fragmented files and directories of a "
+		"mounted BFS volume\ninto contiguous blocks.\n", kProgramName);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "List of options:\n");
+	fprintf(stderr, " -a, --analyze  Only report fragmentation, don't move "
+		"any data\n");
+	fprintf(stderr, " -f, --files    Only defragment file, attribute, and "
+		"symbolic link data\n");
+	fprintf(stderr, " -t, --trees    Only defragment directories, and "
+		"indices\n");
+	fprintf(stderr, " -v, --verbose  List every fragmented node\n");
+	fprintf(stderr, " -h, --help     Display this help\n");
+}
+
+
+static void
+QuitHandler(int /*signal*/)
+{
+	sQuit = 1;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	uint32 flags = 0;
+	bool verbose = false;
+
+	int c;
+	while ((c = getopt_long(argc, argv, "haftv", kLongOptions, NULL)) != -1) {
+		switch (c) {
+			case 0:
+				break;
+			case 'a':
+				flags |= BFS_DEFRAGMENT_ANALYZE_ONLY;
+				break;
+			case 'f':
+				flags |= BFS_DEFRAGMENT_FILES;
+				break;
+			case 't':
+				flags |= BFS_DEFRAGMENT_BPLUSTREES;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'h':
+				PrintUsage();
+				return EXIT_SUCCESS;
+			default:
+				PrintUsage();
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (argc - optind < 1) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+	const char* path = argv[optind++];
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: Could not access path: %s\n", kProgramName,
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	FileDescriptorCloser closer(fd);
+
+	defragment_control control;
+	memset(&control, 0, sizeof(control));
+	control.magic = BFS_IOCTL_DEFRAGMENT_MAGIC;
+	control.flags = flags;
+
+	if (ioctl(fd, BFS_IOCTL_START_DEFRAGMENTING, &control,
+			sizeof(control)) != 0) {
+		fprintf(stderr, "%s: Could not start defragmenting: %s\n",
+			kProgramName, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	// Let an interrupted run still stop properly, and print its results
+	signal(SIGINT, QuitHandler);
+	signal(SIGTERM, QuitHandler);
+
+	status_t status = B_OK;
+	uint64 counter = 0;
+	while (!sQuit) {
+		if (ioctl(fd, BFS_IOCTL_DEFRAGMENT_NEXT_NODE, &control,
+				sizeof(control)) != 0) {
+			status = errno;
+			break;
+		}
+
+		if (++counter % 50 == 0 && isatty(STDOUT_FILENO))
+			printf("%9" B_PRIu64 " nodes processed\x1b[1A\n", counter);
+
+		if (control.runs <= 1)
+			continue;
+
+		if (control.status != B_OK) {
+			printf("%s (inode = %" B_PRIdINO "), %" B_PRIu32 " extents: %s\n",
+				control.name, control.inode, control.runs,
+				strerror(control.status));
+		} else if (verbose) {
+			printf("%s (inode = %" B_PRIdINO "), %" B_PRIu32 " extents\n",
+				control.name, control.inode, control.runs);
+		}
+	}
+
+	if (ioctl(fd, BFS_IOCTL_STOP_DEFRAGMENTING, &control,
+			sizeof(control)) != 0) {
+		fprintf(stderr, "%s: Could not stop defragmenting: %s\n",
+			kProgramName, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	char movedSize[128];
+	string_for_size(control.stats.moved_blocks * control.stats.block_size,
+		movedSize, sizeof(movedSize));
+
+	printf("        %" B_PRIu64 " nodes visited%s\n"
+		"\tfragmented\t%" B_PRIu64 "\n"
+		"\tdefragmented\t%" B_PRIu64 "\n"
+		"\tskipped\t\t%" B_PRIu64 "\n"
+		"\textents\t\t%" B_PRIu64 " -> %" B_PRIu64 "\n"
+		"\tmoved\t\t%s\n", control.stats.inodes,
+		sQuit ? " (interrupted)" : "", control.stats.fragmented,
+		control.stats.defragmented, control.stats.skipped,
+		control.stats.runs_before, control.stats.runs_after, movedSize);
+
+	if (status != B_OK && status != B_ENTRY_NOT_FOUND) {
+		fprintf(stderr, "%s: Defragmenting failed: %s\n", kProgramName,
+			strerror(status));
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -19,8 +19,9 @@ static void
 usage(const char *programName)
 {
 	
-	printf("usage: %s [-ro] [-t fstype] [-p parameter] [device] directory\n"
+	printf("usage: %s [-ro] [-nonegcache] [-t fstype] [-p parameter] [device] directory\n"
 		"\t-ro\tmounts the volume read-only\n"
+		"\t-nonegcache\tdoesn't cache lookups of missing entries\n"
 		"\t-t\tspecifies the file system to use (defaults to automatic recognition)\n"
 		"\t-p\tspecifies parameters to pass to the file system (-o also accepted)\n"
 		"\tif device is not specified, NULL is passed (for in-memory filesystems)\n",programName);
@@ -55,6 +56,9 @@ main(int argc, char **argv)
 
 		if (!strcmp(++arg, "ro") && (flags & B_MOUNT_READ_ONLY) == 0)
 			flags |= B_MOUNT_READ_ONLY;
+		else if (!strcmp(arg, "nonegcache")
+			&& (flags & B_MOUNT_NO_NEGATIVE_ENTRY_CACHE) == 0)
+			flags |= B_MOUNT_NO_NEGATIVE_ENTRY_CACHE;
 		else if (!strcmp(arg, "t") && fs == NULL) {
 			if (argc <= 1)
 				break;
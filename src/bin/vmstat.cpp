@@ -11,10 +11,14 @@
 
 #include <system_info.h>
 
+#include <object_cache_defs.h>
+#include <syscalls.h>
+
 
 static struct option const kLongOptions[] = {
 	{"periodic", no_argument, 0, 'p'},
 	{"rate", required_argument, 0, 'r'},
+	{"slabs", no_argument, 0, 's'},
 	{"help", no_argument, 0, 'h'},
 	{NULL}
 };
@@ -26,15 +30,76 @@ static const char *kProgramName = __progname;
 void
 usage(int status)
 {
-	fprintf(stderr, "usage: %s [-p] [-r <time>]\n"
+	fprintf(stderr, "usage: %s [-p] [-r <time>] [-s]\n"
 		" -p,--periodic\tDumps changes periodically every second.\n"
-		" -r,--rate\tDumps changes periodically every <time> milli seconds.\n",
+		" -r,--rate\tDumps changes periodically every <time> milli seconds.\n"
+		" -s,--slabs\tDumps the statistics of the kernel's object caches.\n",
 		kProgramName);
 
 	exit(status);
 }
 
 
+static int
+dump_object_caches()
+{
+	object_cache_info* infos = NULL;
+	status_t capacity = 0;
+	status_t count;
+
+	// the number of caches may change between the calls, retry until all of
+	// them fit into the buffer
+	while (true) {
+		count = _kern_generic_syscall(OBJECT_CACHE_SYSCALLS,
+			GET_OBJECT_CACHE_INFOS, infos,
+			capacity * sizeof(object_cache_info));
+		if (count < 0) {
+			fprintf(stderr, "%s: cannot get object cache info: %s\n",
+				kProgramName, strerror(count));
+			free(infos);
+			return 1;
+		}
+		if (count <= capacity)
+			break;
+
+		free(infos);
+		capacity = count + 16;
+		infos = (object_cache_info*)malloc(
+			capacity * sizeof(object_cache_info));
+		if (infos == NULL) {
+			fprintf(stderr, "%s: out of memory\n", kProgramName);
+			return 1;
+		}
+	}
+
+	printf("%-32s %6s %9s %9s %10s %4s %6s %10s %9s %3s\n", "name", "size",
+		"used", "total", "usage", "mag", "hit %", "exchanges", "contended",
+		"rsz");
+
+	for (status_t i = 0; i < count; i++) {
+		const object_cache_info& info = infos[i];
+		printf("%-32s %6" B_PRIuSIZE " %9" B_PRIuSIZE " %9" B_PRIuSIZE
+			" %10" B_PRIuSIZE, info.name, info.object_size, info.used_objects,
+			info.total_objects, info.usage);
+
+		if ((info.flags & OBJECT_CACHE_HAS_DEPOT) == 0) {
+			puts("    -      -          -         -   -");
+			continue;
+		}
+
+		uint64 allocations = info.alloc_hits + info.alloc_misses;
+		printf(" %4" B_PRIuSIZE " %6.2f %10" B_PRIu64 " %9" B_PRIu64 " %3"
+			B_PRIu32 "\n", info.magazine_capacity,
+			allocations > 0 ? 100.0 * info.alloc_hits / allocations : 0.0,
+			info.depot_exchanges, info.depot_contentions,
+			info.magazine_resizes);
+	}
+
+	free(infos);
+	return 0;
+}
+
+
 int
 main(int argc, char** argv)
 {
@@ -42,7 +107,7 @@ main(int argc, char** argv)
 	bigtime_t rate = 1000000LL;
 
 	int c;
-	while ((c = getopt_long(argc, argv, "pr:h", kLongOptions, NULL)) != -1) {
+	while ((c = getopt_long(argc, argv, "pr:sh", kLongOptions, NULL)) != -1) {
 		switch (c) {
 			case 0:
 				break;
@@ -58,6 +123,8 @@ main(int argc, char** argv)
 				}
 				periodically = true;
 				break;
+			case 's':
+				return dump_object_caches();
 			case 'h':
 				usage(0);
 				break;
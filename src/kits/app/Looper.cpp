@@ -15,6 +15,7 @@
 
 #include <Looper.h>
 
+#include <algorithm>
 #include <new>
 #include <stdio.h>
 #include <stdlib.h>
@@ -1150,6 +1151,57 @@ BLooper::ReadMessageFromPort(bigtime_t timeout)
 }
 
 
+/*!	Moves all messages currently in the port to the message queue without
+	blocking. Small messages are read in bursts with a single syscall each,
+	only messages that don't fit into the burst buffers are read one by one.
+*/
+void
+BLooper::_DrainPort()
+{
+	const size_t kBurstCount = 8;
+	const size_t kBurstBufferSize = 1024;
+
+	int32 count = port_count(fMsgPort);
+	char buffers[kBurstCount][kBurstBufferSize];
+	port_message_vec messages[kBurstCount];
+
+	while (count > 0) {
+		size_t burst = std::min((size_t)count, kBurstCount);
+		for (size_t i = 0; i < burst; i++) {
+			messages[i].buffer = buffers[i];
+			messages[i].size = kBurstBufferSize;
+		}
+
+		ssize_t read = read_port_messages_etc(fMsgPort, messages, burst,
+			B_RELATIVE_TIMEOUT, 0);
+		if (read == B_BUFFER_OVERFLOW) {
+			// the next message is too large for the burst buffers
+			BMessage* message = ReadMessageFromPort(0);
+			if (message == NULL)
+				break;
+
+			_AddMessagePriv(message);
+			count--;
+			continue;
+		}
+		if (read <= 0)
+			break;
+
+		for (ssize_t i = 0; i < read; i++) {
+			// an empty message leaves its buffer untouched, and is passed on
+			// without one, as ReadRawFromPort() does
+			BMessage* message = ConvertToMessage(
+				messages[i].size > 0 ? messages[i].buffer : NULL,
+				messages[i].code);
+			if (message != NULL)
+				_AddMessagePriv(message);
+		}
+
+		count -= read;
+	}
+}
+
+
 BMessage*
 BLooper::ConvertToMessage(void* buffer, int32 code)
 {
@@ -1194,15 +1246,9 @@ BLooper::task_looper()
 		if (msg)
 			_AddMessagePriv(msg);
 
-		// Get message count from port
-		int32 msgCount = port_count(fMsgPort);
-		for (int32 i = 0; i < msgCount; ++i) {
-			// Read 'count' messages from port (so we will not block)
-			// We use zero as our timeout since we know there is stuff there
-			msg = MessageFromPort(0);
-			if (msg)
-				_AddMessagePriv(msg);
-		}
+		// Read the messages that are already in the port (so we will not
+		// block)
+		_DrainPort();
 
 		// loop: As long as there are messages in the queue and the port is
 		//		 empty... and we are not terminating, of course.
@@ -2923,14 +2923,7 @@ BWindow::_SetName(const char* title)
 void
 BWindow::_DequeueAll()
 {
-	//	Get message count from port
-	int32 count = port_count(fMsgPort);
-
-	for (int32 i = 0; i < count; i++) {
-		BMessage* message = MessageFromPort(0);
-		if (message != NULL)
-			fDirectTarget->Queue()->AddMessage(message);
-	}
+	_DrainPort();
 }
 
 
@@ -2964,16 +2957,9 @@ BWindow::task_looper()
 		if (msg)
 			_AddMessagePriv(msg);
 
-		//	Get message count from port
-		int32 msgCount = port_count(fMsgPort);
-		for (int32 i = 0; i < msgCount; ++i) {
-			// Read 'count' messages from port (so we will not block)
-			// We use zero as our timeout since we know there is stuff there
-			msg = MessageFromPort(0);
-			// Add messages to queue
-			if (msg)
-				_AddMessagePriv(msg);
-		}
+		// Add the messages that are already in the port to the queue
+		// (so we will not block)
+		_DrainPort();
 
 		bool dispatchNextMessage = true;
 		while (!fTerminating && dispatchNextMessage) {
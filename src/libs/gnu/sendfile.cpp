@@ -0,0 +1,28 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <sys/sendfile.h>
+
+#include <errno.h>
+
+#include <syscall_utils.h>
+#include <syscalls.h>
+
+
+ssize_t
+sendfile(int outFD, int inFD, off_t* offset, size_t count)
+{
+	if (offset == NULL) {
+		// use, and update the file position
+		RETURN_AND_SET_ERRNO(_kern_sendfile(outFD, inFD, -1, count, 0));
+	}
+
+	ssize_t bytesSent = _kern_sendfile(outFD, inFD, *offset, count, 0);
+	if (bytesSent > 0)
+		*offset += bytesSent;
+
+	RETURN_AND_SET_ERRNO(bytesSent);
+}
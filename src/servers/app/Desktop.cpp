@@ -3179,6 +3179,7 @@ Desktop::_HideWindow(Window* window)
 	// hidden windows are excluded from the
 	// clipping calculation, but anyways)
 	BRegion dirty(window->VisibleRegion());
+	window->StoreShownContents();
 
 	BRegion background;
 	_RebuildClippingForAllWindows(background);
@@ -3602,6 +3603,11 @@ Desktop::_ScreenChanged(Screen* screen)
 	fScreenRegion.Set(screen->Frame());
 	gInputManager->UpdateScreenBounds(screen->Frame());
 
+	for (Window* window = fAllWindows.FirstWindow(); window != NULL;
+			window = window->NextWindow(kAllWindowList)) {
+		window->ForgetShownContents();
+	}
+
 	BRegion background;
 	_RebuildClippingForAllWindows(background);
 
@@ -3785,6 +3791,7 @@ Desktop::_SetWorkspace(int32 index, bool moveFocusWindow)
 		if (!window->IsHidden()) {
 			// this window will no longer be visible
 			dirty.Include(&window->VisibleRegion());
+			window->StoreShownContents();
 		}
 
 		window->SetCurrentWorkspace(-1);
@@ -29,6 +29,7 @@
 #include "GlobalSubpixelSettings.h"
 #include "ServerConfig.h"
 #include "SystemPalette.h"
+#include "drawing_support.h"
 
 
 DesktopSettingsPrivate::DesktopSettingsPrivate(server_read_only_memory* shared)
@@ -57,6 +58,7 @@ DesktopSettingsPrivate::_SetDefaults()
 	fFocusFollowsMouseMode = B_NORMAL_FOCUS_FOLLOWS_MOUSE;
 	fAcceptFirstClick = true;
 	fShowAllDraggers = true;
+	fWindowBackingStores = false;
 
 	// init scrollbar info
 	fScrollBarInfo.proportional = true;
@@ -89,6 +91,8 @@ DesktopSettingsPrivate::_SetDefaults()
 	gDefaultHintingMode = HINTING_MODE_ON;
 	gSubpixelAverageWeight = 120;
 	gSubpixelOrderingRGB = true;
+
+	gTiledRendering = false;
 }
 
 
@@ -301,6 +305,19 @@ DesktopSettingsPrivate::_Load()
 				gSubpixelOrderingRGB = subpixelOrdering;
 			}
 
+			// parallel rendering of large drawing operations
+			bool tiledRendering;
+			if (settings.FindBool("tiled rendering", &tiledRendering)
+					== B_OK) {
+				gTiledRendering = tiledRendering;
+			}
+
+			bool backingStores;
+			if (settings.FindBool("window backing stores", &backingStores)
+					== B_OK) {
+				fWindowBackingStores = backingStores;
+			}
+
 			const char* controlLook;
 			if (settings.FindString("control look", &controlLook) == B_OK) {
 				fControlLook = controlLook;
@@ -454,6 +471,8 @@ DesktopSettingsPrivate::Save(uint32 mask)
 			settings.AddBool("subpixel antialiasing", gSubpixelAntialiasing);
 			settings.AddInt8("subpixel average weight", gSubpixelAverageWeight);
 			settings.AddBool("subpixel ordering", gSubpixelOrderingRGB);
+			settings.AddBool("tiled rendering", gTiledRendering);
+			settings.AddBool("window backing stores", fWindowBackingStores);
 
 			settings.AddString("control look", fControlLook);
 
@@ -815,6 +834,21 @@ DesktopSettingsPrivate::ControlLook() const
 }
 
 
+void
+DesktopSettingsPrivate::SetWindowBackingStores(bool enabled)
+{
+	fWindowBackingStores = enabled;
+	Save(kAppearanceSettings);
+}
+
+
+bool
+DesktopSettingsPrivate::WindowBackingStores() const
+{
+	return fWindowBackingStores;
+}
+
+
 void
 DesktopSettingsPrivate::_ValidateWorkspacesLayout(int32& columns,
 	int32& rows) const
@@ -976,6 +1010,13 @@ DesktopSettings::ControlLook() const
 	return fSettings->ControlLook();
 }
 
+
+bool
+DesktopSettings::WindowBackingStores() const
+{
+	return fSettings->WindowBackingStores();
+}
+
 //	#pragma mark - write access
 
 
@@ -1103,3 +1144,10 @@ LockedDesktopSettings::SetControlLook(const char* path)
 	return fSettings->SetControlLook(path);
 }
 
+
+void
+LockedDesktopSettings::SetWindowBackingStores(bool enabled)
+{
+	fSettings->SetWindowBackingStores(enabled);
+}
+
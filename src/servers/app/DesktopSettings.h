@@ -78,6 +78,8 @@ public:
 
 			const BString&		ControlLook() const;
 
+			bool				WindowBackingStores() const;
+
 protected:
 			DesktopSettingsPrivate*	fSettings;
 };
@@ -113,6 +115,8 @@ public:
 
 			status_t			SetControlLook(const char* path);
 
+			void				SetWindowBackingStores(bool enabled);
+
 private:
 			Desktop*			fDesktop;
 };
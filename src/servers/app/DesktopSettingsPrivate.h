@@ -97,6 +97,9 @@ public:
 			status_t			SetControlLook(const char* path);
 			const BString&		ControlLook() const;
 
+			void				SetWindowBackingStores(bool enabled);
+			bool				WindowBackingStores() const;
+
 private:
 			void				_SetDefaults();
 			status_t			_Load();
@@ -120,6 +123,7 @@ private:
 			int32				fWorkspacesRows;
 			BMessage			fWorkspaceMessages[kMaxWorkspaces];
 			BString				fControlLook;
+			bool				fWindowBackingStores;
 
 			server_read_only_memory& fShared;
 };
@@ -2482,6 +2482,11 @@ void
 ServerWindow::_DispatchViewDrawingMessage(int32 code,
 	BPrivate::LinkReceiver &link)
 {
+	// the stored contents of the view are out of date now, even if they are
+	// not shown and nothing is drawn
+	if (fCurrentView->IsVisible())
+		fWindow->InvalidateBackingStore(fCurrentView);
+
 	if (!fCurrentView->IsVisible() || !fWindow->IsVisible()) {
 		if (link.NeedsReply()) {
 			debug_printf("ServerWindow::DispatchViewDrawingMessage() got "
@@ -32,10 +32,12 @@
 #include "DecorManager.h"
 #include "Desktop.h"
 #include "DrawingEngine.h"
+#include "DrawState.h"
 #include "HWInterface.h"
 #include "MessagePrivate.h"
 #include "PortLink.h"
 #include "ServerApp.h"
+#include "ServerBitmap.h"
 #include "ServerWindow.h"
 #include "WindowBehaviour.h"
 #include "Workspace.h"
@@ -85,6 +87,10 @@ Window::Window(const BRect& frame, const char *name,
 	fContentRegion(),
 	fEffectiveDrawingRegion(),
 
+	fBackingStoreRegion(),
+	fShownContentRegion(),
+	fShownContentOrigin(),
+
 	fVisibleContentRegionValid(false),
 	fContentRegionValid(false),
 	fEffectiveDrawingRegionValid(false),
@@ -201,6 +207,25 @@ Window::SetClipping(BRegion* stillAvailableOnScreen)
 
 	fVisibleContentRegionValid = false;
 	fEffectiveDrawingRegionValid = false;
+
+	if (!_UsesBackingStore()) {
+		_DiscardBackingStore();
+		fShownContentRegion.MakeEmpty();
+		return;
+	}
+
+	// the screen still shows the contents at their previous location, store
+	// those that are about to be covered
+	if (fShownContentRegion.CountRects() > 0) {
+		BRegion stillShown(VisibleContentRegion());
+		BPoint offset = fShownContentOrigin - fFrame.LeftTop();
+		stillShown.OffsetBy((int32)offset.x, (int32)offset.y);
+		fShownContentRegion.Exclude(&stillShown);
+		_StoreContents(fShownContentRegion, fShownContentOrigin);
+	}
+
+	fShownContentRegion = VisibleContentRegion();
+	fShownContentOrigin = fFrame.LeftTop();
 }
 
 
@@ -367,6 +392,10 @@ Window::ResizeBy(int32 x, int32 y, BRegion* dirtyRegion, bool resizeStack)
 	fContentRegionValid = false;
 	fEffectiveDrawingRegionValid = false;
 
+	// the views might be laid out anew
+	_DiscardBackingStore();
+	fShownContentRegion.MakeEmpty();
+
 	if (fTopView.IsSet()) {
 		fTopView->ResizeBy(x, y, dirtyRegion);
 		fTopView->UpdateOverlay();
@@ -444,6 +473,16 @@ Window::ScrollViewBy(View* view, int32 dx, int32 dy)
 	if (!dirty)
 		return;
 
+	if (fBackingStore.IsSet()) {
+		// Scrolling moves the children of the view, and anything outside of
+		// its user clipping as well, so none of it is valid anymore
+		IntRect bounds(view->Bounds());
+		view->ConvertToVisibleInTopView(&bounds);
+		BRegion region;
+		region.Set((clipping_rect)bounds);
+		_ExcludeFromBackingStore(region);
+	}
+
 	view->ScrollBy(dx, dy, dirty);
 
 //fDrawingEngine->FillRegion(*dirty, (rgb_color){ 255, 0, 255, 255 });
@@ -463,6 +502,12 @@ void
 Window::CopyContents(BRegion* region, int32 xOffset, int32 yOffset)
 {
 	// executed in ServerWindow thread with the read lock held
+	if (fBackingStore.IsSet()) {
+		region->OffsetBy(xOffset, yOffset);
+		_ExcludeFromBackingStore(*region);
+		region->OffsetBy(-xOffset, -yOffset);
+	}
+
 	if (!IsVisible())
 		return;
 
@@ -783,6 +828,13 @@ Window::RedrawDirtyRegion()
 		dirtyContentRegion->IntersectWith(&fDirtyRegion);
 		exposeContentRegion->IntersectWith(&fExposeRegion);
 
+		// only what could not be restored from the backing store needs to
+		// be redrawn by the client
+		if (fBackingStore.IsSet()) {
+			_RestoreContents(*dirtyContentRegion);
+			exposeContentRegion->IntersectWith(dirtyContentRegion);
+		}
+
 		_TriggerContentRedraw(*dirtyContentRegion, *exposeContentRegion);
 
 		fRegionPool.Recycle(dirtyContentRegion);
@@ -820,6 +872,7 @@ Window::MarkContentDirty(BRegion& dirtyRegion, BRegion& exposeRegion)
 	// since this won't affect other windows, read locking
 	// is sufficient. If there was no dirty region before,
 	// an update message is triggered
+	_ExcludeFromBackingStore(dirtyRegion);
 	if (fHidden || IsOffscreenWindow())
 		return;
 
@@ -833,6 +886,7 @@ void
 Window::MarkContentDirtyAsync(BRegion& dirtyRegion)
 {
 	// NOTE: see comments in ProcessDirtyRegion()
+	_ExcludeFromBackingStore(dirtyRegion);
 	if (fHidden || IsOffscreenWindow())
 		return;
 
@@ -849,11 +903,16 @@ Window::MarkContentDirtyAsync(BRegion& dirtyRegion)
 void
 Window::InvalidateView(View* view, BRegion& viewRegion)
 {
-	if (view && IsVisible() && view->IsVisible()) {
+	if (view && view->IsVisible()) {
 		if (!fContentRegionValid)
 			_UpdateContentRegion();
 
 		view->LocalToScreenTransform().Apply(&viewRegion);
+		// the parts that are not visible are out of date as well
+		_ExcludeFromBackingStore(viewRegion);
+		if (!IsVisible())
+			return;
+
 		viewRegion.IntersectWith(&VisibleContentRegion());
 		if (viewRegion.CountRects() > 0) {
 			viewRegion.IntersectWith(
@@ -883,6 +942,51 @@ Window::EnableUpdateRequests()
 		_SendUpdateMessage();
 }
 
+
+/*!	Stores everything that is shown on screen in the backing store, because
+	the window is about to be hidden, or to leave the current workspace.
+*/
+void
+Window::StoreShownContents()
+{
+	// this function is only called from the Desktop thread
+	if (_UsesBackingStore())
+		_StoreContents(fShownContentRegion, fShownContentOrigin);
+
+	fShownContentRegion.MakeEmpty();
+}
+
+
+/*!	Called when the screen contents were lost, so that nothing is taken from
+	there anymore.
+*/
+void
+Window::ForgetShownContents()
+{
+	fShownContentRegion.MakeEmpty();
+}
+
+
+/*!	Removes the parts of the backing store the \a view is about to draw to,
+	since it might draw something else than what was stored.
+*/
+void
+Window::InvalidateBackingStore(View* view)
+{
+	// executed in ServerWindow thread with the read lock held
+	if (!fBackingStore.IsSet())
+		return;
+
+	if (!fContentRegionValid)
+		_UpdateContentRegion();
+
+	BRegion& clipping = view->ScreenAndUserClipping(&fContentRegion);
+	BRect frame = clipping.Frame();
+	frame.OffsetBy(-fFrame.left, -fFrame.top);
+	if (fBackingStoreRegion.Intersects(frame))
+		_ExcludeFromBackingStore(clipping);
+}
+
 // #pragma mark -
 
 
@@ -2013,6 +2117,154 @@ Window::_UpdateContentRegion()
 }
 
 
+bool
+Window::_UsesBackingStore() const
+{
+	if (IsOffscreenWindow() || fWorkspacesViewCount != 0
+		|| (fFlags & kWindowScreenFlag) != 0
+		|| fWindow->HasDirectFrameBufferAccess()) {
+		// the contents are not drawn by us alone
+		return false;
+	}
+
+	return DesktopSettings(fDesktop).WindowBackingStores();
+}
+
+
+/*!	Copies the contents within \a region from the screen to the backing
+	store. The region is in screen coordinates, and \a origin is where the
+	left top of the frame was when the contents were drawn.
+*/
+void
+Window::_StoreContents(const BRegion& region, BPoint origin)
+{
+	if (region.CountRects() == 0)
+		return;
+
+	BRegion* contents = fRegionPool.GetRegion(region);
+	if (contents == NULL)
+		return;
+
+	// the dirty parts are not up to date on screen (they already moved
+	// along with the frame)
+	BPoint offset = origin - fFrame.LeftTop();
+	BRegion* dirty = fRegionPool.GetRegion(fDirtyRegion);
+	if (dirty != NULL) {
+		if (fPendingUpdateSession->IsUsed())
+			dirty->Include(&fPendingUpdateSession->DirtyRegion());
+		if (fCurrentUpdateSession->IsUsed())
+			dirty->Include(&fCurrentUpdateSession->DirtyRegion());
+		dirty->OffsetBy((int32)offset.x, (int32)offset.y);
+		contents->Exclude(dirty);
+		fRegionPool.Recycle(dirty);
+	} else
+		contents->MakeEmpty();
+
+	if (contents->CountRects() > 0 && !fBackingStore.IsSet()) {
+		BRect bounds(0, 0, fFrame.IntegerWidth(), fFrame.IntegerHeight());
+		fBackingStore.SetTo(new(std::nothrow) UtilityBitmap(bounds, B_RGB32,
+			0), true);
+		if (fBackingStore.IsSet() && !fBackingStore->IsValid())
+			fBackingStore.Unset();
+	}
+
+	if (contents->CountRects() > 0 && fBackingStore.IsSet()) {
+		BRegion bounds(fBackingStore->Bounds().OffsetByCopy(origin));
+		contents->IntersectWith(&bounds);
+
+		if (fDrawingEngine->LockExclusiveAccess()) {
+			status_t status = fDrawingEngine->ReadRegion(fBackingStore.Get(),
+				*contents, -(int32)origin.x, -(int32)origin.y);
+			fDrawingEngine->UnlockExclusiveAccess();
+
+			if (status == B_OK) {
+				contents->OffsetBy(-(int32)origin.x, -(int32)origin.y);
+				fBackingStoreRegion.Include(contents);
+			}
+		}
+	}
+
+	fRegionPool.Recycle(contents);
+
+	if (fBackingStoreRegion.CountRects() == 0)
+		_DiscardBackingStore();
+}
+
+
+/*!	Draws what the backing store contains of \a dirtyRegion, and removes
+	those parts from it.
+*/
+void
+Window::_RestoreContents(BRegion& dirtyRegion)
+{
+	// executed in ServerWindow thread with the read lock held
+	BRegion* restore = fRegionPool.GetRegion(fBackingStoreRegion);
+	if (restore == NULL)
+		return;
+
+	BPoint origin = fFrame.LeftTop();
+	restore->OffsetBy((int32)origin.x, (int32)origin.y);
+	restore->IntersectWith(&dirtyRegion);
+
+	if (restore->CountRects() > 0 && fDrawingEngine->LockParallelAccess()) {
+		DrawState state;
+		fDrawingEngine->SetDrawState(&state);
+		fDrawingEngine->ConstrainClippingRegion(restore);
+
+		bool copyToFrontEnabled = fDrawingEngine->CopyToFrontEnabled();
+		fDrawingEngine->SetCopyToFrontEnabled(true);
+
+		BRect bounds = fBackingStore->Bounds();
+		fDrawingEngine->DrawBitmap(fBackingStore.Get(), bounds,
+			bounds.OffsetByCopy(origin));
+
+		fDrawingEngine->SetCopyToFrontEnabled(copyToFrontEnabled);
+
+		// the ServerWindow expects its own draw state to be set
+		fWindow->ResyncDrawState();
+
+		fDrawingEngine->UnlockParallelAccess();
+
+		dirtyRegion.Exclude(restore);
+		_ExcludeFromBackingStore(*restore);
+	}
+
+	fRegionPool.Recycle(restore);
+}
+
+
+/*!	Removes \a region, given in screen coordinates, from the backing store,
+	and frees the store when nothing is left in it.
+*/
+void
+Window::_ExcludeFromBackingStore(const BRegion& region)
+{
+	if (!fBackingStore.IsSet())
+		return;
+
+	BRegion* excluded = fRegionPool.GetRegion(region);
+	if (excluded == NULL) {
+		_DiscardBackingStore();
+		return;
+	}
+
+	excluded->OffsetBy(-(int32)fFrame.left, -(int32)fFrame.top);
+	fBackingStoreRegion.Exclude(excluded);
+	fRegionPool.Recycle(excluded);
+
+	if (fBackingStoreRegion.CountRects() == 0)
+		_DiscardBackingStore();
+}
+
+
+void
+Window::_DiscardBackingStore()
+{
+	fBackingStore.Unset();
+	fBackingStoreRegion.MakeEmpty();
+}
+
+
 void
 Window::_ObeySizeLimits()
 {
@@ -160,6 +160,12 @@ public:
 			// shortcut for invalidating just one view
 			void				InvalidateView(View* view, BRegion& viewRegion);
 
+			// backing store of contents that are not shown on screen, you
+			// need to have WriteLock()ed the clipping for the first two!
+			void				StoreShownContents();
+			void				ForgetShownContents();
+			void				InvalidateBackingStore(View* view);
+
 			void				DisableUpdateRequests();
 			void				EnableUpdateRequests();
 
@@ -332,6 +338,14 @@ protected:
 
 			void				_UpdateContentRegion();
 
+			bool				_UsesBackingStore() const;
+			void				_StoreContents(const BRegion& region,
+									BPoint origin);
+			void				_RestoreContents(BRegion& dirtyRegion);
+			void				_ExcludeFromBackingStore(
+									const BRegion& region);
+			void				_DiscardBackingStore();
+
 			void				_ObeySizeLimits();
 			void				_PropagatePosition();
 
@@ -366,6 +380,17 @@ protected:
 			BRegion				fContentRegion;
 			BRegion				fEffectiveDrawingRegion;
 
+			// Contents that were covered or moved off screen, to be restored
+			// when they are exposed again without a round trip to the client.
+			// The backing store region is relative to the left top of the
+			// frame, while the shown content region is what was on screen
+			// at fShownContentOrigin during the last clipping update.
+			BReference<ServerBitmap>
+								fBackingStore;
+			BRegion				fBackingStoreRegion;
+			BRegion				fShownContentRegion;
+			BPoint				fShownContentOrigin;
+
 			bool				fVisibleContentRegionValid : 1;
 			bool				fContentRegionValid : 1;
 			bool				fEffectiveDrawingRegionValid : 1;
@@ -1379,6 +1379,44 @@ DrawingEngine::ReadBitmap(ServerBitmap* bitmap, bool drawCursor, BRect bounds)
 }
 
 
+/*!	Copies the parts of the drawing buffer that lie within \a region into
+	\a bitmap, at the same location offset by \a xOffset and \a yOffset.
+*/
+status_t
+DrawingEngine::ReadRegion(ServerBitmap* bitmap, const BRegion& region,
+	int32 xOffset, int32 yOffset)
+{
+	ASSERT_EXCLUSIVE_LOCKED();
+
+	RenderingBuffer* buffer = fGraphicsCard->DrawingBuffer();
+	if (buffer == NULL)
+		return B_ERROR;
+
+	BRegion clipped(region);
+	BRegion bufferRegion(BRect(0, 0, buffer->Width() - 1,
+		buffer->Height() - 1));
+	clipped.IntersectWith(&bufferRegion);
+	if (clipped.CountRects() == 0)
+		return B_OK;
+
+	AutoFloatingOverlaysHider _(fGraphicsCard, clipped.Frame());
+
+	int32 count = clipped.CountRects();
+	for (int32 i = 0; i < count; i++) {
+		clipping_rect rect = clipped.RectAtInt(i);
+		status_t status = bitmap->ImportBits(buffer->Bits(),
+			buffer->BitsLength(), buffer->BytesPerRow(), buffer->ColorSpace(),
+			BPoint(rect.left, rect.top),
+			BPoint(rect.left + xOffset, rect.top + yOffset),
+			rect.right - rect.left + 1, rect.bottom - rect.top + 1);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
 // #pragma mark -
 
 
@@ -65,6 +65,9 @@ public:
 			ServerBitmap*	DumpToBitmap();
 	virtual	status_t		ReadBitmap(ServerBitmap *bitmap, bool drawCursor,
 								BRect bounds);
+			status_t		ReadRegion(ServerBitmap* bitmap,
+								const BRegion& region, int32 xOffset,
+								int32 yOffset);
 
 	// clipping for all drawing functions, passing a NULL region
 	// will remove any clipping (drawing allowed everywhere)
@@ -27,8 +27,9 @@
 #include "IntRect.h"
 
 
-AGGTextRenderer::AGGTextRenderer(renderer_subpix_type& subpixRenderer,
-		renderer_type& solidRenderer, renderer_bin_type& binRenderer,
+AGGTextRenderer::AGGTextRenderer(renderer_base& baseRenderer,
+		renderer_subpix_type& subpixRenderer, renderer_type& solidRenderer,
+		renderer_bin_type& binRenderer,
 		scanline_unpacked_type& scanline,
 		scanline_unpacked_subpix_type& subpixScanline,
 		rasterizer_subpix_type& subpixRasterizer,
@@ -45,6 +46,7 @@ AGGTextRenderer::AGGTextRenderer(renderer_subpix_type& subpixRenderer,
 	fCurves(fPathAdaptor),
 	fContour(fCurves),
 
+	fBaseRenderer(baseRenderer),
 	fSolidRenderer(solidRenderer),
 	fBinRenderer(binRenderer),
 	fSubpixRenderer(subpixRenderer),
@@ -268,14 +270,26 @@ public:
 			// "glyphBounds" is now transformed into screen coords
 			// in order to stop drawing when we are already outside
 			// of the clipping frame
+			// Glyphs with a pre-rendered mask in the glyph atlas are blended
+			// directly, unless they have to go through the alpha mask.
+			bool useMask = glyph->mask != NULL
+				&& fRenderer.fMaskedScanline == NULL;
+			int32 maskX = 0;
+			int32 maskY = 0;
 			if (glyph->data_type != glyph_data_outline) {
 				// we cannot use the transformation pipeline
 				double transformedX = x + fTransformOffset.x;
 				double transformedY = y + fTransformOffset.y;
-				entry->InitAdaptors(glyph, transformedX, transformedY,
-					fRenderer.fMonoAdaptor,
-					fRenderer.fGray8Adaptor,
-					fRenderer.fPathAdaptor);
+				if (useMask) {
+					// same rounding as in the adaptors
+					maskX = glyph->bounds.x1 + agg::iround(transformedX);
+					maskY = glyph->bounds.y1 + agg::iround(transformedY);
+				} else {
+					entry->InitAdaptors(glyph, transformedX, transformedY,
+						fRenderer.fMonoAdaptor,
+						fRenderer.fGray8Adaptor,
+						fRenderer.fPathAdaptor);
+				}
 
 				glyphBounds.OffsetBy(fTransformOffset);
 			} else {
@@ -304,6 +318,12 @@ public:
 							agg::render_scanlines(fRenderer.fGray8Adaptor,
 								*fRenderer.fMaskedScanline,
 								fRenderer.fSolidRenderer);
+						} else if (useMask) {
+							fRenderer.fBaseRenderer.blend_solid_mask(maskX,
+								maskY, glyph->bounds.x2 - glyph->bounds.x1 + 1,
+								glyph->bounds.y2 - glyph->bounds.y1 + 1,
+								fRenderer.fSolidRenderer.color(),
+								glyph->mask);
 						} else {
 							agg::render_scanlines(fRenderer.fGray8Adaptor,
 								fRenderer.fGray8Scanline,
@@ -313,9 +333,18 @@ public:
 
 					case glyph_data_subpix:
 						// TODO: Handle alpha mask (fRenderer.fMaskedScanline)
-						agg::render_scanlines(fRenderer.fGray8Adaptor,
-							fRenderer.fGray8Scanline,
-							fRenderer.fSubpixRenderer);
+						if (useMask) {
+							fRenderer.fBaseRenderer.blend_solid_mask_subpix(
+								maskX, maskY,
+								glyph->bounds.x2 - glyph->bounds.x1 + 1,
+								glyph->bounds.y2 - glyph->bounds.y1 + 1,
+								fRenderer.fSubpixRenderer.color(),
+								glyph->mask);
+						} else {
+							agg::render_scanlines(fRenderer.fGray8Adaptor,
+								fRenderer.fGray8Scanline,
+								fRenderer.fSubpixRenderer);
+						}
 						break;
 
 					case glyph_data_outline: {
@@ -58,6 +58,7 @@
 #include "GlobalSubpixelSettings.h"
 #include "PatternHandler.h"
 #include "RenderingBuffer.h"
+#include "RenderingThreadPool.h"
 #include "ServerBitmap.h"
 #include "ServerFont.h"
 #include "SystemPalette.h"
@@ -110,6 +111,14 @@ static uint32 detect_simd();
 
 uint32 gSIMDFlags = detect_simd();
 
+bool gTiledRendering = false;
+
+
+// Only areas of at least this many pixels are split into bands, and the
+// bands are at least this high
+static const int32 kMinTiledArea = 128 * 1024;
+static const int32 kMinBandHeight = 32;
+
 
 /*!	Detect SIMD flags for use in AppServer. Checks all CPUs in the system
 	and chooses the minimum supported set of instructions.
@@ -162,6 +171,8 @@ detect_simd()
 				cpuSIMD |= APPSERVER_SIMD_MMX;
 			if (edx & (1 << 25))
 				cpuSIMD |= APPSERVER_SIMD_SSE;
+			if (edx & (1 << 26))
+				cpuSIMD |= APPSERVER_SIMD_SSE2;
 		} else {
 			// no flags can be identified
 			cpuSIMD = 0;
@@ -169,7 +180,13 @@ detect_simd()
 		systemSIMD &= cpuSIMD;
 	}
 	return systemSIMD;
-#else	// !__i386__
+#elif __x86_64__
+	// SSE2 is part of the base instruction set; MMX and SSE are only used by
+	// the x86 assembly bilinear scaler, and must not be reported here
+	return APPSERVER_SIMD_SSE2;
+#elif __aarch64__
+	return APPSERVER_SIMD_NEON;
+#else
 	return 0;
 #endif
 }
@@ -199,6 +216,26 @@ private:
 };
 
 
+class BandJob : public RenderingThreadPool::Job {
+public:
+	BandJob(RenderingBand* const* bands, BandRenderer& renderer)
+		:
+		fBands(bands),
+		fBandRenderer(renderer)
+	{
+	}
+
+	virtual void Run(int32 index)
+	{
+		fBandRenderer.RenderBand(fBands[index]->AggInterface());
+	}
+
+private:
+	RenderingBand* const*	fBands;
+	BandRenderer&			fBandRenderer;
+};
+
+
 // #pragma mark -
 
 
@@ -216,11 +253,12 @@ Painter::Painter()
 	fLineCapMode(B_BUTT_CAP),
 	fLineJoinMode(B_MITER_JOIN),
 	fMiterLimit(B_DEFAULT_MITER_LIMIT),
+	fFillRule(agg::fill_non_zero),
 
 	fPatternHandler(),
-	fTextRenderer(fSubpixRenderer, fRenderer, fRendererBin, fUnpackedScanline,
-		fSubpixUnpackedScanline, fSubpixRasterizer, fMaskedUnpackedScanline,
-		fTransform),
+	fTextRenderer(fBaseRenderer, fSubpixRenderer, fRenderer, fRendererBin,
+		fUnpackedScanline, fSubpixUnpackedScanline, fSubpixRasterizer,
+		fMaskedUnpackedScanline, fTransform),
 	fInternal(fPatternHandler)
 {
 	fPixelFormat.SetDrawingMode(fDrawingMode, fAlphaSrcMode, fAlphaFncMode);
@@ -229,12 +267,17 @@ Painter::Painter()
 	fRasterizer.gamma(agg::gamma_threshold(0.5));
 	fSubpixRasterizer.gamma(agg:gamma_threshold(0.5));
 #endif
+
+	for (int32 i = 0; i < kMaxRenderingBands; i++)
+		fBands[i] = NULL;
 }
 
 
 // destructor
 Painter::~Painter()
 {
+	for (int32 i = 0; i < kMaxRenderingBands; i++)
+		delete fBands[i];
 }
 
 
@@ -450,11 +493,11 @@ Painter::SetStrokeMode(cap_mode lineCap, join_mode joinMode, float miterLimit)
 void
 Painter::SetFillRule(int32 fillRule)
 {
-	agg::filling_rule_e aggFillRule = fillRule == B_EVEN_ODD
+	fFillRule = fillRule == B_EVEN_ODD
 		? agg::fill_even_odd : agg::fill_non_zero;
 
-	fRasterizer.filling_rule(aggFillRule);
-	fSubpixRasterizer.filling_rule(aggFillRule);
+	fRasterizer.filling_rule(fFillRule);
+	fSubpixRasterizer.filling_rule(fFillRule);
 }
 
 
@@ -1750,6 +1793,75 @@ Painter::_BlendRect32(const BRect& r, const rgb_color& c) const
 }
 
 
+// #pragma mark - tiled rendering
+
+
+/*!	Sets up the bands to render the given \a area with in tiled rendering,
+	and returns their number. If tiled rendering is disabled or would not pay
+	off for the area, 0 is returned, and the calling thread is supposed to
+	render the area on its own.
+*/
+int32
+Painter::_PrepareBands(const BRect& area) const
+{
+	if (!gTiledRendering || !fValidClipping || fMaskedUnpackedScanline != NULL
+		|| !area.IsValid()) {
+		return 0;
+	}
+
+	clipping_rect frame = fClippingRegion->FrameInt();
+	int32 top = max_c((int32)floorf(area.top), frame.top);
+	int32 bottom = min_c((int32)floorf(area.bottom), frame.bottom);
+	int32 height = bottom - top + 1;
+	if (height < 2 * kMinBandHeight
+		|| (area.IntegerWidth() + 1) * height < kMinTiledArea) {
+		return 0;
+	}
+
+	RenderingThreadPool* threadPool = RenderingThreadPool::Default();
+	if (threadPool == NULL)
+		return 0;
+
+	int32 count = min_c(threadPool->CountThreads() + 1,
+		height / kMinBandHeight);
+	if (count > kMaxRenderingBands)
+		count = kMaxRenderingBands;
+
+	for (int32 i = 0; i < count; i++) {
+		if (fBands[i] == NULL) {
+			fBands[i] = new(nothrow) RenderingBand(
+				const_cast<PatternHandler&>(fPatternHandler));
+			if (fBands[i] == NULL)
+				return 0;
+		}
+
+		// the outer bands extend to the clipping frame, so that no pixel
+		// of the area can be missed
+		clipping_rect bandFrame = frame;
+		if (i > 0)
+			bandFrame.top = top + height * i / count;
+		if (i < count - 1)
+			bandFrame.bottom = top + height * (i + 1) / count - 1;
+
+		fBands[i]->SetTo(fInternal, fDrawingMode, fAlphaSrcMode,
+			fAlphaFncMode, fFillRule, *fClippingRegion, bandFrame);
+	}
+
+	return count;
+}
+
+
+/*!	Lets the \a renderer render the first \a count bands that have been set
+	up by _PrepareBands(), and returns when all of them are done.
+*/
+void
+Painter::_RenderBands(int32 count, BandRenderer& renderer) const
+{
+	BandJob job(fBands, renderer);
+	RenderingThreadPool::Default()->Execute(job, count);
+}
+
+
 // #pragma mark -
 
 
@@ -1850,7 +1962,17 @@ template<class VertexSource>
 BRect
 Painter::_RasterizePath(VertexSource& path) const
 {
-	if (fMaskedUnpackedScanline != NULL) {
+	BRect bounds = _Clipped(_BoundingBox(path));
+
+	int32 bandCount = _PrepareBands(bounds);
+	if (bandCount > 1) {
+		// the bands cannot iterate the path concurrently
+		agg::path_storage flattenedPath;
+		flattenedPath.concat_path(path);
+
+		PathBandRenderer renderer(flattenedPath, gSubpixelAntialiasing);
+		_RenderBands(bandCount, renderer);
+	} else if (fMaskedUnpackedScanline != NULL) {
 		// TODO: we can't do both alpha-masking and subpixel AA.
 		fRasterizer.reset();
 		fRasterizer.add_path(path);
@@ -1867,7 +1989,7 @@ Painter::_RasterizePath(VertexSource& path) const
 		agg::render_scanlines(fRasterizer, fPackedScanline, fRenderer);
 	}
 
-	return _Clipped(_BoundingBox(path));
+	return bounds;
 }
 
 
@@ -1891,6 +2013,7 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 {
 	GTRACE("Painter::_RasterizePath\n");
 
+	BRect bounds = _Clipped(_BoundingBox(path));
 	agg::trans_affine gradientTransform;
 
 	switch (gradient.GetType()) {
@@ -1902,7 +2025,8 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 			agg::gradient_x gradientFunction;
 			_CalcLinearGradientTransform(linearGradient.Start(),
 				linearGradient.End(), gradientTransform);
-			_RasterizePath(path, gradient, gradientFunction, gradientTransform);
+			_RasterizePath(path, gradient, gradientFunction, gradientTransform,
+				bounds);
 			break;
 		}
 		case BGradient::TYPE_RADIAL:
@@ -1914,7 +2038,7 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 			_CalcRadialGradientTransform(radialGradient.Center(),
 				gradientTransform);
 			_RasterizePath(path, gradient, gradientFunction, gradientTransform,
-				radialGradient.Radius());
+				bounds, radialGradient.Radius());
 			break;
 		}
 		case BGradient::TYPE_RADIAL_FOCUS:
@@ -1926,7 +2050,7 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 			_CalcRadialGradientTransform(radialGradient.Center(),
 				gradientTransform);
 			_RasterizePath(path, gradient, gradientFunction, gradientTransform,
-				radialGradient.Radius());
+				bounds, radialGradient.Radius());
 			break;
 		}
 		case BGradient::TYPE_DIAMOND:
@@ -1937,7 +2061,8 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 			agg::gradient_diamond gradientFunction;
 			_CalcRadialGradientTransform(diamontGradient.Center(),
 				gradientTransform);
-			_RasterizePath(path, gradient, gradientFunction, gradientTransform);
+			_RasterizePath(path, gradient, gradientFunction, gradientTransform,
+				bounds);
 			break;
 		}
 		case BGradient::TYPE_CONIC:
@@ -1948,7 +2073,8 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 			agg::gradient_conic gradientFunction;
 			_CalcRadialGradientTransform(conicGradient.Center(),
 				gradientTransform);
-			_RasterizePath(path, gradient, gradientFunction, gradientTransform);
+			_RasterizePath(path, gradient, gradientFunction, gradientTransform,
+				bounds);
 			break;
 		}
 
@@ -1958,7 +2084,7 @@ Painter::_RasterizePath(VertexSource& path, const BGradient& gradient)
 			break;
 	}
 
-	return _Clipped(_BoundingBox(path));
+	return bounds;
 }
 
 
@@ -2103,38 +2229,33 @@ template<class VertexSource, typename GradientFunction>
 void
 Painter::_RasterizePath(VertexSource& path, const BGradient& gradient,
 	GradientFunction function, agg::trans_affine& gradientTransform,
-	int gradientStop)
+	const BRect& bounds, int gradientStop)
 {
 	GTRACE("Painter::_RasterizePath\n");
 
-	typedef agg::span_interpolator_linear<> interpolator_type;
 	typedef agg::pod_auto_array<agg::rgba8, 256> color_array_type;
-	typedef agg::span_allocator<agg::rgba8> span_allocator_type;
-	typedef agg::span_gradient<agg::rgba8, interpolator_type,
-				GradientFunction, color_array_type> span_gradient_type;
-	typedef agg::renderer_scanline_aa<renderer_base, span_allocator_type,
-				span_gradient_type> renderer_gradient_type;
 
 	SolidPatternGuard _(this);
 
-	interpolator_type spanInterpolator(gradientTransform);
-	span_allocator_type spanAllocator;
 	color_array_type colorArray;
 
 	_MakeGradient(colorArray, gradient);
 
-	span_gradient_type spanGradient(spanInterpolator, function, colorArray,
-		0, gradientStop);
-
-	renderer_gradient_type gradientRenderer(fBaseRenderer, spanAllocator,
-		spanGradient);
-
-	fRasterizer.reset();
-	fRasterizer.add_path(path);
-	if (fMaskedUnpackedScanline == NULL)
-		agg::render_scanlines(fRasterizer, fUnpackedScanline, gradientRenderer);
-	else {
-		agg::render_scanlines(fRasterizer, *fMaskedUnpackedScanline,
-			gradientRenderer);
+	int32 bandCount = _PrepareBands(bounds);
+	if (bandCount > 1) {
+		// the bands cannot iterate the path concurrently
+		agg::path_storage flattenedPath;
+		flattenedPath.concat_path(path);
+
+		GradientBandRenderer<GradientFunction, color_array_type> renderer(
+			flattenedPath, function, gradientTransform, colorArray,
+			gradientStop);
+		_RenderBands(bandCount, renderer);
+	} else if (fMaskedUnpackedScanline == NULL) {
+		render_gradient(fInternal, path, fUnpackedScanline, function,
+			gradientTransform, colorArray, gradientStop);
+	} else {
+		render_gradient(fInternal, path, *fMaskedUnpackedScanline, function,
+			gradientTransform, colorArray, gradientStop);
 	}
 }
@@ -17,9 +17,11 @@
 #include "PainterAggInterface.h"
 #include "PatternHandler.h"
 #include "ServerFont.h"
+#include "TiledRendering.h"
 #include "Transformable.h"
 
 #include "defines.h"
+#include "drawing_support.h"
 
 #include <agg_conv_curve.h>
 
@@ -43,11 +45,6 @@ class ServerBitmap;
 class ServerFont;
 
 
-// Defines for SIMD support.
-#define APPSERVER_SIMD_MMX	(1 << 0)
-#define APPSERVER_SIMD_SSE	(1 << 1)
-
-
 class Painter {
 public:
 								Painter();
@@ -282,6 +279,11 @@ private:
 			void				_BlendRect32(const BRect& r,
 									const rgb_color& c) const;
 
+								// tiled rendering
+			int32				_PrepareBands(const BRect& area) const;
+			void				_RenderBands(int32 count,
+									BandRenderer& renderer) const;
+
 
 			template<class VertexSource>
 			BRect				_BoundingBox(VertexSource& path) const;
@@ -323,6 +325,7 @@ private:
 									const BGradient& gradient,
 									GradientFunction function,
 									agg::trans_affine& gradientTransform,
+									const BRect& bounds,
 									int gradientStop = 100);
 
 private:
@@ -346,6 +349,7 @@ private:
 			cap_mode			fLineCapMode;
 			join_mode			fLineJoinMode;
 			float				fMiterLimit;
+			agg::filling_rule_e	fFillRule;
 
 			PatternHandler		fPatternHandler;
 
@@ -355,6 +359,9 @@ private:
 	mutable	AGGTextRenderer		fTextRenderer;
 
 	mutable	PainterAggInterface	fInternal;
+
+	// the AGG pipelines of the bands in tiled rendering
+	mutable	RenderingBand*		fBands[kMaxRenderingBands];
 };
 
 
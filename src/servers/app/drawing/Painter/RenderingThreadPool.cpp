@@ -0,0 +1,198 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	A pool of threads that help the drawing threads with rendering large
+	areas. A job consists of a number of independent parts, the thread that
+	executes a job works on it itself, and returns when all parts are done.
+*/
+
+
+#include "RenderingThreadPool.h"
+
+#include <new>
+
+#include <pthread.h>
+
+#include <Autolock.h>
+
+
+static RenderingThreadPool* sDefaultPool = NULL;
+static pthread_once_t sDefaultPoolInitOnce = PTHREAD_ONCE_INIT;
+
+
+RenderingThreadPool::Job::~Job()
+{
+}
+
+
+// #pragma mark -
+
+
+RenderingThreadPool::RenderingThreadPool()
+	:
+	fLock("rendering thread pool"),
+	fWorkSemaphore(-1),
+	fThreadCount(0)
+{
+}
+
+
+RenderingThreadPool::~RenderingThreadPool()
+{
+	delete_sem(fWorkSemaphore);
+
+	for (int32 i = 0; i < fThreadCount; i++) {
+		status_t result;
+		wait_for_thread(fThreads[i], &result);
+	}
+}
+
+
+/*static*/ RenderingThreadPool*
+RenderingThreadPool::Default()
+{
+	pthread_once(&sDefaultPoolInitOnce, &_InitDefault);
+	return sDefaultPool;
+}
+
+
+/*!	Runs \a count parts of the \a job, and returns when all of them are done.
+	The calling thread works on the job as well, the pool threads only help
+	out if they are not busy with another job.
+*/
+void
+RenderingThreadPool::Execute(Job& job, int32 count)
+{
+	job.fCount = count;
+	job.fNextIndex = 0;
+	job.fPending = count;
+	job.fDoneSemaphore = -1;
+
+	if (count > 1 && fThreadCount > 0)
+		job.fDoneSemaphore = create_sem(0, "rendering job");
+
+	if (job.fDoneSemaphore < 0) {
+		for (int32 i = 0; i < count; i++)
+			job.Run(i);
+		return;
+	}
+
+	fLock.Lock();
+	fJobs.Add(&job);
+	fLock.Unlock();
+
+	release_sem_etc(fWorkSemaphore, min_c(count - 1, fThreadCount),
+		B_DO_NOT_RESCHEDULE);
+
+	int32 index;
+	while (_NextIndex(&job, index) != NULL) {
+		job.Run(index);
+		_Done(&job);
+	}
+
+	// wait for the parts the pool threads took over
+	while (acquire_sem(job.fDoneSemaphore) == B_INTERRUPTED)
+		;
+
+	delete_sem(job.fDoneSemaphore);
+}
+
+
+status_t
+RenderingThreadPool::_Init()
+{
+	system_info info;
+	if (get_system_info(&info) != B_OK || info.cpu_count < 2)
+		return B_NOT_SUPPORTED;
+
+	fWorkSemaphore = create_sem(0, "rendering work");
+	if (fWorkSemaphore < 0)
+		return fWorkSemaphore;
+
+	int32 threadCount = min_c((int32)info.cpu_count - 1, kMaxThreads);
+	for (int32 i = 0; i < threadCount; i++) {
+		thread_id thread = spawn_thread(&_ThreadEntry, "rendering helper",
+			B_DISPLAY_PRIORITY, this);
+		if (thread < 0)
+			break;
+
+		fThreads[fThreadCount++] = thread;
+		resume_thread(thread);
+	}
+
+	return fThreadCount > 0 ? B_OK : B_NO_MORE_THREADS;
+}
+
+
+/*static*/ void
+RenderingThreadPool::_InitDefault()
+{
+	RenderingThreadPool* pool = new(std::nothrow) RenderingThreadPool;
+	if (pool == NULL)
+		return;
+
+	if (pool->_Init() != B_OK) {
+		delete pool;
+		return;
+	}
+
+	sDefaultPool = pool;
+}
+
+
+/*static*/ status_t
+RenderingThreadPool::_ThreadEntry(void* data)
+{
+	((RenderingThreadPool*)data)->_Work();
+	return B_OK;
+}
+
+
+void
+RenderingThreadPool::_Work()
+{
+	while (acquire_sem(fWorkSemaphore) == B_OK) {
+		// The job that woke us up might already be done, but there might
+		// also be more parts left than threads were woken up.
+		Job* job;
+		int32 index;
+		while ((job = _NextIndex(NULL, index)) != NULL) {
+			job->Run(index);
+			_Done(job);
+		}
+	}
+}
+
+
+/*!	Claims the next part of \a job, or of the first queued job if \a job is
+	\c NULL. Returns the job the part belongs to, or \c NULL if there is none
+	left.
+*/
+RenderingThreadPool::Job*
+RenderingThreadPool::_NextIndex(Job* job, int32& index)
+{
+	BAutolock _(fLock);
+
+	if (job == NULL)
+		job = fJobs.Head();
+	if (job == NULL || job->fNextIndex >= job->fCount)
+		return NULL;
+
+	index = job->fNextIndex++;
+	if (job->fNextIndex == job->fCount)
+		fJobs.Remove(job);
+
+	return job;
+}
+
+
+void
+RenderingThreadPool::_Done(Job* job)
+{
+	// the job must not be accessed anymore after the last part is done
+	if (atomic_add(&job->fPending, -1) == 1)
+		release_sem(job->fDoneSemaphore);
+}
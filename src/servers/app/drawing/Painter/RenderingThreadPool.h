@@ -0,0 +1,66 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef RENDERING_THREAD_POOL_H
+#define RENDERING_THREAD_POOL_H
+
+
+#include <Locker.h>
+#include <OS.h>
+
+#include <util/DoublyLinkedList.h>
+
+
+class RenderingThreadPool {
+public:
+	class Job : public DoublyLinkedListLinkImpl<Job> {
+	public:
+		virtual					~Job();
+
+		virtual	void			Run(int32 index) = 0;
+
+	private:
+		friend class RenderingThreadPool;
+
+				int32			fCount;
+				int32			fNextIndex;
+				int32			fPending;
+				sem_id			fDoneSemaphore;
+	};
+
+public:
+	static	RenderingThreadPool* Default();
+
+			int32				CountThreads() const
+									{ return fThreadCount; }
+
+			void				Execute(Job& job, int32 count);
+
+private:
+								RenderingThreadPool();
+								~RenderingThreadPool();
+
+			status_t			_Init();
+
+	static	void				_InitDefault();
+	static	status_t			_ThreadEntry(void* data);
+			void				_Work();
+
+			Job*				_NextIndex(Job* job, int32& index);
+			void				_Done(Job* job);
+
+private:
+	typedef DoublyLinkedList<Job> JobList;
+
+	static	const int32			kMaxThreads = 15;
+
+			BLocker				fLock;
+			JobList				fJobs;
+			sem_id				fWorkSemaphore;
+			thread_id			fThreads[kMaxThreads];
+			int32				fThreadCount;
+};
+
+
+#endif // RENDERING_THREAD_POOL_H
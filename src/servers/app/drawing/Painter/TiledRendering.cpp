@@ -0,0 +1,96 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "TiledRendering.h"
+
+
+BandRenderer::~BandRenderer()
+{
+}
+
+
+// #pragma mark - RenderingBand
+
+
+RenderingBand::RenderingBand(PatternHandler& patternHandler)
+	:
+	fInternal(patternHandler)
+{
+#if ALIASED_DRAWING
+	fInternal.fRasterizer.gamma(agg::gamma_threshold(0.5));
+	fInternal.fSubpixRasterizer.gamma(agg::gamma_threshold(0.5));
+#endif
+}
+
+
+/*!	Takes over the state of the \a source pipeline, and clips its output to
+	the part of the \a clipping region that lies within \a frame.
+*/
+void
+RenderingBand::SetTo(PainterAggInterface& source, drawing_mode mode,
+	source_alpha alphaSrcMode, alpha_function alphaFncMode,
+	agg::filling_rule_e fillRule, const BRegion& clipping,
+	const clipping_rect& frame)
+{
+	fInternal.fBuffer.attach(source.fBuffer.buf(), source.fBuffer.width(),
+		source.fBuffer.height(), source.fBuffer.stride());
+	fInternal.fPixelFormat.SetDrawingMode(mode, alphaSrcMode, alphaFncMode);
+
+	BRegion bandRegion;
+	bandRegion.Set(frame);
+	fClipping = clipping;
+	fClipping.IntersectWith(&bandRegion);
+
+	fInternal.fBaseRenderer.set_clipping_region(&fClipping);
+	fInternal.fBaseRenderer.set_offset(source.fBaseRenderer.offset_x(),
+		source.fBaseRenderer.offset_y());
+
+	fInternal.fRenderer.color(source.fRenderer.color());
+	fInternal.fSubpixRenderer.color(source.fSubpixRenderer.color());
+
+	// the rasterizers are not clipped to the band, see
+	// render_band_scanlines()
+	clipping_rect bounds = clipping.FrameInt();
+	fInternal.fRasterizer.filling_rule(fillRule);
+	fInternal.fRasterizer.clip_box(bounds.left, bounds.top, bounds.right + 1,
+		bounds.bottom + 1);
+	fInternal.fSubpixRasterizer.filling_rule(fillRule);
+	fInternal.fSubpixRasterizer.clip_box(bounds.left, bounds.top,
+		bounds.right + 1, bounds.bottom + 1);
+}
+
+
+// #pragma mark - PathBandRenderer
+
+
+PathBandRenderer::PathBandRenderer(const agg::path_storage& path,
+	bool subpixelAntialiasing)
+	:
+	fPath(path),
+	fSubpixelAntialiasing(subpixelAntialiasing)
+{
+}
+
+
+void
+PathBandRenderer::RenderBand(PainterAggInterface& aggInterface)
+{
+	PathStorageReader path(fPath);
+
+	if (fSubpixelAntialiasing) {
+		aggInterface.fSubpixRasterizer.reset();
+		aggInterface.fSubpixRasterizer.add_path(path);
+		render_band_scanlines(aggInterface.fSubpixRasterizer,
+			aggInterface.fSubpixPackedScanline, aggInterface.fSubpixRenderer,
+			aggInterface.fBaseRenderer);
+	} else {
+		aggInterface.fRasterizer.reset();
+		aggInterface.fRasterizer.add_path(path);
+		render_band_scanlines(aggInterface.fRasterizer,
+			aggInterface.fPackedScanline, aggInterface.fRenderer,
+			aggInterface.fBaseRenderer);
+	}
+}
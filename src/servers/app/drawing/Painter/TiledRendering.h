@@ -0,0 +1,215 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Support for splitting large drawing operations of the Painter into
+ * horizontal bands that are rendered in parallel.
+ *
+ */
+#ifndef TILED_RENDERING_H
+#define TILED_RENDERING_H
+
+
+#include <Region.h>
+
+#include "PainterAggInterface.h"
+
+
+// Upper limit of the number of bands a drawing operation is split into
+static const int32 kMaxRenderingBands = 16;
+
+
+/*!	Renders one part of a drawing operation. In tiled rendering, RenderBand()
+	is called concurrently from several threads, each time with the AGG
+	pipeline of another band, which is clipped to its part of the clipping
+	region. Implementations must therefore not change any state of their own.
+*/
+class BandRenderer {
+public:
+	virtual						~BandRenderer();
+
+	virtual	void				RenderBand(
+									PainterAggInterface& aggInterface) = 0;
+};
+
+
+/*!	The AGG pipeline of one band. It is set up from the Painter's own
+	pipeline before each use, and kept around to reuse the memory of its
+	scanlines and rasterizers.
+*/
+class RenderingBand {
+public:
+								RenderingBand(PatternHandler& patternHandler);
+
+			void				SetTo(PainterAggInterface& source,
+									drawing_mode mode,
+									source_alpha alphaSrcMode,
+									alpha_function alphaFncMode,
+									agg::filling_rule_e fillRule,
+									const BRegion& clipping,
+									const clipping_rect& frame);
+
+			PainterAggInterface& AggInterface()
+									{ return fInternal; }
+
+private:
+			PainterAggInterface	fInternal;
+			BRegion				fClipping;
+};
+
+
+/*!	A vertex source for a path that is shared by all bands. Unlike the path
+	storage itself, it can be iterated by several threads at once, as every
+	band uses its own reader.
+*/
+class PathStorageReader {
+public:
+	PathStorageReader(const agg::path_storage& path)
+		:
+		fPath(path),
+		fIndex(0)
+	{
+	}
+
+	void rewind(unsigned)
+	{
+		fIndex = 0;
+	}
+
+	unsigned vertex(double* x, double* y)
+	{
+		if (fIndex >= fPath.total_vertices())
+			return agg::path_cmd_stop;
+
+		return fPath.vertex(fIndex++, x, y);
+	}
+
+private:
+	const agg::path_storage&	fPath;
+	unsigned					fIndex;
+};
+
+
+class PathBandRenderer : public BandRenderer {
+public:
+								PathBandRenderer(
+									const agg::path_storage& path,
+									bool subpixelAntialiasing);
+
+	virtual	void				RenderBand(PainterAggInterface& aggInterface);
+
+private:
+			const agg::path_storage& fPath;
+			bool				fSubpixelAntialiasing;
+};
+
+
+/*!	Like agg::render_scanlines(), but only sweeps the scanlines within the
+	frame of the clipping region of \a baseRenderer.
+	The rasterizer of a band is clipped like the one of the Painter, and
+	always covers the whole path: clipping the path to the band would slightly
+	change the coverage along the edges that cross the band boundaries.
+*/
+template<class Rasterizer, class Scanline, class Renderer>
+void
+render_band_scanlines(Rasterizer& rasterizer, Scanline& scanline,
+	Renderer& renderer, const renderer_base& baseRenderer)
+{
+	const BRegion* clipping = baseRenderer.clipping_region();
+	if (clipping == NULL) {
+		agg::render_scanlines(rasterizer, scanline, renderer);
+		return;
+	}
+
+	if (!rasterizer.rewind_scanlines())
+		return;
+
+	clipping_rect frame = clipping->FrameInt();
+	if (!rasterizer.navigate_scanline(max_c(frame.top, rasterizer.min_y())))
+		return;
+
+	scanline.reset(rasterizer.min_x(), rasterizer.max_x());
+	renderer.prepare();
+	while (rasterizer.sweep_scanline(scanline) && scanline.y() <= frame.bottom)
+		renderer.render(scanline);
+}
+
+
+//! Like agg::render_scanlines_aa(), but see render_band_scanlines().
+template<class Rasterizer, class Scanline, class SpanAllocator,
+	class SpanGenerator>
+void
+render_band_scanlines_aa(Rasterizer& rasterizer, Scanline& scanline,
+	renderer_base& baseRenderer, SpanAllocator& spanAllocator,
+	SpanGenerator& spanGenerator)
+{
+	agg::renderer_scanline_aa<renderer_base, SpanAllocator, SpanGenerator>
+		renderer(baseRenderer, spanAllocator, spanGenerator);
+	render_band_scanlines(rasterizer, scanline, renderer, baseRenderer);
+}
+
+
+template<class VertexSource, class Scanline, class GradientFunction,
+	class ColorArray>
+void
+render_gradient(PainterAggInterface& aggInterface, VertexSource& path,
+	Scanline& scanline, const GradientFunction& function,
+	const agg::trans_affine& gradientTransform, const ColorArray& colorArray,
+	int gradientStop)
+{
+	typedef agg::span_interpolator_linear<> interpolator_type;
+	typedef agg::span_allocator<agg::rgba8> span_allocator_type;
+	typedef agg::span_gradient<agg::rgba8, interpolator_type,
+				GradientFunction, ColorArray> span_gradient_type;
+	typedef agg::renderer_scanline_aa<renderer_base, span_allocator_type,
+				span_gradient_type> renderer_gradient_type;
+
+	interpolator_type spanInterpolator(gradientTransform);
+	span_allocator_type spanAllocator;
+
+	span_gradient_type spanGradient(spanInterpolator, function, colorArray,
+		0, gradientStop);
+
+	renderer_gradient_type gradientRenderer(aggInterface.fBaseRenderer,
+		spanAllocator, spanGradient);
+
+	aggInterface.fRasterizer.reset();
+	aggInterface.fRasterizer.add_path(path);
+	render_band_scanlines(aggInterface.fRasterizer, scanline,
+		gradientRenderer, aggInterface.fBaseRenderer);
+}
+
+
+template<class GradientFunction, class ColorArray>
+class GradientBandRenderer : public BandRenderer {
+public:
+	GradientBandRenderer(const agg::path_storage& path,
+		const GradientFunction& function,
+		const agg::trans_affine& gradientTransform,
+		const ColorArray& colorArray, int gradientStop)
+		:
+		fPath(path),
+		fFunction(function),
+		fGradientTransform(gradientTransform),
+		fColorArray(colorArray),
+		fGradientStop(gradientStop)
+	{
+	}
+
+	virtual void RenderBand(PainterAggInterface& aggInterface)
+	{
+		PathStorageReader path(fPath);
+		render_gradient(aggInterface, path, aggInterface.fUnpackedScanline,
+			fFunction, fGradientTransform, fColorArray, fGradientStop);
+	}
+
+private:
+	const agg::path_storage&	fPath;
+	const GradientFunction&		fFunction;
+	const agg::trans_affine&	fGradientTransform;
+	const ColorArray&			fColorArray;
+	int							fGradientStop;
+};
+
+
+#endif // TILED_RENDERING_H
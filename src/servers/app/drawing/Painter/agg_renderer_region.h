@@ -135,6 +135,8 @@ namespace agg
 			}
 		}
 
+		const BRegion* clipping_region() const { return m_region; }
+
 		//--------------------------------------------------------------------
 		void set_offset(int offset_x, int offset_y)
 		{
@@ -147,6 +149,9 @@ namespace agg
 			}
 		}
 
+		int offset_x() const { return m_offset_x; }
+		int offset_y() const { return m_offset_y; }
+
 		//--------------------------------------------------------------------
 		void translate_to_base_ren_x(int& x)
 		{
@@ -451,7 +456,95 @@ namespace agg
 			while(next_clip_box());
 		}
 
+		//--------------------------------------------------------------------
+		// Blends a coverage mask of width * height pixels with its top left
+		// corner at x, y. Only the clipping rects that intersect the mask
+		// are visited, and pixels without coverage are skipped, so that the
+		// result is the same as for the spans of the mask.
+		void blend_solid_mask(int x, int y, int width, int height,
+							  const color_type& c, const cover_type* mask)
+		{
+			blend_solid_mask(x, y, width, height, 1, c, mask);
+		}
+
+		//--------------------------------------------------------------------
+		// Like blend_solid_mask(), but with three covers per pixel.
+		void blend_solid_mask_subpix(int x, int y, int width, int height,
+							  const color_type& c, const cover_type* mask)
+		{
+			blend_solid_mask(x, y, width, height, 3, c, mask);
+		}
+
 	private:
+		void blend_solid_mask(int x, int y, int width, int height,
+							  int step, const color_type& c,
+							  const cover_type* mask)
+		{
+			if(m_region == NULL)
+				return;
+
+			translate_to_base_ren(x, y);
+
+			int count = m_region->CountRects();
+			for(int i = 0; i < count; i++)
+			{
+				clipping_rect cb = m_region->RectAtInt(i);
+				translate_to_base_ren(cb);
+
+				int x1 = max_c(cb.left, x);
+				int y1 = max_c(cb.top, y);
+				int x2 = min_c(cb.right, x + width - 1);
+				int y2 = min_c(cb.bottom, y + height - 1);
+				if(x1 > x2 || y1 > y2)
+					continue;
+
+				for(int row = y1; row <= y2; row++)
+				{
+					const cover_type* covers
+						= mask + ((row - y) * width + x1 - x) * step;
+					int px = x1;
+					while(px <= x2)
+					{
+						// skip the pixels without coverage
+						while(px <= x2 && is_empty(covers, step))
+						{
+							covers += step;
+							px++;
+						}
+
+						int start = px;
+						const cover_type* spanCovers = covers;
+						while(px <= x2 && !is_empty(covers, step))
+						{
+							covers += step;
+							px++;
+						}
+
+						if(px == start)
+							break;
+
+						if(step == 1)
+						{
+							m_ren.ren().blend_solid_hspan(start, row,
+								px - start, c, spanCovers);
+						}
+						else
+						{
+							m_ren.ren().blend_solid_hspan_subpix(start, row,
+								(px - start) * 3, c, spanCovers);
+						}
+					}
+				}
+			}
+		}
+
+		static bool is_empty(const cover_type* covers, int step)
+		{
+			if(step == 1)
+				return covers[0] == 0;
+			return (covers[0] | covers[1] | covers[2]) == 0;
+		}
+
 		renderer_region(const renderer_region<PixelFormat>&);
 		const renderer_region<PixelFormat>&
 			operator = (const renderer_region<PixelFormat>&);
@@ -58,8 +58,6 @@ void
 Painter::BitmapPainter::Draw(const BRect& sourceRect,
 	const BRect& destinationRect)
 {
-	using namespace BitmapPainterPrivate;
-
 	if (fStatus != B_OK)
 		return;
 
@@ -78,98 +76,98 @@ Painter::BitmapPainter::Draw(const BRect& sourceRect,
 	if (!success)
 		return;
 
-	if ((fOptions & B_TILE_BITMAP) == 0) {
-		// optimized version for no scale in CMAP8 or RGB32 OP_OVER
-		if (!_HasScale() && !_HasAffineTransform() && !_HasAlphaMask()) {
-			if (fColorSpace == B_CMAP8) {
-				if (fPainter->fDrawingMode == B_OP_COPY) {
-					DrawBitmapNoScale<CMap8Copy> drawNoScale;
-					drawNoScale.Draw(fPainter->fInternal, fBitmap, 1, fOffset,
-						fDestinationRect);
-					return;
-				}
-				if (fPainter->fDrawingMode == B_OP_OVER) {
-					DrawBitmapNoScale<CMap8Over> drawNoScale;
-					drawNoScale.Draw(fPainter->fInternal, fBitmap, 1, fOffset,
-						fDestinationRect);
-					return;
-				}
-			} else if (fColorSpace == B_RGB32) {
-				if (fPainter->fDrawingMode == B_OP_OVER) {
-					DrawBitmapNoScale<Bgr32Over> drawNoScale;
-					drawNoScale.Draw(fPainter->fInternal, fBitmap, 4, fOffset,
-						fDestinationRect);
-					return;
-				}
-			}
-		}
+	ObjectDeleter<BBitmap> convertedBitmapDeleter;
+	if (!_DetermineUnconvertedDrawMethod()) {
+		_ConvertColorSpace(convertedBitmapDeleter);
+		_DetermineDrawMethod();
 	}
 
-	ObjectDeleter<BBitmap> convertedBitmapDeleter;
-	_ConvertColorSpace(convertedBitmapDeleter);
-
-	if ((fOptions & B_TILE_BITMAP) == 0) {
-		// optimized version if there is no scale
-		if (!_HasScale() && !_HasAffineTransform() && !_HasAlphaMask()) {
-			if (fPainter->fDrawingMode == B_OP_COPY) {
-				DrawBitmapNoScale<Bgr32Copy> drawNoScale;
-				drawNoScale.Draw(fPainter->fInternal, fBitmap, 4, fOffset,
-					fDestinationRect);
-				return;
-			}
-			if (fPainter->fDrawingMode == B_OP_OVER
-				|| (fPainter->fDrawingMode == B_OP_ALPHA
-					 && fPainter->fAlphaSrcMode == B_PIXEL_ALPHA
-					 && fPainter->fAlphaFncMode == B_ALPHA_OVERLAY)) {
-				DrawBitmapNoScale<Bgr32Alpha> drawNoScale;
-				drawNoScale.Draw(fPainter->fInternal, fBitmap, 4, fOffset,
-					fDestinationRect);
-				return;
-			}
-		}
+	BRect area = fPainter->TransformAndClipRect(fDestinationRect);
+	int32 bandCount = fPainter->_PrepareBands(area);
+	if (bandCount > 1)
+		fPainter->_RenderBands(bandCount, *this);
+	else
+		RenderBand(fPainter->fInternal);
+}
 
-		if (!_HasScale() && !_HasAffineTransform() && _HasAlphaMask()) {
-			if (fPainter->fDrawingMode == B_OP_COPY) {
-				DrawBitmapNoScale<Bgr32CopyMasked> drawNoScale;
-				drawNoScale.Draw(fPainter->fInternal, fBitmap, 4, fOffset,
-					fDestinationRect);
-				return;
-			}
-		}
 
-		// bilinear and nearest-neighbor scaled, OP_COPY only
-		if (fPainter->fDrawingMode == B_OP_COPY
-			&& !_HasAffineTransform() && !_HasAlphaMask()) {
-			if ((fOptions & B_FILTER_BITMAP_BILINEAR) != 0) {
-				DrawBitmapBilinear<ColorTypeRgb, DrawModeCopy> drawBilinear;
-				drawBilinear.Draw(fPainter, fPainter->fInternal,
-					fBitmap, fOffset, fScaleX, fScaleY, fDestinationRect);
-			} else {
-				DrawBitmapNearestNeighborCopy::Draw(fPainter, fPainter->fInternal,
-					fBitmap, fOffset, fScaleX, fScaleY, fDestinationRect);
-			}
-			return;
-		}
+void
+Painter::BitmapPainter::RenderBand(PainterAggInterface& aggInterface)
+{
+	using namespace BitmapPainterPrivate;
 
-		if (fPainter->fDrawingMode == B_OP_ALPHA
-			&& fPainter->fAlphaSrcMode == B_PIXEL_ALPHA
-			&& fPainter->fAlphaFncMode == B_ALPHA_OVERLAY
-			&& !_HasAffineTransform() && !_HasAlphaMask()
-			&& (fOptions & B_FILTER_BITMAP_BILINEAR) != 0) {
-			DrawBitmapBilinear<ColorTypeRgba, DrawModeAlphaOverlay> drawBilinear;
-			drawBilinear.Draw(fPainter, fPainter->fInternal,
+	switch (fDrawMethod) {
+		case kNoScaleCMap8Copy:
+		{
+			DrawBitmapNoScale<CMap8Copy> drawNoScale;
+			drawNoScale.Draw(aggInterface, fBitmap, 1, fOffset,
+				fDestinationRect);
+			break;
+		}
+		case kNoScaleCMap8Over:
+		{
+			DrawBitmapNoScale<CMap8Over> drawNoScale;
+			drawNoScale.Draw(aggInterface, fBitmap, 1, fOffset,
+				fDestinationRect);
+			break;
+		}
+		case kNoScaleBgr32Over:
+		{
+			DrawBitmapNoScale<Bgr32Over> drawNoScale;
+			drawNoScale.Draw(aggInterface, fBitmap, 4, fOffset,
+				fDestinationRect);
+			break;
+		}
+		case kNoScaleCopy:
+		{
+			DrawBitmapNoScale<Bgr32Copy> drawNoScale;
+			drawNoScale.Draw(aggInterface, fBitmap, 4, fOffset,
+				fDestinationRect);
+			break;
+		}
+		case kNoScaleAlpha:
+		{
+			DrawBitmapNoScale<Bgr32Alpha> drawNoScale;
+			drawNoScale.Draw(aggInterface, fBitmap, 4, fOffset,
+				fDestinationRect);
+			break;
+		}
+		case kNoScaleCopyMasked:
+		{
+			DrawBitmapNoScale<Bgr32CopyMasked> drawNoScale;
+			drawNoScale.Draw(aggInterface, fBitmap, 4, fOffset,
+				fDestinationRect);
+			break;
+		}
+		case kBilinearCopy:
+		{
+			DrawBitmapBilinear<ColorTypeRgb, DrawModeCopy> drawBilinear;
+			drawBilinear.Draw(fPainter, aggInterface, fBitmap, fOffset,
+				fScaleX, fScaleY, fDestinationRect);
+			break;
+		}
+		case kNearestNeighborCopy:
+			DrawBitmapNearestNeighborCopy::Draw(fPainter, aggInterface,
 				fBitmap, fOffset, fScaleX, fScaleY, fDestinationRect);
-			return;
+			break;
+		case kBilinearAlpha:
+		{
+			DrawBitmapBilinear<ColorTypeRgba, DrawModeAlphaOverlay>
+				drawBilinear;
+			drawBilinear.Draw(fPainter, aggInterface, fBitmap, fOffset,
+				fScaleX, fScaleY, fDestinationRect);
+			break;
 		}
-	}
-
-	if ((fOptions & B_TILE_BITMAP) != 0) {
-		DrawBitmapGeneric<Tile>::Draw(fPainter, fPainter->fInternal, fBitmap,
-			fOffset, fScaleX, fScaleY, fDestinationRect, fOptions);
-	} else {
-		// for all other cases (non-optimized drawing mode or scaled drawing)
-		DrawBitmapGeneric<Fill>::Draw(fPainter, fPainter->fInternal, fBitmap,
-			fOffset, fScaleX, fScaleY, fDestinationRect, fOptions);
+		case kGenericTile:
+			DrawBitmapGeneric<Tile>::Draw(fPainter, aggInterface, fBitmap,
+				fOffset, fScaleX, fScaleY, fDestinationRect, fOptions);
+			break;
+		case kGenericFill:
+			// for all other cases (non-optimized drawing mode or scaled
+			// drawing)
+			DrawBitmapGeneric<Fill>::Draw(fPainter, aggInterface, fBitmap,
+				fOffset, fScaleX, fScaleY, fDestinationRect, fOptions);
+			break;
 	}
 }
 
@@ -234,6 +232,94 @@ Painter::BitmapPainter::_DetermineTransform(BRect sourceRect,
 }
 
 
+/*!	Chooses an optimized version that can draw the bitmap in its own color
+	space, if there is one.
+*/
+bool
+Painter::BitmapPainter::_DetermineUnconvertedDrawMethod()
+{
+	// optimized version for no scale in CMAP8 or RGB32 OP_OVER
+	if ((fOptions & B_TILE_BITMAP) != 0
+		|| _HasScale() || _HasAffineTransform() || _HasAlphaMask()) {
+		return false;
+	}
+
+	if (fColorSpace == B_CMAP8) {
+		if (fPainter->fDrawingMode == B_OP_COPY) {
+			fDrawMethod = kNoScaleCMap8Copy;
+			return true;
+		}
+		if (fPainter->fDrawingMode == B_OP_OVER) {
+			fDrawMethod = kNoScaleCMap8Over;
+			return true;
+		}
+	} else if (fColorSpace == B_RGB32) {
+		if (fPainter->fDrawingMode == B_OP_OVER) {
+			fDrawMethod = kNoScaleBgr32Over;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*!	Chooses how to draw the bitmap once it has been converted to B_RGBA32.
+*/
+void
+Painter::BitmapPainter::_DetermineDrawMethod()
+{
+	if ((fOptions & B_TILE_BITMAP) != 0) {
+		fDrawMethod = kGenericTile;
+		return;
+	}
+
+	// optimized version if there is no scale
+	if (!_HasScale() && !_HasAffineTransform() && !_HasAlphaMask()) {
+		if (fPainter->fDrawingMode == B_OP_COPY) {
+			fDrawMethod = kNoScaleCopy;
+			return;
+		}
+		if (fPainter->fDrawingMode == B_OP_OVER
+			|| (fPainter->fDrawingMode == B_OP_ALPHA
+				 && fPainter->fAlphaSrcMode == B_PIXEL_ALPHA
+				 && fPainter->fAlphaFncMode == B_ALPHA_OVERLAY)) {
+			fDrawMethod = kNoScaleAlpha;
+			return;
+		}
+	}
+
+	if (!_HasScale() && !_HasAffineTransform() && _HasAlphaMask()) {
+		if (fPainter->fDrawingMode == B_OP_COPY) {
+			fDrawMethod = kNoScaleCopyMasked;
+			return;
+		}
+	}
+
+	// bilinear and nearest-neighbor scaled, OP_COPY only
+	if (fPainter->fDrawingMode == B_OP_COPY
+		&& !_HasAffineTransform() && !_HasAlphaMask()) {
+		if ((fOptions & B_FILTER_BITMAP_BILINEAR) != 0)
+			fDrawMethod = kBilinearCopy;
+		else
+			fDrawMethod = kNearestNeighborCopy;
+		return;
+	}
+
+	if (fPainter->fDrawingMode == B_OP_ALPHA
+		&& fPainter->fAlphaSrcMode == B_PIXEL_ALPHA
+		&& fPainter->fAlphaFncMode == B_ALPHA_OVERLAY
+		&& !_HasAffineTransform() && !_HasAlphaMask()
+		&& (fOptions & B_FILTER_BITMAP_BILINEAR) != 0) {
+		fDrawMethod = kBilinearAlpha;
+		return;
+	}
+
+	// for all other cases (non-optimized drawing mode or scaled drawing)
+	fDrawMethod = kGenericFill;
+}
+
+
 bool
 Painter::BitmapPainter::_HasScale()
 {
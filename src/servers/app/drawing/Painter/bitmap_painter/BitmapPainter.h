@@ -12,7 +12,7 @@
 #include "Painter.h"
 
 
-class Painter::BitmapPainter {
+class Painter::BitmapPainter : public BandRenderer {
 public:
 
 public:
@@ -23,7 +23,26 @@ public:
 			void				Draw(const BRect& sourceRect,
 									const BRect& destinationRect);
 
+	virtual	void				RenderBand(PainterAggInterface& aggInterface);
+
 private:
+			enum draw_method {
+				kNoScaleCMap8Copy,
+				kNoScaleCMap8Over,
+				kNoScaleBgr32Over,
+				kNoScaleCopy,
+				kNoScaleAlpha,
+				kNoScaleCopyMasked,
+				kBilinearCopy,
+				kNearestNeighborCopy,
+				kBilinearAlpha,
+				kGenericTile,
+				kGenericFill
+			};
+
+			bool				_DetermineUnconvertedDrawMethod();
+			void				_DetermineDrawMethod();
+
 			bool				_DetermineTransform(
 									BRect sourceRect,
 									const BRect& destinationRect);
@@ -54,6 +73,7 @@ private:
 			double					fScaleX;
 			double					fScaleY;
 			BPoint					fOffset;
+			draw_method				fDrawMethod;
 };
 
 
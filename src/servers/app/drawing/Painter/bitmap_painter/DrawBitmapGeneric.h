@@ -100,11 +100,11 @@ struct DrawBitmapGeneric {
 
 			// render the path with the bitmap as scanline fill
 			if (aggInterface.fMaskedUnpackedScanline != NULL) {
-				agg::render_scanlines_aa(rasterizer,
+				render_band_scanlines_aa(rasterizer,
 					*aggInterface.fMaskedUnpackedScanline,
 					aggInterface.fBaseRenderer, spanAllocator, spanGenerator);
 			} else {
-				agg::render_scanlines_aa(rasterizer,
+				render_band_scanlines_aa(rasterizer,
 					aggInterface.fUnpackedScanline,
 					aggInterface.fBaseRenderer, spanAllocator, spanGenerator);
 			}
@@ -116,11 +116,11 @@ struct DrawBitmapGeneric {
 
 			// render the path with the bitmap as scanline fill
 			if (aggInterface.fMaskedUnpackedScanline != NULL) {
-				agg::render_scanlines_aa(rasterizer,
+				render_band_scanlines_aa(rasterizer,
 					*aggInterface.fMaskedUnpackedScanline,
 					aggInterface.fBaseRenderer, spanAllocator, spanGenerator);
 			} else {
-				agg::render_scanlines_aa(rasterizer,
+				render_band_scanlines_aa(rasterizer,
 					aggInterface.fUnpackedScanline,
 					aggInterface.fBaseRenderer, spanAllocator, spanGenerator);
 			}
@@ -0,0 +1,859 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * SSE2 and NEON implementations of the span blending functions declared in
+ * DrawingModeSIMD.h. Four pixels are processed at once; the remaining pixels
+ * of a span are blended with the same macros the scalar versions use.
+ *
+ */
+
+#include "DrawingModeSIMD.h"
+
+#ifdef APPSERVER_SIMD_BLENDERS
+
+#if defined(__i386__)
+	// this file is only used when the CPU reports SSE2 support
+#	pragma GCC target("sse2")
+#endif
+
+#if defined(__aarch64__)
+#	include <arm_neon.h>
+#else
+#	include <emmintrin.h>
+#endif
+
+#include "DrawingMode.h"
+#include "GlobalSubpixelSettings.h"
+
+
+#if defined(__aarch64__)
+
+// #pragma mark - NEON primitives
+
+
+//! Four B_RGBA32 pixels, or one 32 bit value per pixel.
+typedef uint32x4_t pixel_vector;
+//! The 16 bit wide channels of two pixels.
+typedef uint16x8_t channel_vector;
+
+
+static inline pixel_vector
+load_pixels(const void* source)
+{
+	return vreinterpretq_u32_u8(vld1q_u8((const uint8*)source));
+}
+
+
+static inline void
+store_pixels(void* target, pixel_vector pixels)
+{
+	vst1q_u8((uint8*)target, vreinterpretq_u8_u32(pixels));
+}
+
+
+static inline pixel_vector
+splat(uint32 value)
+{
+	return vdupq_n_u32(value);
+}
+
+
+//! Returns the next four cover values as one 32 bit value per pixel.
+static inline pixel_vector
+load_covers(const uint8* covers)
+{
+	uint32 value;
+	memcpy(&value, covers, sizeof(value));
+
+	return vmovl_u16(vget_low_u16(vmovl_u8(
+		vreinterpret_u8_u32(vdup_n_u32(value)))));
+}
+
+
+//! Converts four agg::rgba8 colors into B_RGBA32 (BGRA) byte order.
+static inline pixel_vector
+swap_red_blue(pixel_vector colors)
+{
+	static const uint8 kIndices[16] = {
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15
+	};
+	return vreinterpretq_u32_u8(vqtbl1q_u8(vreinterpretq_u8_u32(colors),
+		vld1q_u8(kIndices)));
+}
+
+
+//! Returns the alpha channel of each pixel as a 32 bit value.
+static inline pixel_vector
+alpha_values(pixel_vector pixels)
+{
+	return vshrq_n_u32(pixels, 24);
+}
+
+
+static inline pixel_vector
+multiply_values(pixel_vector a, pixel_vector b)
+{
+	return vmulq_u32(a, b);
+}
+
+
+static inline pixel_vector
+equal_mask(pixel_vector a, pixel_vector b)
+{
+	return vceqq_u32(a, b);
+}
+
+
+static inline pixel_vector
+or_pixels(pixel_vector a, pixel_vector b)
+{
+	return vorrq_u32(a, b);
+}
+
+
+static inline pixel_vector
+select_pixels(pixel_vector mask, pixel_vector a, pixel_vector b)
+{
+	return vbslq_u32(mask, a, b);
+}
+
+
+static inline bool
+all_set(pixel_vector mask)
+{
+	return vminvq_u32(mask) != 0;
+}
+
+
+static inline bool
+none_set(pixel_vector mask)
+{
+	return vmaxvq_u32(mask) == 0;
+}
+
+
+//! Spreads the 16 bit value of each pixel over all of its channels.
+static inline void
+expand_values(pixel_vector values, channel_vector& low, channel_vector& high)
+{
+	static const uint8 kLowIndices[16] = {
+		0, 1, 0, 1, 0, 1, 0, 1, 4, 5, 4, 5, 4, 5, 4, 5
+	};
+	static const uint8 kHighIndices[16] = {
+		8, 9, 8, 9, 8, 9, 8, 9, 12, 13, 12, 13, 12, 13, 12, 13
+	};
+	uint8x16_t bytes = vreinterpretq_u8_u32(values);
+	low = vreinterpretq_u16_u8(vqtbl1q_u8(bytes, vld1q_u8(kLowIndices)));
+	high = vreinterpretq_u16_u8(vqtbl1q_u8(bytes, vld1q_u8(kHighIndices)));
+}
+
+
+static inline pixel_vector
+make_pixels(uint32 first, uint32 second, uint32 third, uint32 fourth)
+{
+	const uint32 values[4] = { first, second, third, fourth };
+	return vld1q_u32(values);
+}
+
+
+//! Widens the channels to 16 bit, and multiplies them by \a factor.
+static inline void
+expand_channels(pixel_vector pixels, uint16 factor, channel_vector& low,
+	channel_vector& high)
+{
+	uint8x16_t bytes = vreinterpretq_u8_u32(pixels);
+	low = vmovl_u8(vget_low_u8(bytes));
+	high = vmovl_u8(vget_high_u8(bytes));
+	if (factor != 1) {
+		low = vmulq_n_u16(low, factor);
+		high = vmulq_n_u16(high, factor);
+	}
+}
+
+
+//! BLEND16 for 16 bit channels, \a alpha is in the range 0..65025.
+static inline channel_vector
+blend16_channels(channel_vector dest, channel_vector source,
+	channel_vector alpha)
+{
+	int16x8_t difference = vsubq_s16(vreinterpretq_s16_u16(source),
+		vreinterpretq_s16_u16(dest));
+	int32x4_t low = vmulq_s32(vmovl_s16(vget_low_s16(difference)),
+		vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(alpha))));
+	int32x4_t high = vmulq_s32(vmovl_s16(vget_high_s16(difference)),
+		vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(alpha))));
+	int16x8_t product = vcombine_s16(vmovn_s32(vshrq_n_s32(low, 16)),
+		vmovn_s32(vshrq_n_s32(high, 16)));
+
+	return vreinterpretq_u16_s16(vaddq_s16(vreinterpretq_s16_u16(dest),
+		product));
+}
+
+
+//! BLEND for 16 bit channels, \a alpha is in the range 0..255.
+static inline channel_vector
+blend_channels(channel_vector dest, channel_vector source,
+	channel_vector alpha)
+{
+	channel_vector inverse = vsubq_u16(vdupq_n_u16(256), alpha);
+	return vshrq_n_u16(vmlaq_u16(vmulq_u16(source, alpha), dest, inverse), 8);
+}
+
+
+static inline pixel_vector
+blend_pixels(pixel_vector dest, pixel_vector source, channel_vector alphaLow,
+	channel_vector alphaHigh, bool wideAlpha)
+{
+	uint8x16_t dest8 = vreinterpretq_u8_u32(dest);
+	uint8x16_t source8 = vreinterpretq_u8_u32(source);
+	channel_vector destLow = vmovl_u8(vget_low_u8(dest8));
+	channel_vector destHigh = vmovl_u8(vget_high_u8(dest8));
+	channel_vector sourceLow = vmovl_u8(vget_low_u8(source8));
+	channel_vector sourceHigh = vmovl_u8(vget_high_u8(source8));
+
+	channel_vector low;
+	channel_vector high;
+	if (wideAlpha) {
+		low = blend16_channels(destLow, sourceLow, alphaLow);
+		high = blend16_channels(destHigh, sourceHigh, alphaHigh);
+	} else {
+		low = blend_channels(destLow, sourceLow, alphaLow);
+		high = blend_channels(destHigh, sourceHigh, alphaHigh);
+	}
+
+	return vreinterpretq_u32_u8(vcombine_u8(vqmovn_u16(low),
+		vqmovn_u16(high)));
+}
+
+
+//! Returns (a + b) / 2 for each channel, rounded down.
+static inline pixel_vector
+average_pixels(pixel_vector a, pixel_vector b)
+{
+	return vreinterpretq_u32_u8(vhaddq_u8(vreinterpretq_u8_u32(a),
+		vreinterpretq_u8_u32(b)));
+}
+
+
+#else	// !__aarch64__
+
+// #pragma mark - SSE2 primitives
+
+
+//! Four B_RGBA32 pixels, or one 32 bit value per pixel.
+typedef __m128i pixel_vector;
+//! The 16 bit wide channels of two pixels.
+typedef __m128i channel_vector;
+
+
+static inline pixel_vector
+load_pixels(const void* source)
+{
+	return _mm_loadu_si128((const __m128i*)source);
+}
+
+
+static inline void
+store_pixels(void* target, pixel_vector pixels)
+{
+	_mm_storeu_si128((__m128i*)target, pixels);
+}
+
+
+static inline pixel_vector
+splat(uint32 value)
+{
+	return _mm_set1_epi32((int)value);
+}
+
+
+//! Returns the next four cover values as one 32 bit value per pixel.
+static inline pixel_vector
+load_covers(const uint8* covers)
+{
+	uint32 value;
+	memcpy(&value, covers, sizeof(value));
+
+	__m128i zero = _mm_setzero_si128();
+	return _mm_unpacklo_epi16(
+		_mm_unpacklo_epi8(_mm_cvtsi32_si128((int)value), zero), zero);
+}
+
+
+//! Converts four agg::rgba8 colors into B_RGBA32 (BGRA) byte order.
+static inline pixel_vector
+swap_red_blue(pixel_vector colors)
+{
+	const __m128i greenAlpha = _mm_set1_epi32((int)0xff00ff00);
+	const __m128i lowByte = _mm_set1_epi32(0x000000ff);
+	const __m128i thirdByte = _mm_set1_epi32(0x00ff0000);
+
+	return _mm_or_si128(_mm_and_si128(colors, greenAlpha),
+		_mm_or_si128(_mm_and_si128(_mm_srli_epi32(colors, 16), lowByte),
+			_mm_and_si128(_mm_slli_epi32(colors, 16), thirdByte)));
+}
+
+
+//! Returns the alpha channel of each pixel as a 32 bit value.
+static inline pixel_vector
+alpha_values(pixel_vector pixels)
+{
+	return _mm_srli_epi32(pixels, 24);
+}
+
+
+static inline pixel_vector
+multiply_values(pixel_vector a, pixel_vector b)
+{
+	// Both factors are at most 255, so their upper 16 bits are zero, and
+	// the multiply-add of the 16 bit halves is the full product
+	return _mm_madd_epi16(a, b);
+}
+
+
+static inline pixel_vector
+equal_mask(pixel_vector a, pixel_vector b)
+{
+	return _mm_cmpeq_epi32(a, b);
+}
+
+
+static inline pixel_vector
+or_pixels(pixel_vector a, pixel_vector b)
+{
+	return _mm_or_si128(a, b);
+}
+
+
+static inline pixel_vector
+select_pixels(pixel_vector mask, pixel_vector a, pixel_vector b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+static inline bool
+all_set(pixel_vector mask)
+{
+	return _mm_movemask_epi8(mask) == 0xffff;
+}
+
+
+static inline bool
+none_set(pixel_vector mask)
+{
+	return _mm_movemask_epi8(mask) == 0;
+}
+
+
+//! Spreads the 16 bit value of each pixel over all of its channels.
+static inline void
+expand_values(pixel_vector values, channel_vector& low, channel_vector& high)
+{
+	__m128i pairs = _mm_shufflehi_epi16(
+		_mm_shufflelo_epi16(values, _MM_SHUFFLE(2, 2, 0, 0)),
+		_MM_SHUFFLE(2, 2, 0, 0));
+	low = _mm_unpacklo_epi32(pairs, pairs);
+	high = _mm_unpackhi_epi32(pairs, pairs);
+}
+
+
+static inline pixel_vector
+make_pixels(uint32 first, uint32 second, uint32 third, uint32 fourth)
+{
+	return _mm_setr_epi32((int)first, (int)second, (int)third, (int)fourth);
+}
+
+
+//! Widens the channels to 16 bit, and multiplies them by \a factor.
+static inline void
+expand_channels(pixel_vector pixels, uint16 factor, channel_vector& low,
+	channel_vector& high)
+{
+	__m128i zero = _mm_setzero_si128();
+	low = _mm_unpacklo_epi8(pixels, zero);
+	high = _mm_unpackhi_epi8(pixels, zero);
+	if (factor != 1) {
+		__m128i scale = _mm_set1_epi16((short)factor);
+		low = _mm_mullo_epi16(low, scale);
+		high = _mm_mullo_epi16(high, scale);
+	}
+}
+
+
+//! BLEND16 for 16 bit channels, \a alpha is in the range 0..65025.
+static inline channel_vector
+blend16_channels(channel_vector dest, channel_vector source,
+	channel_vector alpha)
+{
+	// The upper half of (source - dest) * alpha is computed with a signed
+	// multiply. Alpha values of 32768 and above are negative that way, which
+	// is compensated for by adding the difference once more.
+	__m128i difference = _mm_sub_epi16(source, dest);
+	__m128i product = _mm_add_epi16(_mm_mulhi_epi16(difference, alpha),
+		_mm_and_si128(difference, _mm_srai_epi16(alpha, 15)));
+
+	return _mm_add_epi16(dest, product);
+}
+
+
+//! BLEND for 16 bit channels, \a alpha is in the range 0..255.
+static inline channel_vector
+blend_channels(channel_vector dest, channel_vector source,
+	channel_vector alpha)
+{
+	// source * alpha + dest * (256 - alpha) is at most 255 * 256, and
+	// therefore fits into an unsigned 16 bit channel
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(256), alpha);
+	return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(source, alpha),
+		_mm_mullo_epi16(dest, inverse)), 8);
+}
+
+
+static inline pixel_vector
+blend_pixels(pixel_vector dest, pixel_vector source, channel_vector alphaLow,
+	channel_vector alphaHigh, bool wideAlpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i destLow = _mm_unpacklo_epi8(dest, zero);
+	__m128i destHigh = _mm_unpackhi_epi8(dest, zero);
+	__m128i sourceLow = _mm_unpacklo_epi8(source, zero);
+	__m128i sourceHigh = _mm_unpackhi_epi8(source, zero);
+
+	__m128i low;
+	__m128i high;
+	if (wideAlpha) {
+		low = blend16_channels(destLow, sourceLow, alphaLow);
+		high = blend16_channels(destHigh, sourceHigh, alphaHigh);
+	} else {
+		low = blend_channels(destLow, sourceLow, alphaLow);
+		high = blend_channels(destHigh, sourceHigh, alphaHigh);
+	}
+
+	return _mm_packus_epi16(low, high);
+}
+
+
+//! Returns (a + b) / 2 for each channel, rounded down.
+static inline pixel_vector
+average_pixels(pixel_vector a, pixel_vector b)
+{
+	// _mm_avg_epu8() rounds up
+	return _mm_sub_epi8(_mm_avg_epu8(a, b),
+		_mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+
+#endif	// !__aarch64__
+
+
+// #pragma mark - common helpers
+
+
+static const uint32 kOpaque = 0xff000000;
+
+
+static inline uint32
+make_pixel(uint8 r, uint8 g, uint8 b)
+{
+	pixel32 pixel;
+	pixel.data8[0] = b;
+	pixel.data8[1] = g;
+	pixel.data8[2] = r;
+	pixel.data8[3] = 255;
+	return pixel.data32;
+}
+
+
+//! Packs the subpixel covers of one pixel into its blue, green, and red
+//! channels.
+static inline uint32
+subpixel_covers(const uint8* covers, int blue, int green, int red)
+{
+	pixel32 pixel;
+	pixel.data8[0] = covers[blue];
+	pixel.data8[1] = covers[green];
+	pixel.data8[2] = covers[red];
+	pixel.data8[3] = 0;
+	return pixel.data32;
+}
+
+
+//! Returns the subpixel covers of the next four pixels.
+static inline pixel_vector
+load_subpixel_covers(const uint8* covers, int blue, int green, int red)
+{
+	return make_pixels(subpixel_covers(covers, blue, green, red),
+		subpixel_covers(covers + 3, blue, green, red),
+		subpixel_covers(covers + 6, blue, green, red),
+		subpixel_covers(covers + 9, blue, green, red));
+}
+
+
+static inline void
+assign_pixel(uint8* p, uint8 r, uint8 g, uint8 b)
+{
+	p[0] = b;
+	p[1] = g;
+	p[2] = r;
+	p[3] = 255;
+}
+
+
+/*!	Blends \a source into \a dest with one \a alpha value per pixel, either
+	like BLEND16 (\a wideAlpha), or like BLEND. Pixels in the \a assign mask
+	are replaced by \a source, and those in the \a skip mask are left alone.
+*/
+static inline pixel_vector
+combine_pixels(pixel_vector dest, pixel_vector source, pixel_vector alpha,
+	pixel_vector skip, pixel_vector assign, bool wideAlpha)
+{
+	channel_vector alphaLow;
+	channel_vector alphaHigh;
+	expand_values(alpha, alphaLow, alphaHigh);
+
+	pixel_vector opaque = splat(kOpaque);
+	pixel_vector result = or_pixels(blend_pixels(dest, source, alphaLow,
+		alphaHigh, wideAlpha), opaque);
+	result = select_pixels(assign, or_pixels(source, opaque), result);
+	return select_pixels(skip, dest, result);
+}
+
+
+//! Like combine_pixels(), but works in place, and avoids needless work.
+static inline void
+blend_into(uint8* p, pixel_vector source, pixel_vector alpha,
+	pixel_vector skip, pixel_vector assign, bool wideAlpha)
+{
+	if (all_set(skip))
+		return;
+	if (none_set(skip) && all_set(assign)) {
+		store_pixels(p, or_pixels(source, splat(kOpaque)));
+		return;
+	}
+
+	store_pixels(p, combine_pixels(load_pixels(p), source, alpha, skip,
+		assign, wideAlpha));
+}
+
+
+// #pragma mark - B_OP_ALPHA, B_PIXEL_ALPHA, B_ALPHA_OVERLAY
+
+
+void
+blend_solid_hspan_alpha_po_solid_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern)
+{
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+
+	const pixel_vector source = splat(make_pixel(c.r, c.g, c.b));
+	const pixel_vector colorAlpha = splat(c.a);
+	const pixel_vector zeroAlpha = splat(0);
+	const pixel_vector fullAlpha = splat(255 * 255);
+
+	for (; len >= 4; len -= 4) {
+		pixel_vector alpha = multiply_values(colorAlpha, load_covers(covers));
+		blend_into(p, source, alpha, equal_mask(alpha, zeroAlpha),
+			equal_mask(alpha, fullAlpha), true);
+		covers += 4;
+		p += 16;
+	}
+
+	for (; len > 0; len--) {
+		uint16 alpha = c.a * *covers;
+		if (alpha == 255 * 255) {
+			assign_pixel(p, c.r, c.g, c.b);
+		} else if (alpha) {
+			BLEND16(p, c.r, c.g, c.b, alpha);
+		}
+		covers++;
+		p += 4;
+	}
+}
+
+
+void
+blend_solid_hspan_alpha_po_solid_subpix_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern)
+{
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+	unsigned count = len / 3;
+
+	const int subpixelL = gSubpixelOrderingRGB ? 2 : 0;
+	const int subpixelM = 1;
+	const int subpixelR = gSubpixelOrderingRGB ? 0 : 2;
+
+	const pixel_vector source = splat(make_pixel(c.r, c.g, c.b));
+	const pixel_vector opaque = splat(kOpaque);
+
+	for (; count >= 4; count -= 4) {
+		channel_vector alphaLow;
+		channel_vector alphaHigh;
+		expand_channels(load_subpixel_covers(covers, subpixelR, subpixelM,
+			subpixelL), c.a, alphaLow, alphaHigh);
+
+		store_pixels(p, or_pixels(blend_pixels(load_pixels(p), source,
+			alphaLow, alphaHigh, true), opaque));
+		covers += 12;
+		p += 16;
+	}
+
+	for (; count > 0; count--) {
+		BLEND16_SUBPIX(p, c.r, c.g, c.b, c.a * covers[subpixelR],
+			c.a * covers[subpixelM], c.a * covers[subpixelL]);
+		covers += 3;
+		p += 4;
+	}
+}
+
+
+void
+blend_color_hspan_alpha_po_simd(int x, int y, unsigned len,
+	const color_type* colors, const uint8* covers, uint8 cover,
+	agg_buffer* buffer, const PatternHandler* pattern)
+{
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+
+	const pixel_vector zeroAlpha = splat(0);
+	const pixel_vector fullAlpha = splat(255 * 255);
+
+	if (covers != NULL) {
+		// non-solid opacity
+		for (; len >= 4; len -= 4) {
+			pixel_vector source = load_pixels(colors);
+			pixel_vector alpha = multiply_values(alpha_values(source),
+				load_covers(covers));
+			blend_into(p, swap_red_blue(source), alpha,
+				equal_mask(alpha, zeroAlpha), equal_mask(alpha, fullAlpha),
+				true);
+			covers += 4;
+			colors += 4;
+			p += 16;
+		}
+
+		for (; len > 0; len--) {
+			uint16 alpha = colors->a * *covers;
+			if (alpha == 255 * 255) {
+				assign_pixel(p, colors->r, colors->g, colors->b);
+			} else if (alpha) {
+				BLEND16(p, colors->r, colors->g, colors->b, alpha);
+			}
+			covers++;
+			colors++;
+			p += 4;
+		}
+		return;
+	}
+
+	// The scalar version uses the alpha of the first color for the
+	// whole span as well
+	uint16 alpha = colors->a * cover;
+	if (alpha == 0)
+		return;
+
+	const pixel_vector alphas = splat(alpha);
+	const pixel_vector skip = splat(0);
+	const pixel_vector assign = splat(alpha == 255 * 255 ? 0xffffffff : 0);
+
+	for (; len >= 4; len -= 4) {
+		blend_into(p, swap_red_blue(load_pixels(colors)), alphas, skip,
+			assign, true);
+		colors += 4;
+		p += 16;
+	}
+
+	for (; len > 0; len--) {
+		if (alpha == 255 * 255) {
+			assign_pixel(p, colors->r, colors->g, colors->b);
+		} else {
+			BLEND16(p, colors->r, colors->g, colors->b, alpha);
+		}
+		colors++;
+		p += 4;
+	}
+}
+
+
+// #pragma mark - B_OP_OVER
+
+
+void
+blend_solid_hspan_over_solid_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern)
+{
+	if (pattern->IsSolidLow())
+		return;
+
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+
+	const pixel_vector source = splat(make_pixel(c.r, c.g, c.b));
+	const pixel_vector zeroAlpha = splat(0);
+	const pixel_vector fullAlpha = splat(255);
+
+	for (; len >= 4; len -= 4) {
+		pixel_vector alpha = load_covers(covers);
+		blend_into(p, source, alpha, equal_mask(alpha, zeroAlpha),
+			equal_mask(alpha, fullAlpha), false);
+		covers += 4;
+		p += 16;
+	}
+
+	for (; len > 0; len--) {
+		if (*covers == 255) {
+			assign_pixel(p, c.r, c.g, c.b);
+		} else if (*covers) {
+			BLEND(p, c.r, c.g, c.b, *covers);
+		}
+		covers++;
+		p += 4;
+	}
+}
+
+
+void
+blend_solid_hspan_over_solid_subpix_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern)
+{
+	if (pattern->IsSolidLow())
+		return;
+
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+	unsigned count = len / 3;
+
+	const int subpixelL = gSubpixelOrderingRGB ? 2 : 0;
+	const int subpixelM = 1;
+	const int subpixelR = gSubpixelOrderingRGB ? 0 : 2;
+
+	const pixel_vector source = splat(make_pixel(c.r, c.g, c.b));
+	const pixel_vector opaque = splat(kOpaque);
+
+	for (; count >= 4; count -= 4) {
+		channel_vector alphaLow;
+		channel_vector alphaHigh;
+		expand_channels(load_subpixel_covers(covers, subpixelL, subpixelM,
+			subpixelR), 1, alphaLow, alphaHigh);
+
+		store_pixels(p, or_pixels(blend_pixels(load_pixels(p), source,
+			alphaLow, alphaHigh, false), opaque));
+		covers += 12;
+		p += 16;
+	}
+
+	for (; count > 0; count--) {
+		BLEND_SUBPIX(p, c.r, c.g, c.b, covers[subpixelL], covers[subpixelM],
+			covers[subpixelR]);
+		covers += 3;
+		p += 4;
+	}
+}
+
+
+void
+blend_color_hspan_over_simd(int x, int y, unsigned len,
+	const color_type* colors, const uint8* covers, uint8 cover,
+	agg_buffer* buffer, const PatternHandler* pattern)
+{
+	if (covers == NULL && cover == 0)
+		return;
+
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+
+	const pixel_vector zeroAlpha = splat(0);
+	const pixel_vector fullAlpha = splat(255);
+	const pixel_vector fixedAlpha = splat(cover);
+
+	for (; len >= 4; len -= 4) {
+		pixel_vector source = load_pixels(colors);
+		pixel_vector alpha = covers != NULL ? load_covers(covers) : fixedAlpha;
+		pixel_vector skip = or_pixels(equal_mask(alpha, zeroAlpha),
+			equal_mask(alpha_values(source), zeroAlpha));
+
+		blend_into(p, swap_red_blue(source), alpha, skip,
+			equal_mask(alpha, fullAlpha), false);
+		if (covers != NULL)
+			covers += 4;
+		colors += 4;
+		p += 16;
+	}
+
+	for (; len > 0; len--) {
+		uint8 alpha = covers != NULL ? *covers++ : cover;
+		if (alpha && colors->a > 0) {
+			if (alpha == 255) {
+				assign_pixel(p, colors->r, colors->g, colors->b);
+			} else {
+				BLEND(p, colors->r, colors->g, colors->b, alpha);
+			}
+		}
+		colors++;
+		p += 4;
+	}
+}
+
+
+// #pragma mark - B_OP_BLEND
+
+
+void
+blend_color_hspan_blend_simd(int x, int y, unsigned len,
+	const color_type* colors, const uint8* covers, uint8 cover,
+	agg_buffer* buffer, const PatternHandler* pattern)
+{
+	if (covers == NULL && cover == 0)
+		return;
+
+	uint8* p = buffer->row_ptr(y) + (x << 2);
+
+	// Like in the scalar version, transparent colors are only ignored when
+	// there are individual covers, or when the cover is opaque
+	const bool skipTransparent = covers != NULL || cover == 255;
+
+	const pixel_vector zeroAlpha = splat(0);
+	const pixel_vector fullAlpha = splat(255);
+	const pixel_vector fixedAlpha = splat(cover);
+
+	for (; len >= 4; len -= 4) {
+		pixel_vector source = load_pixels(colors);
+		pixel_vector alpha = covers != NULL ? load_covers(covers) : fixedAlpha;
+		pixel_vector skip = equal_mask(alpha, zeroAlpha);
+		if (skipTransparent) {
+			skip = or_pixels(skip,
+				equal_mask(alpha_values(source), zeroAlpha));
+		}
+
+		if (!all_set(skip)) {
+			pixel_vector dest = load_pixels(p);
+			store_pixels(p, combine_pixels(dest,
+				average_pixels(dest, swap_red_blue(source)), alpha, skip,
+				equal_mask(alpha, fullAlpha), false));
+		}
+		if (covers != NULL)
+			covers += 4;
+		colors += 4;
+		p += 16;
+	}
+
+	for (; len > 0; len--) {
+		uint8 alpha = covers != NULL ? *covers++ : cover;
+		if (alpha && (!skipTransparent || colors->a > 0)) {
+			uint8 b = (p[0] + colors->b) >> 1;
+			uint8 g = (p[1] + colors->g) >> 1;
+			uint8 r = (p[2] + colors->r) >> 1;
+			if (alpha == 255) {
+				assign_pixel(p, r, g, b);
+			} else {
+				BLEND(p, r, g, b, alpha);
+			}
+		}
+		colors++;
+		p += 4;
+	}
+}
+
+
+#endif	// APPSERVER_SIMD_BLENDERS
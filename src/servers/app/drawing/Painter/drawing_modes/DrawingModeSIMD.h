@@ -0,0 +1,61 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ *
+ * Vectorized versions of the span blending functions that are used the most
+ * when filling anti-aliased shapes, drawing text, and drawing bitmaps.
+ * They produce exactly the same results as their scalar counterparts, and
+ * are only used if gSIMDFlags reports the needed instruction set.
+ *
+ */
+
+#ifndef DRAWING_MODE_SIMD_H
+#define DRAWING_MODE_SIMD_H
+
+#include "PixelFormat.h"
+#include "drawing_support.h"
+
+
+#if defined(__x86_64__) || (defined(__i386__) && __GNUC__ >= 5)
+#	define APPSERVER_SIMD_BLENDERS		APPSERVER_SIMD_SSE2
+#elif defined(__aarch64__)
+#	define APPSERVER_SIMD_BLENDERS		APPSERVER_SIMD_NEON
+#endif
+
+
+#ifdef APPSERVER_SIMD_BLENDERS
+
+typedef PixelFormat::color_type		color_type;
+typedef PixelFormat::agg_buffer		agg_buffer;
+
+
+// B_OP_ALPHA, B_PIXEL_ALPHA, B_ALPHA_OVERLAY
+void blend_solid_hspan_alpha_po_solid_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern);
+void blend_solid_hspan_alpha_po_solid_subpix_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern);
+void blend_color_hspan_alpha_po_simd(int x, int y, unsigned len,
+	const color_type* colors, const uint8* covers, uint8 cover,
+	agg_buffer* buffer, const PatternHandler* pattern);
+
+// B_OP_OVER
+void blend_solid_hspan_over_solid_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern);
+void blend_solid_hspan_over_solid_subpix_simd(int x, int y, unsigned len,
+	const color_type& c, const uint8* covers, agg_buffer* buffer,
+	const PatternHandler* pattern);
+void blend_color_hspan_over_simd(int x, int y, unsigned len,
+	const color_type* colors, const uint8* covers, uint8 cover,
+	agg_buffer* buffer, const PatternHandler* pattern);
+
+// B_OP_BLEND
+void blend_color_hspan_blend_simd(int x, int y, unsigned len,
+	const color_type* colors, const uint8* covers, uint8 cover,
+	agg_buffer* buffer, const PatternHandler* pattern);
+
+#endif	// APPSERVER_SIMD_BLENDERS
+
+#endif	// DRAWING_MODE_SIMD_H
@@ -54,6 +54,8 @@
 #include "DrawingModeSelectSUBPIX.h"
 #include "DrawingModeSubtractSUBPIX.h"
 
+#include "DrawingModeSIMD.h"
+
 #include "PatternHandler.h"
 
 // blend_pixel_empty
@@ -361,4 +363,52 @@ fprintf(stderr, "PixelFormat::SetDrawingMode() - drawing_mode not implemented\n"
 //			return fDrawingModeBGRA32Copy;
 			break;
 	}
+
+	SetSIMDBlenders(mode, alphaSrcMode, alphaFncMode);
+}
+
+// SetSIMDBlenders
+void
+PixelFormat::SetSIMDBlenders(drawing_mode mode, source_alpha alphaSrcMode,
+	alpha_function alphaFncMode)
+{
+#ifdef APPSERVER_SIMD_BLENDERS
+	// Replace the span functions that are used the most for anti-aliased
+	// shapes, text and bitmaps with vectorized versions, if the CPU can
+	// run them. Since they produce the very same results, this is invisible
+	// to everyone else.
+	if ((gSIMDFlags & APPSERVER_SIMD_BLENDERS) == 0)
+		return;
+
+	switch (mode) {
+		case B_OP_OVER:
+			if (fPatternHandler->IsSolid()) {
+				fBlendSolidHSpan = blend_solid_hspan_over_solid_simd;
+				fBlendSolidHSpanSubpix
+					= blend_solid_hspan_over_solid_subpix_simd;
+			}
+			fBlendColorHSpan = blend_color_hspan_over_simd;
+			break;
+
+		case B_OP_BLEND:
+			fBlendColorHSpan = blend_color_hspan_blend_simd;
+			break;
+
+		case B_OP_ALPHA:
+			if (alphaSrcMode != B_PIXEL_ALPHA
+				|| alphaFncMode != B_ALPHA_OVERLAY) {
+				break;
+			}
+			if (fPatternHandler->IsSolid()) {
+				fBlendSolidHSpan = blend_solid_hspan_alpha_po_solid_simd;
+				fBlendSolidHSpanSubpix
+					= blend_solid_hspan_alpha_po_solid_subpix_simd;
+			}
+			fBlendColorHSpan = blend_color_hspan_alpha_po_simd;
+			break;
+
+		default:
+			break;
+	}
+#endif
 }
@@ -177,6 +177,10 @@ class PixelFormat {
 	blend_color_span			fBlendColorHSpan;
 	blend_color_span			fBlendColorVSpan;
 
+			void				SetSIMDBlenders(drawing_mode mode,
+											source_alpha alphaSrcMode,
+											alpha_function alphaFncMode);
+
 	template<typename T>
 	void SetAggCompOpAdapter()
 	{
@@ -15,6 +15,19 @@
 class BRect;
 
 
+// Defines for SIMD support.
+#define APPSERVER_SIMD_MMX	(1 << 0)
+#define APPSERVER_SIMD_SSE	(1 << 1)
+#define APPSERVER_SIMD_SSE2	(1 << 2)
+#define APPSERVER_SIMD_NEON	(1 << 3)
+
+extern uint32 gSIMDFlags;
+
+// Whether the Painter may split large drawing operations into horizontal
+// bands that are rendered in parallel.
+extern bool gTiledRendering;
+
+
 // gfxset32
 // * numBytes is expected to be a multiple of 4
 static inline void
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "RemoteBitmapCache.h"
+
+#include "RemoteMessage.h"
+
+#include <new>
+
+
+struct bitmap_key {
+	uint64		hash;
+	uint32		bits_length;
+	int32		width;
+	int32		height;
+	int32		bytes_per_row;
+	color_space	space;
+};
+
+
+struct RemoteBitmapCache::Entry
+	: DoublyLinkedListLinkImpl<RemoteBitmapCache::Entry> {
+	bitmap_key	key;
+	int32		slot;
+	Entry*		hash_link;
+};
+
+
+struct RemoteBitmapCache::EntryHashDefinition {
+	typedef bitmap_key	KeyType;
+	typedef	Entry		ValueType;
+
+	size_t HashKey(const bitmap_key& key) const
+	{
+		return (size_t)(key.hash ^ (key.hash >> 32));
+	}
+
+	size_t Hash(Entry* value) const
+	{
+		return HashKey(value->key);
+	}
+
+	bool Compare(const bitmap_key& key, Entry* value) const
+	{
+		return value->key.hash == key.hash
+			&& value->key.bits_length == key.bits_length
+			&& value->key.width == key.width
+			&& value->key.height == key.height
+			&& value->key.bytes_per_row == key.bytes_per_row
+			&& value->key.space == key.space;
+	}
+
+	Entry*& GetLink(Entry* value) const
+	{
+		return value->hash_link;
+	}
+};
+
+
+RemoteBitmapCache::RemoteBitmapCache(size_t maxSize)
+	:
+	fLock("remote bitmap cache"),
+	fInitStatus(B_NO_INIT),
+	fMaxSize(maxSize),
+	fSize(0),
+	fEntries(NULL),
+	fTable(NULL)
+{
+	fEntries = new(std::nothrow) Entry[kRemoteBitmapCacheSlots];
+	fTable = new(std::nothrow) EntryTable;
+	if (fEntries == NULL || fTable == NULL) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	fInitStatus = fTable->Init(kRemoteBitmapCacheSlots);
+	if (fInitStatus != B_OK)
+		return;
+
+	for (int32 i = 0; i < kRemoteBitmapCacheSlots; i++) {
+		fEntries[i].slot = i;
+		fFreeEntries.Add(&fEntries[i]);
+	}
+}
+
+
+RemoteBitmapCache::~RemoteBitmapCache()
+{
+	delete fTable;
+	delete[] fEntries;
+}
+
+
+/*!	Forgets about all cached bitmaps, for example because the client they
+	were sent to is gone.
+*/
+void
+RemoteBitmapCache::MakeEmpty()
+{
+	while (Entry* entry = fUsedEntries.Head())
+		_Evict(entry);
+}
+
+
+/*!	Returns the cache slot of the bitmap with the given contents. If it is
+	not cached yet, a slot is reserved for it, and \a _added is set to
+	\c true; the caller then has to transfer the bitmap to the client before
+	it releases the lock of the cache.
+	Returns -1 if the bitmap is too large to be cached.
+*/
+int32
+RemoteBitmapCache::SlotFor(const void* bits, uint32 bitsLength, int32 width,
+	int32 height, int32 bytesPerRow, color_space colorSpace, bool& _added)
+{
+	_added = false;
+	if (fInitStatus != B_OK || bitsLength > fMaxSize / 4)
+		return -1;
+
+	bitmap_key key;
+	key.hash = _HashBits(bits, bitsLength);
+	key.bits_length = bitsLength;
+	key.width = width;
+	key.height = height;
+	key.bytes_per_row = bytesPerRow;
+	key.space = colorSpace;
+
+	Entry* entry = fTable->Lookup(key);
+	if (entry != NULL) {
+		// move it to the front of the LRU list
+		fUsedEntries.Remove(entry);
+		fUsedEntries.Add(entry, false);
+		return entry->slot;
+	}
+
+	while (fFreeEntries.IsEmpty() || fSize + bitsLength > fMaxSize)
+		_Evict(fUsedEntries.Tail());
+
+	entry = fFreeEntries.RemoveHead();
+	entry->key = key;
+	fTable->Insert(entry);
+	fUsedEntries.Add(entry, false);
+	fSize += bitsLength;
+
+	_added = true;
+	return entry->slot;
+}
+
+
+void
+RemoteBitmapCache::_Evict(Entry* entry)
+{
+	fTable->Remove(entry);
+	fUsedEntries.Remove(entry);
+	fFreeEntries.Add(entry);
+	fSize -= entry->key.bits_length;
+}
+
+
+/*!	A 64 bit FNV-1a variant that processes the data a word at a time.
+*/
+/*static*/ uint64
+RemoteBitmapCache::_HashBits(const void* bits, uint32 length)
+{
+	uint64 hash = 0xcbf29ce484222325ULL;
+
+	const uint32* words = (const uint32*)bits;
+	for (uint32 i = 0; i < length / sizeof(uint32); i++)
+		hash = (hash ^ words[i]) * 0x100000001b3ULL;
+
+	const uint8* bytes = (const uint8*)bits;
+	for (uint32 i = length & ~(sizeof(uint32) - 1); i < length; i++)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+#ifndef REMOTE_BITMAP_CACHE_H
+#define REMOTE_BITMAP_CACHE_H
+
+#include <GraphicsDefs.h>
+#include <Locker.h>
+
+#include <util/DoublyLinkedList.h>
+#include <util/OpenHashTable.h>
+
+
+/*!	Keeps track of the bitmaps that the client of a remote connection holds
+	in its bitmap cache, so that bitmaps that were already transferred can be
+	referenced by their slot instead of being sent again.
+	Bitmaps are identified by a hash of their contents, which are only sent
+	when they are not in the cache yet. The least recently used bitmaps are
+	evicted when all slots are in use, or the cached data would exceed the
+	size limit.
+*/
+class RemoteBitmapCache {
+public:
+								RemoteBitmapCache(size_t maxSize);
+								~RemoteBitmapCache();
+
+		status_t				InitCheck() const { return fInitStatus; }
+
+		bool					Lock() { return fLock.Lock(); }
+		void					Unlock() { fLock.Unlock(); }
+
+		void					MakeEmpty();
+
+		int32					SlotFor(const void* bits, uint32 bitsLength,
+									int32 width, int32 height,
+									int32 bytesPerRow, color_space colorSpace,
+									bool& _added);
+
+private:
+		struct Entry;
+		struct EntryHashDefinition;
+
+		typedef DoublyLinkedList<Entry> EntryList;
+		typedef BOpenHashTable<EntryHashDefinition> EntryTable;
+
+		void					_Evict(Entry* entry);
+
+static	uint64					_HashBits(const void* bits, uint32 length);
+
+		BLocker					fLock;
+		status_t				fInitStatus;
+		size_t					fMaxSize;
+		size_t					fSize;
+
+		Entry*					fEntries;
+		EntryTable*				fTable;
+		EntryList				fUsedEntries;
+									// least recently used last
+		EntryList				fFreeEntries;
+};
+
+
+#endif // REMOTE_BITMAP_CACHE_H
@@ -7,12 +7,14 @@
  */
 
 #include "RemoteDrawingEngine.h"
+#include "RemoteBitmapCache.h"
 #include "RemoteMessage.h"
 
 #include "BitmapDrawingEngine.h"
 #include "DrawState.h"
 #include "ServerTokenSpace.h"
 
+#include <AutoLocker.h>
 #include <Bitmap.h>
 #include <utf8_functions.h>
 
@@ -362,25 +364,44 @@ RemoteDrawingEngine::DrawBitmap(ServerBitmap* bitmap, const BRect& _bitmapRect,
 			return;
 		}
 
-		RemoteMessage message(NULL, fHWInterface->SendBuffer());
-		message.Start(RP_DRAW_BITMAP_RECTS);
-		message.Add(fToken);
-		message.Add(options);
-		message.Add(bitmap->ColorSpace());
-		message.Add(bitmap->Flags());
-		message.Add(rectCount);
-
+		// the parts are cached on their own, as the same parts tend to be
+		// drawn again when a partially covered view is updated
+		int32 uncachedCount = 0;
 		for (int32 i = 0; i < rectCount; i++) {
-			message.Add(clippedRegion.RectAt(i));
-			message.AddBitmap(*bitmaps[i], true);
-			delete bitmaps[i];
+			if (_DrawCachedBitmap(*bitmaps[i], bitmaps[i]->Bounds(),
+					clippedRegion.RectAt(i), options)) {
+				delete bitmaps[i];
+				bitmaps[i] = NULL;
+			} else
+				uncachedCount++;
+		}
+
+		if (uncachedCount > 0) {
+			RemoteMessage message(NULL, fHWInterface->SendBuffer());
+			message.Start(RP_DRAW_BITMAP_RECTS);
+			message.Add(fToken);
+			message.Add(options);
+			message.Add(bitmap->ColorSpace());
+			message.Add(bitmap->Flags());
+			message.Add(uncachedCount);
+
+			for (int32 i = 0; i < rectCount; i++) {
+				if (bitmaps[i] == NULL)
+					continue;
+
+				message.Add(clippedRegion.RectAt(i));
+				message.AddBitmap(*bitmaps[i], true);
+				delete bitmaps[i];
+			}
 		}
 
 		free(bitmaps);
 		return;
 	}
 
-	// TODO: we may want to cache/checksum bitmaps
+	if (_DrawCachedBitmap(*bitmap, bitmapRect, viewRect, options))
+		return;
+
 	RemoteMessage message(NULL, fHWInterface->SendBuffer());
 	message.Start(RP_DRAW_BITMAP);
 	message.Add(fToken);
@@ -1069,6 +1090,49 @@ RemoteDrawingEngine::_BuildBounds(BPoint* points, int32 pointCount)
 }
 
 
+/*!	Draws the \a bitmap from the bitmap cache of the client, and transfers it
+	there first if it is not cached yet. Returns \c false if the client does
+	not have a bitmap cache, or if the bitmap cannot be cached.
+*/
+bool
+RemoteDrawingEngine::_DrawCachedBitmap(const ServerBitmap& bitmap,
+	const BRect& bitmapRect, const BRect& viewRect, uint32 options)
+{
+	// The messages are sent with the cache locked, so that they cannot be
+	// reordered with those of other engines that use the same slot.
+	RemoteBitmapCache* cache = fHWInterface->BitmapCache();
+	AutoLocker<RemoteBitmapCache> cacheLocker(cache);
+
+	uint32 capabilities = fHWInterface->Capabilities();
+	if ((capabilities & RP_CAPABILITY_BITMAP_CACHE) == 0)
+		return false;
+
+	bool added;
+	int32 slot = cache->SlotFor(bitmap.Bits(), bitmap.BitsLength(),
+		bitmap.Width(), bitmap.Height(), bitmap.BytesPerRow(),
+		bitmap.ColorSpace(), added);
+	if (slot < 0)
+		return false;
+
+	RemoteMessage message(NULL, fHWInterface->SendBuffer());
+	if (added) {
+		message.Start(RP_CACHE_BITMAP);
+		message.Add(slot);
+		message.AddEncodedBitmap(bitmap,
+			(capabilities & RP_CAPABILITY_ZSTD_COMPRESSION) != 0);
+	}
+
+	message.Start(RP_DRAW_CACHED_BITMAP);
+	message.Add(fToken);
+	message.Add(bitmapRect);
+	message.Add(viewRect);
+	message.Add(options);
+	message.Add(slot);
+	message.Flush();
+	return true;
+}
+
+
 status_t
 RemoteDrawingEngine::_ExtractBitmapRegions(ServerBitmap& bitmap, uint32 options,
 	const BRect& bitmapRect, const BRect& viewRect, double xScale,
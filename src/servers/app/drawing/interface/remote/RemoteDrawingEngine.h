@@ -158,6 +158,9 @@ private:
 									RemoteMessage& message);
 
 			BRect				_BuildBounds(BPoint* points, int32 pointCount);
+			bool				_DrawCachedBitmap(const ServerBitmap& bitmap,
+									const BRect& bitmapRect,
+									const BRect& viewRect, uint32 options);
 			status_t			_ExtractBitmapRegions(ServerBitmap& bitmap,
 									uint32 options, const BRect& bitmapRect,
 									const BRect& viewRect, double xScale,
@@ -7,6 +7,7 @@
  */
 
 #include "RemoteHWInterface.h"
+#include "RemoteBitmapCache.h"
 #include "RemoteDrawingEngine.h"
 #include "RemoteEventStream.h"
 #include "RemoteMessage.h"
@@ -18,6 +19,7 @@
 #include "SystemPalette.h"
 
 #include <Autolock.h>
+#include <AutoLocker.h>
 #include <NetEndpoint.h>
 
 #include <new>
@@ -29,6 +31,10 @@
 #define TRACE_ERROR(x...)		debug_printf("RemoteHWInterface: " x)
 
 
+// upper limit of the bitmap data a client is asked to keep in its cache
+static const size_t kBitmapCacheSize = 64 * 1024 * 1024;
+
+
 struct callback_info {
 	uint32				token;
 	RemoteHWInterface::CallbackFunction	callback;
@@ -43,12 +49,14 @@ RemoteHWInterface::RemoteHWInterface(const char* target)
 	fIsConnected(false),
 	fProtocolVersion(100),
 	fConnectionSpeed(0),
+	fCapabilities(0),
 	fListenPort(10901),
 	fListenEndpoint(NULL),
 	fSendBuffer(NULL),
 	fReceiveBuffer(NULL),
 	fSender(NULL),
 	fReceiver(NULL),
+	fBitmapCache(NULL),
 	fEventThread(-1),
 	fEventStream(NULL),
 	fCallbackLocker("callback locker")
@@ -96,6 +104,16 @@ RemoteHWInterface::RemoteHWInterface(const char* target)
 	if (fInitStatus != B_OK)
 		return;
 
+	fBitmapCache.SetTo(new(std::nothrow) RemoteBitmapCache(kBitmapCacheSize));
+	if (!fBitmapCache.IsSet()) {
+		fInitStatus = B_NO_MEMORY;
+		return;
+	}
+
+	fInitStatus = fBitmapCache->InitCheck();
+	if (fInitStatus != B_OK)
+		return;
+
 	fReceiver.SetTo(new(std::nothrow) NetReceiver(fListenEndpoint.Get(), fReceiveBuffer.Get(),
 		_NewConnectionCallback, this));
 	if (!fReceiver.IsSet()) {
@@ -253,11 +271,26 @@ RemoteHWInterface::_EventThread()
 		switch (code) {
 			case RP_INIT_CONNECTION:
 			{
+				// Newer clients send the capabilities they support, we reply
+				// with the ones that will be used. Older ones don't know
+				// about any of them, and get the plain protocol.
+				bool negotiate = message.DataLeft() >= sizeof(uint32);
+				uint32 capabilities = 0;
+				if (negotiate && message.Read(capabilities) == B_OK)
+					capabilities &= RemoteMessage::SupportedCapabilities();
+
 				RemoteMessage reply(NULL, fSendBuffer.Get());
 				reply.Start(RP_INIT_CONNECTION);
+				if (negotiate)
+					reply.Add(capabilities);
 				status_t result = reply.Flush();
 				(void)result;
-				TRACE("init connection result: %s\n", strerror(result));
+				TRACE("init connection result: %s, capabilities %#" B_PRIx32
+					"\n", strerror(result), capabilities);
+
+				AutoLocker<RemoteBitmapCache> cacheLocker(fBitmapCache.Get());
+				fBitmapCache->MakeEmpty();
+				fCapabilities = capabilities;
 				break;
 			}
 
@@ -328,7 +361,14 @@ RemoteHWInterface::_NewConnection(BNetEndpoint &endpoint)
 {
 	fSender.Unset();
 
+	// the new client does not have any of the cached bitmaps, and has yet
+	// to negotiate its capabilities
+	AutoLocker<RemoteBitmapCache> cacheLocker(fBitmapCache.Get());
+	fCapabilities = 0;
+	fBitmapCache->MakeEmpty();
+
 	fSendBuffer->MakeEmpty();
+	cacheLocker.Unlock();
 
 	BNetEndpoint *sendEndpoint = new(std::nothrow) BNetEndpoint(endpoint);
 	if (sendEndpoint == NULL)
@@ -18,6 +18,7 @@ class BNetEndpoint;
 class StreamingRingBuffer;
 class NetSender;
 class NetReceiver;
+class RemoteBitmapCache;
 class RemoteEventStream;
 class RemoteMessage;
 
@@ -85,6 +86,11 @@ virtual	status_t					CopyBackToFront(const BRect& frame);
 										{ return fReceiveBuffer.Get(); }
 		StreamingRingBuffer*		SendBuffer() { return fSendBuffer.Get(); }
 
+		uint32						Capabilities() const
+										{ return fCapabilities; }
+		RemoteBitmapCache*			BitmapCache()
+										{ return fBitmapCache.Get(); }
+
 typedef bool (*CallbackFunction)(void* cookie, RemoteMessage& message);
 
 		status_t					AddCallback(uint32 token,
@@ -113,6 +119,7 @@ static	status_t					_NewConnectionCallback(void *cookie,
 		bool						fIsConnected;
 		uint32						fProtocolVersion;
 		uint32						fConnectionSpeed;
+		uint32						fCapabilities;
 		display_mode				fFallbackMode;
 		display_mode				fCurrentMode;
 		display_mode				fClientMode;
@@ -127,6 +134,9 @@ static	status_t					_NewConnectionCallback(void *cookie,
 		ObjectDeleter<NetSender>	fSender;
 		ObjectDeleter<NetReceiver>	fReceiver;
 
+		ObjectDeleter<RemoteBitmapCache>
+									fBitmapCache;
+
 		thread_id					fEventThread;
 		ObjectDeleter<RemoteEventStream>
 									fEventStream;
@@ -1,5 +1,5 @@
 /*
- * Copyright 2009-2019, Haiku, Inc.
+ * Copyright 2009-2026, Haiku, Inc.
  * Distributed under the terms of the MIT License.
  *
  * Authors:
@@ -25,6 +25,9 @@
 #include <GradientDiamond.h>
 #include <GradientConic.h>
 
+#include <AutoDeleter.h>
+#include <ZstdCompressionAlgorithm.h>
+
 #include <new>
 
 
@@ -38,6 +41,10 @@
 #define TRACE_ERROR(x...)		TRACE_ALWAYS(x)
 
 
+// bits shorter than this are not worth compressing
+static const uint32 kMinCompressLength = 256;
+
+
 status_t
 RemoteMessage::NextMessage(uint16& code)
 {
@@ -86,6 +93,35 @@ RemoteMessage::Cancel()
 }
 
 
+/*!	Returns the RP_CAPABILITY_* flags this side of the connection supports.
+	Compression is only offered if it actually works, as zstd support is
+	optional in the build.
+*/
+/*static*/ uint32
+RemoteMessage::SupportedCapabilities()
+{
+	uint32 capabilities = RP_CAPABILITY_BITMAP_CACHE;
+
+	uint8 data[kMinCompressLength];
+	uint8 compressed[kMinCompressLength];
+	memset(data, 0, sizeof(data));
+
+	BZstdCompressionAlgorithm algorithm;
+	iovec input = { data, sizeof(data) };
+	iovec output = { compressed, sizeof(compressed) };
+	if (algorithm.CompressBuffer(input, output) == B_OK) {
+		iovec encoded = { compressed, output.iov_len };
+		iovec decoded = { data, sizeof(data) };
+		if (algorithm.DecompressBuffer(encoded, decoded) == B_OK
+			&& decoded.iov_len == sizeof(data)) {
+			capabilities |= RP_CAPABILITY_ZSTD_COMPRESSION;
+		}
+	}
+
+	return capabilities;
+}
+
+
 #ifndef CLIENT_COMPILE
 void
 RemoteMessage::AddBitmap(const ServerBitmap& bitmap, bool minimal)
@@ -167,6 +203,23 @@ RemoteMessage::AddPattern(const Pattern& pattern)
 	Add(pattern.GetPattern());
 }
 
+
+/*!	Like AddBitmap(), but the bits are written with AddEncodedBits().
+*/
+void
+RemoteMessage::AddEncodedBitmap(const ServerBitmap& bitmap, bool compress)
+{
+	Add(bitmap.Width());
+	Add(bitmap.Height());
+	Add(bitmap.BytesPerRow());
+	Add(bitmap.ColorSpace());
+	Add(bitmap.Flags());
+
+	uint32 bitsLength = bitmap.BitsLength();
+	Add(bitsLength);
+	AddEncodedBits(bitmap.Bits(), bitsLength, compress);
+}
+
 #else // !CLIENT_COMPILE
 
 void
@@ -192,6 +245,42 @@ RemoteMessage::AddBitmap(const BBitmap& bitmap)
 #endif // !CLIENT_COMPILE
 
 
+/*!	Adds \a length bytes of \a bits, preceded by their encoded length. If
+	\a compress is \c true, the bits are compressed with zstd, unless that
+	does not make them any smaller; an encoded length of 0 means the bits
+	follow uncompressed.
+*/
+void
+RemoteMessage::AddEncodedBits(const void* bits, uint32 length, bool compress)
+{
+	if (!_MakeSpace(sizeof(uint32) + length))
+		return;
+
+	uint32 encodedLength = 0;
+	if (compress && length >= kMinCompressLength) {
+		// compress right behind the length field, the output must not
+		// exceed the space the raw bits would need
+		iovec input = { (void*)bits, length };
+		iovec output = { fBuffer + fWriteIndex + sizeof(uint32), length - 1 };
+		BZstdCompressionParameters parameters(B_ZSTD_COMPRESSION_FASTEST);
+		if (BZstdCompressionAlgorithm().CompressBuffer(input, output,
+				&parameters) == B_OK) {
+			encodedLength = output.iov_len;
+		}
+	}
+
+	Add(encodedLength);
+
+	if (encodedLength == 0) {
+		memcpy(fBuffer + fWriteIndex, bits, length);
+		encodedLength = length;
+	}
+
+	fWriteIndex += encodedLength;
+	fAvailable -= encodedLength;
+}
+
+
 void
 RemoteMessage::AddGradient(const BGradient& gradient)
 {
@@ -333,52 +422,51 @@ status_t
 RemoteMessage::ReadBitmap(BBitmap** _bitmap, bool minimal,
 	color_space colorSpace, uint32 flags)
 {
-	uint32 bitsLength;
-	int32 width, height, bytesPerRow;
+	return _ReadBitmap(_bitmap, minimal, colorSpace, flags, false);
+}
 
-	Read(width);
-	Read(height);
-	Read(bytesPerRow);
 
-	if (!minimal) {
-		Read(colorSpace);
-		Read(flags);
-	}
+//!	Reads a bitmap that was added with AddEncodedBitmap().
+status_t
+RemoteMessage::ReadEncodedBitmap(BBitmap** _bitmap)
+{
+	return _ReadBitmap(_bitmap, false, B_RGB32, 0, true);
+}
 
-	Read(bitsLength);
 
-	if (bitsLength > fDataLeft)
-		return B_ERROR;
+//!	Reads \a length bytes that were added with AddEncodedBits() into \a bits.
+status_t
+RemoteMessage::ReadEncodedBits(void* bits, uint32 length)
+{
+	uint32 encodedLength;
+	status_t result = Read(encodedLength);
+	if (result != B_OK)
+		return result;
 
-#ifndef CLIENT_COMPILE
-	flags = B_BITMAP_NO_SERVER_LINK;
-#endif
+	if (encodedLength == 0)
+		return _ReadData(bits, length);
 
-	BBitmap *bitmap = new(std::nothrow) BBitmap(
-		BRect(0, 0, width - 1, height - 1), flags, colorSpace, bytesPerRow);
-	if (bitmap == NULL)
+	if (encodedLength > fDataLeft)
+		return B_ERROR;
+
+	void* encoded = malloc(encodedLength);
+	if (encoded == NULL)
 		return B_NO_MEMORY;
 
-	status_t result = bitmap->InitCheck();
-	if (result != B_OK) {
-		delete bitmap;
+	MemoryDeleter encodedDeleter(encoded);
+	result = _ReadData(encoded, encodedLength);
+	if (result != B_OK)
 		return result;
-	}
-
-	if (bitmap->BitsLength() < (int32)bitsLength) {
-		delete bitmap;
-		return B_ERROR;
-	}
 
-	int32 readSize = fSource->Read(bitmap->Bits(), bitsLength);
-	if ((uint32)readSize != bitsLength) {
-		delete bitmap;
-		return readSize < 0 ? readSize : B_ERROR;
+	iovec input = { encoded, encodedLength };
+	iovec output = { bits, length };
+	result = BZstdCompressionAlgorithm().DecompressBuffer(input, output);
+	if (result != B_OK) {
+		TRACE_ERROR("failed to decompress bits: %s\n", strerror(result));
+		return result;
 	}
 
-	fDataLeft -= readSize;
-	*_bitmap = bitmap;
-	return B_OK;
+	return output.iov_len == length ? B_OK : B_BAD_DATA;
 }
 
 
@@ -586,3 +674,74 @@ RemoteMessage::ReadArrayLine(BPoint& startPoint, BPoint& endPoint,
 	Read(endPoint);
 	return Read(color);
 }
+
+
+status_t
+RemoteMessage::_ReadBitmap(BBitmap** _bitmap, bool minimal,
+	color_space colorSpace, uint32 flags, bool encoded)
+{
+	uint32 bitsLength;
+	int32 width, height, bytesPerRow;
+
+	Read(width);
+	Read(height);
+	Read(bytesPerRow);
+
+	if (!minimal) {
+		Read(colorSpace);
+		Read(flags);
+	}
+
+	Read(bitsLength);
+
+	if (!encoded && bitsLength > fDataLeft)
+		return B_ERROR;
+
+#ifndef CLIENT_COMPILE
+	flags = B_BITMAP_NO_SERVER_LINK;
+#endif
+
+	BBitmap *bitmap = new(std::nothrow) BBitmap(
+		BRect(0, 0, width - 1, height - 1), flags, colorSpace, bytesPerRow);
+	if (bitmap == NULL)
+		return B_NO_MEMORY;
+
+	status_t result = bitmap->InitCheck();
+	if (result != B_OK) {
+		delete bitmap;
+		return result;
+	}
+
+	if (bitmap->BitsLength() < (int32)bitsLength) {
+		delete bitmap;
+		return B_ERROR;
+	}
+
+	if (encoded)
+		result = ReadEncodedBits(bitmap->Bits(), bitsLength);
+	else
+		result = _ReadData(bitmap->Bits(), bitsLength);
+
+	if (result != B_OK) {
+		delete bitmap;
+		return result;
+	}
+
+	*_bitmap = bitmap;
+	return B_OK;
+}
+
+
+status_t
+RemoteMessage::_ReadData(void* data, uint32 length)
+{
+	if (length > fDataLeft)
+		return B_ERROR;
+
+	int32 readSize = fSource->Read(data, length);
+	if ((uint32)readSize != length)
+		return readSize < 0 ? readSize : B_ERROR;
+
+	fDataLeft -= readSize;
+	return B_OK;
+}
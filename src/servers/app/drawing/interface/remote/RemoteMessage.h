@@ -65,6 +65,8 @@ enum {
 	RP_INVERT_RECT,
 	RP_DRAW_BITMAP,
 	RP_DRAW_BITMAP_RECTS,
+	RP_CACHE_BITMAP,
+	RP_DRAW_CACHED_BITMAP,
 
 	RP_STROKE_ARC = 80,
 	RP_STROKE_BEZIER,
@@ -129,6 +131,17 @@ enum {
 };
 
 
+// capabilities that are negotiated with RP_INIT_CONNECTION
+enum {
+	RP_CAPABILITY_BITMAP_CACHE			= 0x01,
+	RP_CAPABILITY_ZSTD_COMPRESSION		= 0x02
+};
+
+
+// number of bitmaps a client with RP_CAPABILITY_BITMAP_CACHE has to keep
+static const int32 kRemoteBitmapCacheSlots = 1024;
+
+
 class RemoteMessage {
 public:
 								RemoteMessage(StreamingRingBuffer* source,
@@ -143,6 +156,8 @@ public:
 		uint16					Code() { return fCode; }
 		uint32					DataLeft() { return fDataLeft; }
 
+static	uint32					SupportedCapabilities();
+
 		template<typename T>
 		void					Add(const T& value);
 
@@ -159,10 +174,15 @@ public:
 		void					AddDrawState(const DrawState& drawState);
 		void					AddArrayLine(const ViewLineArrayInfo& line);
 		void					AddCursor(const ServerCursor& cursor);
+		void					AddEncodedBitmap(const ServerBitmap& bitmap,
+									bool compress);
 #else
 		void					AddBitmap(const BBitmap& bitmap);
 #endif
 
+		void					AddEncodedBits(const void* bits,
+									uint32 length, bool compress);
+
 		template<typename T>
 		void					AddList(const T* array, int32 count);
 
@@ -180,6 +200,8 @@ public:
 									bool minimal = false,
 									color_space colorSpace = B_RGB32,
 									uint32 flags = 0);
+		status_t				ReadEncodedBitmap(BBitmap** _bitmap);
+		status_t				ReadEncodedBits(void* bits, uint32 length);
 		status_t				ReadGradient(BGradient** _gradient);
 		status_t				ReadTransform(BAffineTransform& transform);
 		status_t				ReadArrayLine(BPoint& startPoint,
@@ -191,6 +213,11 @@ public:
 private:
 		bool					_MakeSpace(size_t size);
 
+		status_t				_ReadBitmap(BBitmap** _bitmap, bool minimal,
+									color_space colorSpace, uint32 flags,
+									bool encoded);
+		status_t				_ReadData(void* data, uint32 length);
+
 		StreamingRingBuffer*	fSource;
 		StreamingRingBuffer*	fTarget;
 
@@ -21,6 +21,10 @@
 using std::nothrow;
 
 
+// the glyphs and glyph atlases of all entries should fit in here
+static const int64 kMaxMemoryUsage = 16 * 1024 * 1024;
+
+
 FontCache
 FontCache::sDefaultInstance;
 
@@ -102,6 +106,15 @@ FontCache::Recycle(FontCacheEntry* entry)
 	if (!entry)
 		return;
 	entry->UpdateUsage();
+
+	// Evicting the other entries doesn't help if this one alone is too large
+	if (FontCacheEntry::TotalMemoryUsage() > kMaxMemoryUsage
+		&& entry->MemoryUsage() <= kMaxMemoryUsage) {
+		AutoWriteLocker locker(this);
+		if (locker.IsLocked())
+			_ConstrainMemoryUsage(entry);
+	}
+
 	entry->ReleaseReference();
 }
 
@@ -153,3 +166,43 @@ FontCache::_ConstrainEntryCount()
 		}
 	}
 }
+
+// _ConstrainMemoryUsage
+void
+FontCache::_ConstrainMemoryUsage(FontCacheEntry* keepEntry)
+{
+	// this function is only ever called with the WriteLock held
+
+	// Entries that are still in use somewhere will only release their
+	// memory later, so this only looks at the entries that are left.
+	int64 memoryUsage = 0;
+	FontMap::Iterator iterator = fFontCacheEntries.GetIterator();
+	while (iterator.HasNext())
+		memoryUsage += iterator.Next().value->MemoryUsage();
+
+	// drop the least recently used entries, but keep the one that was
+	// just used, even if it exceeds the limit on its own
+	while (memoryUsage > kMaxMemoryUsage) {
+		FontCacheEntry* leastRecentlyUsed = NULL;
+		iterator = fFontCacheEntries.GetIterator();
+		while (iterator.HasNext()) {
+			FontCacheEntry* entry = iterator.Next().value;
+			if (entry != keepEntry && (leastRecentlyUsed == NULL
+					|| entry->LastUsed() < leastRecentlyUsed->LastUsed())) {
+				leastRecentlyUsed = entry;
+			}
+		}
+		if (leastRecentlyUsed == NULL)
+			break;
+
+		memoryUsage -= leastRecentlyUsed->MemoryUsage();
+
+		iterator = fFontCacheEntries.GetIterator();
+		while (iterator.HasNext()) {
+			if (iterator.Next().value.Get() == leastRecentlyUsed) {
+				fFontCacheEntries.Remove(iterator);
+				break;
+			}
+		}
+	}
+}
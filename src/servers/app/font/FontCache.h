@@ -30,6 +30,8 @@ class FontCache : public MultiLocker {
 
  private:
 			void				_ConstrainEntryCount();
+			void				_ConstrainMemoryUsage(
+									FontCacheEntry* keepEntry);
 
 	static	FontCache			sDefaultInstance;
 
@@ -40,6 +40,11 @@
 
 
 BLocker FontCacheEntry::sUsageUpdateLock("FontCacheEntry usage lock");
+int64 FontCacheEntry::sTotalMemoryUsage = 0;
+
+static const size_t kGlyphAtlasPageSize = 16 * 1024;
+static const size_t kMaxGlyphMaskSize = kGlyphAtlasPageSize / 4;
+	// larger glyphs are rare enough to be drawn from their scanlines
 
 
 class FontCacheEntry::GlyphCachePool {
@@ -126,6 +131,73 @@ private:
 };
 
 
+/*!	Holds the pre-rendered coverage masks of the glyphs of a FontCacheEntry,
+	packed into larger pages. Masks are never freed individually, but only
+	together with the whole atlas, when the FontCache drops the entry.
+*/
+class FontCacheEntry::GlyphAtlas {
+	struct Page {
+		Page*	next;
+		size_t	size;
+		size_t	used;
+
+		uint8* Data()
+		{
+			return (uint8*)(this + 1);
+		}
+	};
+
+public:
+	GlyphAtlas()
+		:
+		fPages(NULL),
+		fSize(0)
+	{
+	}
+
+	~GlyphAtlas()
+	{
+		while (fPages != NULL) {
+			Page* next = fPages->next;
+			free(fPages);
+			fPages = next;
+		}
+	}
+
+	uint8* Allocate(size_t size)
+	{
+		// keep the masks 4 byte aligned
+		size = (size + 3) & ~(size_t)3;
+
+		if (fPages == NULL || fPages->size - fPages->used < size) {
+			size_t pageSize = max_c(size, kGlyphAtlasPageSize);
+			Page* page = (Page*)malloc(sizeof(Page) + pageSize);
+			if (page == NULL)
+				return NULL;
+
+			page->next = fPages;
+			page->size = pageSize;
+			page->used = 0;
+			fPages = page;
+			fSize += sizeof(Page) + pageSize;
+		}
+
+		uint8* data = fPages->Data() + fPages->used;
+		fPages->used += size;
+		return data;
+	}
+
+	size_t Size() const
+	{
+		return fSize;
+	}
+
+private:
+	Page*		fPages;
+	size_t		fSize;
+};
+
+
 // #pragma mark -
 
 
@@ -133,9 +205,11 @@ FontCacheEntry::FontCacheEntry()
 	:
 	MultiLocker("FontCacheEntry lock"),
 	fGlyphCache(new(std::nothrow) GlyphCachePool()),
+	fGlyphAtlas(new(std::nothrow) GlyphAtlas()),
 	fEngine(),
 	fLastUsedTime(LONGLONG_MIN),
-	fUseCounter(0)
+	fUseCounter(0),
+	fMemoryUsage(0)
 {
 }
 
@@ -143,13 +217,14 @@ FontCacheEntry::FontCacheEntry()
 FontCacheEntry::~FontCacheEntry()
 {
 //printf("~FontCacheEntry()\n");
+	atomic_add64(&sTotalMemoryUsage, -fMemoryUsage);
 }
 
 
 bool
 FontCacheEntry::Init(const ServerFont& font, bool forceVector)
 {
-	if (!fGlyphCache.IsSet())
+	if (!fGlyphCache.IsSet() || !fGlyphAtlas.IsSet())
 		return false;
 
 	glyph_rendering renderingType = _RenderTypeFor(font, forceVector);
@@ -334,14 +409,18 @@ FontCacheEntry::CreateGlyph(uint32 glyphCode, FontCacheEntry* fallbackEntry)
 	}
 
 	if (engine->PrepareGlyph(glyphIndex)) {
-		glyph = fGlyphCache->CacheGlyph(glyphCode,
+		GlyphCache* newGlyph = fGlyphCache->CacheGlyph(glyphCode,
 			engine->DataSize(), engine->DataType(), engine->Bounds(),
 			engine->AdvanceX(), engine->AdvanceY(),
 			engine->PreciseAdvanceX(), engine->PreciseAdvanceY(),
 			engine->InsetLeft(), engine->InsetRight());
 
-		if (glyph != NULL)
-			engine->WriteGlyphTo(glyph->data);
+		if (newGlyph != NULL) {
+			engine->WriteGlyphTo(newGlyph->data);
+			_AddMemoryUsage(sizeof(GlyphCache) + newGlyph->data_size);
+			_CreateGlyphMask(newGlyph);
+		}
+		glyph = newGlyph;
 	}
 
 	return glyph;
@@ -420,6 +499,80 @@ FontCacheEntry::UpdateUsage()
 }
 
 
+/*!	Renders the scanlines of an anti-aliased \a glyph into a coverage mask
+	in the glyph atlas, so that drawing it boils down to blending the mask.
+	If the glyph is too large, or there is not enough memory, it is left
+	without a mask, and will be drawn from its scanlines instead.
+*/
+void
+FontCacheEntry::_CreateGlyphMask(GlyphCache* glyph)
+{
+	int32 bytesPerPixel;
+	switch (glyph->data_type) {
+		case glyph_data_gray8:
+			bytesPerPixel = 1;
+			break;
+		case glyph_data_subpix:
+			bytesPerPixel = 3;
+			break;
+		default:
+			return;
+	}
+
+	const agg::rect_i& bounds = glyph->bounds;
+	if (bounds.x1 > bounds.x2 || bounds.y1 > bounds.y2)
+		return;
+
+	int32 bytesPerRow = (bounds.x2 - bounds.x1 + 1) * bytesPerPixel;
+	size_t size = bytesPerRow * (bounds.y2 - bounds.y1 + 1);
+	if (size > kMaxGlyphMaskSize)
+		return;
+
+	size_t atlasSize = fGlyphAtlas->Size();
+	uint8* mask = fGlyphAtlas->Allocate(size);
+	if (mask == NULL)
+		return;
+
+	_AddMemoryUsage(fGlyphAtlas->Size() - atlasSize);
+	memset(mask, 0, size);
+
+	// The subpixel glyphs are stored like gray8 ones, just with three covers
+	// per pixel, and are rendered with the same adapter.
+	GlyphGray8Adapter adapter;
+	GlyphGray8Scanline scanline;
+	adapter.init(glyph->data, glyph->data_size, 0, 0);
+	if (adapter.rewind_scanlines()) {
+		while (adapter.sweep_scanline(scanline)) {
+			uint8* row = mask + (scanline.y() - bounds.y1) * bytesPerRow;
+			GlyphGray8Scanline::const_iterator span = scanline.begin();
+			unsigned count = scanline.num_spans();
+			while (true) {
+				uint8* covers = row + (span->x - bounds.x1) * bytesPerPixel;
+				if (span->len < 0)
+					memset(covers, *span->covers, -span->len);
+				else
+					memcpy(covers, span->covers, span->len);
+
+				// the iterator reads the next span right away
+				if (--count == 0)
+					break;
+				++span;
+			}
+		}
+	}
+
+	glyph->mask = mask;
+}
+
+
+void
+FontCacheEntry::_AddMemoryUsage(int64 size)
+{
+	atomic_add64(&fMemoryUsage, size);
+	atomic_add64(&sTotalMemoryUsage, size);
+}
+
+
 /*static*/ glyph_rendering
 FontCacheEntry::_RenderTypeFor(const ServerFont& font, bool forceVector)
 {
@@ -58,6 +58,7 @@ struct GlyphCache {
 		precise_advance_y(preciseAdvanceY),
 		inset_left(insetLeft),
 		inset_right(insetRight),
+		mask(NULL),
 		hash_link(NULL)
 	{
 	}
@@ -79,6 +80,10 @@ struct GlyphCache {
 	float			inset_left;
 	float			inset_right;
 
+	const uint8*	mask;
+		// coverage of the bounds, 3 bytes per pixel for glyph_data_subpix,
+		// points into the glyph atlas of the FontCacheEntry, may be NULL
+
 	GlyphCache*		hash_link;
 };
 
@@ -135,6 +140,12 @@ class FontCacheEntry : public MultiLocker, public BReferenceable {
 									{ return fLastUsedTime; }
 			uint64				UsedCount() const
 									{ return fUseCounter; }
+			int64				MemoryUsage() const
+									{ return atomic_get64(
+										(int64*)&fMemoryUsage); }
+	static	int64				TotalMemoryUsage()
+									{ return atomic_get64(
+										&sTotalMemoryUsage); }
 
  private:
 								FontCacheEntry(const FontCacheEntry&);
@@ -143,15 +154,24 @@ class FontCacheEntry : public MultiLocker, public BReferenceable {
 	static	glyph_rendering		_RenderTypeFor(const ServerFont& font,
 									bool forceVector);
 
+			void				_CreateGlyphMask(GlyphCache* glyph);
+			void				_AddMemoryUsage(int64 size);
+
 			class GlyphCachePool;
+			class GlyphAtlas;
 
 			ObjectDeleter<GlyphCachePool>
 								fGlyphCache;
+			ObjectDeleter<GlyphAtlas>
+								fGlyphAtlas;
 			FontEngine			fEngine;
 
 	static	BLocker				sUsageUpdateLock;
 			bigtime_t			fLastUsedTime;
 			uint64				fUseCounter;
+
+			int64				fMemoryUsage;
+	static	int64				sTotalMemoryUsage;
 };
 
 #endif // FONT_CACHE_ENTRY_H
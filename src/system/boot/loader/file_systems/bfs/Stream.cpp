@@ -164,6 +164,39 @@ Stream::GetNextSmallData(const small_data** _smallData) const
 }
 
 
+/*!	Small files may keep their data in the small_data section, which is not
+	loaded with the inode (see above), so the inode block is read again here.
+*/
+status_t
+Stream::ReadInlineData(off_t pos, uint8* buffer, size_t* _length)
+{
+	CachedBlock cached(fVolume);
+	const bfs_inode* node = (const bfs_inode*)cached.SetTo(inode_num);
+	if (node == NULL) {
+		*_length = 0;
+		return B_IO_ERROR;
+	}
+
+	const small_data* smallData = node->small_data_start;
+	for (; !smallData->IsLast(node); smallData = smallData->Next()) {
+		if (*smallData->Name() != INLINE_DATA_NAME
+			|| smallData->NameSize() != INLINE_DATA_NAME_LENGTH)
+			continue;
+
+		size_t length = 0;
+		if (pos < smallData->DataSize())
+			length = min_c(*_length, smallData->DataSize() - pos);
+
+		memcpy(buffer, smallData->Data() + pos, length);
+		*_length = length;
+		return B_OK;
+	}
+
+	*_length = 0;
+	return B_BAD_DATA;
+}
+
+
 status_t
 Stream::GetName(char* name, size_t size) const
 {
@@ -309,6 +342,11 @@ Stream::ReadAt(off_t pos, uint8* buffer, size_t* _length)
 	if (pos + (off_t)length > data.Size())
 		length = data.Size() - pos;
 
+	if ((Flags() & INODE_INLINE_DATA) != 0) {
+		*_length = length;
+		return ReadInlineData(pos, buffer, _length);
+	}
+
 	block_run run;
 	off_t offset;
 	if (FindBlockRun(pos, run, offset) < B_OK) {
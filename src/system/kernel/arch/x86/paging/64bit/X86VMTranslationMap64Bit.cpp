@@ -33,12 +33,53 @@
 #endif
 
 
+/*!	A page table range of user memory that is mapped by a single large page
+	directory entry. The page table that mapped the range before it was
+	collapsed is kept, so that the large page can be split up again without
+	having to allocate anything.
+*/
+struct X86VMTranslationMap64Bit::LargePage {
+	addr_t		address;
+	uint64		pageDirectoryEntry;
+	LargePage*	hashNext;
+};
+
+
+struct X86VMTranslationMap64Bit::LargePageHashDefinition {
+	typedef addr_t		KeyType;
+	typedef LargePage	ValueType;
+
+	size_t HashKey(addr_t key) const
+	{
+		return key / k64BitPageTableRange;
+	}
+
+	size_t Hash(const LargePage* value) const
+	{
+		return HashKey(value->address);
+	}
+
+	bool Compare(addr_t key, const LargePage* value) const
+	{
+		return value->address == key;
+	}
+
+	LargePage*& GetLink(LargePage* value) const
+	{
+		return value->hashNext;
+	}
+};
+
+
 // #pragma mark - X86VMTranslationMap64Bit
 
 
 X86VMTranslationMap64Bit::X86VMTranslationMap64Bit(bool la57)
 	:
 	fPagingStructures(NULL),
+	fLargePages(NULL),
+	fUnusedLargePages(NULL),
+	fLargePageCount(0),
 	fLA57(la57)
 {
 }
@@ -75,6 +116,22 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 						continue;
 
 					address = virtualPageDir[k] & X86_64_PDE_ADDRESS_MASK;
+					if ((virtualPageDir[k] & X86_64_PDE_LARGE_PAGE) != 0) {
+						// The pages themselves belong to the area's cache, only
+						// the page table we kept for the large page is ours.
+						LargePage* largePage = fLargePages->Lookup(
+							i * k64BitPDPTRange + j * k64BitPageDirectoryRange
+								+ k * k64BitPageTableRange);
+						if (largePage == NULL) {
+							panic("large page %u %u %u without page table\n", i,
+								j, k);
+							continue;
+						}
+
+						address = largePage->pageDirectoryEntry
+							& X86_64_PDE_ADDRESS_MASK;
+					}
+
 					page = vm_lookup_page(address / B_PAGE_SIZE);
 					if (page == NULL) {
 						panic("page table %u %u %u on invalid page %#"
@@ -112,6 +169,22 @@ X86VMTranslationMap64Bit::~X86VMTranslationMap64Bit()
 		fPageMapper->Delete();
 	}
 
+	if (fLargePages != NULL) {
+		LargePage* largePage = fLargePages->Clear(true);
+		while (largePage != NULL) {
+			LargePage* next = largePage->hashNext;
+			delete largePage;
+			largePage = next;
+		}
+
+		delete fLargePages;
+	}
+
+	while (LargePage* largePage = fUnusedLargePages) {
+		fUnusedLargePages = largePage->hashNext;
+		delete largePage;
+	}
+
 	fPagingStructures->RemoveReference();
 }
 
@@ -206,6 +279,8 @@ X86VMTranslationMap64Bit::Map(addr_t virtualAddress, phys_addr_t physicalAddress
 	TRACE("X86VMTranslationMap64Bit::Map(%#" B_PRIxADDR ", %#" B_PRIxPHYSADDR
 		")\n", virtualAddress, physicalAddress);
 
+	_SplitLargePages(virtualAddress, virtualAddress);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	// Look up the page table for the virtual address, allocating new tables
@@ -243,6 +318,8 @@ X86VMTranslationMap64Bit::Unmap(addr_t start, addr_t end)
 	TRACE("X86VMTranslationMap64Bit::Unmap(%#" B_PRIxADDR ", %#" B_PRIxADDR
 		")\n", start, end);
 
+	_SplitLargePages(start, end);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
@@ -293,6 +370,8 @@ X86VMTranslationMap64Bit::DebugMarkRangePresent(addr_t start, addr_t end,
 	TRACE("X86VMTranslationMap64Bit::DebugMarkRangePresent(%#" B_PRIxADDR
 		", %#" B_PRIxADDR ")\n", start, end);
 
+	_SplitLargePages(start, end);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
@@ -344,6 +423,12 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 
 	TRACE("X86VMTranslationMap64Bit::UnmapPage(%#" B_PRIxADDR ")\n", address);
 
+	// The map needs to be locked before looking up the page table, as a
+	// large page might be collapsed or split concurrently otherwise.
+	RecursiveLocker locker(fLock);
+
+	_SplitLargePages(address, address);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	// Look up the page table for the virtual address.
@@ -353,8 +438,6 @@ X86VMTranslationMap64Bit::UnmapPage(VMArea* area, addr_t address,
 	if (entry == NULL)
 		return B_ENTRY_NOT_FOUND;
 
-	RecursiveLocker locker(fLock);
-
 	uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(entry);
 
 	pinner.Unlock();
@@ -424,6 +507,9 @@ X86VMTranslationMap64Bit::UnmapPages(VMArea* area, addr_t base, size_t size,
 	VMAreaMappings queue;
 
 	RecursiveLocker locker(fLock);
+
+	_SplitLargePages(start, end);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
@@ -569,6 +655,8 @@ X86VMTranslationMap64Bit::Protect(addr_t start, addr_t end, uint32 attributes,
 	} else if ((attributes & B_KERNEL_WRITE_AREA) != 0)
 		newProtectionFlags = X86_64_PTE_WRITABLE;
 
+	_SplitLargePages(start, end);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	do {
@@ -627,6 +715,8 @@ X86VMTranslationMap64Bit::ClearFlags(addr_t address, uint32 flags)
 	TRACE("X86VMTranslationMap64Bit::ClearFlags(%#" B_PRIxADDR ", %#" B_PRIx32
 		")\n", address, flags);
 
+	_SplitLargePages(address, address);
+
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
 	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
@@ -660,6 +750,25 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 	RecursiveLocker locker(fLock);
 	ThreadCPUPinner pinner(thread_get_current_thread());
 
+	if (fLargePageCount != 0) {
+		uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+			fPagingStructures->VirtualPMLTop(), address, fIsKernelMap,
+			false, NULL, fPageMapper, fMapCount);
+		if (pde != NULL && (*pde & X86_64_PDE_LARGE_PAGE) != 0) {
+			// All pages of a large page share its accessed and dirty flags,
+			// so we must not clear them for a single page. The large page is
+			// treated as a whole instead, and only split up when it hasn't
+			// been accessed at all, or when memory is needed.
+			uint64 entry = *pde;
+			if ((entry & X86_64_PDE_ACCESSED) != 0 || !unmapIfUnaccessed) {
+				_modified = (entry & X86_64_PDE_DIRTY) != 0;
+				return (entry & X86_64_PDE_ACCESSED) != 0;
+			}
+
+			_SplitLargePage(ROUNDDOWN(address, k64BitPageTableRange));
+		}
+	}
+
 	uint64* entry = X86PagingMethod64Bit::PageTableEntryForAddress(
 		fPagingStructures->VirtualPMLTop(), address, fIsKernelMap,
 		false, NULL, fPageMapper, fMapCount);
@@ -727,6 +836,147 @@ X86VMTranslationMap64Bit::ClearAccessedAndModified(VMArea* area, addr_t address,
 }
 
 
+size_t
+X86VMTranslationMap64Bit::LargePageSize() const
+{
+	// TODO: Support LA57, the address computations in the destructor don't
+	// take the additional level into account yet.
+	if (fIsKernelMap || fLA57)
+		return 0;
+
+	return k64BitPageTableRange;
+}
+
+
+/*!	Replaces the page table mapping the range starting at \a address with a
+	single large page directory entry.
+	All 512 page table entries must be present, must map physically contiguous
+	memory starting at a large page aligned physical address, and must have
+	identical protection and memory type (which has to be write-back).
+	The page table is kept around, so that the large page can be split up again
+	at any time without needing to allocate anything.
+	The map must be locked.
+*/
+status_t
+X86VMTranslationMap64Bit::CollapseLargePage(addr_t address)
+{
+	if (LargePageSize() == 0)
+		return B_NOT_SUPPORTED;
+	if (address % k64BitPageTableRange != 0)
+		return B_BAD_VALUE;
+
+	TRACE("X86VMTranslationMap64Bit::CollapseLargePage(%#" B_PRIxADDR ")\n",
+		address);
+
+	if (fLargePages == NULL) {
+		fLargePages = new(std::nothrow) LargePageTable;
+		if (fLargePages == NULL || fLargePages->Init() != B_OK) {
+			delete fLargePages;
+			fLargePages = NULL;
+			return B_NO_MEMORY;
+		}
+	}
+
+	LargePage* largePage = fUnusedLargePages;
+	if (largePage != NULL)
+		fUnusedLargePages = largePage->hashNext;
+	else {
+		largePage = new(std::nothrow) LargePage;
+		if (largePage == NULL)
+			return B_NO_MEMORY;
+	}
+
+	largePage->address = address;
+	if (fLargePages->Insert(largePage) != B_OK) {
+		largePage->hashNext = fUnusedLargePages;
+		fUnusedLargePages = largePage;
+		return B_NO_MEMORY;
+	}
+
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPMLTop(), address, fIsKernelMap,
+		false, NULL, fPageMapper, fMapCount);
+
+	status_t status = B_OK;
+	if (pde == NULL || (*pde & X86_64_PDE_PRESENT) == 0
+		|| (*pde & X86_64_PDE_LARGE_PAGE) != 0) {
+		status = B_ENTRY_NOT_FOUND;
+	}
+
+	const uint64 attributesMask = X86_64_PTE_PRESENT
+		| X86_64_PTE_PROTECTION_MASK | X86_64_PTE_MEMORY_TYPE_MASK
+		| X86_64_PTE_PAT | X86_64_PTE_GLOBAL;
+
+	uint64* pageTable = NULL;
+	uint64 attributes = 0;
+	phys_addr_t physicalAddress = 0;
+	if (status == B_OK) {
+		pageTable = (uint64*)fPageMapper->GetPageTableAt(
+			*pde & X86_64_PDE_ADDRESS_MASK);
+		attributes = pageTable[0] & attributesMask;
+		physicalAddress = pageTable[0] & X86_64_PTE_ADDRESS_MASK;
+
+		if ((attributes & X86_64_PTE_PRESENT) == 0
+			|| (attributes & (X86_64_PTE_MEMORY_TYPE_MASK | X86_64_PTE_PAT
+				| X86_64_PTE_GLOBAL)) != 0
+			|| physicalAddress % k64BitPageTableRange != 0) {
+			status = B_BAD_VALUE;
+		}
+	}
+
+	for (uint32 i = 1; status == B_OK && i < k64BitTableEntryCount; i++) {
+		if ((pageTable[i] & attributesMask) != attributes
+			|| (pageTable[i] & X86_64_PTE_ADDRESS_MASK)
+				!= physicalAddress + i * B_PAGE_SIZE) {
+			status = B_BAD_VALUE;
+		}
+	}
+
+	if (status != B_OK) {
+		fLargePages->RemoveUnchecked(largePage);
+		largePage->hashNext = fUnusedLargePages;
+		fUnusedLargePages = largePage;
+		return status;
+	}
+
+	// Take the page table out of service first, and make sure no CPU still
+	// has any of its entries cached. Any access to the range will fault (and
+	// wait for the map lock) until the large page has been installed.
+	largePage->pageDirectoryEntry = X86PagingMethod64Bit::ClearTableEntry(pde);
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+		InvalidatePage(address + i * B_PAGE_SIZE);
+	Flush();
+
+	// Now that the hardware can no longer update the page table entries, we
+	// can collect their accessed and dirty flags.
+	uint64 usageFlags = 0;
+	for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+		usageFlags |= pageTable[i] & (X86_64_PTE_ACCESSED | X86_64_PTE_DIRTY);
+
+	// The protection, accessed and dirty flags share their positions in page
+	// table and page directory entries.
+	X86PagingMethod64Bit::SetTableEntry(pde, physicalAddress
+		| X86_64_PDE_PRESENT | X86_64_PDE_LARGE_PAGE
+		| (attributes & X86_64_PTE_PROTECTION_MASK) | usageFlags);
+
+	fLargePageCount++;
+
+	return B_OK;
+}
+
+
+/*!	Splits up all large pages intersecting the given range again.
+	The map must be locked.
+*/
+void
+X86VMTranslationMap64Bit::SplitLargePages(addr_t start, addr_t end)
+{
+	_SplitLargePages(start, end);
+}
+
+
 bool
 X86VMTranslationMap64Bit::DebugGetReverseMappingInfo(phys_addr_t physicalAddress,
 	ReverseMappingInfoCallback& callback)
@@ -794,6 +1044,84 @@ X86VMTranslationMap64Bit::DebugGetReverseMappingInfo(phys_addr_t physicalAddress
 }
 
 
+/*!	Turns the large page at \a address, if any, back into the page table it
+	was collapsed from. The accessed and dirty flags of the large page are
+	transferred to all of its page table entries.
+	The map must be locked.
+*/
+void
+X86VMTranslationMap64Bit::_SplitLargePage(addr_t address)
+{
+	LargePage* largePage = fLargePages->Lookup(address);
+	if (largePage == NULL)
+		return;
+
+	TRACE("X86VMTranslationMap64Bit::_SplitLargePage(%#" B_PRIxADDR ")\n",
+		address);
+
+	ThreadCPUPinner pinner(thread_get_current_thread());
+
+	uint64* pde = X86PagingMethod64Bit::PageDirectoryEntryForAddress(
+		fPagingStructures->VirtualPMLTop(), address, fIsKernelMap,
+		false, NULL, fPageMapper, fMapCount);
+	ASSERT(pde != NULL && (*pde & X86_64_PDE_LARGE_PAGE) != 0);
+
+	// Clearing the entry atomically gets us the final accessed and dirty
+	// flags, as long as we make sure no CPU can use a cached copy of it
+	// anymore.
+	uint64 oldEntry = X86PagingMethod64Bit::ClearTableEntry(pde);
+	InvalidatePage(address);
+	Flush();
+
+	uint64 usageFlags = oldEntry & (X86_64_PDE_ACCESSED | X86_64_PDE_DIRTY);
+	uint64* pageTable = (uint64*)fPageMapper->GetPageTableAt(
+		largePage->pageDirectoryEntry & X86_64_PDE_ADDRESS_MASK);
+	if (usageFlags != 0) {
+		for (uint32 i = 0; i < k64BitTableEntryCount; i++)
+			X86PagingMethod64Bit::SetTableEntryFlags(&pageTable[i], usageFlags);
+	}
+
+	X86PagingMethod64Bit::SetTableEntry(pde, largePage->pageDirectoryEntry);
+
+	fLargePages->RemoveUnchecked(largePage);
+	largePage->hashNext = fUnusedLargePages;
+	fUnusedLargePages = largePage;
+	fLargePageCount--;
+}
+
+
+/*!	Splits up all large pages intersecting the range from \a start to \a end
+	(inclusive). Does nothing as long as no large pages exist in this map.
+*/
+void
+X86VMTranslationMap64Bit::_SplitLargePages(addr_t start, addr_t end)
+{
+	if (fLargePageCount == 0 || start > end)
+		return;
+
+	RecursiveLocker locker(fLock);
+
+	start = ROUNDDOWN(start, k64BitPageTableRange);
+	end = ROUNDDOWN(end, k64BitPageTableRange);
+
+	if ((end - start) / k64BitPageTableRange < (addr_t)fLargePageCount) {
+		// Look up all page table ranges of the (small) range directly.
+		for (addr_t address = start; ; address += k64BitPageTableRange) {
+			_SplitLargePage(address);
+			if (address == end)
+				break;
+		}
+		return;
+	}
+
+	LargePageTable::Iterator iterator = fLargePages->GetIterator();
+	while (LargePage* largePage = iterator.Next()) {
+		if (largePage->address >= start && largePage->address <= end)
+			_SplitLargePage(largePage->address);
+	}
+}
+
+
 X86PagingStructures*
 X86VMTranslationMap64Bit::PagingStructures() const
 {
@@ -7,6 +7,8 @@
 #define KERNEL_ARCH_X86_PAGING_64BIT_X86_VM_TRANSLATION_MAP_64BIT_H
 
 
+#include <util/OpenHashTable.h>
+
 #include "paging/X86VMTranslationMap.h"
 
 
@@ -56,6 +58,10 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 									bool unmapIfUnaccessed,
 									bool& _modified);
 
+	virtual	size_t				LargePageSize() const;
+	virtual	status_t			CollapseLargePage(addr_t address);
+	virtual	void				SplitLargePages(addr_t start, addr_t end);
+
 	virtual	bool				DebugGetReverseMappingInfo(
 									phys_addr_t physicalAddress,
 									ReverseMappingInfoCallback& callback);
@@ -64,8 +70,19 @@ struct X86VMTranslationMap64Bit final : X86VMTranslationMap {
 	inline	X86PagingStructures64Bit* PagingStructures64Bit() const
 									{ return fPagingStructures; }
 
+private:
+			struct LargePage;
+			struct LargePageHashDefinition;
+			typedef BOpenHashTable<LargePageHashDefinition> LargePageTable;
+
+			void				_SplitLargePage(addr_t address);
+			void				_SplitLargePages(addr_t start, addr_t end);
+
 private:
 			X86PagingStructures64Bit* fPagingStructures;
+			LargePageTable*		fLargePages;
+			LargePage*			fUnusedLargePages;
+			int32				fLargePageCount;
 			bool				fLA57;
 };
 
@@ -59,6 +59,10 @@
 static const bigtime_t kTransactionIdleTime = 2000000LL;
 	// a transaction is considered idle after 2 seconds of inactivity
 
+static const uint32 kBlockShardCount = 16;
+	// the number of independently locked partitions of the block hash; must
+	// be a power of two
+
 
 namespace {
 
@@ -97,10 +101,16 @@ struct cached_block {
 		// Block has been checked out for writing without transactions, and
 		// cannot be written back if set
 	bool			is_dirty : 1;
-	bool			unused : 1;
 	bool			discard : 1;
 	bool			busy_reading_waiters : 1;
 	bool			busy_writing_waiters : 1;
+	bool			uninitialized : 1;
+		// The block has been inserted without reading it, and its contents
+		// have not been defined yet.
+	bool			unused;
+		// Not part of the bit field above, as it is protected by the shard
+		// lock rather than the cache lock (as is ref_count, last_accessed,
+		// and the link).
 	cache_transaction* transaction;
 		// This is the current active transaction, if any, the block is
 		// currently in (meaning was changed as a part of it).
@@ -175,12 +185,14 @@ struct BlockHash {
 
 	size_t HashKey(KeyType key) const
 	{
-		return key;
+		// the lower bits select the shard, and are the same for all blocks
+		// in a table
+		return key / kBlockShardCount;
 	}
 
 	size_t Hash(ValueType* block) const
 	{
-		return block->block_number;
+		return HashKey(block->block_number);
 	}
 
 	bool Compare(KeyType key, ValueType* block) const
@@ -197,6 +209,23 @@ struct BlockHash {
 typedef BOpenHashTable<BlockHash> BlockTable;
 
 
+/*!	A partition of the block cache. All lookups of a block, and changes
+	to its reference count and to the unused list need the shard lock, so that
+	get/put of blocks that are already cached can be done without holding
+	the cache lock.
+	Inserting or removing blocks from the hash, and changing their transaction
+	state needs both, the cache lock and the shard lock (in this order).
+*/
+struct block_shard {
+	mutex			lock;
+	BlockTable		hash;
+	block_list		unused_blocks;
+		// sorted by last access
+	uint32			lockless_gets;
+	uint32			lockless_puts;
+};
+
+
 struct TransactionHash {
 	typedef int32				KeyType;
 	typedef	cache_transaction	ValueType;
@@ -215,7 +244,7 @@ typedef BOpenHashTable<TransactionHash> TransactionTable;
 
 
 struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
-	BlockTable*		hash;
+	block_shard*	shards;
 	mutex			lock;
 	const int		fd;
 	off_t			max_blocks;
@@ -225,8 +254,9 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	TransactionTable* transaction_hash;
 
 	object_cache*	buffer_cache;
-	block_list		unused_blocks;
-	uint32			unused_block_count;
+	int32			unused_block_count;
+		// the number of blocks in all of the shard's unused lists
+	uint32			next_unused_shard;
 
 	ConditionVariable busy_reading_condition;
 	uint32			busy_reading_count;
@@ -257,14 +287,76 @@ struct block_cache : DoublyLinkedListLinkImpl<block_cache> {
 	cached_block*	NewBlock(off_t blockNumber);
 	void			FreeBlockParentData(cached_block* block);
 
+	block_shard&	ShardFor(off_t blockNumber) const
+						{ return shards[blockNumber & (kBlockShardCount - 1)]; }
+	cached_block*	LookupBlock(off_t blockNumber) const;
+	void			InsertBlock(cached_block* block);
+	void			AddUnused(block_shard& shard, cached_block* block);
+	void			RemoveUnused(block_shard& shard, cached_block* block);
+
 	void			RemoveUnusedBlocks(int32 count, int32 minSecondsOld = 0);
 	void			RemoveBlock(cached_block* block);
+	bool			RemoveUnusedBlock(cached_block* block);
 	void			DiscardBlock(cached_block* block);
 
 private:
 	static void		_LowMemoryHandler(void* data, uint32 resources,
 						int32 level);
 	cached_block*	_GetUnusedBlock();
+	cached_block*	_StealUnusedBlock(block_shard& shard,
+						int32 minSecondsOld);
+};
+
+
+/*!	Iterates over all blocks in all shards of a cache. The cache must be
+	locked, as blocks are only ever inserted or removed with the cache lock
+	held.
+*/
+class CachedBlockIterator {
+public:
+	CachedBlockIterator(block_cache* cache)
+		:
+		fCache(cache),
+		fShard(0),
+		fIterator(&cache->shards[0].hash)
+	{
+		_SkipEmpty();
+	}
+
+	bool HasNext() const
+	{
+		return fIterator.HasNext();
+	}
+
+	cached_block* Next()
+	{
+		cached_block* block = fIterator.Next();
+		_SkipEmpty();
+		return block;
+	}
+
+private:
+	void _SkipEmpty()
+	{
+		while (!fIterator.HasNext() && fShard + 1 < kBlockShardCount) {
+			fShard++;
+			fIterator = BlockTable::Iterator(&fCache->shards[fShard].hash);
+		}
+	}
+
+	block_cache*			fCache;
+	uint32					fShard;
+	BlockTable::Iterator	fIterator;
+};
+
+
+class ShardLocker : public MutexLocker {
+public:
+	ShardLocker(block_cache* cache, cached_block* block)
+		:
+		MutexLocker(cache->ShardFor(block->block_number).lock)
+	{
+	}
 };
 
 struct cache_transaction {
@@ -280,6 +372,8 @@ struct cache_transaction {
 	ListenerList	listeners;
 	bool			open;
 	bool			has_sub_transaction;
+	bool			held;
+		// the blocks must not be written back yet
 	bigtime_t		last_used;
 	int32			busy_writing_count;
 };
@@ -348,7 +442,7 @@ private:
 									generic_size_t bytesTransferred);
 			void			_IOFinished(status_t status, generic_size_t bytesTransferred);
 
-			void				_RemoveAllocated(size_t unbusyCount, size_t removeCount);
+			void				_RemoveAllocated(size_t count);
 
 private:
 			block_cache* 		fCache;
@@ -1055,6 +1149,7 @@ cache_transaction::cache_transaction()
 	first_block = NULL;
 	open = true;
 	has_sub_transaction = false;
+	held = false;
 	last_used = system_time();
 	busy_writing_count = 0;
 }
@@ -1108,6 +1203,12 @@ write_blocks_in_previous_transaction(block_cache* cache,
 	cached_block* block = transaction->first_block;
 	for (; block != NULL; block = block->transaction_next) {
 		if (block->previous_transaction != NULL) {
+			if (block->previous_transaction->held) {
+				panic("write_blocks_in_previous_transaction(): transaction %"
+					B_PRId32 " is still held", block->previous_transaction->id);
+				return B_BAD_VALUE;
+			}
+
 			// need to write back pending changes
 			writer.Add(block);
 		}
@@ -1123,9 +1224,12 @@ write_blocks_in_previous_transaction(block_cache* cache,
 bool
 cached_block::CanBeWritten() const
 {
-	return !busy_writing && !busy_reading
-		&& (previous_transaction != NULL
-			|| (transaction == NULL && is_dirty && !is_writing));
+	if (busy_writing || busy_reading)
+		return false;
+	if (previous_transaction != NULL)
+		return !previous_transaction->held;
+
+	return transaction == NULL && is_dirty && !is_writing;
 }
 
 
@@ -1207,6 +1311,11 @@ BlockWriter::Add(cache_transaction* transaction, bool& hasLeftOvers)
 {
 	ASSERT(!transaction->open);
 
+	if (transaction->held) {
+		// its blocks will be written once it has been released
+		hasLeftOvers = false;
+		return true;
+	}
 	if (transaction->busy_writing_count != 0) {
 		hasLeftOvers = true;
 		return true;
@@ -1376,7 +1485,6 @@ BlockWriter::_BlockDone(cached_block* block,
 	cache_transaction* previous = block->previous_transaction;
 	if (previous != NULL) {
 		previous->blocks.Remove(block);
-		block->previous_transaction = NULL;
 
 		if (block->original_data != NULL && block->transaction == NULL) {
 			// This block is not part of a transaction, so it does not need
@@ -1385,6 +1493,10 @@ BlockWriter::_BlockDone(cached_block* block,
 			block->original_data = NULL;
 		}
 
+		ShardLocker shardLocker(fCache, block);
+		block->previous_transaction = NULL;
+		shardLocker.Unlock();
+
 		// Has the previous transaction been finished with that write?
 		if (--previous->num_blocks == 0) {
 			TRACE(("cache transaction %" B_PRId32 " finished!\n", previous->id));
@@ -1406,12 +1518,14 @@ BlockWriter::_BlockDone(cached_block* block,
 			fDeletedTransaction = true;
 		}
 	}
+
+	block_shard& shard = fCache->ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
 	if (block->transaction == NULL && block->ref_count == 0 && !block->unused) {
 		// the block is no longer used
 		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = true;
-		fCache->unused_blocks.Add(block);
-		fCache->unused_block_count++;
+		fCache->AddUnused(shard, block);
 	}
 
 	TB2(BlockData(fCache, block, "after write"));
@@ -1475,7 +1589,7 @@ BlockPrefetcher::~BlockPrefetcher()
 /*!	Allocates cached_block objects in preparation for prefetching.
 	@return If an error is returned, then no blocks have been allocated.
 	@post Blocks have been constructed (including allocating the current_data member)
-	but current_data is uninitialized.
+	but current_data is uninitialized. The blocks are marked busy reading.
 */
 status_t
 BlockPrefetcher::Allocate()
@@ -1495,7 +1609,7 @@ BlockPrefetcher::Allocate()
 				B_PRIdOFF ")", blockNumIter, fCache->max_blocks - 1);
 			return B_BAD_VALUE;
 		}
-		cached_block* block = fCache->hash->Lookup(blockNumIter);
+		cached_block* block = fCache->LookupBlock(blockNumIter);
 		if (block != NULL) {
 			// truncate the request
 			TRACE(("BlockPrefetcher::Allocate: found an existing block (%" B_PRIdOFF ")\n",
@@ -1510,14 +1624,19 @@ BlockPrefetcher::Allocate()
 	for (size_t i = 0; i < finalNumBlocks; ++i) {
 		cached_block* block = fCache->NewBlock(fBlockNumber + i);
 		if (block == NULL) {
-			_RemoveAllocated(0, i);
+			_RemoveAllocated(i);
 			return B_NO_MEMORY;
 		}
-		fCache->hash->Insert(block);
 
-		block->unused = true;
-		fCache->unused_blocks.Add(block);
-		fCache->unused_block_count++;
+		// The block must already be busy when it becomes visible to lookups
+		// that do not hold the cache lock.
+		mark_block_busy_reading(fCache, block);
+		fCache->InsertBlock(block);
+
+		block_shard& shard = fCache->ShardFor(block->block_number);
+		MutexLocker shardLocker(shard.lock);
+		fCache->AddUnused(shard, block);
+		shardLocker.Unlock();
 
 		fBlocks[i] = block;
 	}
@@ -1541,7 +1660,6 @@ BlockPrefetcher::ReadAsync(MutexLocker& cacheLocker)
 	for (size_t i = 0; i < fNumAllocated; ++i) {
 		vecs[i].base = reinterpret_cast<generic_addr_t>(fBlocks[i]->current_data);
 		vecs[i].length = blockSize;
-		mark_block_busy_reading(fCache, fBlocks[i]);
 	}
 
 	IORequest* request = new IORequest;
@@ -1553,7 +1671,7 @@ BlockPrefetcher::ReadAsync(MutexLocker& cacheLocker)
 			" blocks starting with %" B_PRIdOFF ": %s\n",
 			fNumAllocated, fBlockNumber, strerror(status));
 
-		_RemoveAllocated(fNumAllocated, fNumAllocated);
+		_RemoveAllocated(fNumAllocated);
 		delete request;
 		return status;
 	}
@@ -1583,7 +1701,7 @@ BlockPrefetcher::_IOFinished(status_t status, generic_size_t bytesTransferred)
 	MutexLocker locker(&fCache->lock);
 
 	if (bytesTransferred < (fNumAllocated * fCache->block_size)) {
-		_RemoveAllocated(fNumAllocated, fNumAllocated);
+		_RemoveAllocated(fNumAllocated);
 
 		TB(Error(cache, fBlockNumber, "prefetch starting here failed", status));
 		TRACE_ALWAYS("BlockPrefetcher::_IOFinished: transferred only %" B_PRIuGENADDR
@@ -1593,6 +1711,8 @@ BlockPrefetcher::_IOFinished(status_t status, generic_size_t bytesTransferred)
 		for (size_t i = 0; i < fNumAllocated; i++) {
 			TB(Read(cache, fBlockNumber + i));
 			mark_block_unbusy_reading(fCache, fBlocks[i]);
+
+			ShardLocker shardLocker(fCache, fBlocks[i]);
 			fBlocks[i]->last_accessed = system_time() / 1000000L;
 		}
 	}
@@ -1605,23 +1725,27 @@ BlockPrefetcher::_IOFinished(status_t status, generic_size_t bytesTransferred)
 	is cancelled.
 */
 void
-BlockPrefetcher::_RemoveAllocated(size_t unbusyCount, size_t removeCount)
+BlockPrefetcher::_RemoveAllocated(size_t count)
 {
-	TRACE(("BlockPrefetcher::_RemoveAllocated:  unbusy %" B_PRIuSIZE " and remove %" B_PRIuSIZE
-		" starting with %" B_PRIdOFF "\n", unbusyCount, removeCount, (*fBlocks)->block_number));
+	TRACE(("BlockPrefetcher::_RemoveAllocated: remove %" B_PRIuSIZE
+		" starting with %" B_PRIdOFF "\n", count, (*fBlocks)->block_number));
 
 	ASSERT_LOCKED_MUTEX(&fCache->lock);
 
-	for (size_t i = 0; i < unbusyCount; ++i)
-		mark_block_unbusy_reading(fCache, fBlocks[i]);
-
-	for (size_t i = 0; i < removeCount; ++i) {
-		ASSERT(fBlocks[i]->is_dirty == false && fBlocks[i]->unused == true);
+	for (size_t i = 0; i < count; ++i) {
+		cached_block* block = fBlocks[i];
+		ASSERT(block->is_dirty == false && block->unused == true);
 
-		fCache->unused_blocks.Remove(fBlocks[i]);
-		fCache->unused_block_count--;
+		// Remove the block from the hash before it stops being busy, so that
+		// its undefined contents can't be seen by anyone.
+		block_shard& shard = fCache->ShardFor(block->block_number);
+		MutexLocker shardLocker(shard.lock);
+		fCache->RemoveUnused(shard, block);
+		shard.hash.Remove(block);
+		shardLocker.Unlock();
 
-		fCache->RemoveBlock(fBlocks[i]);
+		mark_block_unbusy_reading(fCache, block);
+		fCache->FreeBlock(block);
 		fBlocks[i] = NULL;
 	}
 
@@ -1638,7 +1762,7 @@ BlockPrefetcher::_RemoveAllocated(size_t unbusyCount, size_t removeCount)
 block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 		bool readOnly)
 	:
-	hash(NULL),
+	shards(NULL),
 	fd(_fd),
 	max_blocks(numBlocks),
 	block_size(blockSize),
@@ -1647,6 +1771,7 @@ block_cache::block_cache(int _fd, off_t numBlocks, size_t blockSize,
 	transaction_hash(NULL),
 	buffer_cache(NULL),
 	unused_block_count(0),
+	next_unused_shard(0),
 	busy_reading_count(0),
 	busy_reading_waiters(false),
 	busy_writing_count(0),
@@ -1665,7 +1790,12 @@ block_cache::~block_cache()
 	unregister_low_resource_handler(&_LowMemoryHandler, this);
 
 	delete transaction_hash;
-	delete hash;
+
+	if (shards != NULL) {
+		for (uint32 i = 0; i < kBlockShardCount; i++)
+			mutex_destroy(&shards[i].lock);
+		delete[] shards;
+	}
 
 	delete_object_cache(buffer_cache);
 
@@ -1686,10 +1816,20 @@ block_cache::Init()
 	if (buffer_cache == NULL)
 		return B_NO_MEMORY;
 
-	hash = new BlockTable();
-	if (hash == NULL || hash->Init(1024) != B_OK)
+	shards = new(std::nothrow) block_shard[kBlockShardCount];
+	if (shards == NULL)
 		return B_NO_MEMORY;
 
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		mutex_init(&shards[i].lock, "block cache shard");
+		shards[i].lockless_gets = 0;
+		shards[i].lockless_puts = 0;
+	}
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		if (shards[i].hash.Init(1024 / kBlockShardCount) != B_OK)
+			return B_NO_MEMORY;
+	}
+
 	transaction_hash = new(std::nothrow) TransactionTable();
 	if (transaction_hash == NULL || transaction_hash->Init(16) != B_OK)
 		return B_NO_MEMORY;
@@ -1762,7 +1902,7 @@ block_cache::NewBlock(off_t blockNumber)
 		} else {
 			TB(Error(this, blockNumber, "allocation failed"));
 			TRACE_ALWAYS("block allocation failed, unused list is %sempty.\n",
-				unused_blocks.IsEmpty() ? "" : "not ");
+				unused_block_count == 0 ? "" : "not ");
 
 			// allocation failed, try to reuse an unused block
 			block = _GetUnusedBlock();
@@ -1789,6 +1929,7 @@ block_cache::NewBlock(off_t blockNumber)
 	block->discard = false;
 	block->busy_reading_waiters = false;
 	block->busy_writing_waiters = false;
+	block->uninitialized = false;
 #if BLOCK_CACHE_DEBUG_CHANGED
 	block->compare = NULL;
 #endif
@@ -1807,39 +1948,90 @@ block_cache::FreeBlockParentData(cached_block* block)
 }
 
 
+/*!	Looks up the block in the hash. The cache must be locked; since blocks are
+	only inserted and removed with both the cache and the shard lock held,
+	the shard lock isn't needed for this.
+*/
+cached_block*
+block_cache::LookupBlock(off_t blockNumber) const
+{
+	return ShardFor(blockNumber).hash.Lookup(blockNumber);
+}
+
+
+/*!	Inserts the new \a block into the hash. The cache must be locked.
+	The contents of the block must either be valid, or it must be marked
+	busy reading or uninitialized already, as it can be found by lockless
+	lookups from now on.
+*/
+void
+block_cache::InsertBlock(cached_block* block)
+{
+	block_shard& shard = ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
+	shard.hash.Insert(block);
+}
+
+
+/*!	Adds the \a block to the list of unused blocks of its \a shard.
+	The shard must be locked.
+*/
+void
+block_cache::AddUnused(block_shard& shard, cached_block* block)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+	ASSERT(!block->unused);
+
+	block->unused = true;
+	shard.unused_blocks.Add(block);
+	atomic_add(&unused_block_count, 1);
+}
+
+
+/*!	Removes the \a block from the list of unused blocks of its \a shard.
+	The shard must be locked.
+*/
+void
+block_cache::RemoveUnused(block_shard& shard, cached_block* block)
+{
+	ASSERT_LOCKED_MUTEX(&shard.lock);
+	ASSERT(block->unused);
+
+	block->unused = false;
+	shard.unused_blocks.Remove(block);
+	atomic_add(&unused_block_count, -1);
+}
+
+
 void
 block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 {
 	TRACE(("block_cache: remove up to %" B_PRId32 " unused blocks\n", count));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		if (minSecondsOld >= block->LastAccess()) {
-			// The list is sorted by last access
-			break;
-		}
-		if (block->busy_reading || block->busy_writing)
+	// Since there is no global LRU order, we take the oldest block from each
+	// shard in turn, until we either have enough, or no shard has any block
+	// left that is old enough.
+	uint32 exhaustedShards = 0;
+	const uint32 kAllShards = (1UL << kBlockShardCount) - 1;
+
+	while (count > 0 && exhaustedShards != kAllShards) {
+		uint32 index = next_unused_shard++ & (kBlockShardCount - 1);
+		if ((exhaustedShards & (1UL << index)) != 0)
+			continue;
+
+		cached_block* block = _StealUnusedBlock(shards[index], minSecondsOld);
+		if (block == NULL) {
+			exhaustedShards |= 1UL << index;
 			continue;
+		}
 
 		TB(Flush(this, block));
 		TRACE(("  remove block %" B_PRIdOFF ", last accessed %" B_PRId32 "\n",
 			block->block_number, block->last_accessed));
 
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->discard) {
-			if (block->busy_writing)
-				continue;
-
-			BlockWriter::WriteBlock(this, block);
-		}
-
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		RemoveBlock(block);
-
-		if (--count <= 0)
-			break;
+		FreeBlock(block);
+		count--;
 	}
 }
 
@@ -1847,11 +2039,36 @@ block_cache::RemoveUnusedBlocks(int32 count, int32 minSecondsOld)
 void
 block_cache::RemoveBlock(cached_block* block)
 {
-	hash->Remove(block);
+	block_shard& shard = ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+	shard.hash.Remove(block);
+	shardLocker.Unlock();
+
 	FreeBlock(block);
 }
 
 
+/*!	Removes the \a block from the cache, and frees it, if it is still unused.
+	The cache must be locked.
+	Returns \c false if the block is in use, and has been left alone.
+*/
+bool
+block_cache::RemoveUnusedBlock(cached_block* block)
+{
+	block_shard& shard = ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+	if (!block->unused || block->busy_reading || block->busy_writing)
+		return false;
+
+	RemoveUnused(shard, block);
+	shard.hash.Remove(block);
+	shardLocker.Unlock();
+
+	FreeBlock(block);
+	return true;
+}
+
+
 /*!	Discards the block from a transaction (this method must not be called
 	for blocks not part of a transaction).
 */
@@ -1929,20 +2146,14 @@ block_cache::_GetUnusedBlock()
 {
 	TRACE(("block_cache: get unused block\n"));
 
-	for (block_list::Iterator iterator = unused_blocks.GetIterator();
-			cached_block* block = iterator.Next();) {
-		TB(Flush(this, block, true));
-		// this can only happen if no transactions are used
-		if (block->is_dirty && !block->busy_writing && !block->discard)
-			BlockWriter::WriteBlock(this, block);
-
-		// remove block from lists
-		iterator.Remove();
-		unused_block_count--;
-		hash->Remove(block);
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		block_shard& shard = shards[next_unused_shard++ & (kBlockShardCount - 1)];
+		cached_block* block = _StealUnusedBlock(shard, -1);
+		if (block == NULL)
+			continue;
 
+		TB(Flush(this, block, true));
 		ASSERT(block->original_data == NULL && block->parent_data == NULL);
-		block->unused = false;
 
 		// TODO: see if compare data is handled correctly here!
 #if BLOCK_CACHE_DEBUG_CHANGED
@@ -1956,6 +2167,50 @@ block_cache::_GetUnusedBlock()
 }
 
 
+/*!	Removes the least recently used block from the unused list of \a shard
+	and from the hash, and returns it. Dirty blocks are written back first.
+	The cache must be locked, the shard must not be locked.
+	Returns \c NULL if the shard has no unused block that has not been
+	accessed for at least \a minSecondsOld.
+*/
+cached_block*
+block_cache::_StealUnusedBlock(block_shard& shard, int32 minSecondsOld)
+{
+	ASSERT_LOCKED_MUTEX(&lock);
+
+	MutexLocker shardLocker(shard.lock);
+
+	block_list::Iterator iterator = shard.unused_blocks.GetIterator();
+	while (cached_block* block = iterator.Next()) {
+		if (minSecondsOld >= block->LastAccess()) {
+			// The list is sorted by last access
+			break;
+		}
+		if (block->busy_reading || block->busy_writing)
+			continue;
+
+		// this can only happen if no transactions are used
+		if (block->is_dirty && !block->discard) {
+			shardLocker.Unlock();
+			BlockWriter::WriteBlock(this, block);
+			shardLocker.Lock();
+
+			// The block might have been referenced while the shard was
+			// unlocked, and the list might have changed
+			iterator = shard.unused_blocks.GetIterator();
+			if (!block->unused || block->busy_reading || block->busy_writing)
+				continue;
+		}
+
+		RemoveUnused(shard, block);
+		shard.hash.Remove(block);
+		return block;
+	}
+
+	return NULL;
+}
+
+
 //	#pragma mark - private block functions
 
 
@@ -2082,6 +2337,9 @@ put_cached_block(block_cache* cache, cached_block* block)
 #endif
 	TB(Put(cache, block));
 
+	block_shard& shard = cache->ShardFor(block->block_number);
+	MutexLocker shardLocker(shard.lock);
+
 	if (block->ref_count < 1) {
 		panic("Invalid ref_count for block %p, cache %p\n", block, cache);
 		return;
@@ -2093,15 +2351,14 @@ put_cached_block(block_cache* cache, cached_block* block)
 		block->is_writing = false;
 
 		if (block->discard) {
-			cache->RemoveBlock(block);
+			shard.hash.Remove(block);
+			shardLocker.Unlock();
+
+			cache->FreeBlock(block);
 		} else {
 			// put this block in the list of unused blocks
-			ASSERT(!block->unused);
-			block->unused = true;
-
 			ASSERT(block->original_data == NULL && block->parent_data == NULL);
-			cache->unused_blocks.Add(block);
-			cache->unused_block_count++;
+			cache->AddUnused(shard, block);
 		}
 	}
 }
@@ -2115,7 +2372,7 @@ put_cached_block(block_cache* cache, off_t blockNumber)
 			blockNumber, cache->max_blocks - 1);
 	}
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->LookupBlock(blockNumber);
 	if (block != NULL)
 		put_cached_block(cache, block);
 	else {
@@ -2148,7 +2405,7 @@ get_cached_block(block_cache* cache, off_t blockNumber, bool* _allocated,
 	}
 
 retry:
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->LookupBlock(blockNumber);
 	*_allocated = false;
 
 	if (block == NULL) {
@@ -2157,7 +2414,14 @@ retry:
 		if (block == NULL)
 			return B_NO_MEMORY;
 
-		cache->hash->Insert(block);
+		// Lockless lookups must not see the block before its contents are
+		// defined
+		if (readBlock)
+			mark_block_busy_reading(cache, block);
+		else
+			block->uninitialized = true;
+
+		cache->InsertBlock(block);
 		*_allocated = true;
 	} else if (block->busy_reading) {
 		// The block is currently busy_reading - wait and try again later
@@ -2168,18 +2432,20 @@ retry:
 		goto retry;
 	}
 
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
 	if (block->unused) {
 		//TRACE(("remove block %" B_PRIdOFF " from unused\n", blockNumber));
-		block->unused = false;
-		cache->unused_blocks.Remove(block);
-		cache->unused_block_count--;
+		cache->RemoveUnused(shard, block);
 	}
 
+	shardLocker.Unlock();
+
 	if (*_allocated && readBlock) {
 		// read block into cache
 		int32 blockSize = cache->block_size;
 
-		mark_block_busy_reading(cache, block);
 		mutex_unlock(&cache->lock);
 
 		ssize_t bytesRead = read_pos(cache->fd, blockNumber * blockSize,
@@ -2187,7 +2453,14 @@ retry:
 
 		mutex_lock(&cache->lock);
 		if (bytesRead < blockSize) {
-			cache->RemoveBlock(block);
+			// Remove the block from the hash before it stops being busy, so
+			// that lockless lookups can never see its undefined contents
+			shardLocker.Lock();
+			shard.hash.Remove(block);
+			shardLocker.Unlock();
+
+			mark_block_unbusy_reading(cache, block);
+			cache->FreeBlock(block);
 			TB(Error(cache, blockNumber, "read failed", bytesRead));
 
 			status_t error = errno;
@@ -2202,6 +2475,7 @@ retry:
 		mark_block_unbusy_reading(cache, block);
 	}
 
+	shardLocker.Lock();
 	block->ref_count++;
 	block->last_accessed = system_time() / 1000000L;
 
@@ -2210,6 +2484,83 @@ retry:
 }
 
 
+/*!	Retrieves the block \a blockNumber from the hash table without acquiring
+	the cache lock, if that is possible.
+	This only succeeds if the block is already cached, and its contents are
+	valid; if \c NULL is returned, the caller needs to fall back to
+	get_cached_block() with the cache lock held.
+*/
+static cached_block*
+get_cached_block_lockless(block_cache* cache, off_t blockNumber)
+{
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return NULL;
+
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
+	cached_block* block = shard.hash.Lookup(blockNumber);
+	if (block == NULL || block->busy_reading || block->uninitialized
+		|| block->discard) {
+		return NULL;
+	}
+
+	if (block->unused)
+		cache->RemoveUnused(shard, block);
+
+	block->ref_count++;
+	block->last_accessed = system_time() / 1000000L;
+	shard.lockless_gets++;
+
+	return block;
+}
+
+
+/*!	Removes a reference from the block \a blockNumber without acquiring the
+	cache lock, if that is possible.
+	This fails if this would release the last reference to a block that is
+	still part of a transaction, or needs any other special treatment, in
+	which case \c false is returned, and put_cached_block() needs to be
+	called with the cache lock held instead.
+*/
+static bool
+put_cached_block_lockless(block_cache* cache, off_t blockNumber)
+{
+#if BLOCK_CACHE_DEBUG_CHANGED
+	// the block contents need to be compared with the cache lock held
+	return false;
+#else
+	if (blockNumber < 0 || blockNumber >= cache->max_blocks)
+		return false;
+
+	block_shard& shard = cache->ShardFor(blockNumber);
+	MutexLocker shardLocker(shard.lock);
+
+	cached_block* block = shard.hash.Lookup(blockNumber);
+	if (block == NULL || block->ref_count < 1)
+		return false;
+
+	if (block->ref_count == 1) {
+		// Changes to the transaction state are done with the shard locked,
+		// so this check is reliable as long as we hold the last reference.
+		if (block->transaction != NULL || block->previous_transaction != NULL
+			|| block->is_writing || block->discard) {
+			return false;
+		}
+
+		ASSERT(block->original_data == NULL && block->parent_data == NULL);
+		block->ref_count = 0;
+		cache->AddUnused(shard, block);
+	} else
+		block->ref_count--;
+
+	shard.lockless_puts++;
+	TB(Put(cache, block));
+	return true;
+#endif
+}
+
+
 /*!	Returns the writable block data for the requested blockNumber.
 	If \a cleared is true, the block is not read from disk; an empty block
 	is returned.
@@ -2252,6 +2603,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber,
 
 			mutex_lock(&cache->lock);
 			mark_block_unbusy_reading(cache, block);
+			block->uninitialized = false;
 		}
 
 		block->is_writing = true;
@@ -2292,7 +2644,9 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber,
 			return B_BAD_VALUE;
 		}
 
+		ShardLocker shardLocker(cache, block);
 		block->transaction = transaction;
+		shardLocker.Unlock();
 
 		// attach the block to the transaction block list
 		block->transaction_next = transaction->first_block;
@@ -2356,6 +2710,7 @@ get_writable_cached_block(block_cache* cache, off_t blockNumber,
 
 		mutex_lock(&cache->lock);
 		mark_block_unbusy_reading(cache, block);
+		block->uninitialized = false;
 	}
 
 	block->is_dirty = true;
@@ -2482,7 +2837,7 @@ dump_cache(int argc, char** argv)
 	off_t blockNumber = -1;
 	if (i + 1 < argc) {
 		blockNumber = parse_expression(argv[i + 1]);
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->LookupBlock(blockNumber);
 		if (block != NULL)
 			dump_block_long(block);
 		else
@@ -2542,7 +2897,7 @@ dump_cache(int argc, char** argv)
 	uint32 count = 0;
 	uint32 dirty = 0;
 	uint32 discarded = 0;
-	BlockTable::Iterator iterator(cache->hash);
+	CachedBlockIterator iterator(cache);
 	while (iterator.HasNext()) {
 		cached_block* block = iterator.Next();
 		if (showBlocks)
@@ -2558,10 +2913,20 @@ dump_cache(int argc, char** argv)
 	}
 
 	kprintf(" %" B_PRIu32 " blocks total, %" B_PRIu32 " dirty, %" B_PRIu32
-		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRIu32
+		" discarded, %" B_PRIu32 " referenced, %" B_PRIu32 " busy, %" B_PRId32
 		" in unused.\n",
 		count, dirty, discarded, referenced, cache->busy_reading_count,
 		cache->unused_block_count);
+
+	uint64 locklessGets = 0;
+	uint64 locklessPuts = 0;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		locklessGets += cache->shards[i].lockless_gets;
+		locklessPuts += cache->shards[i].lockless_puts;
+	}
+	kprintf(" %" B_PRIu32 " shards, %" B_PRIu64 " gets and %" B_PRIu64
+		" puts without the cache lock.\n", kBlockShardCount, locklessGets,
+		locklessPuts);
 	return 0;
 }
 
@@ -2602,7 +2967,8 @@ dump_transaction(int argc, char** argv)
 	kprintf(" main num block: %" B_PRId32 "\n", transaction->main_num_blocks);
 	kprintf(" sub num block:  %" B_PRId32 "\n", transaction->sub_num_blocks);
 	kprintf(" has sub:        %d\n", transaction->has_sub_transaction);
-	kprintf(" state:          %s\n", transaction->open ? "open" : "closed");
+	kprintf(" state:          %s%s\n", transaction->open ? "open" : "closed",
+		transaction->held ? ", held" : "");
 	kprintf(" idle:           %" B_PRId64 " secs\n",
 		(system_time() - transaction->last_used) / 1000000);
 
@@ -2850,7 +3216,7 @@ block_notifier_and_writer(void* /*data*/)
 			if (cache->num_dirty_blocks) {
 				// This cache is not using transactions, we'll scan the blocks
 				// directly
-				BlockTable::Iterator iterator(cache->hash);
+				CachedBlockIterator iterator(cache);
 
 				while (iterator.HasNext()) {
 					cached_block* block = iterator.Next();
@@ -3171,6 +3537,7 @@ cache_end_transaction(void* _cache, int32 id,
 		// move the block to the previous transaction list
 		transaction->blocks.Add(block);
 
+		ShardLocker shardLocker(cache, block);
 		block->previous_transaction = transaction;
 		block->transaction_next = NULL;
 		block->transaction = NULL;
@@ -3181,6 +3548,48 @@ cache_end_transaction(void* _cache, int32 id,
 }
 
 
+/*!	Prevents the blocks of the transaction \a id from being written back
+	until cache_release_transaction_blocks() is called. This allows a file
+	system to end a transaction, and start the next one, before it has
+	written the changes of the former to its log.
+	Blocks of a held transaction are skipped by the block writer and the
+	sync functions; no later transaction may be ended until the transaction
+	has been released.
+*/
+status_t
+cache_hold_transaction_blocks(void* _cache, int32 id)
+{
+	block_cache* cache = (block_cache*)_cache;
+	TransactionLocker locker(cache);
+
+	cache_transaction* transaction = lookup_transaction(cache, id);
+	if (transaction == NULL)
+		return B_BAD_VALUE;
+
+	T(Action("hold", cache, transaction));
+	transaction->held = true;
+	return B_OK;
+}
+
+
+/*!	Allows the blocks of the transaction \a id to be written back again.
+*/
+status_t
+cache_release_transaction_blocks(void* _cache, int32 id)
+{
+	block_cache* cache = (block_cache*)_cache;
+	TransactionLocker locker(cache);
+
+	cache_transaction* transaction = lookup_transaction(cache, id);
+	if (transaction == NULL)
+		return B_BAD_VALUE;
+
+	T(Action("release", cache, transaction));
+	transaction->held = false;
+	return B_OK;
+}
+
+
 status_t
 cache_abort_transaction(void* _cache, int32 id)
 {
@@ -3216,8 +3625,11 @@ cache_abort_transaction(void* _cache, int32 id)
 		if (transaction->has_sub_transaction && block->parent_data != NULL)
 			cache->FreeBlockParentData(block);
 
+		ShardLocker shardLocker(cache, block);
 		block->transaction_next = NULL;
 		block->transaction = NULL;
+		shardLocker.Unlock();
+
 		block->discard = false;
 		if (block->previous_transaction == NULL)
 			block->is_dirty = false;
@@ -3285,6 +3697,8 @@ cache_detach_sub_transaction(void* _cache, int32 id,
 			continue;
 		}
 
+		ShardLocker shardLocker(cache, block);
+
 		if (block->parent_data != NULL) {
 			// The block changed in the parent - free the original data, since
 			// they will be replaced by what is in current.
@@ -3379,21 +3793,23 @@ cache_abort_sub_transaction(void* _cache, int32 id)
 			else
 				transaction->first_block = next;
 
-			block->transaction_next = NULL;
-			block->transaction = NULL;
 			transaction->num_blocks--;
 
 			if (block->previous_transaction == NULL) {
 				cache->Free(block->original_data);
 				block->original_data = NULL;
 				block->is_dirty = false;
+			}
 
-				if (block->ref_count == 0) {
-					// Move the block into the unused list if possible
-					block->unused = true;
-					cache->unused_blocks.Add(block);
-					cache->unused_block_count++;
-				}
+			block_shard& shard = cache->ShardFor(block->block_number);
+			MutexLocker shardLocker(shard.lock);
+
+			block->transaction_next = NULL;
+			block->transaction = NULL;
+
+			if (block->previous_transaction == NULL && block->ref_count == 0) {
+				// Move the block into the unused list if possible
+				cache->AddUnused(shard, block);
 			}
 		} else {
 			if (block->parent_data != block->current_data) {
@@ -3633,7 +4049,7 @@ cache_has_block_in_transaction(void* _cache, int32 id, off_t blockNumber)
 	block_cache* cache = (block_cache*)_cache;
 	TransactionLocker locker(cache);
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->LookupBlock(blockNumber);
 
 	return (block != NULL && block->transaction != NULL
 		&& block->transaction->id == id);
@@ -3663,11 +4079,13 @@ block_cache_delete(void* _cache, bool allowWrites)
 
 	// free all blocks
 
-	cached_block* block = cache->hash->Clear(true);
-	while (block != NULL) {
-		cached_block* next = block->next;
-		cache->FreeBlock(block);
-		block = next;
+	for (uint32 i = 0; i < kBlockShardCount; i++) {
+		cached_block* block = cache->shards[i].hash.Clear(true);
+		while (block != NULL) {
+			cached_block* next = block->next;
+			cache->FreeBlock(block);
+			block = next;
+		}
 	}
 
 	// free all transactions (they will all be aborted)
@@ -3714,7 +4132,7 @@ block_cache_sync(void* _cache)
 	MutexLocker locker(&cache->lock);
 
 	BlockWriter writer(cache);
-	BlockTable::Iterator iterator(cache->hash);
+	CachedBlockIterator iterator(cache);
 
 	while (iterator.HasNext()) {
 		cached_block* block = iterator.Next();
@@ -3752,7 +4170,7 @@ block_cache_sync_etc(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (; numBlocks > 0; numBlocks--, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->LookupBlock(blockNumber);
 		if (block == NULL)
 			continue;
 
@@ -3786,8 +4204,9 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 	BlockWriter writer(cache);
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
-		if (block != NULL && block->previous_transaction != NULL)
+		cached_block* block = cache->LookupBlock(blockNumber);
+		if (block != NULL && block->previous_transaction != NULL
+			&& !block->previous_transaction->held)
 			writer.Add(block);
 	}
 
@@ -3798,26 +4217,30 @@ block_cache_discard(void* _cache, off_t blockNumber, size_t numBlocks)
 		// reset blockNumber to its original value
 
 	for (size_t i = 0; i < numBlocks; i++, blockNumber++) {
-		cached_block* block = cache->hash->Lookup(blockNumber);
+		cached_block* block = cache->LookupBlock(blockNumber);
 		if (block == NULL)
 			continue;
 
+		if (block->previous_transaction != NULL
+			&& block->previous_transaction->held) {
+			// The changes of the held transaction still need to be written
+			// back later on, so we can't discard the block yet
+			continue;
+		}
+
 		ASSERT(block->previous_transaction == NULL);
 
-		if (block->unused) {
-			cache->unused_blocks.Remove(block);
-			cache->unused_block_count--;
-			cache->RemoveBlock(block);
-		} else {
-			if (block->transaction != NULL && block->parent_data != NULL
-				&& block->parent_data != block->current_data) {
-				panic("Discarded block %" B_PRIdOFF " has already been changed in this "
-					"transaction!", blockNumber);
-			}
+		if (cache->RemoveUnusedBlock(block))
+			continue;
 
-			// mark it as discarded (in the current transaction only, if any)
-			block->discard = true;
+		if (block->transaction != NULL && block->parent_data != NULL
+			&& block->parent_data != block->current_data) {
+			panic("Discarded block %" B_PRIdOFF " has already been changed in this "
+				"transaction!", blockNumber);
 		}
+
+		// mark it as discarded (in the current transaction only, if any)
+		block->discard = true;
 	}
 }
 
@@ -3899,10 +4322,22 @@ status_t
 block_cache_get_etc(void* _cache, off_t blockNumber, const void** _block)
 {
 	block_cache* cache = (block_cache*)_cache;
+
+#if !BLOCK_CACHE_DEBUG_CHANGED
+	cached_block* block = get_cached_block_lockless(cache, blockNumber);
+	if (block != NULL) {
+		TB(Get(cache, block));
+
+		*_block = block->current_data;
+		return B_OK;
+	}
+#else
+	cached_block* block;
+#endif
+
 	MutexLocker locker(&cache->lock);
 	bool allocated;
 
-	cached_block* block;
 	status_t status = get_cached_block(cache, blockNumber, &allocated, true,
 		&block);
 	if (status != B_OK)
@@ -3946,7 +4381,7 @@ block_cache_set_dirty(void* _cache, off_t blockNumber, bool dirty,
 	block_cache* cache = (block_cache*)_cache;
 	MutexLocker locker(&cache->lock);
 
-	cached_block* block = cache->hash->Lookup(blockNumber);
+	cached_block* block = cache->LookupBlock(blockNumber);
 	if (block == NULL)
 		return B_BAD_VALUE;
 	if (block->is_dirty == dirty) {
@@ -3966,6 +4401,9 @@ void
 block_cache_put(void* _cache, off_t blockNumber)
 {
 	block_cache* cache = (block_cache*)_cache;
+	if (put_cached_block_lockless(cache, blockNumber))
+		return;
+
 	MutexLocker locker(&cache->lock);
 
 	put_cached_block(cache, blockNumber);
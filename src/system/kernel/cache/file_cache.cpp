@@ -13,10 +13,12 @@
 #include <KernelExport.h>
 #include <fs_cache.h>
 
+#include <AutoDeleter.h>
 #include <condition_variable.h>
 #include <file_cache.h>
 #include <generic_syscall.h>
 #include <low_resource_manager.h>
+#include <slab/Slab.h>
 #include <thread.h>
 #include <util/AutoLock.h>
 #include <util/kernel_cpp.h>
@@ -37,10 +39,29 @@
 
 // maximum number of iovecs per request
 #define MAX_IO_VECS			32	// 128 kB
+// maximum number of pages per chunk for large requests
+#define MAX_IO_BATCH_PAGES	1024	// 4 MB
 
 #define BYPASS_IO_SIZE		65536
 #define LAST_ACCESSES		3
 
+// number of concurrent sequential read streams tracked per file
+#define READ_AHEAD_STREAMS	4
+
+static const uint32 kMinReadAhead = 64 * 1024;
+static const uint32 kMaxReadAhead = 2 * 1024 * 1024;
+
+struct read_ahead_stream {
+	off_t			next_offset;
+		// where the next read of this stream is expected, -1 if unused
+	off_t			ahead_end;
+		// end of the range that has already been scheduled for reading
+	uint32			window;
+		// current read-ahead size in bytes; 0 if the stream is not
+		// considered sequential (yet)
+	uint32			last_used;
+};
+
 struct file_cache_ref {
 	VMCache			*cache;
 	struct vnode	*vnode;
@@ -51,6 +72,10 @@ struct file_cache_ref {
 	int32			last_access_index;
 	uint16			disabled_count;
 
+	read_ahead_stream streams[READ_AHEAD_STREAMS];
+	uint32			read_ahead_tick;
+		// all read-ahead state is protected by the cache lock
+
 	inline void SetLastAccess(int32 index, off_t access, bool isWrite)
 	{
 		// we remember writes as negative offsets
@@ -96,9 +121,32 @@ private:
 #endif
 };
 
+/*!	Scratch space for a single chunk of a cache_io() request: room for one
+	I/O vector and one page per page of the chunk. Small requests use arrays
+	on the stack, large ones get a heap allocated batch, so that they can be
+	passed on to the file system in multi-megabyte pieces.
+*/
+struct io_batch {
+	generic_io_vec*	vecs;
+	vm_page**		pages;
+	uint32			max_pages;
+};
+
+/*!	A file cache page that has been handed out by file_cache_wire_pages().
+	It keeps a reference to its cache, and the page wired and mapped until
+	it is passed to file_cache_unwire_page().
+*/
+struct wired_file_page {
+	VMCache*		cache;
+	vm_page*		page;
+	addr_t			address;
+	void*			handle;
+};
+
 typedef status_t (*cache_func)(file_cache_ref* ref, void* cookie, off_t offset,
 	int32 pageOffset, addr_t buffer, size_t bufferSize, bool useBuffer,
-	vm_page_reservation* reservation, size_t reservePages);
+	const io_batch* batch, vm_page_reservation* reservation,
+	size_t reservePages);
 
 static void add_to_iovec(generic_io_vec* vecs, uint32 &index, uint32 max,
 	generic_addr_t address, generic_size_t size);
@@ -112,6 +160,8 @@ static const size_t kZeroVecSize = kZeroVecCount * B_PAGE_SIZE;
 static phys_addr_t sZeroPage;
 static generic_io_vec sZeroVecs[kZeroVecCount];
 
+static object_cache* sWiredPageCache;
+
 
 //	#pragma mark -
 
@@ -368,28 +418,27 @@ read_pages_and_clear_partial(file_cache_ref* ref, void* cookie, off_t offset,
 
 /*!	Reads the requested amount of data into the cache, and allocates
 	pages needed to fulfill that request. This function is called by cache_io().
-	It can only handle a certain amount of bytes, and the caller must make
-	sure that it matches that criterion.
+	It can only handle as many pages as fit into \a batch, and the caller must
+	make sure that it matches that criterion.
 	The cache_ref lock must be held when calling this function; during
 	operation it will unlock the cache, though.
 */
 static status_t
 read_into_cache(file_cache_ref* ref, void* cookie, off_t offset,
 	int32 pageOffset, addr_t buffer, size_t bufferSize, bool useBuffer,
-	vm_page_reservation* reservation, size_t reservePages)
+	const io_batch* batch, vm_page_reservation* reservation,
+	size_t reservePages)
 {
 	TRACE(("read_into_cache(offset = %lld, pageOffset = %ld, buffer = %#lx, "
 		"bufferSize = %lu\n", offset, pageOffset, buffer, bufferSize));
 
 	VMCache* cache = ref->cache;
 
-	// TODO: We're using way too much stack! Rather allocate a sufficiently
-	// large chunk on the heap.
-	generic_io_vec vecs[MAX_IO_VECS];
+	generic_io_vec* vecs = batch->vecs;
 	uint32 vecCount = 0;
 
 	generic_size_t numBytes = PAGE_ALIGN(pageOffset + bufferSize);
-	vm_page* pages[MAX_IO_VECS];
+	vm_page** pages = batch->pages;
 	int32 pageIndex = 0;
 
 	// allocate pages for the cache and mark them busy
@@ -399,9 +448,8 @@ read_into_cache(file_cache_ref* ref, void* cookie, off_t offset,
 
 		cache->InsertPage(page, offset + pos);
 
-		add_to_iovec(vecs, vecCount, MAX_IO_VECS,
+		add_to_iovec(vecs, vecCount, batch->max_pages,
 			page->physical_page_number * B_PAGE_SIZE, B_PAGE_SIZE);
-			// TODO: check if the array is large enough (currently panics)!
 	}
 
 	push_access(ref, offset, bufferSize, false);
@@ -460,7 +508,8 @@ read_into_cache(file_cache_ref* ref, void* cookie, off_t offset,
 static status_t
 read_from_file(file_cache_ref* ref, void* cookie, off_t offset,
 	int32 pageOffset, addr_t buffer, size_t bufferSize, bool useBuffer,
-	vm_page_reservation* reservation, size_t reservePages)
+	const io_batch* batch, vm_page_reservation* reservation,
+	size_t reservePages)
 {
 	TRACE(("read_from_file(offset = %lld, pageOffset = %ld, buffer = %#lx, "
 		"bufferSize = %lu\n", offset, pageOffset, buffer, bufferSize));
@@ -497,14 +546,13 @@ read_from_file(file_cache_ref* ref, void* cookie, off_t offset,
 static status_t
 write_to_cache(file_cache_ref* ref, void* cookie, off_t offset,
 	int32 pageOffset, addr_t buffer, size_t bufferSize, bool useBuffer,
-	vm_page_reservation* reservation, size_t reservePages)
+	const io_batch* batch, vm_page_reservation* reservation,
+	size_t reservePages)
 {
-	// TODO: We're using way too much stack! Rather allocate a sufficiently
-	// large chunk on the heap.
-	generic_io_vec vecs[MAX_IO_VECS];
+	generic_io_vec* vecs = batch->vecs;
 	uint32 vecCount = 0;
 	generic_size_t numBytes = PAGE_ALIGN(pageOffset + bufferSize);
-	vm_page* pages[MAX_IO_VECS];
+	vm_page** pages = batch->pages;
 	int32 pageIndex = 0;
 	status_t status = B_OK;
 
@@ -527,7 +575,7 @@ write_to_cache(file_cache_ref* ref, void* cookie, off_t offset,
 
 		ref->cache->InsertPage(page, offset + pos);
 
-		add_to_iovec(vecs, vecCount, MAX_IO_VECS,
+		add_to_iovec(vecs, vecCount, batch->max_pages,
 			page->physical_page_number * B_PAGE_SIZE, B_PAGE_SIZE);
 	}
 
@@ -669,7 +717,7 @@ write_zeros_to_file(struct vnode* vnode, void* cookie, off_t offset,
 
 static status_t
 write_to_file(file_cache_ref* ref, void* cookie, off_t offset, int32 pageOffset,
-	addr_t buffer, size_t bufferSize, bool useBuffer,
+	addr_t buffer, size_t bufferSize, bool useBuffer, const io_batch* batch,
 	vm_page_reservation* reservation, size_t reservePages)
 {
 	push_access(ref, offset, bufferSize, true);
@@ -704,17 +752,18 @@ satisfy_cache_io(file_cache_ref* ref, void* cookie, cache_func function,
 	off_t offset, addr_t buffer, bool useBuffer, int32 &pageOffset,
 	size_t bytesLeft, size_t &reservePages, off_t &lastOffset,
 	addr_t &lastBuffer, int32 &lastPageOffset, size_t &lastLeft,
-	size_t &lastReservedPages, vm_page_reservation* reservation)
+	size_t &lastReservedPages, const io_batch* batch,
+	vm_page_reservation* reservation)
 {
 	if (lastBuffer == buffer)
 		return B_OK;
 
 	size_t requestSize = buffer - lastBuffer;
-	reservePages = min_c(MAX_IO_VECS, (lastLeft - requestSize
+	reservePages = min_c(batch->max_pages, (lastLeft - requestSize
 		+ lastPageOffset + B_PAGE_SIZE - 1) >> PAGE_SHIFT);
 
 	status_t status = function(ref, cookie, lastOffset, lastPageOffset,
-		lastBuffer, requestSize, useBuffer, reservation, reservePages);
+		lastBuffer, requestSize, useBuffer, batch, reservation, reservePages);
 	if (status == B_OK) {
 		lastReservedPages = reservePages;
 		lastBuffer = buffer;
@@ -749,13 +798,35 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 	// the "last*" variables always point to the end of the last
 	// satisfied request part
 
-	const uint32 kMaxChunkSize = MAX_IO_VECS * B_PAGE_SIZE;
+	// Requests that span more than MAX_IO_VECS pages are handled in chunks of
+	// up to MAX_IO_BATCH_PAGES pages, so that the file system gets to see
+	// few large I/Os, and we don't have to go through the cache lock and the
+	// page reservation for every 128 kB. Splitting the vectors up according
+	// to the device's DMA restrictions is left to the I/O scheduler.
+	generic_io_vec stackVecs[MAX_IO_VECS];
+	vm_page* stackPages[MAX_IO_VECS];
+	io_batch batch = { stackVecs, stackPages, MAX_IO_VECS };
+
+	size_t requestPages = (pageOffset + size + B_PAGE_SIZE - 1) >> PAGE_SHIFT;
+	if (requestPages > MAX_IO_VECS
+		&& low_resource_state(B_KERNEL_RESOURCE_PAGES) == B_NO_LOW_RESOURCE) {
+		uint32 batchPages = min_c(requestPages, MAX_IO_BATCH_PAGES);
+		generic_io_vec* vecs = (generic_io_vec*)malloc(batchPages
+			* (sizeof(generic_io_vec) + sizeof(vm_page*)));
+		if (vecs != NULL) {
+			batch.vecs = vecs;
+			batch.pages = (vm_page**)(vecs + batchPages);
+			batch.max_pages = batchPages;
+		}
+	}
+	MemoryDeleter batchDeleter(batch.vecs != stackVecs ? batch.vecs : NULL);
+
+	const size_t kMaxChunkSize = (size_t)batch.max_pages * B_PAGE_SIZE;
 	size_t bytesLeft = size, lastLeft = size;
 	int32 lastPageOffset = pageOffset;
 	addr_t lastBuffer = buffer;
 	off_t lastOffset = offset;
-	size_t lastReservedPages = min_c(MAX_IO_VECS, (pageOffset + bytesLeft
-		+ B_PAGE_SIZE - 1) >> PAGE_SHIFT);
+	size_t lastReservedPages = min_c(batch.max_pages, requestPages);
 	size_t reservePages = 0;
 	size_t pagesProcessed = 0;
 	cache_func function = NULL;
@@ -789,7 +860,7 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 			status_t status = satisfy_cache_io(ref, cookie, function, offset,
 				buffer, useBuffer, pageOffset, bytesLeft, reservePages,
 				lastOffset, lastBuffer, lastPageOffset, lastLeft,
-				lastReservedPages, &reservation);
+				lastReservedPages, &batch, &reservation);
 			if (status != B_OK)
 				return status;
 
@@ -886,7 +957,7 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 			status_t status = satisfy_cache_io(ref, cookie, function, offset,
 				buffer, useBuffer, pageOffset, bytesLeft, reservePages,
 				lastOffset, lastBuffer, lastPageOffset, lastLeft,
-				lastReservedPages, &reservation);
+				lastReservedPages, &batch, &reservation);
 			if (status != B_OK)
 				return status;
 		}
@@ -895,7 +966,186 @@ cache_io(void* _cacheRef, void* cookie, off_t offset, addr_t buffer,
 	// fill the last remaining bytes of the request (either write or read)
 
 	return function(ref, cookie, lastOffset, lastPageOffset, lastBuffer,
-		lastLeft, useBuffer, &reservation, 0);
+		lastLeft, useBuffer, &batch, &reservation, 0);
+}
+
+
+/*!	Asynchronously reads all pages in the given range that are not yet in
+	the cache. \a offset and \a size must be page aligned, and enough pages
+	must have been reserved to cover the whole range.
+	The cache must be locked; it is temporarily unlocked while the I/O
+	requests are issued.
+*/
+static void
+precache_range(file_cache_ref* ref, off_t offset, size_t size,
+	vm_page_reservation* reservation)
+{
+	VMCache* cache = ref->cache;
+	size_t bytesToRead = 0;
+	off_t lastOffset = offset;
+
+	while (true) {
+		// check if this page is already in memory
+		if (size > 0) {
+			vm_page* page = cache->LookupPage(offset);
+
+			offset += B_PAGE_SIZE;
+			size -= B_PAGE_SIZE;
+
+			if (page == NULL) {
+				bytesToRead += B_PAGE_SIZE;
+				continue;
+			}
+		}
+		if (bytesToRead != 0) {
+			// read the part before the current page (or the end of the request)
+			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
+				bytesToRead);
+			if (io == NULL || io->Prepare(reservation) != B_OK) {
+				delete io;
+				break;
+			}
+
+			// we must not have the cache locked during I/O
+			cache->Unlock();
+			io->ReadAsync();
+			cache->Lock();
+
+			bytesToRead = 0;
+		}
+
+		if (size == 0) {
+			// we have reached the end of the request
+			break;
+		}
+
+		lastOffset = offset;
+	}
+}
+
+
+static void
+init_read_ahead(file_cache_ref* ref)
+{
+	for (int32 i = 0; i < READ_AHEAD_STREAMS; i++) {
+		read_ahead_stream& stream = ref->streams[i];
+		stream.next_offset = -1;
+		stream.ahead_end = 0;
+		stream.window = 0;
+		stream.last_used = 0;
+	}
+	ref->read_ahead_tick = 0;
+}
+
+
+/*!	Finds the read stream the read of \a size bytes at \a offset belongs to,
+	and updates its read-ahead window. A stream that keeps reading
+	sequentially gets its window doubled every time it catches up with the
+	data read ahead for it; streams that skip around have it halved, and
+	accesses that don't belong to any stream replace the least recently used
+	one.
+	Returns the stream if it should read ahead, and the range to read in
+	\a _aheadOffset and \a _aheadEnd.
+	The cache must be locked.
+*/
+static read_ahead_stream*
+update_read_ahead(file_cache_ref* ref, off_t offset, size_t size,
+	off_t& _aheadOffset, off_t& _aheadEnd)
+{
+	const off_t end = offset + size;
+	read_ahead_stream* stream = NULL;
+	read_ahead_stream* oldest = &ref->streams[0];
+
+	for (int32 i = 0; i < READ_AHEAD_STREAMS; i++) {
+		read_ahead_stream& candidate = ref->streams[i];
+		if (candidate.next_offset >= 0
+			&& offset >= candidate.next_offset - B_PAGE_SIZE
+			&& offset <= max_c(candidate.ahead_end,
+				candidate.next_offset + B_PAGE_SIZE)) {
+			stream = &candidate;
+			break;
+		}
+		if (candidate.last_used < oldest->last_used)
+			oldest = &candidate;
+	}
+
+	if (stream == NULL) {
+		// This is either random access, or a new stream -- only reading
+		// from the start of the file is sequential right away.
+		stream = oldest;
+		stream->window = offset == 0 ? kMinReadAhead : 0;
+		stream->ahead_end = end;
+	} else if (offset > stream->next_offset + B_PAGE_SIZE) {
+		// the stream skipped forward
+		stream->window /= 2;
+		if (stream->window < kMinReadAhead)
+			stream->window = 0;
+	} else if (stream->window == 0)
+		stream->window = kMinReadAhead;
+
+	stream->next_offset = end;
+	stream->last_used = ++ref->read_ahead_tick;
+
+	if (stream->window == 0)
+		return NULL;
+
+	if (stream->ahead_end < end)
+		stream->ahead_end = end;
+	else if (stream->ahead_end - end >= (off_t)stream->window / 2) {
+		// there is still enough data ahead of the reader
+		return NULL;
+	} else if (stream->ahead_end > end) {
+		// the stream caught up with what we have read ahead
+		stream->window = min_c(stream->window * 2, kMaxReadAhead);
+	}
+
+	_aheadOffset = ROUNDDOWN(stream->ahead_end, B_PAGE_SIZE);
+	_aheadEnd = min_c(stream->ahead_end + stream->window,
+		ref->cache->virtual_end);
+	_aheadEnd = ROUNDUP(_aheadEnd, B_PAGE_SIZE);
+	if (_aheadOffset >= _aheadEnd)
+		return NULL;
+
+	return stream;
+}
+
+
+/*!	Called after a successful read of \a size bytes at \a offset; starts
+	asynchronous read-ahead for the stream the read belongs to, if needed.
+*/
+static void
+read_ahead(file_cache_ref* ref, off_t offset, size_t size)
+{
+	VMCache* cache = ref->cache;
+	AutoLocker<VMCache> locker(cache);
+
+	off_t aheadOffset;
+	off_t aheadEnd;
+	read_ahead_stream* stream = update_read_ahead(ref, offset, size,
+		aheadOffset, aheadEnd);
+	if (stream == NULL)
+		return;
+
+	// Reading ahead is not worth making the memory situation any worse
+	uint32 pageCount = (aheadEnd - aheadOffset) / B_PAGE_SIZE;
+	vm_page_reservation reservation;
+	if (low_resource_state(B_KERNEL_RESOURCE_PAGES) != B_NO_LOW_RESOURCE
+		|| !vm_page_try_reserve_pages(&reservation, pageCount,
+			VM_PRIORITY_USER)) {
+		stream->window /= 2;
+		if (stream->window < kMinReadAhead)
+			stream->window = 0;
+		return;
+	}
+
+	TRACE(("read_ahead(ref = %p): %lld - %lld, window %lu\n", ref,
+		aheadOffset, aheadEnd, stream->window));
+
+	stream->ahead_end = aheadEnd;
+	precache_range(ref, aheadOffset, aheadEnd - aheadOffset, &reservation);
+	locker.Unlock();
+
+	vm_page_unreserve_pages(&reservation);
 }
 
 
@@ -986,71 +1236,208 @@ cache_prefetch_vnode(struct vnode* vnode, off_t offset, size_t size)
 		return;
 	}
 
-	size_t bytesToRead = 0;
-	off_t lastOffset = offset;
-
 	vm_page_reservation reservation;
 	vm_page_reserve_pages(&reservation, pagesCount, VM_PRIORITY_USER);
 
 	cache->Lock();
+	precache_range(ref, offset, size, &reservation);
+	cache->ReleaseRefAndUnlock();
 
-	while (true) {
-		// check if this page is already in memory
-		if (size > 0) {
-			vm_page* page = cache->LookupPage(offset);
+	vm_page_unreserve_pages(&reservation);
+}
 
-			offset += B_PAGE_SIZE;
-			size -= B_PAGE_SIZE;
 
-			if (page == NULL) {
-				bytesToRead += B_PAGE_SIZE;
-				continue;
-			}
-		}
-		if (bytesToRead != 0) {
-			// read the part before the current page (or the end of the request)
-			PrecacheIO* io = new(std::nothrow) PrecacheIO(ref, lastOffset,
-				bytesToRead);
-			if (io == NULL || io->Prepare(&reservation) != B_OK) {
-				delete io;
-				break;
-			}
+extern "C" void
+cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
+{
+	// ToDo: schedule prefetch
 
-			// we must not have the cache locked during I/O
-			cache->Unlock();
-			io->ReadAsync();
-			cache->Lock();
+	TRACE(("cache_prefetch(vnode %ld:%lld)\n", mountID, vnodeID));
 
-			bytesToRead = 0;
+	// get the vnode for the object, this also grabs a ref to it
+	struct vnode* vnode;
+	if (vfs_get_vnode(mountID, vnodeID, true, &vnode) != B_OK)
+		return;
+
+	cache_prefetch_vnode(vnode, offset, size);
+	vfs_put_vnode(vnode);
+}
+
+
+/*!	Wires and maps the pages of the file cache of \a vnode that contain the
+	range from \a offset to \a offset + \a size, and reads those that are
+	not cached yet. \a cookie is the file system's cookie of the open file.
+
+	On entry, \a _count specifies the number of entries available in
+	\a pages, on return it is set to the number of pages that have been
+	wired; they may cover less than the requested range. A count of zero
+	means \a offset lies beyond the end of the file.
+	Every returned page has to be released via file_cache_unwire_page()
+	again. Until then, its data stays valid, but it is not a snapshot: later
+	writes to the file will still be visible in it. If the file is truncated
+	in the mean time, the page is detached from the cache, and only freed
+	once it has been unwired.
+
+	Returns \c B_NOT_SUPPORTED if the file does not use the file cache.
+*/
+extern "C" status_t
+file_cache_wire_pages(struct vnode* vnode, void* cookie, off_t offset,
+	size_t size, file_cache_wired_page* pages, uint32* _count)
+{
+	uint32 maxCount = *_count;
+	*_count = 0;
+
+	if (offset < 0)
+		return B_BAD_VALUE;
+	if (sWiredPageCache == NULL)
+		return B_NO_MEMORY;
+
+	VMCache* cache;
+	if (vfs_get_vnode_cache(vnode, &cache, false) != B_OK)
+		return B_NOT_SUPPORTED;
+
+	file_cache_ref* ref = NULL;
+	if (cache->type == CACHE_TYPE_VNODE)
+		ref = ((VMVnodeCache*)cache)->FileCacheRef();
+	if (ref == NULL || ref->disabled_count > 0) {
+		cache->ReleaseRef();
+		return B_NOT_SUPPORTED;
+	}
+
+	const off_t fileSize = cache->virtual_end;
+	if (offset >= fileSize || size == 0 || maxCount == 0) {
+		cache->ReleaseRef();
+		return B_OK;
+	}
+
+	int32 pageOffset = offset & (B_PAGE_SIZE - 1);
+	if ((off_t)(offset + size) > fileSize)
+		size = fileSize - offset;
+	size = min_c(size, (size_t)maxCount * B_PAGE_SIZE - pageOffset);
+
+	// Bring the whole range into the cache first; without a buffer, this
+	// doesn't copy anything
+	size_t bytes = size;
+	status_t status = cache_io(ref, cookie, offset, 0, &bytes, false);
+	if (status != B_OK) {
+		cache->ReleaseRef();
+		return status;
+	}
+	read_ahead(ref, offset, size);
+
+	off_t pageStart = offset - pageOffset;
+	uint32 count = 0;
+
+	cache->Lock();
+
+	while (count < maxCount && size > 0) {
+		// In low memory situations, cache_io() may have bypassed the cache,
+		// or the page might have been stolen already
+		vm_page* page = cache->LookupPage(pageStart);
+		if (page == NULL)
+			break;
+		if (page->busy) {
+			cache->WaitForPageEvents(page, PAGE_EVENT_NOT_BUSY, true);
+			continue;
 		}
 
-		if (size == 0) {
-			// we have reached the end of the request
+		wired_file_page* wired = (wired_file_page*)object_cache_alloc(
+			sWiredPageCache, CACHE_DONT_WAIT_FOR_MEMORY);
+		if (wired == NULL)
 			break;
+
+		if (!page->IsMapped())
+			atomic_add(&gMappedPagesCount, 1);
+		page->IncrementWiredCount();
+
+		// The page counts as mapped now, and therefore must not remain in
+		// the cached queue
+		if (page->State() == PAGE_STATE_CACHED
+			|| page->State() == PAGE_STATE_INACTIVE) {
+			DEBUG_PAGE_ACCESS_START(page);
+			vm_page_set_state(page, PAGE_STATE_ACTIVE);
+			DEBUG_PAGE_ACCESS_END(page);
 		}
 
-		lastOffset = offset;
+		cache->AcquireRefLocked();
+		wired->cache = cache;
+		wired->page = page;
+		wired->address = 0;
+
+		size_t length = min_c((size_t)B_PAGE_SIZE - pageOffset, size);
+		pages[count].data = (void*)(addr_t)pageOffset;
+		pages[count].length = length;
+		pages[count].ref = wired;
+		count++;
+
+		size -= length;
+		pageStart += B_PAGE_SIZE;
+		pageOffset = 0;
 	}
 
 	cache->ReleaseRefAndUnlock();
-	vm_page_unreserve_pages(&reservation);
+
+	// Map the pages; this may block, and can therefore not be done with the
+	// cache locked. The pages cannot go away anymore, though.
+	for (uint32 i = 0; i < count; i++) {
+		wired_file_page* wired = (wired_file_page*)pages[i].ref;
+		status = vm_get_physical_page(
+			(phys_addr_t)wired->page->physical_page_number * B_PAGE_SIZE,
+			&wired->address, &wired->handle);
+		if (status != B_OK) {
+			wired->address = 0;
+			for (uint32 j = i; j < count; j++)
+				file_cache_unwire_page(pages[j].ref);
+			count = i;
+			break;
+		}
+
+		pages[i].data = (uint8*)wired->address + (addr_t)pages[i].data;
+	}
+
+	*_count = count;
+	if (count == 0)
+		return status != B_OK ? status : B_NO_MEMORY;
+
+	return B_OK;
 }
 
 
+/*!	Releases a page that has been wired by file_cache_wire_pages(). \a ref
+	is the file_cache_wired_page::ref of that page.
+*/
 extern "C" void
-cache_prefetch(dev_t mountID, ino_t vnodeID, off_t offset, size_t size)
+file_cache_unwire_page(void* ref)
 {
-	// ToDo: schedule prefetch
+	wired_file_page* wired = (wired_file_page*)ref;
+	VMCache* cache = wired->cache;
+	vm_page* page = wired->page;
 
-	TRACE(("cache_prefetch(vnode %ld:%lld)\n", mountID, vnodeID));
+	if (wired->address != 0)
+		vm_put_physical_page(wired->address, wired->handle);
 
-	// get the vnode for the object, this also grabs a ref to it
-	struct vnode* vnode;
-	if (vfs_get_vnode(mountID, vnodeID, true, &vnode) != B_OK)
-		return;
+	cache->Lock();
 
-	cache_prefetch_vnode(vnode, offset, size);
-	vfs_put_vnode(vnode);
+	page->DecrementWiredCount();
+	if (!page->IsMapped())
+		atomic_add(&gMappedPagesCount, -1);
+
+	if (page->Cache() == NULL) {
+		// The file has been truncated in the mean time, and the page was
+		// only kept alive for its users; see VMCache::_FreePageRange()
+		if (page->WiredCount() == 0)
+			vm_free_detached_page(page);
+	} else if (!page->IsMapped() && !page->busy
+		&& page->State() == PAGE_STATE_ACTIVE) {
+		// put the page back where an unmapped page of a file belongs
+		DEBUG_PAGE_ACCESS_START(page);
+		vm_page_set_state(page, page->modified
+			? PAGE_STATE_MODIFIED : PAGE_STATE_CACHED);
+		DEBUG_PAGE_ACCESS_END(page);
+	}
+
+	cache->ReleaseRefAndUnlock();
+	object_cache_free(sWiredPageCache, wired, 0);
 }
 
 
@@ -1129,6 +1516,9 @@ file_cache_init(void)
 		sZeroVecs[i].length = B_PAGE_SIZE;
 	}
 
+	sWiredPageCache = create_object_cache("wired file pages",
+		sizeof(wired_file_page), 0, NULL, NULL, NULL);
+
 	register_generic_syscall(CACHE_SYSCALLS, file_cache_control, 1, 0);
 	return B_OK;
 }
@@ -1150,6 +1540,7 @@ file_cache_create(dev_t mountID, ino_t vnodeID, off_t size)
 	memset(ref->last_access, 0, sizeof(ref->last_access));
 	ref->last_access_index = 0;
 	ref->disabled_count = 0;
+	init_read_ahead(ref);
 
 	// TODO: delay VMCache creation until data is
 	//	requested/written for the first time? Listing lots of
@@ -1327,7 +1718,12 @@ file_cache_read(void* _cacheRef, void* cookie, off_t offset, void* buffer,
 		return error;
 	}
 
-	return cache_io(ref, cookie, offset, (addr_t)buffer, _size, false);
+	status_t status = cache_io(ref, cookie, offset, (addr_t)buffer, _size,
+		false);
+	if (status == B_OK && *_size > 0)
+		read_ahead(ref, offset, *_size);
+
+	return status;
 }
 
 
@@ -7,13 +7,30 @@
 #include "EntryCache.h"
 
 #include <new>
+#include <KernelExport.h>
+#include <arch/atomic.h>
 #include <vm/vm.h>
 #include <slab/Slab.h>
 
 
+/*	Lookups usually do not take any lock. Instead, every change to the hash
+	table or to an entry is enclosed by increments of a sequence counter, and
+	a lookup is only valid if the counter was even and did not change while
+	it was in progress. Entries that have been removed from the table, and
+	the buckets of a resized table, are only freed once all CPUs have
+	acknowledged an inter-CPU call, since a lookup runs with interrupts
+	disabled.
+	Only entries in the younger half of the generations are found this way;
+	all others need the lock to be moved to the current generation, so that
+	they don't get evicted.
+*/
+
+
 static const int32 kEntryNotInArray = -1;
 static const int32 kEntryRemoved = -2;
 
+static const int32 kMaxLocklessSteps = 32;
+
 
 // #pragma mark - EntryCacheGeneration
 
@@ -52,7 +69,10 @@ EntryCache::EntryCache()
 	:
 	fGenerationCount(0),
 	fGenerations(NULL),
-	fCurrentGeneration(0)
+	fCurrentGeneration(0),
+	fCacheMissing(true),
+	fSequence(0),
+	fDeferredCount(0)
 {
 	rw_lock_init(&fLock, "entry cache");
 
@@ -69,6 +89,8 @@ EntryCache::~EntryCache()
 		free(entry);
 		entry = next;
 	}
+	for (int32 i = 0; i < fDeferredCount; i++)
+		free(fDeferredEntries[i]);
 	delete[] fGenerations;
 
 	rw_lock_destroy(&fLock);
@@ -76,8 +98,10 @@ EntryCache::~EntryCache()
 
 
 status_t
-EntryCache::Init()
+EntryCache::Init(bool cacheMissing)
 {
+	fCacheMissing = cacheMissing;
+
 	status_t error = fEntries.Init();
 	if (error != B_OK)
 		return error;
@@ -113,10 +137,20 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 	if (fGenerationCount == 0)
 		return B_NO_MEMORY;
 
+	if (missing && !fCacheMissing) {
+		// negative entries are not cached on this volume, but an existing
+		// entry would be stale now
+		_RemoveEntry(key);
+		return B_OK;
+	}
+
 	EntryCacheEntry* entry = fEntries.Lookup(key);
 	if (entry != NULL) {
+		_BeginChange();
 		entry->node_id = nodeID;
 		entry->missing = missing;
+		_EndChange();
+
 		if (entry->generation != fCurrentGeneration) {
 			if (entry->index >= 0) {
 				fGenerations[entry->generation].entries[entry->index] = NULL;
@@ -142,7 +176,11 @@ EntryCache::Add(ino_t dirID, const char* name, ino_t nodeID, bool missing)
 	entry->index = kEntryNotInArray;
 	memcpy(entry->name, name, nameLen + 1);
 
+	_ResizeTable();
+
+	_BeginChange();
 	fEntries.Insert(entry);
+	_EndChange();
 
 	_AddEntryToCurrentGeneration(entry);
 
@@ -157,24 +195,7 @@ EntryCache::Remove(ino_t dirID, const char* name)
 
 	WriteLocker writeLocker(fLock);
 
-	EntryCacheEntry* entry = fEntries.Lookup(key);
-	if (entry == NULL)
-		return B_ENTRY_NOT_FOUND;
-
-	fEntries.Remove(entry);
-
-	if (entry->index >= 0) {
-		// remove the entry from its generation and delete it
-		fGenerations[entry->generation].entries[entry->index] = NULL;
-		free(entry);
-	} else {
-		// We can't free it, since another thread is about to try to move it
-		// to another generation. We mark it removed and the other thread will
-		// take care of deleting it.
-		entry->index = kEntryRemoved;
-	}
-
-	return B_OK;
+	return _RemoveEntry(key) ? B_OK : B_ENTRY_NOT_FOUND;
 }
 
 
@@ -184,6 +205,9 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 {
 	EntryCacheKey key(dirID, name);
 
+	if (_LocklessLookup(key, _nodeID, _missing))
+		return true;
+
 	ReadLocker readLocker(fLock);
 
 	EntryCacheEntry* entry = fEntries.Lookup(key);
@@ -221,7 +245,7 @@ EntryCache::Lookup(ino_t dirID, const char* name, ino_t& _nodeID,
 
 	if (entry->index == kEntryRemoved) {
 		// the entry has been removed in the meantime
-		free(entry);
+		_FreeEntry(entry);
 		return false;
 	}
 
@@ -249,6 +273,110 @@ EntryCache::DebugReverseLookup(ino_t nodeID, ino_t& _dirID)
 }
 
 
+/*!	Looks up the entry without locking. Returns \c false if the entry could
+	not be found this way; it might still be in the cache, though.
+*/
+bool
+EntryCache::_LocklessLookup(const EntryCacheKey& key, ino_t& _nodeID,
+	bool& _missing)
+{
+	const int32 sequence = atomic_get(&fSequence);
+	if ((sequence & 1) != 0)
+		return false;
+
+	bool found = false;
+	ino_t nodeID = -1;
+	bool missing = false;
+
+	cpu_status state = disable_interrupts();
+
+	EntryCacheEntry* entry = fEntries.LocklessLookup(key, kMaxLocklessSteps,
+		&fSequence, sequence);
+	if (entry != NULL) {
+		int32 age = atomic_get(&fCurrentGeneration)
+			- atomic_get(&entry->generation);
+		if (age < 0)
+			age += fGenerationCount;
+
+		if (age < fGenerationCount / 2) {
+			nodeID = entry->node_id;
+			missing = entry->missing;
+			found = true;
+		}
+	}
+
+	restore_interrupts(state);
+
+	memory_read_barrier();
+	if (!found || atomic_get(&fSequence) != sequence)
+		return false;
+
+	_nodeID = nodeID;
+	_missing = missing;
+	return true;
+}
+
+
+/*!	Removes the entry for \a key from the cache, if there is one.
+	The write lock must be held.
+*/
+bool
+EntryCache::_RemoveEntry(const EntryCacheKey& key)
+{
+	ASSERT_WRITE_LOCKED_RW_LOCK(&fLock);
+
+	EntryCacheEntry* entry = fEntries.Lookup(key);
+	if (entry == NULL)
+		return false;
+
+	_BeginChange();
+	fEntries.Remove(entry);
+	_EndChange();
+
+	if (entry->index >= 0) {
+		// remove the entry from its generation and delete it
+		fGenerations[entry->generation].entries[entry->index] = NULL;
+		_FreeEntry(entry);
+	} else {
+		// We can't free it, since another thread is about to try to move it
+		// to another generation. We mark it removed and the other thread will
+		// take care of deleting it.
+		entry->index = kEntryRemoved;
+	}
+
+	return true;
+}
+
+
+/*!	Grows or shrinks the hash table, if necessary. Since lockless lookups
+	might still use the old buckets, they are only freed after all CPUs
+	have left them.
+*/
+void
+EntryCache::_ResizeTable()
+{
+	ASSERT_WRITE_LOCKED_RW_LOCK(&fLock);
+
+	size_t size = fEntries.ResizeNeeded();
+	if (size == 0)
+		return;
+
+	void* allocation = malloc_etc(size, CACHE_DONT_WAIT_FOR_MEMORY);
+	if (allocation == NULL) {
+		// the table will just be a bit slower
+		return;
+	}
+
+	void* oldTable;
+	_BeginChange();
+	fEntries.Resize(allocation, size, true, &oldTable);
+	_EndChange();
+
+	_WaitForReaders();
+	free(oldTable);
+}
+
+
 void
 EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 {
@@ -265,20 +393,82 @@ EntryCache::_AddEntryToCurrentGeneration(EntryCacheEntry* entry)
 
 	// we have to clear the oldest generation
 	const int32 newGeneration = (fCurrentGeneration + 1) % fGenerationCount;
-	for (int32 i = 0; i < fGenerations[newGeneration].entries_size; i++) {
-		EntryCacheEntry* otherEntry = fGenerations[newGeneration].entries[i];
-		if (otherEntry == NULL)
-			continue;
-
-		fGenerations[newGeneration].entries[i] = NULL;
-		fEntries.Remove(otherEntry);
-		free(otherEntry);
+	EntryCacheGeneration& generation = fGenerations[newGeneration];
+
+	_BeginChange();
+	for (int32 i = 0; i < generation.entries_size; i++) {
+		EntryCacheEntry* otherEntry = generation.entries[i];
+		if (otherEntry != NULL)
+			fEntries.Remove(otherEntry);
+	}
+	_EndChange();
+
+	// the removed entries can only be freed once no lockless lookup can
+	// access them anymore
+	_WaitForReaders();
+
+	for (int32 i = 0; i < generation.entries_size; i++) {
+		free(generation.entries[i]);
+		generation.entries[i] = NULL;
 	}
 
 	// set the new generation and add the entry
-	fCurrentGeneration = newGeneration;
-	fGenerations[newGeneration].entries[0] = entry;
-	fGenerations[newGeneration].next_index = 1;
+	atomic_set(&fCurrentGeneration, newGeneration);
+	generation.entries[0] = entry;
+	generation.next_index = 1;
 	entry->generation = newGeneration;
 	entry->index = 0;
 }
+
+
+void
+EntryCache::_BeginChange()
+{
+	atomic_add(&fSequence, 1);
+}
+
+
+void
+EntryCache::_EndChange()
+{
+	atomic_add(&fSequence, 1);
+}
+
+
+/*!	Frees an entry that has already been removed from the table, once no
+	lockless lookup can access it anymore.
+	The write lock must be held.
+*/
+void
+EntryCache::_FreeEntry(EntryCacheEntry* entry)
+{
+	fDeferredEntries[fDeferredCount++] = entry;
+	if (fDeferredCount == kMaxDeferredEntries)
+		_WaitForReaders();
+}
+
+
+static void
+wait_for_readers(void* /* cookie */, int /* cpu */)
+{
+}
+
+
+/*!	Waits until all lockless lookups that might have seen removed entries or
+	old buckets are done, and frees the deferred entries.
+	The write lock must be held.
+*/
+void
+EntryCache::_WaitForReaders()
+{
+	ASSERT_WRITE_LOCKED_RW_LOCK(&fLock);
+
+	// lockless lookups run with interrupts disabled, so once every CPU has
+	// executed the call, none of them can still be inside one that started
+	// before
+	call_all_cpus_sync(&wait_for_readers, NULL);
+
+	for (int32 i = 0; i < fDeferredCount; i++)
+		free(fDeferredEntries[i]);
+	fDeferredCount = 0;
+}
@@ -8,6 +8,7 @@
 
 #include <stdlib.h>
 
+#include <arch/atomic.h>
 #include <util/AutoLock.h>
 #include <util/DoublyLinkedList.h>
 #include <util/OpenHashTable.h>
@@ -89,12 +90,50 @@ struct EntryCacheHashDefinition {
 };
 
 
+/*!	A hash table that can be looked up without holding any lock. Lookups
+	may see the table in the middle of a change, and have to be validated
+	by the caller; EntryCache makes sure that the buckets and entries stay
+	accessible while a lockless lookup is in progress.
+	\a sequence is the change counter of the cache, and \a expectedSequence
+	the (even) value the caller read before starting the lookup.
+*/
+class EntryCacheTable : public BOpenHashTable<EntryCacheHashDefinition, false> {
+public:
+	EntryCacheEntry* LocklessLookup(const EntryCacheKey& key,
+		int32 maxSteps, int32* sequence, int32 expectedSequence) const
+	{
+		size_t tableSize = *(volatile size_t*)&this->fTableSize;
+		EntryCacheEntry* const* table
+			= *(EntryCacheEntry** const volatile*)&this->fTable;
+
+		// A resize sets the new size before the new buckets, so both only
+		// belong together if no change has begun since the caller read the
+		// sequence.
+		memory_read_barrier();
+		if (atomic_get(sequence) != expectedSequence)
+			return NULL;
+		if (tableSize == 0 || table == NULL)
+			return NULL;
+
+		EntryCacheEntry* entry
+			= *(EntryCacheEntry* volatile*)&table[key.hash & (tableSize - 1)];
+		while (entry != NULL && maxSteps-- > 0) {
+			if (this->fDefinition.Compare(key, entry))
+				return entry;
+			entry = *(EntryCacheEntry* volatile*)&entry->hash_link;
+		}
+
+		return NULL;
+	}
+};
+
+
 class EntryCache {
 public:
 								EntryCache();
 								~EntryCache();
 
-			status_t			Init();
+			status_t			Init(bool cacheMissing = true);
 
 			status_t			Add(ino_t dirID, const char* name,
 									ino_t nodeID, bool missing);
@@ -107,19 +146,37 @@ public:
 			const char*			DebugReverseLookup(ino_t nodeID, ino_t& _dirID);
 
 private:
-			typedef BOpenHashTable<EntryCacheHashDefinition> EntryTable;
+			typedef EntryCacheTable EntryTable;
 			typedef DoublyLinkedList<EntryCacheEntry> EntryList;
 
+	static	const int32			kMaxDeferredEntries = 64;
+
 private:
+			bool				_LocklessLookup(const EntryCacheKey& key,
+									ino_t& nodeID, bool& missing);
+			bool				_RemoveEntry(const EntryCacheKey& key);
+			void				_ResizeTable();
 			void				_AddEntryToCurrentGeneration(
 									EntryCacheEntry* entry);
 
+	inline	void				_BeginChange();
+	inline	void				_EndChange();
+			void				_FreeEntry(EntryCacheEntry* entry);
+			void				_WaitForReaders();
+
 private:
 			rw_lock				fLock;
 			EntryTable			fEntries;
 			int32				fGenerationCount;
 			EntryCacheGeneration* fGenerations;
 			int32				fCurrentGeneration;
+			bool				fCacheMissing;
+
+			int32				fSequence;
+				// odd while the table or its entries are being changed
+			EntryCacheEntry*	fDeferredEntries[kMaxDeferredEntries];
+			int32				fDeferredCount;
+				// removed entries that lockless lookups might still access
 };
 
 
@@ -18,6 +18,7 @@
 #include <syscall_utils.h>
 
 #include <fd.h>
+#include <file_cache.h>
 #include <kernel.h>
 #include <lock.h>
 #include <syscall_restart.h>
@@ -25,6 +26,7 @@
 #include <util/iovec_support.h>
 #include <vfs.h>
 
+#include <net_buffer.h>
 #include <net_stack_interface.h>
 #include <net_stat.h>
 
@@ -33,6 +35,9 @@
 #define MAX_SOCKET_OPTION_LENGTH	128
 #define MAX_ANCILLARY_DATA_LENGTH	1024
 
+#define MAX_SEND_FILE_PAGES			32
+#define SEND_FILE_BUFFER_SIZE		65536
+
 #define GET_SOCKET_FD_OR_RETURN(fd, kernel, descriptor)	\
 	do {												\
 		status_t getError = get_socket_descriptor(fd, kernel, descriptor); \
@@ -632,6 +637,151 @@ common_getsockname(int fd, struct sockaddr *address,
 }
 
 
+/*!	Sends the file's data directly out of the file cache, by handing its
+	pages over to the networking stack.
+	Returns \c B_NOT_SUPPORTED if either the file or the socket cannot do
+	this, and \c B_NO_MEMORY if the file cache could not keep the pages; in
+	both cases, nothing has been sent yet.
+*/
+static ssize_t
+send_file_pages(net_socket* socket, file_descriptor* descriptor, off_t pos,
+	size_t length, int flags)
+{
+	struct vnode* vnode = fd_vnode(descriptor);
+	if (vnode == NULL)
+		return B_NOT_SUPPORTED;
+
+	file_cache_wired_page pages[MAX_SEND_FILE_PAGES];
+	net_external_vec vecs[MAX_SEND_FILE_PAGES];
+	ssize_t bytesSent = 0;
+
+	while (length > 0) {
+		uint32 count = MAX_SEND_FILE_PAGES;
+		status_t status = file_cache_wire_pages(vnode, descriptor->cookie, pos,
+			length, pages, &count);
+		if (status != B_OK)
+			return bytesSent > 0 ? bytesSent : status;
+		if (count == 0) {
+			// we've reached the end of the file
+			break;
+		}
+
+		size_t bytes = 0;
+		for (uint32 i = 0; i < count; i++) {
+			vecs[i].data = pages[i].data;
+			vecs[i].length = pages[i].length;
+			vecs[i].release = &file_cache_unwire_page;
+			vecs[i].cookie = pages[i].ref;
+			bytes += pages[i].length;
+		}
+
+		// the stack takes over the pages in any case
+		ssize_t sent = sStackInterface->send_external(socket, vecs, count,
+			flags);
+		if (sent < 0)
+			return bytesSent > 0 ? bytesSent : sent;
+
+		bytesSent += sent;
+		pos += sent;
+		length -= sent;
+
+		if ((size_t)sent < bytes)
+			break;
+	}
+
+	return bytesSent;
+}
+
+
+/*!	Sends the file's data by reading it into an intermediate kernel buffer.
+	This works with any file descriptor that supports reading at a position.
+*/
+static ssize_t
+send_file_copy(net_socket* socket, file_descriptor* descriptor, off_t pos,
+	size_t length, int flags)
+{
+	size_t bufferSize = min_c(length, SEND_FILE_BUFFER_SIZE);
+	void* buffer = malloc(bufferSize);
+	if (buffer == NULL)
+		return B_NO_MEMORY;
+
+	MemoryDeleter bufferDeleter(buffer);
+	ssize_t bytesSent = 0;
+
+	while (length > 0) {
+		size_t bytes = min_c(length, bufferSize);
+		status_t status = descriptor->ops->fd_read(descriptor, pos, buffer,
+			&bytes);
+		if (status != B_OK)
+			return bytesSent > 0 ? bytesSent : status;
+		if (bytes == 0)
+			break;
+
+		ssize_t sent = sStackInterface->send(socket, buffer, bytes, flags);
+		if (sent < 0)
+			return bytesSent > 0 ? bytesSent : sent;
+
+		bytesSent += sent;
+		pos += sent;
+		length -= sent;
+
+		if ((size_t)sent < bytes)
+			break;
+	}
+
+	return bytesSent;
+}
+
+
+static ssize_t
+common_sendfile(int socketFD, int fd, off_t pos, size_t length, int flags,
+	bool kernel)
+{
+	if (pos < -1)
+		return B_BAD_VALUE;
+
+	file_descriptor* descriptor;
+	GET_SOCKET_FD_OR_RETURN(socketFD, kernel, descriptor);
+	FileDescriptorPutter _(descriptor);
+
+	FileDescriptorPutter file(get_fd(get_current_io_context(kernel), fd));
+	if (!file.IsSet())
+		return B_FILE_ERROR;
+	if ((file->open_mode & O_RWMASK) == O_WRONLY || file->ops->fd_read == NULL)
+		return B_FILE_ERROR;
+
+	bool movePosition = false;
+	if (pos == -1) {
+		// only positionable files can be sent
+		if (file->pos == -1)
+			return ESPIPE;
+
+		pos = file->pos;
+		movePosition = true;
+	}
+
+	if (length > SSIZE_MAX)
+		length = SSIZE_MAX;
+	if (length == 0)
+		return 0;
+
+	ssize_t bytesSent = B_NOT_SUPPORTED;
+	if (fd_is_file(file.Get())) {
+		bytesSent = send_file_pages(FD_SOCKET(descriptor), file.Get(), pos,
+			length, flags);
+	}
+	if (bytesSent == B_NOT_SUPPORTED || bytesSent == B_NO_MEMORY) {
+		bytesSent = send_file_copy(FD_SOCKET(descriptor), file.Get(), pos,
+			length, flags);
+	}
+
+	if (movePosition && bytesSent > 0)
+		file->pos = pos + bytesSent;
+
+	return bytesSent;
+}
+
+
 static int
 common_sockatmark(int fd, bool kernel)
 {
@@ -1157,6 +1307,14 @@ _user_sendmsg(int socket, const struct msghdr *userMessage, int flags)
 }
 
 
+ssize_t
+_user_sendfile(int socket, int fd, off_t pos, size_t length, int flags)
+{
+	SyscallRestartWrapper<ssize_t> result;
+	return result = common_sendfile(socket, fd, pos, length, flags, false);
+}
+
+
 status_t
 _user_getsockopt(int socket, int level, int option, void *userValue,
 	socklen_t *_length)
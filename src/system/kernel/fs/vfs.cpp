@@ -7500,7 +7500,8 @@ fs_mount(char* path, const char* device, const char* fsName, uint32 flags,
 	mount->device_name = strdup(device);
 		// "device" can be NULL
 
-	status = mount->entry_cache.Init();
+	status = mount->entry_cache.Init(
+		(flags & B_MOUNT_NO_NEGATIVE_ENTRY_CACHE) == 0);
 	if (status != B_OK)
 		goto err1;
 
@@ -24,6 +24,7 @@
 #include <AutoDeleter.h>
 #include <StackOrHeapArray.h>
 
+#include <arch/atomic.h>
 #include <arch/int.h>
 #include <heap.h>
 #include <kernel.h>
@@ -32,6 +33,7 @@
 #include <syscall_restart.h>
 #include <team.h>
 #include <tracing.h>
+#include <util/atomic.h>
 #include <util/AutoLock.h>
 #include <util/list.h>
 #include <util/iovec_support.h>
@@ -86,12 +88,29 @@
 //   understanding, the linearization points are annotated with comments.
 // * Ports are reference-counted so it's not a problem when someone still
 //   has a reference to a deleted port.
+//
+// Ports that are busy with messages from a single writer to a single reader
+// get a PortRing with preallocated message slots. Small messages can then be
+// passed through the ring without Port::lock, and without allocating them:
+// * Port::read_count, Port::write_count, Port::list_count, Port::total_count,
+//   Port::read_waiters, and Port::sequence are only changed atomically, and
+//   messages and slots are reserved by decrementing read_count and
+//   write_count, respectively.
+// * Only one writer at a time can use the ring, the one that managed to set
+//   PortRing::writing; any other writer falls back to the message list.
+// * PortRing::read_lock protects PortRing::read_index, and the transition of
+//   a slot from kSlotFull to kSlotReading.
+// * Messages are ordered by their sequence number, so that the oldest message
+//   is read first, no matter if it is in the ring, or in the message list.
+// * Lock-free writers and readers only take Port::lock to notify waiting
+//   threads, or select events.
 
 
 namespace {
 
 struct port_message : DoublyLinkedListLinkImpl<port_message> {
 	int32				code;
+	int32				sequence;
 	size_t				size;
 	uid_t				sender;
 	gid_t				sender_group;
@@ -101,10 +120,33 @@ struct port_message : DoublyLinkedListLinkImpl<port_message> {
 
 typedef DoublyLinkedList<port_message> MessageList;
 
+static const int32 kPortRingSlotCount = 16;
+static const size_t kPortRingSlotSize = 1024;
+
+enum {
+	kSlotFree = 0,
+	kSlotFull,
+	kSlotReading
+};
+
+struct port_ring_slot {
+	int32				state;
+	port_message*		message;
+};
+
+struct PortRing {
+	int32				writing;
+	uint32				write_index;
+	spinlock			read_lock;
+	uint32				read_index;
+	port_ring_slot		slots[kPortRingSlotCount];
+};
+
 } // namespace
 
 
 static void put_port_message(port_message* message);
+static void delete_port_ring(PortRing* ring);
 
 
 namespace {
@@ -125,14 +167,24 @@ struct Port : public KernelReferenceable {
 	int32				capacity;
 	mutex				lock;
 	int32				state;
-	uint32				read_count;
+	int32				read_count;
 	int32				write_count;
+	int32				list_count;
+		// messages in the message list
+	int32				read_waiters;
+	int32				sequence;
 	ConditionVariable	read_condition;
 	ConditionVariable	write_condition;
 	int32				total_count;
 		// messages read from port since creation
 	select_info*		select_infos;
 	MessageList			messages;
+	PortRing*			ring;
+	thread_id			last_writer;
+	thread_id			last_reader;
+	int32				sequential_count;
+		// messages written by last_writer since a different thread wrote
+		// to, or read from the port
 
 	Port(team_id owner, int32 queueLength, const char* name)
 		:
@@ -142,8 +194,15 @@ struct Port : public KernelReferenceable {
 		state(kUnused),
 		read_count(0),
 		write_count(queueLength),
+		list_count(0),
+		read_waiters(0),
+		sequence(0),
 		total_count(0),
-		select_infos(NULL)
+		select_infos(NULL),
+		ring(NULL),
+		last_writer(-1),
+		last_reader(-1),
+		sequential_count(0)
 	{
 		// id is initialized when the caller adds the port to the hash table
 
@@ -156,6 +215,8 @@ struct Port : public KernelReferenceable {
 	{
 		while (port_message* message = messages.RemoveHead())
 			put_port_message(message);
+		if (ring != NULL)
+			delete_port_ring(ring);
 
 		mutex_destroy(&lock);
 	}
@@ -442,6 +503,12 @@ static const size_t kTotalSpaceLimit = 64 * 1024 * 1024;
 static const size_t kTeamSpaceLimit = 8 * 1024 * 1024;
 static const size_t kBufferGrowRate = kInitialPortBufferSize;
 
+static const int32 kPortRingThreshold = 64;
+	// messages a single writer has to send to a single reader before the
+	// port gets a ring
+static const size_t kPortRingMessageSize
+	= sizeof(port_message) + kPortRingSlotSize;
+
 #define MAX_QUEUE_LENGTH 4096
 #define PORT_MAX_MESSAGE_SIZE (256 * 1024)
 
@@ -524,7 +591,7 @@ dump_port_list(int argc, char** argv)
 			|| (name != NULL && strstr(port->lock.name, name) == NULL))
 			continue;
 
-		kprintf("%p %8" B_PRId32 " %4" B_PRId32 " %9" B_PRIu32 " %9" B_PRId32
+		kprintf("%p %8" B_PRId32 " %4" B_PRId32 " %9" B_PRId32 " %9" B_PRId32
 			" %8" B_PRId32 " %6" B_PRId32 "  %s\n", port, port->id,
 			port->capacity, port->read_count, port->write_count,
 			port->total_count, port->owner, port->lock.name);
@@ -542,7 +609,7 @@ _dump_port_info(Port* port)
 	kprintf(" name:            \"%s\"\n", port->lock.name);
 	kprintf(" owner:           %" B_PRId32 "\n", port->owner);
 	kprintf(" capacity:        %" B_PRId32 "\n", port->capacity);
-	kprintf(" read_count:      %" B_PRIu32 "\n", port->read_count);
+	kprintf(" read_count:      %" B_PRId32 "\n", port->read_count);
 	kprintf(" write_count:     %" B_PRId32 "\n", port->write_count);
 	kprintf(" total count:     %" B_PRId32 "\n", port->total_count);
 
@@ -555,6 +622,22 @@ _dump_port_info(Port* port)
 		}
 	}
 
+	if (PortRing* ring = port->ring) {
+		kprintf("ring:            %p, write index %" B_PRIu32 ", read index %"
+			B_PRIu32 "%s\n", ring, ring->write_index, ring->read_index,
+			ring->writing != 0 ? ", writing" : "");
+
+		for (int32 i = 0; i < kPortRingSlotCount; i++) {
+			port_ring_slot& slot = ring->slots[i];
+			if (slot.state == kSlotFree)
+				continue;
+
+			kprintf(" %p  %08" B_PRIx32 "  %ld%s\n", slot.message,
+				slot.message->code, slot.message->size,
+				slot.state == kSlotReading ? " (reading)" : "");
+		}
+	}
+
 	set_debug_variable("_port", (addr_t)port);
 	set_debug_variable("_portID", port->id);
 	set_debug_variable("_owner", port->owner);
@@ -624,6 +707,14 @@ notify_port_select_events(Port* port, uint16 events)
 }
 
 
+/*!	Locks the port, if it is still active. */
+static inline bool
+lock_port(Port* port)
+{
+	return port->state == Port::kActive && mutex_lock(&port->lock) == B_OK;
+}
+
+
 static BReference<Port>
 get_locked_port(port_id id) GCC_2_NRV(portRef)
 {
@@ -635,10 +726,7 @@ get_locked_port(port_id id) GCC_2_NRV(portRef)
 		portRef.SetTo(sPorts.Lookup(id));
 	}
 
-	if (portRef != NULL && portRef->state == Port::kActive) {
-		if (mutex_lock(&portRef->lock) != B_OK)
-			portRef.Unset();
-	} else
+	if (portRef != NULL && !lock_port(portRef))
 		portRef.Unset();
 
 	return portRef;
@@ -792,6 +880,358 @@ copy_port_message(port_message* message, int32* _code, void* buffer,
 }
 
 
+/*!	Copies the contents of \a vecs into the buffer of \a message, which must
+	be large enough to hold \a bufferSize bytes.
+*/
+static status_t
+fill_port_message(port_message* message, const iovec* vecs, size_t vecCount,
+	size_t bufferSize, bool userCopy)
+{
+	// sender credentials
+	message->sender = geteuid();
+	message->sender_group = getegid();
+	message->sender_team = team_get_current_team_id();
+
+	size_t offset = 0;
+	for (uint32 i = 0; i < vecCount && bufferSize > 0; i++) {
+		size_t bytes = vecs[i].iov_len;
+		if (bytes > bufferSize)
+			bytes = bufferSize;
+
+		if (userCopy) {
+			status_t status = user_memcpy(message->buffer + offset,
+				vecs[i].iov_base, bytes);
+			if (status != B_OK)
+				return status;
+		} else
+			memcpy(message->buffer + offset, vecs[i].iov_base, bytes);
+
+		bufferSize -= bytes;
+		offset += bytes;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Atomically decrements \a count, if it is greater than zero.
+	Returns whether or not it did.
+*/
+static inline bool
+reserve_port_count(int32* count)
+{
+	int32 value = atomic_get(count);
+	while (value > 0) {
+		int32 previous = atomic_test_and_set(count, value - 1, value);
+		if (previous == value)
+			return true;
+
+		value = previous;
+	}
+
+	return false;
+}
+
+
+static void
+create_port_ring(Port* port)
+{
+	const size_t size = sizeof(PortRing)
+		+ kPortRingSlotCount * kPortRingMessageSize;
+
+	// the ring counts against the space limit just like the messages
+	int32 previouslyCommited = atomic_add(&sTotalSpaceCommited, size);
+	if (previouslyCommited + size > kTotalSpaceLimit) {
+		atomic_add(&sTotalSpaceCommited, -size);
+		return;
+	}
+
+	PortRing* ring = (PortRing*)malloc(size);
+	if (ring == NULL) {
+		atomic_add(&sTotalSpaceCommited, -size);
+		return;
+	}
+
+	ring->writing = 0;
+	ring->write_index = 0;
+	B_INITIALIZE_SPINLOCK(&ring->read_lock);
+	ring->read_index = 0;
+
+	uint8* buffer = (uint8*)(ring + 1);
+	for (int32 i = 0; i < kPortRingSlotCount; i++) {
+		ring->slots[i].state = kSlotFree;
+		ring->slots[i].message
+			= (port_message*)(buffer + i * kPortRingMessageSize);
+	}
+
+	atomic_pointer_set(&port->ring, ring);
+}
+
+
+static void
+delete_port_ring(PortRing* ring)
+{
+	const size_t size = sizeof(PortRing)
+		+ kPortRingSlotCount * kPortRingMessageSize;
+	free(ring);
+
+	atomic_add(&sTotalSpaceCommited, -size);
+	if (sWaitingForSpace > 0)
+		sNoSpaceCondition.NotifyAll();
+}
+
+
+/*!	Keeps track of who is using the port, and gives it a ring when it is
+	being used by a single writer and a single reader.
+	The port must be locked.
+*/
+static void
+update_port_users(Port* port, bool writer, size_t bufferSize)
+{
+	if (port->ring != NULL)
+		return;
+
+	thread_id thread = thread_get_current_thread_id();
+	if (!writer) {
+		if (thread != port->last_reader) {
+			port->last_reader = thread;
+			port->sequential_count = 0;
+		}
+		return;
+	}
+
+	if (thread != port->last_writer) {
+		port->last_writer = thread;
+		port->sequential_count = 0;
+	} else if (bufferSize <= kPortRingSlotSize
+		&& ++port->sequential_count >= kPortRingThreshold) {
+		create_port_ring(port);
+	}
+}
+
+
+/*!	Returns the oldest message of the port, which is either the head of its
+	message list, or in the next slot of its ring. In the latter case,
+	\a _slot is set to the slot, and \a ringLocker holds the read lock of the
+	ring, which must not be released while the message is accessed.
+	The port must be locked.
+*/
+static port_message*
+get_head_message(Port* port, InterruptsSpinLocker& ringLocker,
+	port_ring_slot** _slot)
+{
+	port_message* message = port->messages.Head();
+	*_slot = NULL;
+
+	PortRing* ring = port->ring;
+	if (ring == NULL)
+		return message;
+
+	ringLocker.SetTo(ring->read_lock, false);
+
+	port_ring_slot* slot
+		= &ring->slots[ring->read_index % kPortRingSlotCount];
+	if (atomic_get(&slot->state) != kSlotFull) {
+		ringLocker.Unlock();
+		return message;
+	}
+
+	if (message != NULL
+		&& (int32)((uint32)message->sequence
+			- (uint32)slot->message->sequence) < 0) {
+		ringLocker.Unlock();
+		return message;
+	}
+
+	*_slot = slot;
+	return slot->message;
+}
+
+
+/*!	Removes the oldest message from the port. If it was in the port's ring,
+	\a _slot is set to its slot, which has to be freed once the message has
+	been copied.
+	If the message is larger than \a maxSize, it is left in the port, and
+	\c B_BUFFER_OVERFLOW is returned.
+	The port must be locked, and the message must have been reserved via
+	Port::read_count.
+*/
+static status_t
+remove_head_message(Port* port, size_t maxSize, port_message** _message,
+	port_ring_slot** _slot)
+{
+	InterruptsSpinLocker ringLocker;
+	port_message* message = get_head_message(port, ringLocker, _slot);
+	if (message == NULL)
+		return B_ERROR;
+	if (message->size > maxSize)
+		return B_BUFFER_OVERFLOW;
+
+	if (*_slot != NULL) {
+		atomic_set(&(*_slot)->state, kSlotReading);
+		port->ring->read_index++;
+	} else {
+		port->messages.Remove(message);
+		atomic_add(&port->list_count, -1);
+	}
+
+	*_message = message;
+	return B_OK;
+}
+
+
+/*!	Gives a message slot of the port back to the writers. Since this is
+	called without holding the port lock, it only locks the port when there
+	are waiting writers, or select events to notify.
+*/
+static void
+release_port_write_slot(Port* port)
+{
+	if (atomic_add(&port->write_count, 1) >= 0
+		&& atomic_pointer_get(&port->select_infos) == NULL) {
+		return;
+	}
+
+	MutexLocker locker(port->lock);
+	notify_port_select_events(port, B_EVENT_WRITE);
+	port->write_condition.NotifyOne();
+}
+
+
+/*!	Passes a message through the port's ring, without locking the port.
+	Returns \c false if this isn't possible, and the message has to be
+	written the regular way; \a _status is only valid otherwise.
+*/
+static bool
+write_port_message_fast(Port* port, int32 code, const iovec* vecs,
+	size_t vecCount, size_t bufferSize, bool userCopy, status_t& _status)
+{
+	PortRing* ring = atomic_pointer_get(&port->ring);
+	if (ring == NULL || bufferSize > kPortRingSlotSize
+		|| port->state != Port::kActive || is_port_closed(port)) {
+		return false;
+	}
+
+	if (atomic_test_and_set(&ring->writing, 1, 0) != 0) {
+		// someone else is using the ring
+		return false;
+	}
+
+	port_ring_slot* slot
+		= &ring->slots[ring->write_index % kPortRingSlotCount];
+	if (atomic_get(&slot->state) != kSlotFree
+		|| !reserve_port_count(&port->write_count)) {
+		atomic_set(&ring->writing, 0);
+		return false;
+	}
+
+	port_message* message = slot->message;
+	message->code = code;
+	message->size = bufferSize;
+
+	_status = fill_port_message(message, vecs, vecCount, bufferSize,
+		userCopy);
+	if (_status != B_OK) {
+		atomic_set(&ring->writing, 0);
+		release_port_write_slot(port);
+		return true;
+	}
+
+	// publish the message
+	message->sequence = atomic_add(&port->sequence, 1);
+	atomic_set(&slot->state, kSlotFull);
+	ring->write_index++;
+	atomic_set(&ring->writing, 0);
+
+	atomic_add(&port->read_count, 1);
+
+	T(Write(port->id, port->read_count, port->write_count, code, bufferSize,
+		B_OK));
+
+	if (atomic_get(&port->read_waiters) > 0
+		|| atomic_pointer_get(&port->select_infos) != NULL) {
+		MutexLocker locker(port->lock);
+		notify_port_select_events(port, B_EVENT_READ);
+		port->read_condition.NotifyOne();
+	}
+
+	return true;
+}
+
+
+/*!	Reads the next message from the port's ring, without locking the port.
+	Returns \c false if there is no such message, or if an older one waits in
+	the message list; the message has to be read the regular way then.
+*/
+static bool
+read_port_message_fast(Port* port, int32* _code, void* buffer,
+	size_t bufferSize, bool userCopy, bool truncate, ssize_t& _size)
+{
+	PortRing* ring = atomic_pointer_get(&port->ring);
+	if (ring == NULL || port->state != Port::kActive)
+		return false;
+
+	InterruptsSpinLocker ringLocker(ring->read_lock);
+
+	port_ring_slot* slot
+		= &ring->slots[ring->read_index % kPortRingSlotCount];
+	if (atomic_get(&slot->state) != kSlotFull
+		|| atomic_get(&port->list_count) != 0
+		|| (!truncate && slot->message->size > bufferSize)
+		|| !reserve_port_count(&port->read_count)) {
+		return false;
+	}
+
+	atomic_set(&slot->state, kSlotReading);
+	ring->read_index++;
+
+	ringLocker.Unlock();
+
+	atomic_add(&port->total_count, 1);
+
+	T(Read(port->id, port->read_count, port->write_count, slot->message->code,
+		std::min(bufferSize, slot->message->size)));
+
+	_size = copy_port_message(slot->message, _code, buffer, bufferSize,
+		userCopy);
+
+	atomic_set(&slot->state, kSlotFree);
+	release_port_write_slot(port);
+	return true;
+}
+
+
+/*!	Reads the size and sender of the next message in the port's ring without
+	locking the port. Returns \c false if that isn't possible.
+*/
+static bool
+get_port_message_info_fast(Port* port, port_message_info* info)
+{
+	PortRing* ring = atomic_pointer_get(&port->ring);
+	if (ring == NULL || port->state != Port::kActive)
+		return false;
+
+	InterruptsSpinLocker ringLocker(ring->read_lock);
+
+	port_ring_slot* slot
+		= &ring->slots[ring->read_index % kPortRingSlotCount];
+	if (atomic_get(&slot->state) != kSlotFull
+		|| atomic_get(&port->list_count) != 0) {
+		return false;
+	}
+
+	port_message* message = slot->message;
+	info->size = message->size;
+	info->sender = message->sender;
+	info->sender_group = message->sender_group;
+	info->sender_team = message->sender_team;
+
+	T(Info(port->id, port->read_count, port->write_count, message->code,
+		B_OK));
+	return true;
+}
+
+
 static void
 uninit_port(Port* port)
 {
@@ -1168,13 +1608,17 @@ select_port(int32 id, struct select_info* info, bool kernel)
 		info->next = portRef->select_infos;
 		portRef->select_infos = info;
 
+		// Writers and readers that don't lock the port check select_infos
+		// after having changed the counts, so make sure to see their changes
+		memory_full_barrier();
+
 		// check for events
 		if ((info->selected_events & B_EVENT_READ) != 0
-			&& !portRef->messages.IsEmpty()) {
+			&& atomic_get(&portRef->read_count) > 0) {
 			events |= B_EVENT_READ;
 		}
 
-		if (portRef->write_count > 0)
+		if (atomic_get(&portRef->write_count) > 0)
 			events |= B_EVENT_WRITE;
 
 		if (events != 0)
@@ -1340,18 +1784,32 @@ _get_port_message_info_etc(port_id id, port_message_info* info,
 		| B_ABSOLUTE_TIMEOUT;
 
 	// get the port
-	BReference<Port> portRef = get_locked_port(id);
+	BReference<Port> portRef = get_port(id);
 	if (portRef == NULL)
 		return B_BAD_PORT_ID;
+
+	if (get_port_message_info_fast(portRef, info))
+		return B_OK;
+
+	if (!lock_port(portRef))
+		return B_BAD_PORT_ID;
 	MutexLocker locker(portRef->lock, true);
 
-	if (is_port_closed(portRef) && portRef->messages.IsEmpty()) {
+	if (is_port_closed(portRef) && atomic_get(&portRef->read_count) == 0) {
 		T(Info(portRef, 0, B_BAD_PORT_ID));
 		TRACE(("_get_port_message_info_etc(): closed port %ld\n", id));
 		return B_BAD_PORT_ID;
 	}
 
-	while (portRef->read_count == 0) {
+	InterruptsSpinLocker ringLocker;
+	port_ring_slot* slot;
+	port_message* message;
+	while ((message = get_head_message(portRef, ringLocker, &slot)) == NULL) {
+		if (atomic_get(&portRef->read_count) > 0) {
+			// a lock-free reader took the message in the meantime
+			continue;
+		}
+
 		// We need to wait for a message to appear
 		if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout <= 0)
 			return B_WOULD_BLOCK;
@@ -1359,10 +1817,19 @@ _get_port_message_info_etc(port_id id, port_message_info* info,
 		ConditionVariableEntry entry;
 		portRef->read_condition.Add(&entry);
 
+		// lock-free writers check for waiting readers after having added
+		// their message
+		atomic_add(&portRef->read_waiters, 1);
+		if (atomic_get(&portRef->read_count) > 0) {
+			atomic_add(&portRef->read_waiters, -1);
+			continue;
+		}
+
 		locker.Unlock();
 
 		// block if no message, or, if B_TIMEOUT flag set, block with timeout
 		status_t status = entry.Wait(flags, timeout);
+		atomic_add(&portRef->read_waiters, -1);
 
 		if (status != B_OK) {
 			T(Info(portRef, 0, status));
@@ -1378,26 +1845,21 @@ _get_port_message_info_etc(port_id id, port_message_info* info,
 		locker.SetTo(newPortRef->lock, true);
 
 		if (newPortRef != portRef
-			|| (is_port_closed(portRef) && portRef->messages.IsEmpty())) {
+			|| (is_port_closed(portRef)
+				&& atomic_get(&portRef->read_count) == 0)) {
 			// the port is no longer there
 			T(Info(id, 0, 0, 0, B_BAD_PORT_ID));
 			return B_BAD_PORT_ID;
 		}
 	}
 
-	// determine tail & get the length of the message
-	port_message* message = portRef->messages.Head();
-	if (message == NULL) {
-		panic("port %" B_PRId32 ": no messages found\n", portRef->id);
-		return B_ERROR;
-	}
-
 	info->size = message->size;
 	info->sender = message->sender;
 	info->sender_group = message->sender_group;
 	info->sender_team = message->sender_team;
 
 	T(Info(portRef, message->code, B_OK));
+	ringLocker.Unlock();
 
 	// notify next one, as we haven't read from the port
 	portRef->read_condition.NotifyOne();
@@ -1444,23 +1906,35 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 	bool userCopy = (flags & PORT_FLAG_USE_USER_MEMCPY) != 0;
 	bool peekOnly = !userCopy && (flags & B_PEEK_PORT_MESSAGE) != 0;
 		// TODO: we could allow peeking for user apps now
+	bool truncate = (flags & PORT_FLAG_NO_TRUNCATE) == 0;
 
 	flags &= B_CAN_INTERRUPT | B_KILL_CAN_INTERRUPT | B_RELATIVE_TIMEOUT
 		| B_ABSOLUTE_TIMEOUT;
 
 	// get the port
-	BReference<Port> portRef = get_locked_port(id);
+	BReference<Port> portRef = get_port(id);
 	if (portRef == NULL)
 		return B_BAD_PORT_ID;
+
+	if (!peekOnly) {
+		ssize_t size;
+		if (read_port_message_fast(portRef, _code, buffer, bufferSize,
+				userCopy, truncate, size)) {
+			return size;
+		}
+	}
+
+	if (!lock_port(portRef))
+		return B_BAD_PORT_ID;
 	MutexLocker locker(portRef->lock, true);
 
-	if (is_port_closed(portRef) && portRef->messages.IsEmpty()) {
+	if (is_port_closed(portRef) && atomic_get(&portRef->read_count) == 0) {
 		T(Read(portRef, 0, B_BAD_PORT_ID));
 		TRACE(("read_port_etc(): closed port %ld\n", id));
 		return B_BAD_PORT_ID;
 	}
 
-	while (portRef->read_count == 0) {
+	while (!reserve_port_count(&portRef->read_count)) {
 		if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout <= 0)
 			return B_WOULD_BLOCK;
 
@@ -1468,10 +1942,19 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 		ConditionVariableEntry entry;
 		portRef->read_condition.Add(&entry);
 
+		// lock-free writers check for waiting readers after having added
+		// their message
+		atomic_add(&portRef->read_waiters, 1);
+		if (atomic_get(&portRef->read_count) > 0) {
+			atomic_add(&portRef->read_waiters, -1);
+			continue;
+		}
+
 		locker.Unlock();
 
 		// block if no message, or, if B_TIMEOUT flag set, block with timeout
 		status_t status = entry.Wait(flags, timeout);
+		atomic_add(&portRef->read_waiters, -1);
 
 		// re-lock
 		BReference<Port> newPortRef = get_locked_port(id);
@@ -1482,7 +1965,8 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 		locker.SetTo(newPortRef->lock, true);
 
 		if (newPortRef != portRef
-			|| (is_port_closed(portRef) && portRef->messages.IsEmpty())) {
+			|| (is_port_closed(portRef)
+				&& atomic_get(&portRef->read_count) == 0)) {
 			// the port is no longer there
 			T(Read(id, 0, 0, 0, B_BAD_PORT_ID));
 			return B_BAD_PORT_ID;
@@ -1494,28 +1978,48 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 		}
 	}
 
-	// determine tail & get the length of the message
-	port_message* message = portRef->messages.Head();
-	if (message == NULL) {
-		panic("port %" B_PRId32 ": no messages found\n", portRef->id);
-		return B_ERROR;
-	}
+	// the message is reserved for us now
+	port_ring_slot* slot;
 
 	if (peekOnly) {
+		InterruptsSpinLocker ringLocker;
+		port_message* message = get_head_message(portRef, ringLocker, &slot);
+		if (message == NULL) {
+			panic("port %" B_PRId32 ": no messages found\n", portRef->id);
+			return B_ERROR;
+		}
+
 		size_t size = copy_port_message(message, _code, buffer, bufferSize,
 			userCopy);
 
 		T(Read(portRef, message->code, size));
+		ringLocker.Unlock();
 
+		atomic_add(&portRef->read_count, 1);
 		portRef->read_condition.NotifyOne();
 			// we only peeked, but didn't grab the message
 		return size;
 	}
 
-	portRef->messages.RemoveHead();
-	portRef->total_count++;
-	portRef->write_count++;
-	portRef->read_count--;
+	port_message* message;
+	status_t status = remove_head_message(portRef,
+		truncate ? SIZE_MAX : bufferSize, &message, &slot);
+	if (status == B_BUFFER_OVERFLOW) {
+		// leave the message to someone with a larger buffer
+		atomic_add(&portRef->read_count, 1);
+		portRef->read_condition.NotifyOne();
+
+		T(Read(portRef, 0, B_BUFFER_OVERFLOW));
+		return B_BUFFER_OVERFLOW;
+	}
+	if (status != B_OK) {
+		panic("port %" B_PRId32 ": no messages found\n", portRef->id);
+		return B_ERROR;
+	}
+
+	atomic_add(&portRef->total_count, 1);
+	atomic_add(&portRef->write_count, 1);
+	update_port_users(portRef, false, 0);
 
 	notify_port_select_events(portRef, B_EVENT_WRITE);
 	portRef->write_condition.NotifyOne();
@@ -1528,7 +2032,10 @@ read_port_etc(port_id id, int32* _code, void* buffer, size_t bufferSize,
 	size_t size = copy_port_message(message, _code, buffer, bufferSize,
 		userCopy);
 
-	put_port_message(message);
+	if (slot != NULL)
+		atomic_set(&slot->state, kSlotFree);
+	else
+		put_port_message(message);
 	return size;
 }
 
@@ -1578,11 +2085,21 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 	port_message* message = NULL;
 
 	// get the port
-	BReference<Port> portRef = get_locked_port(id);
+	BReference<Port> portRef = get_port(id);
 	if (portRef == NULL) {
 		TRACE(("write_port_etc: invalid port_id %ld\n", id));
 		return B_BAD_PORT_ID;
 	}
+
+	if (write_port_message_fast(portRef, msgCode, msgVecs, vecCount,
+			bufferSize, userCopy, status)) {
+		return status;
+	}
+
+	if (!lock_port(portRef)) {
+		TRACE(("write_port_etc: invalid port_id %ld\n", id));
+		return B_BAD_PORT_ID;
+	}
 	MutexLocker locker(portRef->lock, true);
 
 	if (is_port_closed(portRef)) {
@@ -1590,12 +2107,11 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 		return B_BAD_PORT_ID;
 	}
 
-	if (portRef->write_count <= 0) {
-		if ((flags & B_RELATIVE_TIMEOUT) != 0 && timeout <= 0)
-			return B_WOULD_BLOCK;
-
-		portRef->write_count--;
+	const bool reserved = reserve_port_count(&portRef->write_count);
+	if (!reserved && (flags & B_RELATIVE_TIMEOUT) != 0 && timeout <= 0)
+		return B_WOULD_BLOCK;
 
+	if (!reserved && atomic_add(&portRef->write_count, -1) <= 0) {
 		// We need to block in order to wait for a free message slot
 		ConditionVariableEntry entry;
 		portRef->write_condition.Add(&entry);
@@ -1620,8 +2136,7 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 
 		if (status != B_OK)
 			goto error;
-	} else
-		portRef->write_count--;
+	}
 
 	status = get_port_message(msgCode, bufferSize, flags, timeout,
 		&message, *portRef);
@@ -1635,38 +2150,18 @@ writev_port_etc(port_id id, int32 msgCode, const iovec* msgVecs,
 		goto error;
 	}
 
-	// sender credentials
-	message->sender = geteuid();
-	message->sender_group = getegid();
-	message->sender_team = team_get_current_team_id();
-
-	if (bufferSize > 0) {
-		size_t offset = 0;
-		for (uint32 i = 0; i < vecCount; i++) {
-			size_t bytes = msgVecs[i].iov_len;
-			if (bytes > bufferSize)
-				bytes = bufferSize;
-
-			if (userCopy) {
-				status_t status = user_memcpy(message->buffer + offset,
-					msgVecs[i].iov_base, bytes);
-				if (status != B_OK) {
-					put_port_message(message);
-					goto error;
-				}
-			} else
-				memcpy(message->buffer + offset, msgVecs[i].iov_base, bytes);
-
-			bufferSize -= bytes;
-			if (bufferSize == 0)
-				break;
-
-			offset += bytes;
-		}
+	status = fill_port_message(message, msgVecs, vecCount, bufferSize,
+		userCopy);
+	if (status != B_OK) {
+		put_port_message(message);
+		goto error;
 	}
 
+	message->sequence = atomic_add(&portRef->sequence, 1);
 	portRef->messages.Add(message);
-	portRef->read_count++;
+	atomic_add(&portRef->list_count, 1);
+	atomic_add(&portRef->read_count, 1);
+	update_port_users(portRef, true, message->size);
 
 	T(Write(id, portRef->read_count, portRef->write_count, message->code,
 		message->size, B_OK));
@@ -1679,7 +2174,7 @@ error:
 	// Give up our slot in the queue again, and let someone else
 	// try and fail
 	T(Write(id, portRef->read_count, portRef->write_count, 0, 0, status));
-	portRef->write_count++;
+	atomic_add(&portRef->write_count, 1);
 	notify_port_select_events(portRef, B_EVENT_WRITE);
 	portRef->write_condition.NotifyOne();
 
@@ -1687,6 +2182,76 @@ error:
 }
 
 
+/*!	Writes the messages in \a messages to the port, in order. Blocks only as
+	long as the port is full, and not longer than \a timeout in total.
+	Returns the number of messages written, or an error if the first message
+	could not be written.
+*/
+ssize_t
+write_port_messages_etc(port_id id, const port_message_vec* messages,
+	size_t count, uint32 flags, bigtime_t timeout)
+{
+	if (count == 0)
+		return 0;
+	if (messages == NULL)
+		return B_BAD_VALUE;
+
+	if ((flags & B_RELATIVE_TIMEOUT) != 0
+		&& timeout != B_INFINITE_TIMEOUT && timeout > 0) {
+		// all messages share the same timeout
+		flags = (flags & ~B_RELATIVE_TIMEOUT) | B_ABSOLUTE_TIMEOUT;
+		timeout += system_time();
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		iovec vec = { messages[i].buffer, messages[i].size };
+		status_t status = writev_port_etc(id, messages[i].code, &vec, 1,
+			messages[i].size, flags, timeout);
+		if (status != B_OK)
+			return i > 0 ? (ssize_t)i : status;
+	}
+
+	return count;
+}
+
+
+/*!	Reads up to \a count messages from the port into \a messages, and sets
+	their code and size fields. Only the first message is waited for; the
+	call returns as soon as the port has no more messages, or the next message
+	does not fit into its buffer, in which case it is left in the port.
+	Returns the number of messages read, or an error if not even the first
+	message could be read; \c B_BUFFER_OVERFLOW means that it did not fit.
+*/
+ssize_t
+read_port_messages_etc(port_id id, port_message_vec* messages, size_t count,
+	uint32 flags, bigtime_t timeout)
+{
+	if (count == 0)
+		return 0;
+	if (messages == NULL)
+		return B_BAD_VALUE;
+
+	flags = (flags & ~B_PEEK_PORT_MESSAGE) | PORT_FLAG_NO_TRUNCATE;
+
+	for (size_t i = 0; i < count; i++) {
+		int32 code;
+		ssize_t size = read_port_etc(id, &code, messages[i].buffer,
+			messages[i].size, flags, timeout);
+		if (size < 0)
+			return i > 0 ? (ssize_t)i : size;
+
+		messages[i].code = code;
+		messages[i].size = size;
+
+		// don't wait for any further messages
+		flags = (flags & ~B_ABSOLUTE_TIMEOUT) | B_RELATIVE_TIMEOUT;
+		timeout = 0;
+	}
+
+	return count;
+}
+
+
 status_t
 set_port_owner(port_id id, team_id newTeamID)
 {
@@ -1963,3 +2528,114 @@ _user_get_port_message_info_etc(port_id port, port_message_info *userInfo,
 
 	return syscall_restart_handle_timeout_post(error, timeout);
 }
+
+
+/*!	Copies the next chunk of at most \a count message vectors from userland,
+	and checks that their buffers are userland addresses.
+*/
+static status_t
+get_port_message_vecs_from_user(const port_message_vec* userMessages,
+	size_t count, port_message_vec* messages)
+{
+	if (!IS_USER_ADDRESS(userMessages)
+		|| user_memcpy(messages, userMessages,
+			count * sizeof(port_message_vec)) != B_OK) {
+		return B_BAD_ADDRESS;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (messages[i].buffer == NULL && messages[i].size != 0)
+			return B_BAD_VALUE;
+		if (messages[i].buffer != NULL && !IS_USER_ADDRESS(messages[i].buffer))
+			return B_BAD_ADDRESS;
+	}
+
+	return B_OK;
+}
+
+
+ssize_t
+_user_write_port_messages_etc(port_id port,
+	const port_message_vec* userMessages, size_t count, uint32 flags,
+	bigtime_t timeout)
+{
+	if (userMessages == NULL || count > MAX_QUEUE_LENGTH)
+		return B_BAD_VALUE;
+
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	flags |= PORT_FLAG_USE_USER_MEMCPY | B_CAN_INTERRUPT;
+
+	port_message_vec messages[16];
+	size_t written = 0;
+
+	while (written < count) {
+		size_t chunk = std::min(count - written, B_COUNT_OF(messages));
+		status_t status = get_port_message_vecs_from_user(
+			userMessages + written, chunk, messages);
+		if (status != B_OK)
+			return written > 0 ? (ssize_t)written : status;
+
+		ssize_t result = write_port_messages_etc(port, messages, chunk, flags,
+			timeout);
+		if (result < 0) {
+			if (written > 0)
+				return written;
+			return syscall_restart_handle_timeout_post(result, timeout);
+		}
+
+		written += result;
+		if ((size_t)result < chunk)
+			break;
+	}
+
+	return written;
+}
+
+
+ssize_t
+_user_read_port_messages_etc(port_id port, port_message_vec* userMessages,
+	size_t count, uint32 flags, bigtime_t timeout)
+{
+	if (userMessages == NULL || count > MAX_QUEUE_LENGTH)
+		return B_BAD_VALUE;
+
+	syscall_restart_handle_timeout_pre(flags, timeout);
+
+	flags |= PORT_FLAG_USE_USER_MEMCPY | B_CAN_INTERRUPT;
+
+	port_message_vec messages[16];
+	size_t read = 0;
+
+	while (read < count) {
+		size_t chunk = std::min(count - read, B_COUNT_OF(messages));
+		status_t status = get_port_message_vecs_from_user(userMessages + read,
+			chunk, messages);
+		if (status != B_OK)
+			return read > 0 ? (ssize_t)read : status;
+
+		ssize_t result = read_port_messages_etc(port, messages, chunk, flags,
+			timeout);
+		if (result < 0) {
+			if (read > 0)
+				return read;
+			return syscall_restart_handle_timeout_post(result, timeout);
+		}
+
+		// copy the codes and sizes back to userland
+		if (user_memcpy(userMessages + read, messages,
+				result * sizeof(port_message_vec)) != B_OK) {
+			return B_BAD_ADDRESS;
+		}
+
+		read += result;
+		if ((size_t)result < chunk)
+			break;
+
+		// only the first message may be waited for
+		flags = (flags & ~B_ABSOLUTE_TIMEOUT) | B_RELATIVE_TIMEOUT;
+		timeout = 0;
+	}
+
+	return read;
+}
@@ -0,0 +1,328 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include <util/AutoLock.h>
+
+#include "scheduler_common.h"
+#include "scheduler_cpu.h"
+#include "scheduler_modes.h"
+#include "scheduler_profiler.h"
+#include "scheduler_thread.h"
+
+
+using namespace Scheduler;
+
+
+/*	Cores sharing the last level cache form a cache domain. The kernel does not
+	know about memory nodes, but on all common systems a memory node never
+	spans more than a single package, and the last level cache never spans
+	more than that, either. Keeping a thread within its cache domain therefore
+	keeps it close to both the data in the cache, and to the memory it has
+	touched so far.
+	Threads are only moved to another cache domain when a core there is idle,
+	while their own domain has none left.
+*/
+
+
+const bigtime_t kCacheExpire = 100000;
+
+// The domain of each core, represented by the ID of its first core.
+static int32 sCoreDomains[SMP_MAX_CPUS];
+
+
+static inline bool
+in_same_domain(const CoreEntry* core, const CoreEntry* other)
+{
+	return sCoreDomains[core->ID()] == sCoreDomains[other->ID()];
+}
+
+
+static inline bool
+matches_mask(const CoreEntry* core, const CPUSet& mask, bool useMask)
+{
+	return !useMask || core->CPUMask().Matches(mask);
+}
+
+
+static void
+compute_cache_domains()
+{
+	static int32 cacheIDs[SMP_MAX_CPUS];
+	int32 cpuCount = smp_get_num_cpus();
+	int32 cacheLevel = (int32)gCPUCacheLevelCount - 1;
+
+	for (int32 i = 0; i < gCoreCount; i++)
+		cacheIDs[i] = -1;
+
+	for (int32 i = 0; i < cpuCount; i++) {
+		int32 coreID = CoreEntry::GetCore(i)->ID();
+		if (cacheLevel >= 0)
+			cacheIDs[coreID] = gCPU[i].cache_id[cacheLevel];
+	}
+
+	for (int32 i = 0; i < gCoreCount; i++) {
+		CoreEntry* core = &gCoreEntries[i];
+		sCoreDomains[i] = i;
+
+		for (int32 j = 0; j < i; j++) {
+			// without cache information, a domain covers a whole package
+			CoreEntry* other = &gCoreEntries[j];
+			if (other->Package() == core->Package()
+				&& cacheIDs[j] == cacheIDs[i]) {
+				sCoreDomains[i] = sCoreDomains[j];
+				break;
+			}
+		}
+	}
+}
+
+
+/*!	Returns an idle core of \a package, preferring one in the cache domain of
+	\a home, if given. If \a domainOnly is \c true, only cores in the domain
+	of \a home are considered.
+*/
+static CoreEntry*
+get_idle_core(PackageEntry* package, const CoreEntry* home, bool domainOnly,
+	const CPUSet& mask, bool useMask)
+{
+	CoreEntry* fallback = NULL;
+
+	int32 index = 0;
+	CoreEntry* core;
+	while ((core = package->GetIdleCore(index++)) != NULL) {
+		if (!matches_mask(core, mask, useMask))
+			continue;
+		if (home == NULL || in_same_domain(core, home))
+			return core;
+		if (fallback == NULL && !domainOnly)
+			fallback = core;
+	}
+
+	return fallback;
+}
+
+
+/*!	Returns the least loaded enabled core in the cache domain of \a home.
+*/
+static CoreEntry*
+get_least_loaded_domain_core(const CoreEntry* home, const CPUSet& mask,
+	bool useMask)
+{
+	CoreEntry* chosen = NULL;
+	int32 chosenLoad = 0;
+
+	for (int32 i = 0; i < gCoreCount; i++) {
+		CoreEntry* core = &gCoreEntries[i];
+		if (core->CPUCount() == 0 || !in_same_domain(core, home)
+			|| !matches_mask(core, mask, useMask)) {
+			continue;
+		}
+
+		int32 load = core->GetLoad();
+		if (chosen == NULL || load < chosenLoad) {
+			chosen = core;
+			chosenLoad = load;
+		}
+	}
+
+	return chosen;
+}
+
+
+/*!	Returns an idle core outside of the cache domain of \a home, preferring
+	the package of \a home.
+*/
+static CoreEntry*
+steal_idle_core(const CoreEntry* home, const CPUSet& mask, bool useMask)
+{
+	CoreEntry* core = get_idle_core(home->Package(), NULL, false, mask,
+		useMask);
+	if (core != NULL)
+		return core;
+
+	PackageEntry* package = gIdlePackageList.Last();
+	if (package == NULL)
+		package = PackageEntry::GetMostIdlePackage();
+	if (package == NULL || package == home->Package())
+		return NULL;
+
+	return get_idle_core(package, NULL, false, mask, useMask);
+}
+
+
+static void
+switch_to_mode()
+{
+	compute_cache_domains();
+}
+
+
+static void
+set_cpu_enabled(int32 /* cpu */, bool /* enabled */)
+{
+}
+
+
+static bool
+has_cache_expired(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+	if (threadData->WentSleepActive() == 0)
+		return false;
+	CoreEntry* core = threadData->Core();
+	bigtime_t activeTime = core->GetActiveTime();
+	return activeTime - threadData->WentSleepActive() > kCacheExpire;
+}
+
+
+static CoreEntry*
+choose_core(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CPUSet mask = threadData->GetCPUMask();
+	const bool useMask = !mask.IsEmpty();
+
+	// Even if the private caches of the previous core have gone cold, its
+	// cache domain is likely to still hold some of the thread's data.
+	CoreEntry* home = threadData->Core();
+	if (home != NULL) {
+		CoreEntry* core = get_idle_core(home->Package(), home, true, mask,
+			useMask);
+		if (core != NULL)
+			return core;
+
+		core = get_least_loaded_domain_core(home, mask, useMask);
+		if (core != NULL && core->GetLoad() < kHighLoad)
+			return core;
+
+		// the whole domain is busy, fall back to an idle core elsewhere
+		CoreEntry* idleCore = steal_idle_core(home, mask, useMask);
+		if (idleCore != NULL)
+			return idleCore;
+		if (core != NULL)
+			return core;
+	}
+
+	// new threads are spread just like in low latency mode
+	PackageEntry* package = gIdlePackageList.Last();
+	if (package == NULL)
+		package = PackageEntry::GetMostIdlePackage();
+
+	CoreEntry* core = NULL;
+	if (package != NULL)
+		core = get_idle_core(package, NULL, false, mask, useMask);
+
+	if (core == NULL) {
+		ReadSpinLocker coreLocker(gCoreHeapsLock);
+		int32 index = 0;
+		do {
+			core = gCoreLoadHeap.PeekMinimum(index++);
+		} while (core != NULL && !matches_mask(core, mask, useMask));
+		if (core == NULL) {
+			index = 0;
+			do {
+				core = gCoreHighLoadHeap.PeekMinimum(index++);
+			} while (core != NULL && !matches_mask(core, mask, useMask));
+		}
+	}
+
+	ASSERT(core != NULL);
+	return core;
+}
+
+
+static CoreEntry*
+rebalance(const ThreadData* threadData)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	CoreEntry* core = threadData->Core();
+	ASSERT(core != NULL);
+
+	CPUSet mask = threadData->GetCPUMask();
+	const bool useMask = !mask.IsEmpty();
+
+	int32 coreLoad = core->GetLoad();
+	int32 threadLoad = threadData->GetLoad() / core->CPUCount();
+
+	// Balance the load within the cache domain only.
+	CoreEntry* other = get_least_loaded_domain_core(core, mask, useMask);
+	if (other != NULL && other != core) {
+		int32 otherLoad = other->GetLoad();
+		int32 difference = coreLoad - otherLoad - kLoadDifference;
+		if (difference > 0 && difference >= threadLoad)
+			return other;
+	}
+
+	// Leaving the domain means losing both the cache contents and possibly
+	// memory locality, which is only worth it if the thread has to compete
+	// for its core, and there is an idle one elsewhere.
+	if (coreLoad < kHighLoad || (other != NULL && other->GetLoad() < kHighLoad))
+		return core;
+
+	other = steal_idle_core(core, mask, useMask);
+	return other != NULL ? other : core;
+}
+
+
+static void
+rebalance_irqs(bool idle)
+{
+	SCHEDULER_ENTER_FUNCTION();
+
+	if (idle)
+		return;
+
+	cpu_ent* cpu = get_cpu_struct();
+	SpinLocker locker(cpu->irqs_lock);
+
+	irq_assignment* chosen = NULL;
+	irq_assignment* irq = (irq_assignment*)list_get_first_item(&cpu->irqs);
+
+	int32 totalLoad = 0;
+	while (irq != NULL) {
+		if (chosen == NULL || chosen->load < irq->load)
+			chosen = irq;
+		totalLoad += irq->load;
+		irq = (irq_assignment*)list_get_next_item(&cpu->irqs, irq);
+	}
+
+	locker.Unlock();
+
+	if (chosen == NULL || totalLoad < kLowLoad)
+		return;
+
+	// interrupt handlers share data with the threads they wake up, so keep
+	// them within the cache domain, too
+	CoreEntry* core = CoreEntry::GetCore(cpu->cpu_num);
+	CoreEntry* other = get_least_loaded_domain_core(core, CPUSet(), false);
+	if (other == NULL || other == core)
+		return;
+	if (other->GetLoad() + kLoadDifference >= core->GetLoad())
+		return;
+
+	int32 newCPU = other->CPUHeap()->PeekRoot()->ID();
+	assign_io_interrupt_to_cpu(chosen->irq, newCPU);
+}
+
+
+scheduler_mode_operations gSchedulerCacheAffinityMode = {
+	"cache affinity",
+
+	1000,
+	100,
+	{ 2, 5 },
+
+	5000,
+
+	switch_to_mode,
+	set_cpu_enabled,
+	has_cache_expired,
+	choose_core,
+	rebalance,
+	rebalance_irqs,
+};
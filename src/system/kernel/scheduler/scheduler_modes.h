@@ -32,6 +32,7 @@ struct scheduler_mode_operations {
 
 extern struct scheduler_mode_operations gSchedulerLowLatencyMode;
 extern struct scheduler_mode_operations gSchedulerPowerSavingMode;
+extern struct scheduler_mode_operations gSchedulerCacheAffinityMode;
 
 
 namespace Scheduler {
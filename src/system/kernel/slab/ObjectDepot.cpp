@@ -11,6 +11,7 @@
 
 #include <algorithm>
 
+#include <cpu.h>
 #include <int.h>
 #include <slab/Slab.h>
 #include <smp.h>
@@ -42,7 +43,29 @@ public:
 struct depot_cpu_store {
 	DepotMagazine*	loaded;
 	DepotMagazine*	previous;
-};
+
+	// only ever changed by the owning CPU, with interrupts disabled
+	uint64			obtain_hits;
+	uint64			obtain_misses;
+	uint64			store_hits;
+	uint64			store_misses;
+} CACHE_LINE_ALIGN;
+
+
+/*!	The magazine capacity adapts to how the depot is used: every
+	kAdaptWindow exchanges with the depot's magazine lists, the capacity is
+	doubled if the inner lock was contended too often, or if the window
+	passed too quickly, as larger magazines let the CPUs go longer without
+	visiting the depot. If a window was slow and without any contention,
+	the capacity is halved again, down to its initial value.
+	Only newly allocated magazines use the new capacity; magazines of the
+	wrong size are freed instead of being put back on the full list.
+*/
+static const uint32 kAdaptWindow = 128;
+static const uint32 kGrowContentions = 8;
+static const bigtime_t kBusyWindowTime = 10000;
+static const bigtime_t kIdleWindowTime = 1000000;
+static const size_t kMaxMagazineCapacity = 256;
 
 
 RANGE_MARKER_FUNCTION_BEGIN(SlabObjectDepot)
@@ -102,13 +125,15 @@ DepotMagazine::ContainsObject(void* object) const
 static DepotMagazine*
 alloc_magazine(object_depot* depot, uint32 flags)
 {
+	// the capacity may be adapted concurrently
+	int32 capacity = atomic_get(&depot->magazine_capacity);
+
 	DepotMagazine* magazine = (DepotMagazine*)slab_internal_alloc(
-		sizeof(DepotMagazine) + depot->magazine_capacity * sizeof(void*),
-		flags);
+		sizeof(DepotMagazine) + capacity * sizeof(void*), flags);
 	if (magazine) {
 		magazine->next = NULL;
 		magazine->current_round = 0;
-		magazine->round_count = depot->magazine_capacity;
+		magazine->round_count = capacity;
 	}
 
 	return magazine;
@@ -131,12 +156,60 @@ empty_magazine(object_depot* depot, DepotMagazine* magazine, uint32 flags)
 }
 
 
+static void
+adapt_magazine_capacity(object_depot* depot)
+{
+	bigtime_t now = system_time();
+	bigtime_t elapsed = now - depot->window_start;
+
+	if (depot->window_contentions >= kGrowContentions
+		|| elapsed < kBusyWindowTime) {
+		if ((size_t)depot->magazine_capacity < depot->max_capacity) {
+			atomic_set(&depot->magazine_capacity, std::min(depot->max_capacity,
+				(size_t)depot->magazine_capacity * 2));
+			depot->resizes++;
+		}
+	} else if (depot->window_contentions == 0 && elapsed > kIdleWindowTime
+		&& (size_t)depot->magazine_capacity > depot->min_capacity) {
+		atomic_set(&depot->magazine_capacity, std::max(depot->min_capacity,
+			(size_t)depot->magazine_capacity / 2));
+		depot->resizes++;
+	}
+
+	depot->window_exchanges = 0;
+	depot->window_contentions = 0;
+	depot->window_start = now;
+}
+
+
+/*!	Acquires the inner lock for an exchange of magazines, and keeps track
+	of how often this had to wait for another CPU.
+*/
+static void
+lock_for_exchange(object_depot* depot)
+{
+	bool contended = !try_acquire_spinlock(&depot->inner_lock);
+	if (contended)
+		acquire_spinlock(&depot->inner_lock);
+
+	depot->exchanges++;
+	if (contended) {
+		depot->contentions++;
+		depot->window_contentions++;
+	}
+
+	if (++depot->window_exchanges >= kAdaptWindow)
+		adapt_magazine_capacity(depot);
+}
+
+
 static bool
 exchange_with_full(object_depot* depot, DepotMagazine*& magazine)
 {
 	ASSERT(magazine->IsEmpty());
 
-	SpinLocker _(depot->inner_lock);
+	lock_for_exchange(depot);
+	SpinLocker _(depot->inner_lock, true);
 
 	if (depot->full == NULL)
 		return false;
@@ -156,7 +229,8 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 {
 	ASSERT(magazine == NULL || magazine->IsFull());
 
-	SpinLocker _(depot->inner_lock);
+	lock_for_exchange(depot);
+	SpinLocker _(depot->inner_lock, true);
 
 	if (depot->empty == NULL)
 		return false;
@@ -164,7 +238,8 @@ exchange_with_empty(object_depot* depot, DepotMagazine*& magazine,
 	depot->empty_count--;
 
 	if (magazine != NULL) {
-		if (depot->full_count < depot->max_count) {
+		if (depot->full_count < depot->max_count
+			&& magazine->round_count == depot->magazine_capacity) {
 			_push(depot->full, magazine);
 			depot->full_count++;
 			freeMagazine = NULL;
@@ -207,21 +282,41 @@ object_depot_init(object_depot* depot, size_t capacity, size_t maxCount,
 	depot->full_count = depot->empty_count = 0;
 	depot->max_count = maxCount;
 	depot->magazine_capacity = capacity;
+	depot->min_capacity = capacity;
+	depot->max_capacity = std::max(capacity,
+		std::min(capacity * 8, kMaxMagazineCapacity));
+
+	depot->window_exchanges = 0;
+	depot->window_contentions = 0;
+	depot->window_start = system_time();
+	depot->exchanges = 0;
+	depot->contentions = 0;
+	depot->resizes = 0;
 
 	rw_lock_init(&depot->outer_lock, "object depot");
 	B_INITIALIZE_SPINLOCK(&depot->inner_lock);
 
+	// Every store gets its own cache line, so that the CPUs don't have to
+	// share the lines their counters are on
 	int cpuCount = smp_get_num_cpus();
-	depot->stores = (depot_cpu_store*)slab_internal_alloc(
-		sizeof(depot_cpu_store) * cpuCount, flags);
-	if (depot->stores == NULL) {
+	depot->stores_allocation = slab_internal_alloc(
+		sizeof(depot_cpu_store) * cpuCount + CACHE_LINE_SIZE - 1, flags);
+	if (depot->stores_allocation == NULL) {
 		rw_lock_destroy(&depot->outer_lock);
 		return B_NO_MEMORY;
 	}
 
+	depot->stores = (depot_cpu_store*)ROUNDUP(
+		(addr_t)depot->stores_allocation, CACHE_LINE_SIZE);
+
 	for (int i = 0; i < cpuCount; i++) {
-		depot->stores[i].loaded = NULL;
-		depot->stores[i].previous = NULL;
+		depot_cpu_store& store = depot->stores[i];
+		store.loaded = NULL;
+		store.previous = NULL;
+		store.obtain_hits = 0;
+		store.obtain_misses = 0;
+		store.store_hits = 0;
+		store.store_misses = 0;
 	}
 
 	depot->cookie = cookie;
@@ -236,7 +331,7 @@ object_depot_destroy(object_depot* depot, uint32 flags)
 {
 	object_depot_make_empty(depot, flags);
 
-	slab_internal_free(depot->stores, flags);
+	slab_internal_free(depot->stores_allocation, flags);
 
 	rw_lock_destroy(&depot->outer_lock);
 }
@@ -257,19 +352,25 @@ object_depot_obtain(object_depot* depot)
 	// if it's not empty, or from the previous magazine if it's full
 	// and finally from the Slab if the magazine depot has no full magazines.
 
-	if (store->loaded == NULL)
+	if (store->loaded == NULL) {
+		store->obtain_misses++;
 		return NULL;
+	}
 
 	while (true) {
-		if (!store->loaded->IsEmpty())
+		if (!store->loaded->IsEmpty()) {
+			store->obtain_hits++;
 			return store->loaded->Pop();
+		}
 
 		if (store->previous
 			&& (store->previous->IsFull()
 				|| exchange_with_full(depot, store->previous))) {
 			std::swap(store->previous, store->loaded);
-		} else
+		} else {
+			store->obtain_misses++;
 			return NULL;
+		}
 	}
 }
 
@@ -288,8 +389,10 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 	// we return the object directly to the slab.
 
 	while (true) {
-		if (store->loaded != NULL && store->loaded->Push(object))
+		if (store->loaded != NULL && store->loaded->Push(object)) {
+			store->store_hits++;
 			return;
+		}
 
 		DepotMagazine* freeMagazine = NULL;
 		if ((store->previous != NULL && store->previous->IsEmpty())
@@ -316,6 +419,9 @@ object_depot_store(object_depot* depot, void* object, uint32 flags)
 			DepotMagazine* magazine = alloc_magazine(depot, flags);
 			if (magazine == NULL) {
 				depot->return_object(depot, depot->cookie, object, flags);
+
+				InterruptsLocker _;
+				object_depot_cpu(depot)->store_misses++;
 				return;
 			}
 
@@ -361,6 +467,12 @@ object_depot_make_empty(object_depot* depot, uint32 flags)
 	DepotMagazine* emptyMagazines = depot->empty;
 	depot->empty = NULL;
 
+	depot->full_count = 0;
+	depot->empty_count = 0;
+
+	// we are asked to give back memory, so start over small
+	atomic_set(&depot->magazine_capacity, depot->min_capacity);
+
 	writeLocker.Unlock();
 
 	// free all magazines
@@ -376,6 +488,40 @@ object_depot_make_empty(object_depot* depot, uint32 flags)
 }
 
 
+/*!	Fills in the current state and the statistics of the depot. The per-CPU
+	counters are read without synchronization, so the result is only an
+	approximation while the depot is in use.
+*/
+void
+object_depot_get_info(object_depot* depot, object_depot_info* info)
+{
+	ReadLocker readLocker(depot->outer_lock);
+
+	info->obtain_hits = 0;
+	info->obtain_misses = 0;
+	info->store_hits = 0;
+	info->store_misses = 0;
+
+	int cpuCount = smp_get_num_cpus();
+	for (int i = 0; i < cpuCount; i++) {
+		const depot_cpu_store& store = depot->stores[i];
+		info->obtain_hits += store.obtain_hits;
+		info->obtain_misses += store.obtain_misses;
+		info->store_hits += store.store_hits;
+		info->store_misses += store.store_misses;
+	}
+
+	InterruptsSpinLocker locker(depot->inner_lock);
+
+	info->magazine_capacity = depot->magazine_capacity;
+	info->full_magazines = depot->full_count;
+	info->empty_magazines = depot->empty_count;
+	info->exchanges = depot->exchanges;
+	info->contentions = depot->contentions;
+	info->resizes = depot->resizes;
+}
+
+
 #if PARANOID_KERNEL_FREE
 
 bool
@@ -419,14 +565,22 @@ dump_object_depot(object_depot* depot)
 	kprintf("  full:     %p, count %lu\n", depot->full, depot->full_count);
 	kprintf("  empty:    %p, count %lu\n", depot->empty, depot->empty_count);
 	kprintf("  max full: %lu\n", depot->max_count);
-	kprintf("  capacity: %lu\n", depot->magazine_capacity);
+	kprintf("  capacity: %" B_PRId32 " (%lu - %lu)\n", depot->magazine_capacity,
+		depot->min_capacity, depot->max_capacity);
+	kprintf("  exchanges: %" B_PRIu64 ", contended %" B_PRIu64 ", resized %"
+		B_PRIu32 "\n", depot->exchanges, depot->contentions, depot->resizes);
 	kprintf("  stores:\n");
 
 	int cpuCount = smp_get_num_cpus();
 
 	for (int i = 0; i < cpuCount; i++) {
-		kprintf("  [%d] loaded:   %p\n", i, depot->stores[i].loaded);
-		kprintf("      previous: %p\n", depot->stores[i].previous);
+		depot_cpu_store& store = depot->stores[i];
+		kprintf("  [%d] loaded:   %p\n", i, store.loaded);
+		kprintf("      previous: %p\n", store.previous);
+		kprintf("      obtained: %" B_PRIu64 " hits, %" B_PRIu64 " misses\n",
+			store.obtain_hits, store.obtain_misses);
+		kprintf("      stored:   %" B_PRIu64 " hits, %" B_PRIu64 " misses\n",
+			store.store_hits, store.store_misses);
 	}
 }
 
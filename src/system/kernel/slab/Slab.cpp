@@ -16,10 +16,13 @@
 
 #include <KernelExport.h>
 
+#include <AutoDeleter.h>
 #include <condition_variable.h>
 #include <elf.h>
+#include <generic_syscall.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <object_cache_defs.h>
 #include <slab/ObjectDepot.h>
 #include <smp.h>
 #include <tracing.h>
@@ -1147,6 +1150,93 @@ object_cache_maintainer(void*)
 }
 
 
+static void
+get_object_cache_info(ObjectCache* cache, object_cache_info& info)
+{
+	strlcpy(info.name, cache->name, sizeof(info.name));
+	info.flags = 0;
+
+	MutexLocker locker(cache->lock);
+	info.object_size = cache->object_size;
+	info.total_objects = cache->total_objects;
+	info.used_objects = cache->used_count;
+	info.usage = cache->usage;
+	locker.Unlock();
+
+	object_depot_info depotInfo;
+	if ((cache->flags & CACHE_NO_DEPOT) == 0) {
+		object_depot_get_info(&cache->depot, &depotInfo);
+		info.flags |= OBJECT_CACHE_HAS_DEPOT;
+	} else
+		memset(&depotInfo, 0, sizeof(depotInfo));
+
+	info.magazine_capacity = depotInfo.magazine_capacity;
+	info.full_magazines = depotInfo.full_magazines;
+	info.alloc_hits = depotInfo.obtain_hits;
+	info.alloc_misses = depotInfo.obtain_misses;
+	info.free_hits = depotInfo.store_hits;
+	info.free_misses = depotInfo.store_misses;
+	info.depot_exchanges = depotInfo.exchanges;
+	info.depot_contentions = depotInfo.contentions;
+	info.magazine_resizes = depotInfo.resizes;
+}
+
+
+static status_t
+object_cache_control(const char* subsystem, uint32 function, void* buffer,
+	size_t bufferSize)
+{
+	switch (function) {
+		case GET_OBJECT_CACHE_INFOS:
+		{
+			if (buffer != NULL && !IS_USER_ADDRESS(buffer))
+				return B_BAD_ADDRESS;
+
+			size_t maxCount = buffer != NULL
+				? bufferSize / sizeof(object_cache_info) : 0;
+
+			MutexLocker locker(sObjectCacheListLock);
+			maxCount = std::min(maxCount, (size_t)sObjectCaches.Count());
+			locker.Unlock();
+
+			object_cache_info* infos = NULL;
+			if (maxCount > 0) {
+				// zeroed, as the padding and the unused parts of the names
+				// are copied to userland, too
+				infos = (object_cache_info*)calloc(maxCount,
+					sizeof(object_cache_info));
+				if (infos == NULL)
+					return B_NO_MEMORY;
+			}
+			MemoryDeleter infosDeleter(infos);
+
+			// the caches can't go away while we hold the list lock
+			locker.Lock();
+
+			size_t count = 0;
+			int32 totalCount = 0;
+			ObjectCacheList::Iterator iterator = sObjectCaches.GetIterator();
+			while (ObjectCache* cache = iterator.Next()) {
+				if (count < maxCount)
+					get_object_cache_info(cache, infos[count++]);
+				totalCount++;
+			}
+
+			locker.Unlock();
+
+			if (count > 0 && user_memcpy(buffer, infos,
+					count * sizeof(object_cache_info)) != B_OK) {
+				return B_BAD_ADDRESS;
+			}
+
+			return totalCount;
+		}
+	}
+
+	return B_BAD_VALUE;
+}
+
+
 // #pragma mark - public API
 
 
@@ -1448,6 +1538,9 @@ slab_init_post_thread()
 	}
 
 	resume_thread(objectCacheResizer);
+
+	register_generic_syscall(OBJECT_CACHE_SYSCALLS, object_cache_control, 1,
+		0);
 }
 
 
@@ -64,6 +64,32 @@ ObjectCache* gVnodeCacheObjectCache;
 ObjectCache* gDeviceCacheObjectCache;
 ObjectCache* gNullCacheObjectCache;
 
+// Shadow entries remember when the page daemon evicted a page from a cache,
+// so that we can tell how long it was gone, once it is faulted in again.
+// They are kept in a global, direct-mapped table that simply overwrites older
+// entries on collision; this bounds the memory used, and losing an entry now
+// and then only means that a refault goes unnoticed.
+struct shadow_entry {
+	uint32	cache_id;
+	uint32	offset;
+	uint32	eviction_time;
+};
+
+static const uint32 kShadowLockCount = 64;
+
+static shadow_entry* sShadowEntries;
+static uint32 sShadowEntryMask;
+static spinlock sShadowLocks[kShadowLockCount];
+static int32 sNextShadowID;
+
+
+static inline uint32
+shadow_entry_index(uint32 cacheID, page_num_t offset)
+{
+	return ((uint32)offset * 2654435761U ^ cacheID * 40503U)
+		& sShadowEntryMask;
+}
+
 
 struct VMCache::PageEventWaiter {
 	Thread*				thread;
@@ -541,6 +567,24 @@ vm_cache_init(kernel_args* args)
 void
 vm_cache_init_post_heap()
 {
+	// Allocate the shadow entry table: one entry for every eight pages of
+	// memory should cover everything the page daemon can evict in a
+	// reasonable time frame.
+	uint32 shadowEntries = 1024;
+	while (shadowEntries < vm_page_num_pages() / 8
+		&& shadowEntries < 1024 * 1024) {
+		shadowEntries *= 2;
+	}
+
+	for (uint32 i = 0; i < kShadowLockCount; i++)
+		B_INITIALIZE_SPINLOCK(&sShadowLocks[i]);
+
+	sShadowEntries = (shadow_entry*)calloc(shadowEntries, sizeof(shadow_entry));
+	if (sShadowEntries != NULL)
+		sShadowEntryMask = shadowEntries - 1;
+	else
+		dprintf("vm_cache_init_post_heap(): no memory for shadow entries\n");
+
 #if VM_CACHE_TRACING
 	add_debugger_command_etc("cache_stack", &command_cache_stack,
 		"List the ancestors (sources) of a VMCache at the time given by "
@@ -646,6 +690,10 @@ VMCache::Init(uint32 cacheType, uint32 allocationFlags)
 	type = cacheType;
 	fPageEventWaiters = NULL;
 
+	do {
+		fShadowID = (uint32)atomic_add(&sNextShadowID, 1) + 1;
+	} while (fShadowID == 0);
+
 #if DEBUG_CACHE_LIST
 	debug_previous = NULL;
 	debug_next = NULL;
@@ -815,6 +863,11 @@ VMCache::InsertPage(vm_page* page, off_t offset)
 
 	if (page->WiredCount() > 0)
 		IncrementWiredPagesCount();
+
+	// let the page daemon know if the page was evicted before
+	uint32 evictionTime;
+	if (RemoveShadowEntry(page->cache_offset, evictionTime))
+		vm_page_refault(page, evictionTime);
 }
 
 
@@ -844,6 +897,52 @@ VMCache::RemovePage(vm_page* page)
 }
 
 
+/*!	Remembers that the page at \a offset has been evicted from this cache
+	at \a evictionTime (as counted by the page daemon).
+	The cache must be locked.
+*/
+void
+VMCache::AddShadowEntry(page_num_t offset, uint32 evictionTime)
+{
+	AssertLocked();
+
+	if (sShadowEntries == NULL)
+		return;
+
+	uint32 index = shadow_entry_index(fShadowID, offset);
+	InterruptsSpinLocker locker(sShadowLocks[index % kShadowLockCount]);
+
+	shadow_entry& entry = sShadowEntries[index];
+	entry.cache_id = fShadowID;
+	entry.offset = (uint32)offset;
+	entry.eviction_time = evictionTime;
+}
+
+
+/*!	Looks up and removes the shadow entry for the page at \a offset.
+	Returns \c true and the time the page had been evicted in
+	\a _evictionTime, if there was one.
+	The cache must be locked.
+*/
+bool
+VMCache::RemoveShadowEntry(page_num_t offset, uint32& _evictionTime)
+{
+	if (sShadowEntries == NULL)
+		return false;
+
+	uint32 index = shadow_entry_index(fShadowID, offset);
+	InterruptsSpinLocker locker(sShadowLocks[index % kShadowLockCount]);
+
+	shadow_entry& entry = sShadowEntries[index];
+	if (entry.cache_id != fShadowID || entry.offset != (uint32)offset)
+		return false;
+
+	_evictionTime = entry.eviction_time;
+	entry.cache_id = 0;
+	return true;
+}
+
+
 /*!	Moves the given page from its current cache inserts it into this cache
 	at the given offset.
 	Both caches must be locked.
@@ -1125,16 +1224,25 @@ VMCache::_FreePageRange(VMCachePagesTree::Iterator it,
 
 		// remove the page and put it into the free queue
 		DEBUG_PAGE_ACCESS_START(page);
-		vm_remove_all_page_mappings(page);
-		ASSERT(page->WiredCount() == 0);
-			// TODO: Find a real solution! If the page is wired
-			// temporarily (e.g. by lock_memory()), we actually must not
-			// unmap it!
+
+		// If the page is still in use, e.g. by lock_memory() or a sendfile()
+		// in flight, it keeps its mappings and is only detached from the
+		// cache; whoever unwires it last frees it (see vm_free_detached_page())
+		bool wired = page->WiredCount() > 0;
+		if (wired)
+			vm_page_set_state(page, PAGE_STATE_WIRED);
+		else
+			vm_remove_all_page_mappings(page);
+
 		RemovePage(page);
 			// Note: When iterating through a IteratableSplayTree
 			// removing the current node is safe.
 
-		vm_page_free(this, page);
+		if (wired)
+			DEBUG_PAGE_ACCESS_END(page);
+		else
+			vm_page_free(this, page);
+
 		if (freedPages != NULL)
 			(*freedPages)++;
 	}
@@ -39,6 +39,45 @@ VMTranslationMap::DebugMarkRangePresent(addr_t start, addr_t end,
 }
 
 
+/*!	Returns the size of the large pages CollapseLargePage() can create in
+	this map, or \c 0, if large pages are not supported.
+
+	The default implementation returns \c 0.
+*/
+size_t
+VMTranslationMap::LargePageSize() const
+{
+	return 0;
+}
+
+
+/*!	Maps the range of LargePageSize() bytes starting at \a address with a
+	single large page.
+	The range must already be completely mapped, to physically contiguous
+	pages starting at a suitably aligned physical address, and with the same
+	protection and memory type for all pages. The large page is split up
+	again, whenever a part of the range is changed later.
+
+	The default implementation returns \c B_NOT_SUPPORTED.
+*/
+status_t
+VMTranslationMap::CollapseLargePage(addr_t address)
+{
+	return B_NOT_SUPPORTED;
+}
+
+
+/*!	Splits up all large pages intersecting the range from \a start to \a end
+	(inclusive) into individually mapped pages.
+
+	The default implementation does nothing.
+*/
+void
+VMTranslationMap::SplitLargePages(addr_t start, addr_t end)
+{
+}
+
+
 /*!	Unmaps a range of pages of an area.
 
 	The default implementation just iterates over all virtual pages of the
@@ -146,7 +185,7 @@ VMTranslationMap::UnmapArea(VMArea* area, bool deletingAddressSpace,
 			if ((flags & PAGE_MODIFIED) != 0)
 				page->modified = true;
 
-			if (pageFullyUnmapped) {
+			if (pageFullyUnmapped && cache != NULL) {
 				DEBUG_PAGE_ACCESS_START(page);
 
 				if (cache->temporary)
@@ -268,7 +307,9 @@ VMTranslationMap::PageUnmapped(VMArea* area, page_num_t pageNumber,
 	if (!page->IsMapped()) {
 		atomic_add(&gMappedPagesCount, -1);
 
-		if (updatePageQueue) {
+		// Pages detached from their cache are still wired, and freed by
+		// whoever unwires them last; see vm_free_detached_page().
+		if (updatePageQueue && page->Cache() != NULL) {
 			if (page->Cache()->temporary)
 				vm_page_set_state(page, PAGE_STATE_INACTIVE);
 			else if (page->modified)
@@ -3336,6 +3336,22 @@ vm_remove_all_page_mappings(vm_page* page)
 }
 
 
+/*!	Frees a page that has been detached from its cache while it was still
+	wired (see VMCache::_FreePageRange()), after its last wiring is gone.
+	Any mappings the page still has are removed first.
+	No translation map must be locked.
+*/
+void
+vm_free_detached_page(vm_page* page)
+{
+	ASSERT(page->Cache() == NULL && page->WiredCount() == 0);
+
+	DEBUG_PAGE_ACCESS_START(page);
+	vm_remove_all_page_mappings(page);
+	vm_page_free(NULL, page);
+}
+
+
 int32
 vm_clear_page_mapping_accessed_flags(struct vm_page *page)
 {
@@ -3919,6 +3935,369 @@ vm_allocate_early(kernel_args* args, size_t virtualSize, size_t physicalSize,
 }
 
 
+//	#pragma mark - large pages
+
+
+static const bigtime_t kLargePageCollapseInterval = 2000000;
+static const uint32 kLargePageScanAreas = 32;
+static const int32 kLargePageMigrationsPerPass = 32;
+
+static int32 sLargePagesCollapsed;
+static int32 sLargePagesMigrated;
+static int32 sLargePageRunFailures;
+
+
+/*!	Returns whether the pages of \a area may be moved around and be mapped by
+	large pages.
+	The area's address space must be locked.
+*/
+static bool
+is_large_page_area(VMArea* area)
+{
+	return (area->protection & B_LARGE_PAGES_AREA) != 0
+		&& area->wiring == B_NO_LOCK
+		&& area->cache_type == CACHE_TYPE_RAM
+		&& area->page_protections == NULL
+		&& !area->IsWired();
+}
+
+
+/*!	Checks whether the range of \a size bytes at \a address of \a area can be
+	mapped by a large page.
+	Only ranges whose pages are all present in the area's cache, and mapped by
+	no one but \a area are eligible.
+	The area's address space and cache must be locked.
+	\return \c B_OK, if the pages are physically contiguous and suitably
+		aligned already, \c B_BUSY, if they would have to be moved first, or
+		another error code, if the range is not eligible.
+*/
+static status_t
+check_large_page_range(VMArea* area, addr_t address, size_t size)
+{
+	VMCache* cache = area->cache;
+	if (!cache->consumers.IsEmpty() || cache->areas.Head() != area
+		|| cache->areas.GetNext(area) != NULL) {
+		return B_NOT_ALLOWED;
+	}
+
+	page_num_t firstOffset
+		= (address - area->Base() + area->cache_offset) >> PAGE_SHIFT;
+	page_num_t pageCount = size / B_PAGE_SIZE;
+	page_num_t firstPhysicalPage = 0;
+	bool contiguous = true;
+
+	VMCachePagesTree::Iterator it
+		= cache->pages.GetIterator(firstOffset, true, true);
+	for (page_num_t i = 0; i < pageCount; i++) {
+		vm_page* page = it.Next();
+		if (page == NULL || page->cache_offset != firstOffset + i
+			|| page->busy || page->WiredCount() != 0) {
+			return B_ENTRY_NOT_FOUND;
+		}
+
+		vm_page_mapping* mapping = page->mappings.Head();
+		if (mapping == NULL || mapping->area != area
+			|| page->mappings.GetNext(mapping) != NULL) {
+			return B_ENTRY_NOT_FOUND;
+		}
+
+		if (i == 0) {
+			firstPhysicalPage = page->physical_page_number;
+			contiguous = firstPhysicalPage % pageCount == 0;
+		} else if (page->physical_page_number != firstPhysicalPage + i)
+			contiguous = false;
+	}
+
+	return contiguous ? B_OK : B_BUSY;
+}
+
+
+/*!	Moves the pages of the range of \a size bytes at \a address of \a area to
+	the physically contiguous page run starting at \a run, and maps them again.
+	The pages of the run that aren't used are freed.
+	The area's address space and cache must be locked, and
+	check_large_page_range() must have returned \c B_BUSY for the range.
+*/
+static status_t
+migrate_large_page_range(VMArea* area, addr_t address, size_t size,
+	vm_page* run, vm_page_reservation* reservation)
+{
+	VMCache* cache = area->cache;
+	VMTranslationMap* map = area->address_space->TranslationMap();
+	off_t cacheOffset = address - area->Base() + area->cache_offset;
+	page_num_t pageCount = size / B_PAGE_SIZE;
+
+	status_t status = B_OK;
+	page_num_t i = 0;
+	for (; i < pageCount; i++) {
+		addr_t pageAddress = address + i * B_PAGE_SIZE;
+		off_t pageOffset = cacheOffset + i * B_PAGE_SIZE;
+		vm_page* page = cache->LookupPage(pageOffset);
+		vm_page* newPage = &run[i];
+
+		// Unmap the page before copying it, so that it cannot be changed
+		// meanwhile. Any access will fault and wait for the cache lock.
+		DEBUG_PAGE_ACCESS_START(page);
+		map->UnmapPage(area, pageAddress, false);
+
+		vm_memcpy_physical_page(newPage->physical_page_number * B_PAGE_SIZE,
+			page->physical_page_number * B_PAGE_SIZE);
+		newPage->accessed = page->accessed;
+		newPage->modified = page->modified;
+		newPage->usage_count = page->usage_count;
+		int32 state = page->State();
+
+		cache->RemovePage(page);
+		cache->InsertPage(newPage, pageOffset);
+		if (newPage->State() != state)
+			vm_page_set_state(newPage, state);
+
+		vm_page_free_etc(cache, page, reservation);
+
+		status = map_page(area, newPage, pageAddress,
+			get_area_page_protection(area, pageAddress), reservation);
+		DEBUG_PAGE_ACCESS_END(newPage);
+
+		if (status != B_OK) {
+			// The page will simply be faulted in again.
+			i++;
+			break;
+		}
+	}
+
+	for (; i < pageCount; i++)
+		vm_page_free_etc(NULL, &run[i], reservation);
+
+	return status;
+}
+
+
+/*!	Tries to map all suitable large page sized ranges of the area with the ID
+	\a id by large pages. At most \a migrationBudget ranges will have their
+	pages moved to a physically contiguous page run for this.
+*/
+static void
+collapse_area_large_pages(area_id id, int32& migrationBudget)
+{
+	AddressSpaceReadLocker locker;
+	VMArea* area;
+	if (locker.SetFromArea(id, area) != B_OK)
+		return;
+
+	VMTranslationMap* map = area->address_space->TranslationMap();
+	size_t largePageSize = map->LargePageSize();
+	if (largePageSize == 0)
+		return;
+
+	for (addr_t address = ROUNDUP(area->Base(), largePageSize);;
+			address += largePageSize) {
+		// The area may have changed while it was unlocked.
+		if (!is_large_page_area(area) || address < area->Base()
+			|| address - area->Base() + largePageSize > area->Size()) {
+			return;
+		}
+
+		VMCache* cache = vm_area_get_locked_cache(area);
+		status_t status = check_large_page_range(area, address,
+			largePageSize);
+		if (status == B_OK) {
+			map->Lock();
+			if (map->CollapseLargePage(address) == B_OK)
+				atomic_add(&sLargePagesCollapsed, 1);
+			map->Unlock();
+		}
+		vm_area_put_locked_cache(cache);
+
+		if (status != B_BUSY || migrationBudget <= 0)
+			continue;
+
+		// The pages have to be moved to a suitable page run first. Since
+		// allocating one may take a while, we don't hold any locks meanwhile.
+		// We don't even try, if we would eat into the page reserves.
+		locker.Unset();
+
+		page_num_t pageCount = largePageSize / B_PAGE_SIZE;
+		vm_page* run = NULL;
+		if (vm_page_num_unused_pages() > pageCount * 8) {
+			physical_address_restrictions restrictions = {};
+			restrictions.alignment = largePageSize;
+			run = vm_page_allocate_page_run(PAGE_STATE_ACTIVE, pageCount,
+				&restrictions, VM_PRIORITY_USER);
+		}
+
+		if (run == NULL) {
+			// Physical memory is too fragmented, try again later.
+			atomic_add(&sLargePageRunFailures, 1);
+			migrationBudget = 0;
+			return;
+		}
+
+		migrationBudget--;
+
+		vm_page_reservation reservation;
+		vm_page_reserve_pages(&reservation,
+			map->MaxPagesNeededToMap(address, address + largePageSize - 1),
+			VM_PRIORITY_USER);
+
+		bool runUsed = false;
+		if (locker.SetFromArea(id, area) == B_OK && is_large_page_area(area)
+			&& address >= area->Base()
+			&& address - area->Base() + largePageSize <= area->Size()) {
+			cache = vm_area_get_locked_cache(area);
+			if (check_large_page_range(area, address, largePageSize)
+					== B_BUSY) {
+				runUsed = true;
+				status = migrate_large_page_range(area, address,
+					largePageSize, run, &reservation);
+				if (status == B_OK) {
+					atomic_add(&sLargePagesMigrated, 1);
+
+					map->Lock();
+					if (map->CollapseLargePage(address) == B_OK)
+						atomic_add(&sLargePagesCollapsed, 1);
+					map->Unlock();
+				}
+			}
+			vm_area_put_locked_cache(cache);
+		}
+
+		if (!runUsed) {
+			// The range has changed while we weren't looking.
+			for (page_num_t i = 0; i < pageCount; i++)
+				vm_page_free_etc(NULL, &run[i], &reservation);
+		}
+
+		vm_page_unreserve_pages(&reservation);
+
+		if (!locker.IsLocked())
+			return;
+	}
+}
+
+
+/*!	Fills \a areas with the IDs of up to \a maxCount areas with the
+	\c B_LARGE_PAGES_AREA hint, whose IDs are greater than \a after.
+*/
+static uint32
+collect_large_page_areas(area_id after, area_id* areas, uint32 maxCount)
+{
+	uint32 count = 0;
+
+	VMAreas::ReadLock();
+
+	for (VMAreasTree::Iterator it = VMAreas::GetIterator();
+			VMArea* area = it.Next();) {
+		if (area->id > after && (area->protection & B_LARGE_PAGES_AREA) != 0) {
+			areas[count++] = area->id;
+			if (count == maxCount)
+				break;
+		}
+	}
+
+	VMAreas::ReadUnlock();
+
+	return count;
+}
+
+
+/*!	Periodically looks for ranges of large page areas that can be mapped by
+	large pages, and moves their pages to physically contiguous page runs, if
+	necessary.
+*/
+static status_t
+large_page_collapser(void* /*unused*/)
+{
+	area_id lastArea = -1;
+
+	while (true) {
+		snooze(kLargePageCollapseInterval);
+
+		if (low_resource_state(B_KERNEL_RESOURCE_PAGES
+				| B_KERNEL_RESOURCE_MEMORY) != B_NO_LOW_RESOURCE) {
+			continue;
+		}
+
+		area_id areas[kLargePageScanAreas];
+		uint32 count = collect_large_page_areas(lastArea, areas,
+			kLargePageScanAreas);
+
+		int32 migrationBudget = kLargePageMigrationsPerPass;
+		for (uint32 i = 0; i < count; i++)
+			collapse_area_large_pages(areas[i], migrationBudget);
+
+		lastArea = count == kLargePageScanAreas ? areas[count - 1] : -1;
+	}
+
+	return B_OK;
+}
+
+
+/*!	Splits up the large pages of all large page areas again when memory is
+	getting low, so that the page daemon can reclaim their pages individually.
+*/
+static void
+large_pages_low_resource_handler(void* /*data*/, uint32 resources,
+	int32 level)
+{
+	if (level < B_LOW_RESOURCE_WARNING)
+		return;
+
+	area_id lastArea = -1;
+	while (true) {
+		area_id areas[kLargePageScanAreas];
+		uint32 count = collect_large_page_areas(lastArea, areas,
+			kLargePageScanAreas);
+
+		for (uint32 i = 0; i < count; i++) {
+			AddressSpaceReadLocker locker;
+			VMArea* area;
+			if (locker.SetFromArea(areas[i], area) != B_OK)
+				continue;
+
+			VMTranslationMap* map = area->address_space->TranslationMap();
+			map->Lock();
+			map->SplitLargePages(area->Base(),
+				area->Base() + (area->Size() - 1));
+			map->Unlock();
+		}
+
+		if (count < kLargePageScanAreas)
+			break;
+
+		lastArea = areas[count - 1];
+	}
+}
+
+
+static int
+dump_large_pages(int argc, char** argv)
+{
+	kprintf("large pages collapsed: %" B_PRId32 "\n", sLargePagesCollapsed);
+	kprintf("page ranges migrated:  %" B_PRId32 "\n", sLargePagesMigrated);
+	kprintf("page run failures:     %" B_PRId32 "\n", sLargePageRunFailures);
+	return 0;
+}
+
+
+static void
+large_pages_init_post_thread()
+{
+	register_low_resource_handler(&large_pages_low_resource_handler, NULL,
+		B_KERNEL_RESOURCE_PAGES | B_KERNEL_RESOURCE_MEMORY, 0);
+
+	thread_id thread = spawn_kernel_thread(&large_page_collapser,
+		"large page collapser", B_LOWEST_ACTIVE_PRIORITY, NULL);
+	if (thread >= 0)
+		resume_thread(thread);
+
+	add_debugger_command("large_pages", &dump_large_pages,
+		"Print large page statistics");
+}
+
+
+//	#pragma mark -
+
+
 /*!	The main entrance point to initialize the VM. */
 status_t
 vm_init(kernel_args* args)
@@ -4080,6 +4459,7 @@ vm_init_post_thread(kernel_args* args)
 {
 	vm_page_init_post_thread(args);
 	slab_init_post_thread();
+	large_pages_init_post_thread();
 	return heap_init_post_thread();
 }
 
@@ -5338,6 +5718,8 @@ vm_unwire_page(VMPageWiringInfo* info)
 	}
 
 	decrement_page_wired_count(info->page);
+	if (info->page->Cache() == NULL && info->page->WiredCount() == 0)
+		vm_free_detached_page(info->page);
 
 	// remove the wired range from the range
 	area->Unwire(&info->range);
@@ -5621,6 +6003,14 @@ unlock_memory_etc(team_id team, void* address, size_t numBytes, uint32 flags)
 				// Already mapped with the correct permissions -- just increment
 				// the page's wired count.
 				decrement_page_wired_count(page);
+
+				if (page->Cache() == NULL && page->WiredCount() == 0) {
+					// The page's cache has been shrunk in the mean time, and
+					// we were the last ones to use it.
+					map->Unlock();
+					vm_free_detached_page(page);
+					map->Lock();
+				}
 			} else {
 				panic("unlock_memory_etc(): Failed to unwire page: address "
 					"space %p, address: %#" B_PRIxADDR, addressSpace,
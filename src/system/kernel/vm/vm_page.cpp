@@ -27,6 +27,7 @@
 #include <heap.h>
 #include <kernel.h>
 #include <low_resource_manager.h>
+#include <smp.h>
 #include <thread.h>
 #include <tracing.h>
 #include <util/AutoLock.h>
@@ -133,6 +134,50 @@ static mutex sPageDeficitLock = MUTEX_INITIALIZER("page deficit");
 static rw_lock sFreePageQueuesLock
 	= RW_LOCK_INITIALIZER("free/clear page queues");
 
+// Per-CPU caches of free and clear pages, so that vm_page_allocate_page() and
+// free_page() usually don't have to touch sFreePageQueuesLock at all.
+// Pages in a magazine keep their PAGE_STATE_FREE/CLEAR state, but are not in
+// any queue. Anyone who write-locks sFreePageQueuesLock and expects to find
+// all free pages in the queues must call disable_page_magazines() first.
+static const uint32 kPageMagazineSize = 64;
+static const uint32 kPageMagazineBatch = 32;
+	// number of pages moved between a magazine and the queues at once
+
+struct page_magazine {
+	VMPageQueue::PageList	pages;
+	uint32					count;
+};
+
+struct page_magazine_store {
+	spinlock				lock;
+	page_magazine			free;
+	page_magazine			clear;
+
+	// statistics
+	uint64					hits;
+	uint64					misses;
+	uint64					frees;
+	uint64					drains;
+	uint64					flushes;
+} CACHE_LINE_ALIGN;
+
+static page_magazine_store sPageMagazines[SMP_MAX_CPUS];
+static int32 sPageMagazinesDisabled;
+
+static page_num_t count_magazine_pages();
+
+// Working set detection: every page stolen from the cached queue advances
+// the eviction clock, and leaves a shadow entry in its cache. If the page is
+// faulted in again, the difference of the clock values tells us how many
+// pages would have been needed to keep it in memory. If that is less than
+// what the active and inactive queues hold, the page is considered part of a
+// working set, and gets a few extra rounds in the cached queue; pages that are
+// only read once (ie. streamed) don't, and are thus evicted first.
+static uint32 sPageEvictionClock;
+static uint32 sPageRefaults;
+static uint32 sWorkingSetRefaults;
+static uint32 sWorkingSetSecondChances;
+
 #ifdef TRACK_PAGE_USAGE_STATS
 static page_num_t sPageUsageArrays[512];
 static page_num_t* sPageUsage = sPageUsageArrays;
@@ -1216,6 +1261,30 @@ dump_page_stats(int argc, char **argv)
 		&sInactivePageQueue, sInactivePageQueue.Count());
 	kprintf("cached queue: %p, count = %" B_PRIuPHYSADDR "\n",
 		&sCachedPageQueue, sCachedPageQueue.Count());
+
+	kprintf("\nevicted pages: %" B_PRIu32 ", refaults: %" B_PRIu32
+		" (working set: %" B_PRIu32 "), second chances: %" B_PRIu32 "\n",
+		sPageEvictionClock, sPageRefaults, sWorkingSetRefaults,
+		sWorkingSetSecondChances);
+
+	kprintf("\nper-CPU page magazines%s:\n",
+		sPageMagazinesDisabled != 0 ? " (disabled)" : "");
+	kprintf("  cpu   free  clear         hits       misses        frees"
+		"   drains  flushes\n");
+	uint64 totalHits = 0;
+	uint64 totalMisses = 0;
+	for (int32 i = 0; i < smp_get_num_cpus(); i++) {
+		const page_magazine_store& store = sPageMagazines[i];
+		kprintf("  %3" B_PRId32 " %6" B_PRIu32 " %6" B_PRIu32 " %12" B_PRIu64
+			" %12" B_PRIu64 " %12" B_PRIu64 " %8" B_PRIu64 " %8" B_PRIu64 "\n",
+			i, store.free.count, store.clear.count, store.hits, store.misses,
+			store.frees, store.drains, store.flushes);
+		totalHits += store.hits;
+		totalMisses += store.misses;
+	}
+	kprintf("  pages in magazines: %" B_PRIuPHYSADDR ", hit rate: %" B_PRIu64
+		"%%\n", count_magazine_pages(), totalHits + totalMisses > 0
+			? totalHits * 100 / (totalHits + totalMisses) : 0);
 	return 0;
 }
 
@@ -1551,6 +1620,221 @@ unreserve_pages(uint32 count)
 }
 
 
+/*!	Moves all pages from the given magazine to the end of \a queue.
+	The caller must hold a read lock on the free/clear page queues, and must
+	own the pages, ie. they must already have been removed from the magazine.
+*/
+static void
+return_magazine_pages(VMPageQueue& queue, VMPageQueue::PageList& pages,
+	uint32 count)
+{
+	if (count == 0)
+		return;
+
+	queue.AppendUnlocked(pages, count);
+
+	if (&queue == &sFreePageQueue)
+		sFreePageCondition.NotifyAll();
+}
+
+
+/*!	Takes a page from the current CPU's magazines, and sets it to the state
+	given in \a flags. Prefers a clear page if VM_PAGE_ALLOC_CLEAR is set, a
+	free one otherwise. Returns \c NULL if both magazines are empty.
+	\a _oldState is set to the state the page had before.
+*/
+static vm_page*
+page_magazine_get(uint32 flags, int& _oldState)
+{
+	InterruptsLocker interruptsLocker;
+	page_magazine_store& store = sPageMagazines[smp_get_current_cpu()];
+	SpinLocker locker(store.lock);
+
+	if (atomic_get(&sPageMagazinesDisabled) != 0)
+		return NULL;
+
+	bool clear = (flags & VM_PAGE_ALLOC_CLEAR) != 0;
+	page_magazine* magazine = clear ? &store.clear : &store.free;
+	if (magazine->count == 0)
+		magazine = clear ? &store.free : &store.clear;
+	if (magazine->count == 0) {
+		store.misses++;
+		return NULL;
+	}
+
+	vm_page* page = magazine->pages.RemoveHead();
+	magazine->count--;
+	store.hits++;
+
+	// The state must be changed before we unlock, so that no one will try to
+	// find the page in the free/clear queues (see disable_page_magazines()).
+	DEBUG_PAGE_ACCESS_START(page);
+
+	_oldState = page->State();
+	page->SetState(flags & VM_PAGE_ALLOC_STATE);
+
+	return page;
+}
+
+
+/*!	Moves a batch of pages from \a queue into the current CPU's magazine of
+	the same kind, if there are enough pages left in the queue that other CPUs
+	won't miss them.
+	The caller must hold a read lock on the free/clear page queues.
+*/
+static void
+page_magazine_refill(VMPageQueue& queue)
+{
+	if (queue.Count()
+			< (page_num_t)smp_get_num_cpus() * kPageMagazineSize) {
+		return;
+	}
+
+	VMPageQueue::PageList pages;
+	uint32 count = 0;
+	while (count < kPageMagazineBatch) {
+		vm_page* page = queue.RemoveHeadUnlocked();
+		if (page == NULL)
+			break;
+
+		pages.Add(page);
+		count++;
+	}
+
+	if (count == 0)
+		return;
+
+	InterruptsLocker interruptsLocker;
+	page_magazine_store& store = sPageMagazines[smp_get_current_cpu()];
+	SpinLocker locker(store.lock);
+
+	page_magazine& magazine
+		= &queue == &sClearPageQueue ? store.clear : store.free;
+	if (atomic_get(&sPageMagazinesDisabled) == 0
+		&& magazine.count + count <= kPageMagazineSize) {
+		magazine.pages.TakeFrom(&pages);
+		magazine.count += count;
+		return;
+	}
+
+	locker.Unlock();
+	interruptsLocker.Unlock();
+
+	return_magazine_pages(queue, pages, count);
+}
+
+
+/*!	Sets the given page to PAGE_STATE_CLEAR or PAGE_STATE_FREE, depending on
+	\a clear, and puts it into the current CPU's magazine. If the magazine is
+	full, its oldest pages are returned to the free/clear queues first.
+	Returns \c false if the magazines cannot be used at the moment; the page
+	is left untouched, then.
+*/
+static bool
+page_magazine_put(vm_page* page, bool clear)
+{
+	ReadLocker queuesLocker;
+	VMPageQueue::PageList overflow;
+	uint32 overflowCount = 0;
+
+	while (true) {
+		InterruptsLocker interruptsLocker;
+		page_magazine_store& store = sPageMagazines[smp_get_current_cpu()];
+		SpinLocker locker(store.lock);
+
+		if (atomic_get(&sPageMagazinesDisabled) != 0)
+			return false;
+
+		page_magazine& magazine = clear ? store.clear : store.free;
+		if (magazine.count >= kPageMagazineSize) {
+			// Pages that are neither in a magazine nor in a queue must not
+			// be visible as free while the queues aren't locked.
+			if (!queuesLocker.IsLocked()) {
+				locker.Unlock();
+				interruptsLocker.Unlock();
+				queuesLocker.SetTo(sFreePageQueuesLock, false);
+				continue;
+			}
+
+			while (overflowCount < kPageMagazineBatch) {
+				overflow.Add(magazine.pages.RemoveTail(), false);
+				overflowCount++;
+			}
+			magazine.count -= overflowCount;
+			store.drains++;
+		}
+
+		page->SetState(clear ? PAGE_STATE_CLEAR : PAGE_STATE_FREE);
+		DEBUG_PAGE_ACCESS_END(page);
+
+		magazine.pages.Add(page, false);
+		magazine.count++;
+		store.frees++;
+		break;
+	}
+
+	return_magazine_pages(clear ? sClearPageQueue : sFreePageQueue, overflow,
+		overflowCount);
+	return true;
+}
+
+
+/*!	Empties all per-CPU magazines into the free/clear queues, and prevents
+	them from being used until enable_page_magazines() is called.
+	The caller must write-lock the free/clear page queues.
+*/
+static void
+disable_page_magazines()
+{
+	atomic_add(&sPageMagazinesDisabled, 1);
+
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++) {
+		page_magazine_store& store = sPageMagazines[i];
+		VMPageQueue::PageList freePages;
+		VMPageQueue::PageList clearPages;
+
+		InterruptsSpinLocker locker(store.lock);
+
+		uint32 freeCount = store.free.count;
+		uint32 clearCount = store.clear.count;
+		freePages.TakeFrom(&store.free.pages);
+		clearPages.TakeFrom(&store.clear.pages);
+		store.free.count = 0;
+		store.clear.count = 0;
+		if (freeCount + clearCount > 0)
+			store.flushes++;
+
+		locker.Unlock();
+
+		return_magazine_pages(sFreePageQueue, freePages, freeCount);
+		return_magazine_pages(sClearPageQueue, clearPages, clearCount);
+	}
+}
+
+
+static inline void
+enable_page_magazines()
+{
+	atomic_add(&sPageMagazinesDisabled, -1);
+}
+
+
+/*!	Returns the number of pages currently held in the per-CPU magazines.
+	The value is not synchronized, and only meant for statistics.
+*/
+static page_num_t
+count_magazine_pages()
+{
+	page_num_t count = 0;
+	int32 cpuCount = smp_get_num_cpus();
+	for (int32 i = 0; i < cpuCount; i++)
+		count += sPageMagazines[i].free.count + sPageMagazines[i].clear.count;
+
+	return count;
+}
+
+
 static void
 free_page(vm_page* page, bool clear)
 {
@@ -1601,6 +1885,12 @@ free_page(vm_page* page, bool clear)
 	page->allocation_tracking_info.Clear();
 #endif
 
+	// As long as nobody is waiting for pages, keep the page on this CPU
+	if (atomic_get(&sUnsatisfiedPageReservations) == 0
+		&& page_magazine_put(page, clear)) {
+		return;
+	}
+
 	ReadLocker locker(sFreePageQueuesLock);
 
 	DEBUG_PAGE_ACCESS_END(page);
@@ -1777,6 +2067,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 	}
 
 	WriteLocker locker(sFreePageQueuesLock);
+	disable_page_magazines();
 
 	for (page_num_t i = 0; i < length; i++) {
 		vm_page *page = &sPages[startPage + i];
@@ -1814,6 +2105,7 @@ mark_page_range_in_use(page_num_t startPage, page_num_t length, bool wired)
 		}
 	}
 
+	enable_page_magazines();
 	return B_OK;
 }
 
@@ -2105,11 +2397,18 @@ PageWriteWrapper::Done(status_t result)
 			// The busy_writing flag was cleared. That means the cache has been
 			// shrunk while we were trying to write the page and we have to free
 			// it now.
-			vm_remove_all_page_mappings(fPage);
+			if (fPage->WiredCount() > 0) {
+				// still in use, see VMCache::_FreePageRange()
+				set_page_state(fPage, PAGE_STATE_WIRED);
+				fCache->RemovePage(fPage);
+				DEBUG_PAGE_ACCESS_END(fPage);
+			} else {
+				vm_remove_all_page_mappings(fPage);
 // TODO: Unmapping should already happen when resizing the cache!
-			fCache->RemovePage(fPage);
-			free_page(fPage, false);
-			unreserve_pages(1);
+				fCache->RemovePage(fPage);
+				free_page(fPage, false);
+				unreserve_pages(1);
+			}
 		} else {
 			// Writing the page failed -- mark the page modified and move it to
 			// an appropriate queue other than the modified queue, so we don't
@@ -2644,8 +2943,12 @@ find_cached_page_candidate(struct vm_page &marker)
 }
 
 
+/*!	Steals the given page from its cache. If \a protectWorkingSet is \c true,
+	pages that have been faulted back in recently (and not yet used up their
+	extra rounds) are requeued instead.
+*/
 static bool
-free_cached_page(vm_page *page, bool dontWait)
+free_cached_page(vm_page *page, bool dontWait, bool protectWorkingSet)
 {
 	// try to lock the page's cache
 	if (vm_cache_acquire_locked_page_cache(page, dontWait) == NULL)
@@ -2664,8 +2967,18 @@ free_cached_page(vm_page *page, bool dontWait)
 	PAGE_ASSERT(page, !page->IsMapped());
 	PAGE_ASSERT(page, !page->modified);
 
+	if (protectWorkingSet && page->usage_count > 0) {
+		page->usage_count--;
+		sCachedPageQueue.RequeueUnlocked(page, true);
+		atomic_add((int32*)&sWorkingSetSecondChances, 1);
+		DEBUG_PAGE_ACCESS_END(page);
+		return false;
+	}
+
 	// we can now steal this page
 
+	cache->AddShadowEntry(page->cache_offset,
+		(uint32)atomic_add((int32*)&sPageEvictionClock, 1));
 	cache->RemovePage(page);
 		// Now the page doesn't have cache anymore, so no one else (e.g.
 		// vm_page_allocate_page_run() can pick it up), since they would be
@@ -2689,7 +3002,7 @@ free_cached_pages(uint32 pagesToFree, bool dontWait)
 		if (page == NULL)
 			break;
 
-		if (free_cached_page(page, dontWait)) {
+		if (free_cached_page(page, dontWait, true)) {
 			ReadLocker locker(sFreePageQueuesLock);
 			page->SetState(PAGE_STATE_FREE);
 			DEBUG_PAGE_ACCESS_END(page);
@@ -3406,6 +3719,13 @@ vm_page_init(kernel_args *args)
 
 	new (&sPageReservationWaiters) PageReservationWaiterList;
 
+	for (int32 i = 0; i < SMP_MAX_CPUS; i++) {
+		page_magazine_store& store = sPageMagazines[i];
+		B_INITIALIZE_SPINLOCK(&store.lock);
+		new (&store.free.pages) VMPageQueue::PageList;
+		new (&store.clear.pages) VMPageQueue::PageList;
+	}
+
 	// map in the new free page table
 	sPages = (vm_page *)vm_allocate_early(args, sNumPages * sizeof(vm_page),
 		~0L, B_KERNEL_READ_AREA | B_KERNEL_WRITE_AREA, 0);
@@ -3660,60 +3980,73 @@ vm_page_allocate_page(vm_page_reservation* reservation, uint32 flags)
 	ASSERT(reservation->count > 0);
 	reservation->count--;
 
-	VMPageQueue* queue;
-	VMPageQueue* otherQueue;
-
-	if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
-		queue = &sClearPageQueue;
-		otherQueue = &sFreePageQueue;
-	} else {
-		queue = &sFreePageQueue;
-		otherQueue = &sClearPageQueue;
-	}
+	// try the current CPU's magazines first
+	int oldPageState;
+	vm_page* page = page_magazine_get(flags, oldPageState);
+	if (page == NULL) {
+		VMPageQueue* queue;
+		VMPageQueue* otherQueue;
 
-	ReadLocker locker(sFreePageQueuesLock);
+		if ((flags & VM_PAGE_ALLOC_CLEAR) != 0) {
+			queue = &sClearPageQueue;
+			otherQueue = &sFreePageQueue;
+		} else {
+			queue = &sFreePageQueue;
+			otherQueue = &sClearPageQueue;
+		}
 
-	vm_page* page = queue->RemoveHeadUnlocked();
-	if (page == NULL) {
-		// if the primary queue was empty, grab the page from the
-		// secondary queue
-		page = otherQueue->RemoveHeadUnlocked();
+		ReadLocker locker(sFreePageQueuesLock);
 
+		page = queue->RemoveHeadUnlocked();
 		if (page == NULL) {
-			// Unlikely, but possible: the page we have reserved has moved
-			// between the queues after we checked the first queue. Grab the
-			// write locker to make sure this doesn't happen again.
-			locker.Unlock();
-			WriteLocker writeLocker(sFreePageQueuesLock);
-
-			page = queue->RemoveHead();
-			if (page == NULL)
-				otherQueue->RemoveHead();
+			// if the primary queue was empty, grab the page from the
+			// secondary queue
+			page = otherQueue->RemoveHeadUnlocked();
 
 			if (page == NULL) {
-				panic("Had reserved page, but there is none!");
-				return NULL;
-			}
+				// Unlikely, but possible: the page we have reserved has moved
+				// between the queues after we checked the first queue, or it
+				// is sitting in another CPU's magazine. Grab the write locker
+				// to make sure this doesn't happen again.
+				locker.Unlock();
+				WriteLocker writeLocker(sFreePageQueuesLock);
+				disable_page_magazines();
+
+				page = queue->RemoveHead();
+				if (page == NULL)
+					page = otherQueue->RemoveHead();
+
+				enable_page_magazines();
+
+				if (page == NULL) {
+					panic("Had reserved page, but there is none!");
+					return NULL;
+				}
 
-			// downgrade to read lock
-			locker.Lock();
+				// downgrade to read lock
+				locker.Lock();
+			}
+		} else {
+			// take a few more pages for the next allocations on this CPU
+			page_magazine_refill(*queue);
 		}
+
+		DEBUG_PAGE_ACCESS_START(page);
+
+		oldPageState = page->State();
+		page->SetState(pageState);
+
+		locker.Unlock();
 	}
 
 	if (page->CacheRef() != NULL)
 		panic("supposed to be free page %p has cache @! page %p; cache _cache", page, page);
 
-	DEBUG_PAGE_ACCESS_START(page);
-
-	int oldPageState = page->State();
-	page->SetState(pageState);
 	page->busy = (flags & VM_PAGE_ALLOC_BUSY) != 0;
 	page->usage_count = 0;
 	page->accessed = false;
 	page->modified = false;
 
-	locker.Unlock();
-
 	if (pageState < PAGE_STATE_FIRST_UNQUEUED)
 		sPageQueues[pageState].AppendUnlocked(page);
 
@@ -3861,7 +4194,7 @@ allocate_page_run(page_num_t start, page_num_t length, uint32 flags,
 
 			// free the page, if it is still cached
 			vm_page& page = sPages[nextIndex];
-			if (!free_cached_page(&page, false)) {
+			if (!free_cached_page(&page, false, false)) {
 				// TODO: if the page turns out to have been freed already,
 				// there would be no need to fail
 				break;
@@ -3983,6 +4316,10 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 
 	WriteLocker freeClearQueueLocker(sFreePageQueuesLock);
 
+	// The magazines stay disabled until we're done, as allocate_page_run()
+	// temporarily unlocks the queues.
+	disable_page_magazines();
+
 	// First we try to get a run with free pages only. If that fails, we also
 	// consider cached pages. If there are only few free pages and many cached
 	// ones, the odds are that we won't find enough contiguous ones, so we skip
@@ -4022,6 +4359,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 				" boundary: %" B_PRIuPHYSADDR ")!\n", length, requestedStart,
 				end, restrictions->alignment, restrictions->boundary);
 
+			enable_page_magazines();
 			freeClearQueueLocker.Unlock();
 			vm_page_unreserve_pages(&reservation);
 			return NULL;
@@ -4042,6 +4380,7 @@ vm_page_allocate_page_run(uint32 flags, page_num_t length,
 		if (foundRun) {
 			i = allocate_page_run(start, length, flags, freeClearQueueLocker);
 			if (i == length) {
+				enable_page_magazines();
 				reservation.count = 0;
 				return &sPages[start];
 			}
@@ -4124,6 +4463,30 @@ vm_page_set_state(vm_page *page, int pageState)
 }
 
 
+/*!	Called by VMCache::InsertPage() when a page is inserted at an offset the
+	page daemon had evicted a page from at \a evictionTime.
+	The page's cache must be locked.
+*/
+void
+vm_page_refault(struct vm_page *page, uint32 evictionTime)
+{
+	atomic_add((int32*)&sPageRefaults, 1);
+
+	// The page would have stayed in memory, if there had been room for
+	// "distance" more pages. Those could have come from the active and
+	// inactive pages.
+	uint32 distance = (uint32)atomic_get((int32*)&sPageEvictionClock)
+		- evictionTime;
+	if (distance > sActivePageQueue.Count() + sInactivePageQueue.Count())
+		return;
+
+	atomic_add((int32*)&sWorkingSetRefaults, 1);
+
+	if (page->usage_count < kPageUsageAdvance)
+		page->usage_count = kPageUsageAdvance;
+}
+
+
 /*!	Moves a page to either the tail of the head of its current queue,
 	depending on \a tail.
 	The page must have a cache and the cache must be locked!
@@ -4229,7 +4592,7 @@ vm_page_get_stats(system_info *info)
 	// So taking out the cached (including modified non-temporary), free and
 	// clear ones leaves us with all used pages.
 	uint32 subtractPages = info->cached_pages + sFreePageQueue.Count()
-		+ sClearPageQueue.Count();
+		+ sClearPageQueue.Count() + count_magazine_pages();
 	info->used_pages = subtractPages > info->max_pages
 		? 0 : info->max_pages - subtractPages;
 
@@ -118,3 +118,20 @@ _get_port_message_info_etc(port_id port, port_message_info *info,
 	return _kern_get_port_message_info_etc(port, info, infoSize, flags,
 		timeout);
 }
+
+
+ssize_t
+write_port_messages_etc(port_id port, const port_message_vec *messages,
+	size_t count, uint32 flags, bigtime_t timeout)
+{
+	return _kern_write_port_messages_etc(port, messages, count, flags,
+		timeout);
+}
+
+
+ssize_t
+read_port_messages_etc(port_id port, port_message_vec *messages, size_t count,
+	uint32 flags, bigtime_t timeout)
+{
+	return _kern_read_port_messages_etc(port, messages, count, flags, timeout);
+}
@@ -25,6 +25,7 @@
 #include <syscalls.h>
 
 #include <libroot_private.h>
+#include <vm_defs.h>
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -96,7 +97,7 @@ __init_heap(void)
 	if (status != B_OK)
 		sHeapBase = NULL;
 
-	uint32 protection = B_READ_AREA | B_WRITE_AREA;
+	uint32 protection = B_READ_AREA | B_WRITE_AREA | B_LARGE_PAGES_AREA;
 	if (__gABIVersion < B_HAIKU_ABI_GCC_2_HAIKU)
 		protection |= B_EXECUTE_AREA;
 	sHeapArea = create_area("heap", (void **)&sHeapBase,
@@ -154,7 +155,7 @@ hoardSbrk(long size)
 	size = (size + hoardHeap::ALIGNMENT - 1) & ~(hoardHeap::ALIGNMENT - 1);
 
 	// choose correct protection flags
-	uint32 protection = B_READ_AREA | B_WRITE_AREA;
+	uint32 protection = B_READ_AREA | B_WRITE_AREA | B_LARGE_PAGES_AREA;
 	if (__gABIVersion < B_HAIKU_ABI_GCC_2_HAIKU)
 		protection |= B_EXECUTE_AREA;
 
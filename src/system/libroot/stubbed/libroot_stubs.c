@@ -1235,6 +1235,7 @@ void _kern_read_index_stat() {}
 void _kern_read_kernel_image_symbols() {}
 void _kern_read_link() {}
 void _kern_read_port_etc() {}
+void _kern_read_port_messages_etc() {}
 void _kern_read_stat() {}
 void _kern_readv() {}
 void _kern_realtime_sem_close() {}
@@ -1355,6 +1356,7 @@ void _kern_write() {}
 void _kern_write_attr() {}
 void _kern_write_fs_info() {}
 void _kern_write_port_etc() {}
+void _kern_write_port_messages_etc() {}
 void _kern_write_stat() {}
 void _kern_writev() {}
 void _kern_writev_port_etc() {}
@@ -2335,6 +2337,7 @@ void re_set_syntax() {}
 void read() {}
 void read_port() {}
 void read_port_etc() {}
+void read_port_messages_etc() {}
 void read_pos() {}
 void readdir() {}
 void readdir_r() {}
@@ -2738,6 +2741,7 @@ void wprintf() {}
 void write() {}
 void write_port() {}
 void write_port_etc() {}
+void write_port_messages_etc() {}
 void write_pos() {}
 void writev() {}
 void writev_pos() {}
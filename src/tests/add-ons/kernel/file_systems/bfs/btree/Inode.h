@@ -32,6 +32,9 @@ class Inode {
 		status_t FindBlockRun(off_t pos, block_run& run, off_t& offset);
 		status_t Append(Transaction&, off_t bytes);
 		status_t SetFileSize(Transaction&, off_t bytes);
+		void WriteLockInTransaction(Transaction&) {}
+		void DirectoryEntryAdded(const uint8*, uint16, ino_t) {}
+		void DirectoryEntryRemoved(const uint8*, uint16) {}
 
 		Volume* GetVolume() const { return fVolume; }
 		off_t ID() const { return 0; }
@@ -534,6 +534,37 @@ duplicateTest(Transaction& transaction, BPlusTree* tree)
 }
 
 
+void
+bulkBuildTest(BPlusTree* tree)
+{
+	printf("*** Building the tree from all keys at once...\n");
+
+	TreeBuilder builder(tree);
+	for (int32 i = 0; i < gNum; i++) {
+		// add some keys more than once to get duplicate fragments and nodes
+		int32 count = 1 + (i % 31 == 0 ? i % 300 : i % 3);
+		for (int32 j = 0; j < count; j++) {
+			status_t status = builder.Add((uint8*)gKeys[i].data,
+				gKeys[i].length, gKeys[i].value);
+			if (status != B_OK) {
+				printf("TreeBuilder::Add() returned: %s\n", strerror(status));
+				bailOutWithKey(gKeys[i].data, gKeys[i].length);
+			}
+			gKeys[i].in++;
+			gTreeCount++;
+		}
+	}
+
+	status_t status = builder.Finish();
+	if (status != B_OK) {
+		printf("TreeBuilder::Finish() returned: %s\n", strerror(status));
+		bailOut();
+	}
+
+	checkTree(tree);
+}
+
+
 void
 addRandomSet(Transaction& transaction, BPlusTree* tree, int32 num)
 {
@@ -768,6 +799,9 @@ main(int argc, char** argv)
 		removeAllKeys(transaction, &tree);
 	}
 
+	bulkBuildTest(&tree);
+	removeAllKeys(transaction, &tree);
+
 	transaction.Done();
 
 	// Of course, we would have to free all our memory in a real application
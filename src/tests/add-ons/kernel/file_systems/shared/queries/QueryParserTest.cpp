@@ -3,6 +3,15 @@
  * Distributed under the terms of the MIT License.
  */
 
+/*!	Runs queries against an in-memory volume with "name", "type", and
+	"rating" indices, and compares their results with those of a brute force
+	search. It also checks which index the query planner chose to iterate,
+	and how many nodes it had to load for that.
+	When queries are passed as arguments, only those are run, and their
+	results are printed.
+*/
+
+
 #include <stdio.h>
 
 #define DEBUG_QUERY
@@ -14,15 +23,76 @@
 #include <file_systems/QueryParser.h>
 
 
-class Entry;
+using QueryParser::compareKeys;
+
+
+static const int32 kEntryCount = 1000;
+
+
+struct TestEntry {
+	ino_t		id;
+	char		name[32];
+	const char*	type;
+	int32		rating;
+};
+
+
+struct IndexEntry {
+	const void*	key;
+	size_t		keyLength;
+	TestEntry*	entry;
+};
+
+
+struct TestIndex {
+	const char*	name;
+	type_code	type;
+	int32		keySize;
+	IndexEntry*	entries;
+	int32		count;
+};
+
+
+class TestVolume {
+public:
+								TestVolume();
+								~TestVolume();
+
+			status_t			Init(int32 entryCount);
+
+			int32				CountEntries() const { return fEntryCount; }
+			TestEntry&			EntryAt(int32 index)
+									{ return fEntries[index]; }
+
+			TestIndex*			FindIndex(const char* name);
+
+			void				ResetStatistics();
+
+private:
+			status_t			_InitIndex(TestIndex& index, const char* name,
+									type_code type);
+
+public:
+			int32				loadedNodes;
+			const char*			iteratedIndex;
+
+private:
+			TestEntry*			fEntries;
+			int32				fEntryCount;
+			TestIndex			fIndices[3];
+};
 
 
 class Query {
 public:
-	static	status_t		Create(void* volume, const char* queryString,
+							~Query();
+
+	static	status_t		Create(TestVolume* volume, const char* queryString,
 								uint32 flags, port_id port, uint32 token,
 								Query*& _query);
 
+			status_t		GetNextEntry(struct dirent* dirent, size_t size);
+
 private:
 	struct QueryPolicy;
 	friend struct QueryPolicy;
@@ -31,8 +101,8 @@ private:
 private:
 							Query();
 
-			status_t		_Init(const char* queryString, uint32 flags,
-								port_id port, uint32 token);
+			status_t		_Init(TestVolume* volume, const char* queryString,
+								uint32 flags, port_id port, uint32 token);
 
 private:
 			QueryImpl*		fImpl;
@@ -40,23 +110,26 @@ private:
 
 
 struct Query::QueryPolicy {
-	typedef Query Context;
-	typedef ::Entry Entry;
-	typedef ::Entry Node;
+	typedef TestVolume Context;
+	typedef TestEntry Entry;
+	typedef TestEntry Node;
 	typedef void* NodeHolder;
 
 	struct Index {
-		Query*		query;
+		TestVolume*	volume;
+		TestIndex*	index;
 
 		Index(Context* context)
 			:
-			query(context)
+			volume(context),
+			index(NULL)
 		{
 		}
 	};
 
 	struct IndexIterator {
-		Entry* entry;
+		TestIndex*	index;
+		int32		position;
 	};
 
 	static const int32 kMaxFileNameLength = B_FILE_NAME_LENGTH;
@@ -65,7 +138,7 @@ struct Query::QueryPolicy {
 
 	static ino_t EntryGetParentID(Entry* entry)
 	{
-		return -1;
+		return 1;
 	}
 
 	static Node* EntryGetNode(Entry* entry)
@@ -75,48 +148,74 @@ struct Query::QueryPolicy {
 
 	static ino_t EntryGetNodeID(Entry* entry)
 	{
-		return -1;
+		return entry->id;
 	}
 
 	static ssize_t EntryGetName(Entry* entry, void* buffer, size_t bufferSize)
 	{
-		return B_ERROR;
+		size_t length = strlcpy((char*)buffer, entry->name, bufferSize);
+		if (length >= bufferSize)
+			return B_BUFFER_OVERFLOW;
+		return length + 1;
 	}
 
 	static const char* EntryGetNameNoCopy(NodeHolder& holder, Entry* entry)
 	{
-		return NULL;
+		return entry->name;
 	}
 
 	// Index interface
 
 	static status_t IndexSetTo(Index& index, const char* attribute)
 	{
-		return B_ERROR;
+		index.index = index.volume->FindIndex(attribute);
+		return index.index != NULL ? B_OK : B_ENTRY_NOT_FOUND;
 	}
 
 	static void IndexUnset(Index& index)
 	{
+		index.index = NULL;
 	}
 
 	static int32 IndexGetSize(Index& index)
 	{
-		return 0;
+		return index.index->count;
+	}
+
+	static int32 IndexEstimateMatches(Index& index, const void* value,
+		size_t size, int32 maxCount)
+	{
+		TestIndex* testIndex = index.index;
+		int32 count = 0;
+		for (int32 i = 0; i < testIndex->count && count < maxCount; i++) {
+			IndexEntry& entry = testIndex->entries[i];
+			if (compareKeys(testIndex->type, entry.key, entry.keyLength, value,
+					size) == 0) {
+				count++;
+			}
+		}
+		return count;
 	}
 
 	static type_code IndexGetType(Index& index)
 	{
-		return 0;
+		return index.index->type;
 	}
 
 	static int32 IndexGetKeySize(Index& index)
 	{
-		return 0;
+		return index.index->keySize;
 	}
 
 	static IndexIterator* IndexCreateIterator(Index& index)
 	{
-		return NULL;
+		IndexIterator* iterator = new(std::nothrow) IndexIterator;
+		if (iterator == NULL)
+			return NULL;
+
+		iterator->index = index.index;
+		iterator->position = 0;
+		return iterator;
 	}
 
 	// IndexIterator interface
@@ -129,19 +228,64 @@ struct Query::QueryPolicy {
 	static status_t IndexIteratorFind(IndexIterator* indexIterator,
 		const void* value, size_t size)
 	{
-		return B_ERROR;
+		TestIndex* index = indexIterator->index;
+
+		int32 position = 0;
+		int compare = -1;
+		for (; position < index->count; position++) {
+			IndexEntry& entry = index->entries[position];
+			compare = compareKeys(index->type, entry.key, entry.keyLength,
+				value, size);
+			if (compare >= 0)
+				break;
+		}
+
+		indexIterator->position = position;
+		return compare == 0 ? B_OK : B_ENTRY_NOT_FOUND;
 	}
 
 	static status_t IndexIteratorFetchNextEntry(IndexIterator* indexIterator,
 		void* value, size_t* _valueLength, size_t bufferSize, size_t* duplicate)
 	{
-		return B_ERROR;
+		TestIndex* index = indexIterator->index;
+		if (indexIterator->position >= index->count)
+			return B_ENTRY_NOT_FOUND;
+
+		IndexEntry& entry = index->entries[indexIterator->position++];
+		if (entry.keyLength >= bufferSize)
+			return B_BUFFER_OVERFLOW;
+
+		memcpy(value, entry.key, entry.keyLength);
+		if (index->type == B_STRING_TYPE)
+			((char*)value)[entry.keyLength] = '\0';
+
+		*_valueLength = entry.keyLength;
+		*duplicate = 0;
+		return B_OK;
+	}
+
+	static status_t IndexIteratorGetEntry(Context* context,
+		IndexIterator* indexIterator, NodeHolder& holder, Entry** _entry)
+	{
+		if (indexIterator->position == 0)
+			return B_BAD_VALUE;
+
+		TestIndex* index = indexIterator->index;
+		*_entry = index->entries[indexIterator->position - 1].entry;
+
+		context->loadedNodes++;
+		context->iteratedIndex = index->name;
+		return B_OK;
 	}
 
-	static status_t IndexIteratorGetEntry(Context* context, IndexIterator* indexIterator,
-		NodeHolder& holder, Entry** _entry)
+	static status_t IndexIteratorGetEntryID(IndexIterator* indexIterator,
+		ino_t* _id)
 	{
-		*_entry = indexIterator->entry;
+		if (indexIterator->position == 0)
+			return B_BAD_VALUE;
+
+		TestIndex* index = indexIterator->index;
+		*_id = index->entries[indexIterator->position - 1].entry->id;
 		return B_OK;
 	}
 
@@ -172,7 +316,26 @@ struct Query::QueryPolicy {
 	static status_t NodeGetAttribute(NodeHolder& nodeHolder, Node* node,
 		const char* attribute, void* buffer, size_t* _size, int32* _type)
 	{
-		return B_ERROR;
+		if (!strcmp(attribute, "type")) {
+			size_t size = strlen(node->type) + 1;
+			if (size > *_size)
+				return B_BUFFER_OVERFLOW;
+
+			memcpy(buffer, node->type, size);
+			*_size = size;
+			*_type = B_STRING_TYPE;
+			return B_OK;
+		}
+		if (!strcmp(attribute, "rating")) {
+			if (sizeof(int32) > *_size)
+				return B_BUFFER_OVERFLOW;
+
+			memcpy(buffer, &node->rating, sizeof(int32));
+			*_size = sizeof(int32);
+			*_type = B_INT32_TYPE;
+			return B_OK;
+		}
+		return B_ENTRY_NOT_FOUND;
 	}
 
 	static Entry* NodeGetFirstReferrer(Node* node)
@@ -189,20 +352,137 @@ struct Query::QueryPolicy {
 
 	static dev_t ContextGetVolumeID(Context* context)
 	{
-		return 0;
+		return 1;
 	}
 };
 
 
+// #pragma mark - TestVolume
+
+
+TestVolume::TestVolume()
+	:
+	loadedNodes(0),
+	iteratedIndex(NULL),
+	fEntries(NULL),
+	fEntryCount(0)
+{
+	memset(fIndices, 0, sizeof(fIndices));
+}
+
+
+TestVolume::~TestVolume()
+{
+	for (int32 i = 0; i < 3; i++)
+		delete[] fIndices[i].entries;
+	delete[] fEntries;
+}
+
+
+status_t
+TestVolume::Init(int32 entryCount)
+{
+	fEntries = new(std::nothrow) TestEntry[entryCount];
+	if (fEntries == NULL)
+		return B_NO_MEMORY;
+
+	fEntryCount = entryCount;
+
+	// Most entries share one of two types, some have a rare one; the ratings
+	// are spread evenly.
+	for (int32 i = 0; i < entryCount; i++) {
+		TestEntry& entry = fEntries[i];
+		entry.id = 100 + i;
+		snprintf(entry.name, sizeof(entry.name), "file%04" B_PRId32, i);
+		if (i % 50 == 0)
+			entry.type = "image/rare";
+		else
+			entry.type = (i % 2) != 0 ? "image/png" : "text/plain";
+		entry.rating = (i / 7) % 10;
+	}
+
+	status_t status = _InitIndex(fIndices[0], "name", B_STRING_TYPE);
+	if (status == B_OK)
+		status = _InitIndex(fIndices[1], "type", B_STRING_TYPE);
+	if (status == B_OK)
+		status = _InitIndex(fIndices[2], "rating", B_INT32_TYPE);
+	return status;
+}
+
+
+TestIndex*
+TestVolume::FindIndex(const char* name)
+{
+	for (int32 i = 0; i < 3; i++) {
+		if (fIndices[i].name != NULL && !strcmp(fIndices[i].name, name))
+			return &fIndices[i];
+	}
+	return NULL;
+}
+
+
+void
+TestVolume::ResetStatistics()
+{
+	loadedNodes = 0;
+	iteratedIndex = NULL;
+}
+
+
+status_t
+TestVolume::_InitIndex(TestIndex& index, const char* name, type_code type)
+{
+	index.entries = new(std::nothrow) IndexEntry[fEntryCount];
+	if (index.entries == NULL)
+		return B_NO_MEMORY;
+
+	index.name = name;
+	index.type = type;
+	index.keySize = type == B_INT32_TYPE ? sizeof(int32) : 0;
+	index.count = fEntryCount;
+
+	for (int32 i = 0; i < fEntryCount; i++) {
+		TestEntry& entry = fEntries[i];
+		IndexEntry& indexEntry = index.entries[i];
+		indexEntry.entry = &entry;
+
+		if (!strcmp(name, "name")) {
+			indexEntry.key = entry.name;
+			indexEntry.keyLength = strlen(entry.name);
+		} else if (!strcmp(name, "type")) {
+			indexEntry.key = entry.type;
+			indexEntry.keyLength = strlen(entry.type);
+		} else {
+			indexEntry.key = &entry.rating;
+			indexEntry.keyLength = sizeof(int32);
+		}
+	}
+
+	// like in a B+tree, duplicates are ordered by their node ID
+	std::sort(index.entries, index.entries + index.count,
+		[type](const IndexEntry& a, const IndexEntry& b) {
+			int compare = compareKeys(type, a.key, a.keyLength, b.key,
+				b.keyLength);
+			if (compare != 0)
+				return compare < 0;
+			return a.entry->id < b.entry->id;
+		});
+	return B_OK;
+}
+
+
+// #pragma mark - Query
+
+
 /*static*/ status_t
-Query::Create(void* volume, const char* queryString, uint32 flags,
+Query::Create(TestVolume* volume, const char* queryString, uint32 flags,
 	port_id port, uint32 token, Query*& _query)
 {
 	Query* query = new(std::nothrow) Query();
 	if (query == NULL)
 		return B_NO_MEMORY;
 
-	status_t error = query->_Init(queryString, flags, port, token);
+	status_t error = query->_Init(volume, queryString, flags, port, token);
 	if (error != B_OK) {
 		delete query;
 		return error;
@@ -220,10 +500,24 @@ Query::Query()
 }
 
 
+Query::~Query()
+{
+	delete fImpl;
+}
+
+
 status_t
-Query::_Init(const char* queryString, uint32 flags, port_id port, uint32 token)
+Query::GetNextEntry(struct dirent* dirent, size_t size)
 {
-	status_t error = QueryImpl::Create(this, queryString, flags, port, token,
+	return fImpl->GetNextEntry(dirent, size);
+}
+
+
+status_t
+Query::_Init(TestVolume* volume, const char* queryString, uint32 flags,
+	port_id port, uint32 token)
+{
+	status_t error = QueryImpl::Create(volume, queryString, flags, port, token,
 		fImpl);
 	if (error != B_OK)
 		return error;
@@ -232,18 +526,194 @@ Query::_Init(const char* queryString, uint32 flags, port_id port, uint32 token)
 }
 
 
-int
-main(int argc, char* argv[])
+// #pragma mark - tests
+
+
+struct query_test {
+	const char*	query;
+	bool		(*matches)(const TestEntry& entry);
+	const char*	index;
+		// the index the planner should iterate, if any
+	bool		onlyMatchesLoaded;
+		// whether the other "==" equations should keep the planner from
+		// loading nodes that don't match
+};
+
+
+static const query_test kTests[] = {
+	{
+		"(type==\"image/rare\")&&(rating==0)",
+		[](const TestEntry& entry) {
+			return !strcmp(entry.type, "image/rare") && entry.rating == 0;
+		},
+		"type", true
+	},
+	{
+		"(rating==3)&&(type==\"text/plain\")",
+		[](const TestEntry& entry) {
+			return entry.rating == 3 && !strcmp(entry.type, "text/plain");
+		},
+		"rating", true
+	},
+	{
+		"(rating==1)&&(type==\"image/png\")&&(name==\"file0151\")",
+		[](const TestEntry& entry) {
+			return entry.rating == 1 && !strcmp(entry.type, "image/png")
+				&& !strcmp(entry.name, "file0151");
+		},
+		"name", true
+	},
+	{
+		"(name==\"file01*\")&&(rating>=5)",
+		[](const TestEntry& entry) {
+			return !strncmp(entry.name, "file01", 6) && entry.rating >= 5;
+		},
+		"name", false
+	},
+	{
+		"rating>7",
+		[](const TestEntry& entry) {
+			return entry.rating > 7;
+		},
+		"rating", true
+	},
+	{
+		"(type==\"does/not/exist\")&&(rating==0)",
+		[](const TestEntry& entry) {
+			return false;
+		},
+		NULL, true
+	},
+};
+
+
+static bool
+run_test(TestVolume& volume, const query_test& test)
 {
-	for (int i = 1; i < argc; i++) {
-		Query* query;
-		status_t error = Query::Create(NULL, argv[i], 0, 0, 0, query);
-		if (error != B_OK) {
-			fprintf(stderr, "Error creating query %d: %s\n", i - 1, strerror(error));
+	printf("%s\n", test.query);
+	volume.ResetStatistics();
+
+	Query* query;
+	status_t status = Query::Create(&volume, test.query, 0, -1, 0, query);
+	if (status != B_OK) {
+		printf("  FAILED: could not create query: %s\n", strerror(status));
+		return false;
+	}
+
+	ino_t* found = new(std::nothrow) ino_t[volume.CountEntries() + 1];
+	if (found == NULL) {
+		delete query;
+		return false;
+	}
+
+	char buffer[sizeof(struct dirent) + B_FILE_NAME_LENGTH];
+	struct dirent* dirent = (struct dirent*)buffer;
+	int32 foundCount = 0;
+	while (query->GetNextEntry(dirent, sizeof(buffer)) == B_OK) {
+		if (foundCount > volume.CountEntries())
+			break;
+		found[foundCount++] = dirent->d_ino;
+	}
+	delete query;
+
+	std::sort(found, found + foundCount);
+
+	bool passed = true;
+
+	int32 expectedCount = 0;
+	for (int32 i = 0; i < volume.CountEntries(); i++) {
+		TestEntry& entry = volume.EntryAt(i);
+		if (!test.matches(entry))
 			continue;
+
+		if (expectedCount >= foundCount
+			|| found[expectedCount] != entry.id) {
+			printf("  FAILED: node %" B_PRIdINO " (%s) missing or out of "
+				"place\n", entry.id, entry.name);
+			passed = false;
+			break;
 		}
-		delete query;
+		expectedCount++;
+	}
+	if (passed && expectedCount != foundCount) {
+		printf("  FAILED: %" B_PRId32 " results, expected %" B_PRId32 "\n",
+			foundCount, expectedCount);
+		passed = false;
+	}
+
+	delete[] found;
+
+	if (test.index != NULL && volume.iteratedIndex != NULL
+		&& strcmp(test.index, volume.iteratedIndex) != 0) {
+		printf("  FAILED: iterated index \"%s\", expected \"%s\"\n",
+			volume.iteratedIndex, test.index);
+		passed = false;
+	}
+	if (test.onlyMatchesLoaded && volume.loadedNodes != foundCount) {
+		printf("  FAILED: loaded %" B_PRId32 " nodes for %" B_PRId32
+			" results\n", volume.loadedNodes, foundCount);
+		passed = false;
+	}
+
+	printf("  %" B_PRId32 " results, %" B_PRId32 " nodes loaded from index "
+		"\"%s\"\n", foundCount, volume.loadedNodes,
+		volume.iteratedIndex != NULL ? volume.iteratedIndex : "-");
+	return passed;
+}
+
+
+static void
+print_results(TestVolume& volume, const char* queryString)
+{
+	volume.ResetStatistics();
+
+	Query* query;
+	status_t error = Query::Create(&volume, queryString, 0, -1, 0, query);
+	if (error != B_OK) {
+		fprintf(stderr, "Error creating query \"%s\": %s\n", queryString,
+			strerror(error));
+		return;
+	}
+
+	char buffer[sizeof(struct dirent) + B_FILE_NAME_LENGTH];
+	struct dirent* dirent = (struct dirent*)buffer;
+	while (query->GetNextEntry(dirent, sizeof(buffer)) == B_OK)
+		printf("  %s\n", dirent->d_name);
+	delete query;
+
+	printf("%" B_PRId32 " nodes loaded from index \"%s\"\n",
+		volume.loadedNodes,
+		volume.iteratedIndex != NULL ? volume.iteratedIndex : "-");
+}
+
+
+int
+main(int argc, char* argv[])
+{
+	TestVolume volume;
+	if (volume.Init(kEntryCount) != B_OK) {
+		fprintf(stderr, "%s: Out of memory\n", argv[0]);
+		return 1;
+	}
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++)
+			print_results(volume, argv[i]);
+		return 0;
+	}
+
+	int failed = 0;
+	for (size_t i = 0; i < sizeof(kTests) / sizeof(kTests[0]); i++) {
+		if (!run_test(volume, kTests[i]))
+			failed++;
+	}
+
+	if (failed > 0) {
+		printf("%d of %d tests failed!\n", failed,
+			(int)(sizeof(kTests) / sizeof(kTests[0])));
+		return 1;
 	}
 
+	printf("All tests passed.\n");
 	return 0;
 }
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures the throughput of the app_server span blending functions in
+	Mpixels/s, once with the scalar, and once with the vectorized versions,
+	and verifies that both produce the same pixels.
+*/
+
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <OS.h>
+
+#include "DrawingModeSIMD.h"
+#include "PatternHandler.h"
+#include "PixelFormat.h"
+
+
+uint32 gSIMDFlags = 0;
+
+
+static const int32 kWidth = 1024;
+static const int32 kHeight = 256;
+
+
+enum span_type {
+	SOLID_SPAN,
+	SUBPIXEL_SPAN,
+	COLOR_SPAN,
+	FIXED_COVER_COLOR_SPAN
+};
+
+struct benchmark_case {
+	const char*		name;
+	drawing_mode	mode;
+	source_alpha	alphaSourceMode;
+	alpha_function	alphaFunctionMode;
+	span_type		type;
+};
+
+static const benchmark_case kCases[] = {
+	{"alpha, solid", B_OP_ALPHA, B_PIXEL_ALPHA, B_ALPHA_OVERLAY, SOLID_SPAN},
+	{"alpha, subpixel", B_OP_ALPHA, B_PIXEL_ALPHA, B_ALPHA_OVERLAY,
+		SUBPIXEL_SPAN},
+	{"alpha, colors", B_OP_ALPHA, B_PIXEL_ALPHA, B_ALPHA_OVERLAY, COLOR_SPAN},
+	{"alpha, colors, cover", B_OP_ALPHA, B_PIXEL_ALPHA, B_ALPHA_OVERLAY,
+		FIXED_COVER_COLOR_SPAN},
+	{"over, solid", B_OP_OVER, B_PIXEL_ALPHA, B_ALPHA_OVERLAY, SOLID_SPAN},
+	{"over, subpixel", B_OP_OVER, B_PIXEL_ALPHA, B_ALPHA_OVERLAY,
+		SUBPIXEL_SPAN},
+	{"over, colors", B_OP_OVER, B_PIXEL_ALPHA, B_ALPHA_OVERLAY, COLOR_SPAN},
+	{"blend, colors", B_OP_BLEND, B_PIXEL_ALPHA, B_ALPHA_OVERLAY, COLOR_SPAN},
+	{"blend, colors, cover", B_OP_BLEND, B_PIXEL_ALPHA, B_ALPHA_OVERLAY,
+		FIXED_COVER_COLOR_SPAN},
+};
+
+
+static uint8*
+create_pixels()
+{
+	uint8* pixels = (uint8*)malloc(kWidth * kHeight * 4);
+	if (pixels == NULL)
+		return NULL;
+
+	srand(42);
+	for (int32 i = 0; i < kWidth * kHeight * 4; i++)
+		pixels[i] = rand();
+
+	return pixels;
+}
+
+
+/*!	Creates cover values that resemble the ones of anti-aliased shapes:
+	mostly fully opaque and fully transparent runs, with edges in between.
+*/
+static void
+fill_covers(uint8* covers, int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		int value = rand() % 8;
+		if (value < 4)
+			covers[i] = 255;
+		else if (value < 5)
+			covers[i] = 0;
+		else
+			covers[i] = rand();
+	}
+}
+
+
+static void
+fill_colors(PixelFormat::color_type* colors, int32 count)
+{
+	for (int32 i = 0; i < count; i++) {
+		colors[i].r = rand();
+		colors[i].g = rand();
+		colors[i].b = rand();
+		colors[i].a = rand() % 4 == 0 ? rand() : 255;
+	}
+}
+
+
+static bigtime_t
+run_case(const benchmark_case& info, uint8* pixels, int32 spanLength,
+	int32 rounds, const uint8* covers, const PixelFormat::color_type* colors)
+{
+	agg::rendering_buffer buffer(pixels, kWidth, kHeight, kWidth * 4);
+
+	PatternHandler pattern;
+	pattern.SetHighColor((rgb_color){ 51, 102, 204, 160 });
+
+	PixelFormat pixelFormat(buffer, &pattern);
+	pixelFormat.SetDrawingMode(info.mode, info.alphaSourceMode,
+		info.alphaFunctionMode);
+
+	PixelFormat::color_type color(51, 102, 204, 160);
+
+	bigtime_t startTime = system_time();
+
+	for (int32 round = 0; round < rounds; round++) {
+		for (int32 y = 0; y < kHeight; y++) {
+			int32 x = (y * 7 + round) % (kWidth - spanLength);
+			int32 offset = (y * 13) % kWidth;
+
+			switch (info.type) {
+				case SOLID_SPAN:
+					pixelFormat.blend_solid_hspan(x, y, spanLength, color,
+						covers + offset);
+					break;
+				case SUBPIXEL_SPAN:
+					pixelFormat.blend_solid_hspan_subpix(x, y, spanLength * 3,
+						color, covers + offset * 3);
+					break;
+				case COLOR_SPAN:
+					pixelFormat.blend_color_hspan(x, y, spanLength,
+						colors + offset, covers + offset, 255);
+					break;
+				case FIXED_COVER_COLOR_SPAN:
+					pixelFormat.blend_color_hspan(x, y, spanLength,
+						colors + offset, NULL, 160);
+					break;
+			}
+		}
+	}
+
+	return system_time() - startTime;
+}
+
+
+static void
+print_usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [span-length [rounds]]\n", name);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 spanLength = 64;
+	int32 rounds = 2000;
+
+	if (argc > 1)
+		spanLength = atol(argv[1]);
+	if (argc > 2)
+		rounds = atol(argv[2]);
+	if (argc > 3 || spanLength < 1 || spanLength >= kWidth || rounds < 1) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	uint32 simdFlags = 0;
+#ifdef APPSERVER_SIMD_BLENDERS
+	simdFlags = APPSERVER_SIMD_BLENDERS;
+#else
+	printf("There are no vectorized blenders for this architecture.\n");
+#endif
+
+	uint8* source = create_pixels();
+	uint8* scalarPixels = (uint8*)malloc(kWidth * kHeight * 4);
+	uint8* simdPixels = (uint8*)malloc(kWidth * kHeight * 4);
+	uint8* covers = (uint8*)malloc(kWidth * 2 * 3);
+	PixelFormat::color_type* colors = new(std::nothrow)
+		PixelFormat::color_type[kWidth * 2];
+	if (source == NULL || scalarPixels == NULL || simdPixels == NULL
+		|| covers == NULL || colors == NULL) {
+		fprintf(stderr, "%s: Out of memory\n", argv[0]);
+		return 1;
+	}
+
+	fill_covers(covers, kWidth * 2 * 3);
+	fill_colors(colors, kWidth * 2);
+
+	printf("%" B_PRId32 " pixel spans, %" B_PRId32 " rounds, Mpixels/s\n\n",
+		spanLength, rounds);
+	printf("%-22s %10s %10s %8s\n", "mode", "scalar", "SIMD", "speedup");
+
+	double pixelCount = (double)spanLength * kHeight * rounds;
+	bool failed = false;
+
+	for (size_t i = 0; i < sizeof(kCases) / sizeof(kCases[0]); i++) {
+		const benchmark_case& info = kCases[i];
+
+		memcpy(scalarPixels, source, kWidth * kHeight * 4);
+		memcpy(simdPixels, source, kWidth * kHeight * 4);
+
+		gSIMDFlags = 0;
+		bigtime_t scalarTime = run_case(info, scalarPixels, spanLength, rounds,
+			covers, colors);
+		gSIMDFlags = simdFlags;
+		bigtime_t simdTime = run_case(info, simdPixels, spanLength, rounds,
+			covers, colors);
+
+		bool identical = memcmp(scalarPixels, simdPixels,
+			kWidth * kHeight * 4) == 0;
+		if (!identical)
+			failed = true;
+
+		double scalarRate = pixelCount / max_c(scalarTime, 1);
+		double simdRate = pixelCount / max_c(simdTime, 1);
+
+		printf("%-22s %10.1f %10.1f %7.2fx%s\n", info.name, scalarRate,
+			simdRate, simdRate / scalarRate,
+			identical ? "" : "  results differ!");
+	}
+
+	free(source);
+	free(scalarPixels);
+	free(simdPixels);
+	free(covers);
+	delete[] colors;
+
+	return failed ? 1 : 0;
+}
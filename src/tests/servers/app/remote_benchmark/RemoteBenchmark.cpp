@@ -0,0 +1,381 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Replays a stream of bitmap drawing commands through the message encoding
+	of the remote desktop protocol and a local ring buffer, once for each
+	combination of bitmap caching and compression. It reports how much data
+	would be sent to the client, how long encoding and decoding took, and
+	the resulting latency per drawing command on a few typical links.
+*/
+
+
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <Bitmap.h>
+#include <OS.h>
+
+#include "RemoteBitmapCache.h"
+#include "RemoteMessage.h"
+#include "StreamingRingBuffer.h"
+
+
+static const int32 kIconCount = 24;
+static const int32 kImageCount = 8;
+static const int32 kBitmapCount = kIconCount + kImageCount;
+
+static const size_t kBitmapCacheSize = 64 * 1024 * 1024;
+
+// links the transfer time is estimated for, in bits per second
+static const double kLinkSpeeds[] = { 1000e6, 100e6, 10e6 };
+
+enum {
+	BENCHMARK_BITMAP = RP_DRAW_BITMAP,
+	BENCHMARK_CACHE_BITMAP = RP_CACHE_BITMAP,
+	BENCHMARK_CACHED_BITMAP = RP_DRAW_CACHED_BITMAP,
+	BENCHMARK_DONE = RP_CLOSE_CONNECTION
+};
+
+struct benchmark_mode {
+	const char*	name;
+	bool		cache;
+	bool		compress;
+};
+
+static const benchmark_mode kModes[] = {
+	{ "raw", false, false },
+	{ "zstd", false, true },
+	{ "cache", true, false },
+	{ "cache, zstd", true, true }
+};
+
+struct benchmark_run {
+	const benchmark_mode*	mode;
+	StreamingRingBuffer*	buffer;
+	BBitmap**				bitmaps;
+	int32					drawCount;
+
+	uint64					bytes;
+	int32					messages;
+	int32					failures;
+};
+
+
+static uint32
+checksum(const BBitmap* bitmap)
+{
+	const uint8* bits = (const uint8*)bitmap->Bits();
+	uint32 a = 1;
+	uint32 b = 0;
+	for (int32 i = 0; i < bitmap->BitsLength(); i++) {
+		a = (a + bits[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+
+/*!	Fills the bitmap with something that resembles user interface graphics:
+	flat areas, gradients and some fine detail.
+*/
+static void
+fill_bitmap(BBitmap* bitmap, int32 seed)
+{
+	BRect bounds = bitmap->Bounds();
+	int32 width = bounds.IntegerWidth() + 1;
+	int32 height = bounds.IntegerHeight() + 1;
+	uint8* bits = (uint8*)bitmap->Bits();
+
+	for (int32 y = 0; y < height; y++) {
+		uint32* row = (uint32*)(bits + y * bitmap->BytesPerRow());
+		for (int32 x = 0; x < width; x++) {
+			uint8 red = 216;
+			uint8 green = 216;
+			uint8 blue = 216;
+
+			int32 dx = x - width / 2;
+			int32 dy = y - height / 2;
+			if (dx * dx + dy * dy < width * height / 6) {
+				red = 255 * x / width;
+				green = (seed * 37) & 0xff;
+				blue = 255 * y / height;
+			}
+
+			if ((y % 12) == 4 && (x + seed) % 9 < 6) {
+				// a line of "text"
+				red = green = blue = (x * 7 + y) % 3 == 0 ? 0 : 64;
+			}
+
+			row[x] = 0xff000000 | (red << 16) | (green << 8) | blue;
+		}
+	}
+}
+
+
+static void
+add_bitmap(RemoteMessage& message, const BBitmap* bitmap, bool encoded,
+	bool compress)
+{
+	if (!encoded) {
+		message.AddBitmap(*bitmap);
+		return;
+	}
+
+	BRect bounds = bitmap->Bounds();
+	message.Add(bounds.IntegerWidth() + 1);
+	message.Add(bounds.IntegerHeight() + 1);
+	message.Add(bitmap->BytesPerRow());
+	message.Add((uint32)bitmap->ColorSpace());
+	message.Add(bitmap->Flags());
+
+	uint32 bitsLength = bitmap->BitsLength();
+	message.Add(bitsLength);
+	message.AddEncodedBits(bitmap->Bits(), bitsLength, compress);
+}
+
+
+static status_t
+writer_thread(void* data)
+{
+	benchmark_run& run = *(benchmark_run*)data;
+	const benchmark_mode& mode = *run.mode;
+
+	RemoteBitmapCache cache(kBitmapCacheSize);
+	RemoteMessage message(NULL, run.buffer);
+
+	srand(42);
+	for (int32 i = 0; i < run.drawCount; i++) {
+		// Icons are drawn most of the time, and one in ten draws shows
+		// changed contents.
+		int32 index = rand() % 4 != 0 ? rand() % kIconCount
+			: kIconCount + rand() % kImageCount;
+		BBitmap* bitmap = run.bitmaps[index];
+		if (rand() % 10 == 0)
+			fill_bitmap(bitmap, i);
+
+		BRect bounds = bitmap->Bounds();
+		uint32 sum = checksum(bitmap);
+
+		if (mode.cache) {
+			bool added;
+			int32 slot = cache.SlotFor(bitmap->Bits(), bitmap->BitsLength(),
+				bounds.IntegerWidth() + 1, bounds.IntegerHeight() + 1,
+				bitmap->BytesPerRow(), bitmap->ColorSpace(), added);
+			if (slot >= 0) {
+				if (added) {
+					message.Start(BENCHMARK_CACHE_BITMAP);
+					message.Add(slot);
+					add_bitmap(message, bitmap, true, mode.compress);
+				}
+
+				message.Start(BENCHMARK_CACHED_BITMAP);
+				message.Add(sum);
+				message.Add(slot);
+				continue;
+			}
+		}
+
+		message.Start(BENCHMARK_BITMAP);
+		message.Add(sum);
+		add_bitmap(message, bitmap, mode.compress, mode.compress);
+	}
+
+	message.Start(BENCHMARK_DONE);
+	message.Flush();
+	return B_OK;
+}
+
+
+static void
+read_messages(benchmark_run& run)
+{
+	const benchmark_mode& mode = *run.mode;
+	BBitmap* cached[kRemoteBitmapCacheSlots] = {};
+
+	RemoteMessage message(run.buffer, NULL);
+	while (true) {
+		uint16 code;
+		if (message.NextMessage(code) != B_OK) {
+			run.failures++;
+			break;
+		}
+
+		run.bytes += message.DataLeft() + sizeof(uint16) + sizeof(uint32);
+		run.messages++;
+
+		if (code == BENCHMARK_DONE)
+			break;
+
+		if (code == BENCHMARK_CACHE_BITMAP) {
+			int32 slot;
+			BBitmap* bitmap;
+			if (message.Read(slot) != B_OK || slot < 0
+				|| slot >= kRemoteBitmapCacheSlots
+				|| message.ReadEncodedBitmap(&bitmap) != B_OK) {
+				run.failures++;
+				continue;
+			}
+
+			delete cached[slot];
+			cached[slot] = bitmap;
+			continue;
+		}
+
+		uint32 sum;
+		message.Read(sum);
+
+		if (code == BENCHMARK_CACHED_BITMAP) {
+			int32 slot;
+			if (message.Read(slot) != B_OK || slot < 0
+				|| slot >= kRemoteBitmapCacheSlots || cached[slot] == NULL
+				|| checksum(cached[slot]) != sum) {
+				run.failures++;
+			}
+			continue;
+		}
+
+		BBitmap* bitmap = NULL;
+		status_t result = mode.compress ? message.ReadEncodedBitmap(&bitmap)
+			: message.ReadBitmap(&bitmap);
+		if (result != B_OK || checksum(bitmap) != sum)
+			run.failures++;
+
+		delete bitmap;
+	}
+
+	for (int32 i = 0; i < kRemoteBitmapCacheSlots; i++)
+		delete cached[i];
+}
+
+
+static BBitmap**
+create_bitmaps()
+{
+	BBitmap** bitmaps = new(std::nothrow) BBitmap*[kBitmapCount];
+	if (bitmaps == NULL)
+		return NULL;
+
+	for (int32 i = 0; i < kBitmapCount; i++) {
+		BRect bounds = i < kIconCount
+			? BRect(0, 0, i % 2 == 0 ? 31 : 63, i % 2 == 0 ? 31 : 63)
+			: BRect(0, 0, 319, 239);
+		bitmaps[i] = new(std::nothrow) BBitmap(bounds,
+			B_BITMAP_NO_SERVER_LINK, B_RGB32);
+		if (bitmaps[i] == NULL || bitmaps[i]->InitCheck() != B_OK)
+			return NULL;
+
+		fill_bitmap(bitmaps[i], i);
+	}
+
+	return bitmaps;
+}
+
+
+static void
+delete_bitmaps(BBitmap** bitmaps)
+{
+	if (bitmaps == NULL)
+		return;
+
+	for (int32 i = 0; i < kBitmapCount; i++)
+		delete bitmaps[i];
+	delete[] bitmaps;
+}
+
+
+static void
+print_usage(const char* name)
+{
+	fprintf(stderr, "Usage: %s [draw-count]\n", name);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 drawCount = 2000;
+	if (argc > 1)
+		drawCount = atol(argv[1]);
+	if (argc > 2 || drawCount < 1) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	if ((RemoteMessage::SupportedCapabilities()
+			& RP_CAPABILITY_ZSTD_COMPRESSION) == 0) {
+		printf("zstd is not available, the compressed modes send raw "
+			"data.\n");
+	}
+
+	printf("%" B_PRId32 " bitmap draws; latency per draw in ms on a 1000, "
+		"100, and 10 Mbit/s link\n\n", drawCount);
+	printf("%-12s %10s %8s %8s %8s %8s %8s\n", "mode", "KiB", "ratio",
+		"cpu ms", "1000", "100", "10");
+
+	bool failed = false;
+	uint64 rawBytes = 0;
+
+	for (size_t i = 0; i < sizeof(kModes) / sizeof(kModes[0]); i++) {
+		StreamingRingBuffer buffer(64 * 1024);
+		BBitmap** bitmaps = create_bitmaps();
+		if (buffer.InitCheck() != B_OK || bitmaps == NULL) {
+			fprintf(stderr, "%s: Out of memory\n", argv[0]);
+			delete_bitmaps(bitmaps);
+			return 1;
+		}
+
+		benchmark_run run;
+		run.mode = &kModes[i];
+		run.buffer = &buffer;
+		run.bitmaps = bitmaps;
+		run.drawCount = drawCount;
+		run.bytes = 0;
+		run.messages = 0;
+		run.failures = 0;
+
+		bigtime_t startTime = system_time();
+
+		thread_id writer = spawn_thread(&writer_thread, "remote writer",
+			B_NORMAL_PRIORITY, &run);
+		if (writer < 0) {
+			fprintf(stderr, "%s: Could not spawn thread\n", argv[0]);
+			delete_bitmaps(bitmaps);
+			return 1;
+		}
+
+		resume_thread(writer);
+		read_messages(run);
+
+		status_t result;
+		wait_for_thread(writer, &result);
+
+		bigtime_t time = system_time() - startTime;
+		delete_bitmaps(bitmaps);
+
+		if (i == 0)
+			rawBytes = run.bytes;
+
+		printf("%-12s %10.1f %7.2fx %8.1f", run.mode->name,
+			run.bytes / 1024.0, (double)rawBytes / max_c(run.bytes, 1),
+			time / 1000.0);
+
+		for (size_t j = 0; j < sizeof(kLinkSpeeds) / sizeof(kLinkSpeeds[0]);
+				j++) {
+			double transferTime = run.bytes * 8 / kLinkSpeeds[j] * 1000;
+			printf(" %8.3f", (transferTime + time / 1000.0) / drawCount);
+		}
+
+		if (run.failures > 0) {
+			printf("  %" B_PRId32 " failed!", run.failures);
+			failed = true;
+		}
+		printf("\n");
+	}
+
+	return failed ? 1 : 0;
+}
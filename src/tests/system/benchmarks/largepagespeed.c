@@ -0,0 +1,184 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Compares the random access latency of an area mapped with regular pages
+	to that of an area created with the B_LARGE_PAGES_AREA hint.
+
+	The kernel maps the latter with large pages in the background, after the
+	area's memory has been touched. Since the benchmark follows a pointer
+	chain through all pages of the area in random order, it is dominated by
+	TLB misses as soon as the area is larger than what the TLB can cover,
+	which large pages should considerably reduce.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <OS.h>
+
+#include <vm_defs.h>
+
+
+#define MB				(1024 * 1024)
+#define CACHE_LINE_SIZE	64
+#define ROUNDS			3
+
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: largepagespeed [-s <area size in MB>] "
+		"[-w <seconds to wait for large pages>] [-i <iterations>]\n");
+	exit(1);
+}
+
+
+static char*
+create_test_area(const char* name, size_t size, uint32 flags)
+{
+	void* address;
+	area_id area = create_area(name, &address, B_ANY_ADDRESS, size,
+		B_NO_LOCK, B_READ_AREA | B_WRITE_AREA | flags);
+	if (area < 0) {
+		fprintf(stderr, "largepagespeed: could not create area: %s\n",
+			strerror(area));
+		exit(1);
+	}
+
+	return (char*)address;
+}
+
+
+static void**
+chain_slot(char* buffer, size_t page)
+{
+	// Vary the offset within the pages, so that all accesses don't end up in
+	// the same cache set.
+	return (void**)(buffer + page * B_PAGE_SIZE
+		+ page % (B_PAGE_SIZE / CACHE_LINE_SIZE) * CACHE_LINE_SIZE);
+}
+
+
+/*!	Links all pages of \a buffer into a single cycle in random order, and
+	returns its start. This also touches all pages of the buffer.
+*/
+static void**
+build_chain(char* buffer, size_t size)
+{
+	size_t pageCount = size / B_PAGE_SIZE;
+	size_t* order = (size_t*)malloc(pageCount * sizeof(size_t));
+	size_t i;
+
+	if (order == NULL) {
+		fprintf(stderr, "largepagespeed: out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < pageCount; i++)
+		order[i] = i;
+
+	srandom(42);
+	for (i = pageCount - 1; i > 0; i--) {
+		size_t j = (size_t)random() % (i + 1);
+		size_t temp = order[i];
+		order[i] = order[j];
+		order[j] = temp;
+	}
+
+	for (i = 0; i < pageCount; i++) {
+		*chain_slot(buffer, order[i])
+			= chain_slot(buffer, order[(i + 1) % pageCount]);
+	}
+
+	void** start = chain_slot(buffer, order[0]);
+	free(order);
+	return start;
+}
+
+
+static bigtime_t
+follow_chain(void** start, long iterations)
+{
+	void** pointer = start;
+	bigtime_t time = system_time();
+	long i;
+
+	for (i = 0; i < iterations; i++)
+		pointer = (void**)*pointer;
+
+	time = system_time() - time;
+
+	// make sure the loop can't be optimized away
+	if (pointer == NULL)
+		printf("\n");
+
+	return time;
+}
+
+
+static double
+measure(const char* what, void** start, long iterations)
+{
+	bigtime_t best = B_INFINITE_TIMEOUT;
+	int round;
+
+	for (round = 0; round < ROUNDS; round++) {
+		bigtime_t time = follow_chain(start, iterations);
+		if (time < best)
+			best = time;
+	}
+
+	double nanoseconds = (double)best * 1000 / iterations;
+	printf("%-14s %8.2f ns per access\n", what, nanoseconds);
+	return nanoseconds;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	size_t size = 512 * MB;
+	int wait = 30;
+	long iterations = 10000000;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:w:i:")) != -1) {
+		switch (c) {
+			case 's':
+				size = (size_t)strtoul(optarg, NULL, 0) * MB;
+				break;
+			case 'w':
+				wait = atoi(optarg);
+				break;
+			case 'i':
+				iterations = strtol(optarg, NULL, 0);
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (optind != argc || size == 0 || iterations <= 0)
+		usage();
+
+	char* regular = create_test_area("regular pages", size, 0);
+	char* large = create_test_area("large pages", size, B_LARGE_PAGES_AREA);
+
+	void** regularChain = build_chain(regular, size);
+	void** largeChain = build_chain(large, size);
+
+	printf("area size: %lu MB, waiting %d seconds for large pages...\n",
+		(unsigned long)(size / MB), wait);
+	sleep(wait);
+
+	double regularTime = measure("regular pages:", regularChain, iterations);
+	double largeTime = measure("large pages:", largeChain, iterations);
+
+	printf("speedup: %.2fx\n", regularTime / largeTime);
+	return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+/*!	Measures how well block_cache_get()/block_cache_put() of already cached
+	blocks scale with the number of threads. Every thread works on its own
+	range of blocks, but as the shard of a block is selected by the lower
+	bits of its number, all threads use all shards; the test measures how
+	well the contention is spread across the shards.
+*/
+
+
+#define read_pos	block_cache_read_pos
+
+#include "block_cache.cpp"
+
+#undef read_pos
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define MAX_THREADS			32
+#define BLOCKS_PER_THREAD	256
+#define BLOCK_SIZE			2048
+
+
+static block_cache* sCache;
+static int32 sIterations = 200000;
+static sem_id sStartSemaphore;
+static int32 sBlockErrors;
+
+
+ssize_t
+block_cache_read_pos(int fd, off_t offset, void* buffer, size_t size)
+{
+	memset(buffer, 0, size);
+	*(off_t*)buffer = offset / BLOCK_SIZE;
+	return size;
+}
+
+
+static status_t
+contention_thread(void* _index)
+{
+	int32 index = (int32)(addr_t)_index;
+	off_t firstBlock = index * BLOCKS_PER_THREAD;
+
+	acquire_sem(sStartSemaphore);
+
+	for (int32 i = 0; i < sIterations; i++) {
+		off_t blockNumber = firstBlock + i % BLOCKS_PER_THREAD;
+
+		const void* block = block_cache_get(sCache, blockNumber);
+		if (block == NULL || *(const off_t*)block != blockNumber)
+			atomic_add(&sBlockErrors, 1);
+		else
+			block_cache_put(sCache, blockNumber);
+	}
+
+	return B_OK;
+}
+
+
+static void
+run_test(int32 threadCount)
+{
+	thread_id threads[MAX_THREADS];
+	sStartSemaphore = create_sem(0, "start");
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(&contention_thread, "contention",
+			B_NORMAL_PRIORITY, (void*)(addr_t)i);
+		resume_thread(threads[i]);
+	}
+
+	bigtime_t start = system_time();
+	release_sem_etc(sStartSemaphore, threadCount, 0);
+
+	for (int32 i = 0; i < threadCount; i++) {
+		status_t status;
+		wait_for_thread(threads[i], &status);
+	}
+
+	bigtime_t duration = system_time() - start;
+	delete_sem(sStartSemaphore);
+
+	double operations = (double)threadCount * sIterations;
+	printf("%2" B_PRId32 " threads: %10.0f get/put pairs per second, "
+		"%6.1f ns per pair\n", threadCount,
+		operations * 1000000.0 / duration, duration * 1000.0 / operations);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 maxThreads = 16;
+	if (argc > 1)
+		maxThreads = min_c(max_c(atoi(argv[1]), 1), MAX_THREADS);
+	if (argc > 2)
+		sIterations = max_c(atoi(argv[2]), 1);
+
+	block_cache_init();
+
+	sCache = (block_cache*)block_cache_create(-1,
+		MAX_THREADS * BLOCKS_PER_THREAD, BLOCK_SIZE, true);
+	if (sCache == NULL) {
+		fprintf(stderr, "Could not create block cache!\n");
+		return 1;
+	}
+
+	// populate the cache, so that only lookups are measured
+	for (off_t i = 0; i < MAX_THREADS * BLOCKS_PER_THREAD; i++) {
+		block_cache_get(sCache, i);
+		block_cache_put(sCache, i);
+	}
+
+	for (int32 threads = 1; threads <= maxThreads; threads *= 2)
+		run_test(threads);
+
+	uint64 locklessGets = 0;
+	for (uint32 i = 0; i < kBlockShardCount; i++)
+		locklessGets += sCache->shards[i].lockless_gets;
+
+	printf("%" B_PRIu64 " gets did not need the cache lock, %" B_PRId32
+		" errors.\n", locklessGets, sBlockErrors);
+
+	block_cache_delete(sCache, false);
+	return sBlockErrors != 0 ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures file cache throughput depending on the size of the read() and
+	write() requests.
+
+	With -w, the file is first written once per request size (truncating it
+	before, and syncing it after each pass). Then it is read once per request
+	size. Note that reads are only served from disk if the file is not in the
+	cache yet, ie. when the file is larger than the available memory, or the
+	volume has been mounted freshly; use -b to read it with a single request
+	size in that case.
+*/
+
+
+#include <OS.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+extern const char* __progname;
+
+static const size_t kMinRequestSize = 4 * 1024;
+static const size_t kMaxRequestSize = 16 * 1024 * 1024;
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s [-w] [-s <file size in MB>] "
+		"[-b <request size in KB>] <file>\n", __progname);
+	exit(1);
+}
+
+
+static void
+print_result(const char* what, size_t requestSize, off_t bytes,
+	bigtime_t time)
+{
+	if (time <= 0)
+		time = 1;
+
+	printf("%-5s %8" B_PRIuSIZE " KB: %10.1f MB/s  (%" B_PRIdOFF " bytes in %"
+		B_PRIdBIGTIME " usecs)\n", what,
+		requestSize / 1024, (double)bytes / time * 1000000 / (1024 * 1024),
+		bytes, time);
+}
+
+
+static status_t
+write_pass(const char* path, off_t fileSize, size_t requestSize, char* buffer)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "%s: could not create \"%s\": %s\n", __progname, path,
+			strerror(errno));
+		return errno;
+	}
+
+	bigtime_t start = system_time();
+	off_t written = 0;
+
+	while (written < fileSize) {
+		size_t bytes = requestSize;
+		if (fileSize - written < (off_t)bytes)
+			bytes = fileSize - written;
+
+		ssize_t bytesWritten = write(fd, buffer, bytes);
+		if (bytesWritten <= 0) {
+			fprintf(stderr, "%s: writing failed: %s\n", __progname,
+				strerror(errno));
+			close(fd);
+			return B_IO_ERROR;
+		}
+
+		written += bytesWritten;
+	}
+
+	fsync(fd);
+	print_result("write", requestSize, written, system_time() - start);
+
+	close(fd);
+	return B_OK;
+}
+
+
+static status_t
+read_pass(const char* path, size_t requestSize, char* buffer)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: could not open \"%s\": %s\n", __progname, path,
+			strerror(errno));
+		return errno;
+	}
+
+	bigtime_t start = system_time();
+	off_t total = 0;
+
+	while (true) {
+		ssize_t bytesRead = read(fd, buffer, requestSize);
+		if (bytesRead < 0) {
+			fprintf(stderr, "%s: reading failed: %s\n", __progname,
+				strerror(errno));
+			close(fd);
+			return B_IO_ERROR;
+		}
+		if (bytesRead == 0)
+			break;
+
+		total += bytesRead;
+	}
+
+	print_result("read", requestSize, total, system_time() - start);
+
+	close(fd);
+	return B_OK;
+}
+
+
+int
+main(int argc, char** argv)
+{
+	off_t fileSize = 256LL * 1024 * 1024;
+	size_t onlyRequestSize = 0;
+	bool doWrite = false;
+
+	int c;
+	while ((c = getopt(argc, argv, "ws:b:")) != -1) {
+		switch (c) {
+			case 'w':
+				doWrite = true;
+				break;
+			case 's':
+				fileSize = strtoll(optarg, NULL, 0) * 1024 * 1024;
+				break;
+			case 'b':
+				onlyRequestSize = strtoul(optarg, NULL, 0) * 1024;
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (optind + 1 != argc || fileSize <= 0)
+		usage();
+
+	const char* path = argv[optind];
+
+	size_t minSize = kMinRequestSize;
+	size_t maxSize = kMaxRequestSize;
+	if (onlyRequestSize != 0)
+		minSize = maxSize = onlyRequestSize;
+
+	char* buffer = (char*)malloc(maxSize);
+	if (buffer == NULL) {
+		fprintf(stderr, "%s: out of memory\n", __progname);
+		return 1;
+	}
+	memset(buffer, 0x55, maxSize);
+
+	if (doWrite) {
+		for (size_t size = minSize; size <= maxSize; size *= 2) {
+			if (write_pass(path, fileSize, size, buffer) != B_OK)
+				return 1;
+		}
+	}
+
+	for (size_t size = minSize; size <= maxSize; size *= 2) {
+		if (read_pass(path, size, buffer) != B_OK)
+			return 1;
+	}
+
+	free(buffer);
+	return 0;
+}
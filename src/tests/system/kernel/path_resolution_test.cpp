@@ -9,6 +9,14 @@
 #include <OS.h>
 
 
+static const int32 kMaxThreads = 64;
+
+struct parallel_info {
+	const char*	path;
+	int32		iterations;
+};
+
+
 static void
 time_lstat(const char* path)
 {
@@ -27,6 +35,50 @@ time_lstat(const char* path)
 }
 
 
+static status_t
+lstat_thread(void* _info)
+{
+	parallel_info* info = (parallel_info*)_info;
+
+	for (int32 i = 0; i < info->iterations; i++) {
+		struct stat st;
+		lstat(info->path, &st);
+	}
+
+	return B_OK;
+}
+
+
+/*!	Lets \a threadCount threads lstat() the same path at the same time, and
+	prints the combined throughput.
+*/
+static void
+time_parallel_lstat(const char* path, int32 threadCount)
+{
+	static const int32 iterations = 100000;
+	thread_id threads[kMaxThreads];
+	parallel_info info = { path, iterations };
+
+	printf("%-48s %3" B_PRId32 " threads ...", path, threadCount);
+	fflush(stdout);
+
+	for (int32 i = 0; i < threadCount; i++) {
+		threads[i] = spawn_thread(lstat_thread, "lstat", B_NORMAL_PRIORITY,
+			&info);
+	}
+
+	bigtime_t startTime = system_time();
+	for (int32 i = 0; i < threadCount; i++)
+		resume_thread(threads[i]);
+	for (int32 i = 0; i < threadCount; i++)
+		wait_for_thread(threads[i], NULL);
+
+	bigtime_t totalTime = system_time() - startTime;
+	printf(" %9.0f calls/s\n",
+		(double)iterations * threadCount * 1000000 / totalTime);
+}
+
+
 int
 main()
 {
@@ -44,5 +96,23 @@ main()
 	for (int32 i = 0; paths[i] != NULL; i++)
 		time_lstat(paths[i]);
 
+	// parallel lookups of the same entries, existing and missing ones
+	const char* const parallelPaths[] = {
+		"/boot/develop/headers/posix/sys/stat.h",
+		"/boot/develop/headers/posix/sys/does-not-exist.h",
+		NULL
+	};
+
+	system_info info;
+	get_system_info(&info);
+
+	for (int32 i = 0; parallelPaths[i] != NULL; i++) {
+		for (int32 threadCount = 1; threadCount <= (int32)info.cpu_count
+				&& threadCount <= kMaxThreads;
+				threadCount *= 2) {
+			time_parallel_lstat(parallelPaths[i], threadCount);
+		}
+	}
+
 	return 0;
 }
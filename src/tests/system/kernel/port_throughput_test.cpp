@@ -0,0 +1,384 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+/*!	Measures the throughput of a port with a single writer and a single
+	reader for different message sizes, and the round trip latency between
+	two threads ping-ponging a message over two ports.
+
+	The reader uses port_buffer_size() followed by read_port(), just like
+	BLooper does. All messages are checked to arrive in order; every other
+	message of the mixed size pass is larger than what the kernel can pass
+	through its preallocated message slots.
+	A last pass moves the messages in bursts using write_port_messages_etc()
+	and read_port_messages_etc().
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <OS.h>
+
+
+extern const char* __progname;
+
+static const int32 kPortCapacity = 100;
+static const size_t kMaxMessageSize = 8192;
+static const size_t kMessageSizes[] = { 16, 128, 512, 1024, 4096 };
+static const size_t kBurstCount = 16;
+
+
+struct throughput_info {
+	port_id		port;
+	int32		count;
+	size_t		size;
+	bool		mixed;
+	bool		batched;
+	int32		errors;
+};
+
+
+static size_t
+message_size(const throughput_info& info, int32 index)
+{
+	if (info.mixed && (index % 2) != 0)
+		return kMaxMessageSize;
+	return info.size;
+}
+
+
+static status_t
+writer_thread(void* _info)
+{
+	throughput_info& info = *(throughput_info*)_info;
+	char buffer[kMaxMessageSize];
+	memset(buffer, 0x55, sizeof(buffer));
+
+	for (int32 i = 0; i < info.count; i++) {
+		status_t status = write_port(info.port, i, buffer,
+			message_size(info, i));
+		if (status != B_OK) {
+			fprintf(stderr, "%s: write_port() failed: %s\n", __progname,
+				strerror(status));
+			return status;
+		}
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+batch_writer_thread(void* _info)
+{
+	throughput_info& info = *(throughput_info*)_info;
+	char buffer[kMaxMessageSize];
+	memset(buffer, 0x55, sizeof(buffer));
+
+	port_message_vec messages[kBurstCount];
+	int32 written = 0;
+	while (written < info.count) {
+		size_t count = std::min((size_t)(info.count - written), kBurstCount);
+		for (size_t i = 0; i < count; i++) {
+			messages[i].code = written + i;
+			messages[i].buffer = buffer;
+			messages[i].size = message_size(info, written + i);
+		}
+
+		ssize_t result = write_port_messages_etc(info.port, messages, count,
+			0, 0);
+		if (result < 0) {
+			fprintf(stderr, "%s: write_port_messages_etc() failed: %s\n",
+				__progname, strerror(result));
+			return result;
+		}
+		written += result;
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+batch_reader_thread(void* _info)
+{
+	throughput_info& info = *(throughput_info*)_info;
+	char buffers[kBurstCount][kMaxMessageSize];
+
+	port_message_vec messages[kBurstCount];
+	int32 read = 0;
+	while (read < info.count) {
+		for (size_t i = 0; i < kBurstCount; i++) {
+			messages[i].buffer = buffers[i];
+			messages[i].size = kMaxMessageSize;
+		}
+
+		ssize_t result = read_port_messages_etc(info.port, messages,
+			kBurstCount, 0, 0);
+		if (result < 0) {
+			fprintf(stderr, "%s: read_port_messages_etc() failed: %s\n",
+				__progname, strerror(result));
+			return result;
+		}
+
+		for (ssize_t i = 0; i < result; i++, read++) {
+			if (messages[i].code != read
+				|| messages[i].size != message_size(info, read)) {
+				if (info.errors++ == 0) {
+					fprintf(stderr, "%s: expected message %" B_PRId32 " of %"
+						B_PRIuSIZE " bytes, got %" B_PRId32 " of %"
+						B_PRIuSIZE "\n", __progname, read,
+						message_size(info, read), messages[i].code,
+						messages[i].size);
+				}
+			}
+		}
+	}
+
+	return B_OK;
+}
+
+
+static status_t
+reader_thread(void* _info)
+{
+	throughput_info& info = *(throughput_info*)_info;
+	char buffer[kMaxMessageSize];
+
+	for (int32 i = 0; i < info.count; i++) {
+		ssize_t size = port_buffer_size(info.port);
+		if (size < 0) {
+			fprintf(stderr, "%s: port_buffer_size() failed: %s\n",
+				__progname, strerror(size));
+			return size;
+		}
+
+		int32 code;
+		ssize_t bytesRead = read_port(info.port, &code, buffer,
+			sizeof(buffer));
+		if (bytesRead < 0) {
+			fprintf(stderr, "%s: read_port() failed: %s\n", __progname,
+				strerror(bytesRead));
+			return bytesRead;
+		}
+
+		if (code != i || size != bytesRead
+			|| (size_t)bytesRead != message_size(info, i)) {
+			if (info.errors++ == 0) {
+				fprintf(stderr, "%s: expected message %" B_PRId32 " of %"
+					B_PRIuSIZE " bytes, got %" B_PRId32 " of %" B_PRIdSSIZE
+					" (announced %" B_PRIdSSIZE ")\n", __progname, i,
+					message_size(info, i), code, bytesRead, size);
+			}
+		}
+	}
+
+	return B_OK;
+}
+
+
+static bool
+measure_throughput(int32 count, size_t size, bool mixed, bool batched)
+{
+	throughput_info info;
+	info.port = create_port(kPortCapacity, "throughput test");
+	info.count = count;
+	info.size = size;
+	info.mixed = mixed;
+	info.batched = batched;
+	info.errors = 0;
+
+	if (info.port < 0) {
+		fprintf(stderr, "%s: could not create port: %s\n", __progname,
+			strerror(info.port));
+		return false;
+	}
+
+	bigtime_t start = system_time();
+
+	thread_id reader = spawn_thread(
+		batched ? batch_reader_thread : reader_thread, "port reader",
+		B_NORMAL_PRIORITY, &info);
+	thread_id writer = spawn_thread(
+		batched ? batch_writer_thread : writer_thread, "port writer",
+		B_NORMAL_PRIORITY, &info);
+	resume_thread(reader);
+	resume_thread(writer);
+
+	status_t readerStatus;
+	status_t writerStatus;
+	wait_for_thread(writer, &writerStatus);
+	wait_for_thread(reader, &readerStatus);
+
+	bigtime_t time = std::max(system_time() - start, (bigtime_t)1);
+	delete_port(info.port);
+
+	double bytes = (double)count * size;
+	if (mixed)
+		bytes += (double)(count / 2) * (kMaxMessageSize - size);
+
+	if (batched)
+		printf("batched %5" B_PRIuSIZE " bytes: ", size);
+	else if (mixed) {
+		printf("mixed %5" B_PRIuSIZE "/%" B_PRIuSIZE " bytes: ", size,
+			kMaxMessageSize);
+	} else
+		printf("%5" B_PRIuSIZE " bytes: ", size);
+
+	printf("%10.0f messages/s, %8.1f MB/s%s\n",
+		(double)count * 1000000 / time,
+		bytes * 1000000 / time / (1024 * 1024),
+		info.errors != 0 ? "  (ORDER ERRORS)" : "");
+
+	return writerStatus == B_OK && readerStatus == B_OK && info.errors == 0;
+}
+
+
+struct latency_info {
+	port_id		ping;
+	port_id		pong;
+	int32		count;
+};
+
+
+static status_t
+echo_thread(void* _info)
+{
+	latency_info& info = *(latency_info*)_info;
+	char buffer[64];
+
+	for (int32 i = 0; i < info.count; i++) {
+		int32 code;
+		ssize_t bytesRead = read_port(info.ping, &code, buffer,
+			sizeof(buffer));
+		if (bytesRead < 0)
+			return bytesRead;
+
+		status_t status = write_port(info.pong, code, buffer, bytesRead);
+		if (status != B_OK)
+			return status;
+	}
+
+	return B_OK;
+}
+
+
+static int
+compare_times(const void* _a, const void* _b)
+{
+	bigtime_t a = *(const bigtime_t*)_a;
+	bigtime_t b = *(const bigtime_t*)_b;
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+
+static bool
+measure_latency(int32 count)
+{
+	latency_info info;
+	info.ping = create_port(1, "latency ping");
+	info.pong = create_port(1, "latency pong");
+	info.count = count;
+
+	bigtime_t* times = (bigtime_t*)malloc(count * sizeof(bigtime_t));
+	if (info.ping < 0 || info.pong < 0 || times == NULL) {
+		fprintf(stderr, "%s: could not create ports\n", __progname);
+		return false;
+	}
+
+	thread_id echo = spawn_thread(echo_thread, "port echo", B_NORMAL_PRIORITY,
+		&info);
+	resume_thread(echo);
+
+	char buffer[64];
+	memset(buffer, 0x55, sizeof(buffer));
+
+	bool success = true;
+	for (int32 i = 0; i < count; i++) {
+		bigtime_t start = system_time();
+
+		int32 code;
+		if (write_port(info.ping, i, buffer, sizeof(buffer)) != B_OK
+			|| read_port(info.pong, &code, buffer, sizeof(buffer)) < 0
+			|| code != i) {
+			fprintf(stderr, "%s: round trip %" B_PRId32 " failed\n",
+				__progname, i);
+			success = false;
+			break;
+		}
+
+		times[i] = system_time() - start;
+	}
+
+	delete_port(info.ping);
+	delete_port(info.pong);
+	wait_for_thread(echo, NULL);
+
+	if (success) {
+		bigtime_t total = 0;
+		for (int32 i = 0; i < count; i++)
+			total += times[i];
+
+		qsort(times, count, sizeof(bigtime_t), compare_times);
+
+		printf("round trip: %.2f us average, %" B_PRIdBIGTIME " us median, %"
+			B_PRIdBIGTIME " us 99th percentile, %" B_PRIdBIGTIME " us max\n",
+			(double)total / count, times[count / 2], times[count * 99 / 100],
+			times[count - 1]);
+	}
+
+	free(times);
+	return success;
+}
+
+
+static void
+usage()
+{
+	fprintf(stderr, "usage: %s [-c <message count>] [-l <round trips>]\n",
+		__progname);
+	exit(1);
+}
+
+
+int
+main(int argc, char** argv)
+{
+	int32 count = 200000;
+	int32 roundTrips = 20000;
+
+	int c;
+	while ((c = getopt(argc, argv, "c:l:")) != -1) {
+		switch (c) {
+			case 'c':
+				count = strtol(optarg, NULL, 0);
+				break;
+			case 'l':
+				roundTrips = strtol(optarg, NULL, 0);
+				break;
+			default:
+				usage();
+		}
+	}
+
+	if (optind != argc || count <= 0 || roundTrips <= 0)
+		usage();
+
+	bool success = true;
+	for (size_t i = 0; i < sizeof(kMessageSizes) / sizeof(kMessageSizes[0]);
+			i++) {
+		success &= measure_throughput(count, kMessageSizes[i], false, false);
+	}
+	success &= measure_throughput(count, kMessageSizes[0], true, false);
+	success &= measure_throughput(count, kMessageSizes[0], false, true);
+
+	success &= measure_latency(roundTrips);
+
+	return success ? 0 : 1;
+}
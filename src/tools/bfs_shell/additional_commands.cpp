@@ -7,6 +7,7 @@
 #include "fssh.h"
 
 #include "command_checkfs.h"
+#include "command_defragfs.h"
 #include "command_resizefs.h"
 
 
@@ -18,6 +19,8 @@ register_additional_commands()
 {
 	CommandManager::Default()->AddCommand(command_checkfs, "checkfs",
 		"check file system");
+	CommandManager::Default()->AddCommand(command_defragfs, "defragfs",
+		"defragment file system");
 	CommandManager::Default()->AddCommand(command_resizefs, "resizefs",
 		"resize file system");
 }
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2026, Haiku, Inc. All rights reserved.
+ * Distributed under the terms of the MIT License.
+ */
+
+
+#include "fssh_stdio.h"
+#include "syscalls.h"
+
+#include "bfs.h"
+#include "bfs_control.h"
+
+
+namespace FSShell {
+
+
+fssh_status_t
+command_defragfs(int argc, const char* const* argv)
+{
+	if (argc == 2 && !strcmp(argv[1], "--help")) {
+		fssh_dprintf("Usage: %s [-a]\n"
+			"  -a  Analyze only; don't perform any changes\n", argv[0]);
+		return B_OK;
+	}
+
+	bool analyzeOnly = false;
+	if (argc == 2 && !strcmp(argv[1], "-a"))
+		analyzeOnly = true;
+
+	int rootDir = _kern_open_dir(-1, "/myfs");
+	if (rootDir < 0)
+		return rootDir;
+
+	struct defragment_control result;
+	memset(&result, 0, sizeof(result));
+	result.magic = BFS_IOCTL_DEFRAGMENT_MAGIC;
+	result.flags = BFS_DEFRAGMENT_FILES | BFS_DEFRAGMENT_BPLUSTREES;
+	if (analyzeOnly)
+		result.flags |= BFS_DEFRAGMENT_ANALYZE_ONLY;
+
+	// start defragmenting
+	fssh_status_t status = _kern_ioctl(rootDir, BFS_IOCTL_START_DEFRAGMENTING,
+		&result, sizeof(result));
+	if (status != B_OK) {
+		_kern_close(rootDir);
+		return status;
+	}
+
+	uint64 counter = 0;
+
+	// visit all nodes, and report the fragmented ones
+	while (_kern_ioctl(rootDir, BFS_IOCTL_DEFRAGMENT_NEXT_NODE, &result,
+			sizeof(result)) == B_OK) {
+		if (++counter % 50 == 0) {
+			fssh_dprintf("%9" FSSH_B_PRIu64 " nodes processed\x1b[1A\n",
+				counter);
+		}
+
+		if (result.runs > 1 && result.status != B_OK) {
+			fssh_dprintf("%s (inode = %" FSSH_B_PRIdINO "), %" FSSH_B_PRIu32
+				" extents: %s\n", result.name, result.inode, result.runs,
+				fssh_strerror(result.status));
+		}
+	}
+
+	// stop defragmenting
+	if (_kern_ioctl(rootDir, BFS_IOCTL_STOP_DEFRAGMENTING, &result,
+			sizeof(result)) != B_OK) {
+		_kern_close(rootDir);
+		return errno;
+	}
+
+	_kern_close(rootDir);
+
+	fssh_dprintf("        %" FSSH_B_PRIu64 " nodes visited,\n\t%"
+		FSSH_B_PRIu64 " fragmented,\n\t%" FSSH_B_PRIu64 " defragmented,\n\t%"
+		FSSH_B_PRIu64 " skipped\n\n", result.stats.inodes,
+		result.stats.fragmented, result.stats.defragmented,
+		result.stats.skipped);
+	fssh_dprintf("\textents before\t%" FSSH_B_PRIu64 "\n\textents after\t%"
+		FSSH_B_PRIu64 "\n\tmoved\t\t%" FSSH_B_PRIu64 " bytes\n",
+		result.stats.runs_before, result.stats.runs_after,
+		result.stats.moved_blocks * result.stats.block_size);
+
+	if (result.status == B_ENTRY_NOT_FOUND)
+		result.status = B_OK;
+
+	return result.status;
+}
+
+
+}	// namespace FSShell
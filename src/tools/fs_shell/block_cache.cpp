@@ -160,6 +160,7 @@ struct cache_transaction {
 	ListenerList	listeners;
 	bool			open;
 	bool			has_sub_transaction;
+	bool			held;
 };
 
 
@@ -390,6 +391,7 @@ cache_transaction::cache_transaction()
 	notification_data = NULL;
 	open = true;
 	has_sub_transaction = false;
+	held = false;
 }
 
 
@@ -1014,7 +1016,8 @@ fssh_cache_sync_transaction(void* _cache, int32_t id)
 			cache->transaction_hash, &iterator)) != NULL) {
 		// close all earlier transactions which haven't been closed yet
 
-		if (transaction->id <= id && !transaction->open) {
+		if (transaction->id <= id && !transaction->open
+			&& !transaction->held) {
 			// write back all of their remaining dirty blocks
 			while (transaction->num_blocks > 0) {
 				status = write_cached_block(cache, transaction->blocks.Head(),
@@ -1101,6 +1104,36 @@ fssh_cache_end_transaction(void* _cache, int32_t id,
 }
 
 
+fssh_status_t
+fssh_cache_hold_transaction_blocks(void* _cache, int32_t id)
+{
+	block_cache* cache = (block_cache*)_cache;
+	MutexLocker locker(&cache->lock);
+
+	cache_transaction* transaction = lookup_transaction(cache, id);
+	if (transaction == NULL)
+		return FSSH_B_BAD_VALUE;
+
+	transaction->held = true;
+	return FSSH_B_OK;
+}
+
+
+fssh_status_t
+fssh_cache_release_transaction_blocks(void* _cache, int32_t id)
+{
+	block_cache* cache = (block_cache*)_cache;
+	MutexLocker locker(&cache->lock);
+
+	cache_transaction* transaction = lookup_transaction(cache, id);
+	if (transaction == NULL)
+		return FSSH_B_BAD_VALUE;
+
+	transaction->held = false;
+	return FSSH_B_OK;
+}
+
+
 fssh_status_t
 fssh_cache_abort_transaction(void* _cache, int32_t id)
 {
@@ -1547,6 +1580,10 @@ fssh_block_cache_sync(void* _cache)
 
 	cached_block* block;
 	while ((block = (cached_block*)hash_next(cache->hash, &iterator)) != NULL) {
+		if (block->previous_transaction != NULL
+			&& block->previous_transaction->held)
+			continue;
+
 		if (block->previous_transaction != NULL
 			|| (block->transaction == NULL && block->is_dirty)) {
 			fssh_status_t status = write_cached_block(cache, block);
@@ -1583,6 +1620,10 @@ fssh_block_cache_sync_etc(void* _cache, fssh_off_t blockNumber,
 		if (block == NULL)
 			continue;
 
+		if (block->previous_transaction != NULL
+			&& block->previous_transaction->held)
+			continue;
+
 		if (block->previous_transaction != NULL
 			|| (block->transaction == NULL && block->is_dirty)) {
 			fssh_status_t status = write_cached_block(cache, block);
@@ -1608,6 +1649,12 @@ fssh_block_cache_discard(void* _cache, fssh_off_t blockNumber,
 		if (block == NULL)
 			continue;
 
+		if (block->previous_transaction != NULL
+			&& block->previous_transaction->held) {
+			// the block still has to be written back later
+			continue;
+		}
+
 		if (block->previous_transaction != NULL)
 			write_cached_block(cache, block);
 